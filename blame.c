@@ -1256,10 +1256,11 @@ static int bloom_count_queries = 0;
 static int bloom_count_no = 0;
 static int maybe_changed_path(struct repository *r,
 			      struct blame_origin *origin,
+			      int nth_parent,
 			      struct blame_bloom_data *bd)
 {
 	int i;
-	struct bloom_filter *filter;
+	struct bloom_filter *filter, parent_filter;
 
 	if (!bd)
 		return 1;
@@ -1267,7 +1268,13 @@ static int maybe_changed_path(struct repository *r,
 	if (commit_graph_generation(origin->commit) == GENERATION_NUMBER_INFINITY)
 		return 1;
 
-	filter = get_bloom_filter(r, origin->commit);
+	if (nth_parent) {
+		if (!get_parent_bloom_filter(r, origin->commit, nth_parent,
+					     &parent_filter))
+			return 1;
+		filter = &parent_filter;
+	} else
+		filter = get_bloom_filter(r, origin->commit);
 
 	if (!filter)
 		return 1;
@@ -1343,10 +1350,18 @@ static struct blame_origin *find_origin(struct repository *r,
 		do_diff_cache(get_commit_tree_oid(parent), &diff_opts);
 	else {
 		int compute_diff = 1;
-		if (origin->commit->parents &&
-		    oideq(&parent->object.oid,
-			  &origin->commit->parents->item->object.oid))
-			compute_diff = maybe_changed_path(r, origin, bd);
+		struct commit_list *parents;
+		int nth_parent;
+
+		for (parents = origin->commit->parents, nth_parent = 0;
+		     parents; parents = parents->next, nth_parent++) {
+			if (oideq(&parent->object.oid,
+				  &parents->item->object.oid)) {
+				compute_diff = maybe_changed_path(r, origin,
+								  nth_parent, bd);
+				break;
+			}
+		}
 
 		if (compute_diff)
 			diff_tree_oid(get_commit_tree_oid(parent),
@@ -0,0 +1,160 @@
+/*
+ * SHA-1 block functions using the SHA instructions of x86 and ARMv8
+ * CPUs. Which one (if any) gets used is decided at runtime, see
+ * blk_SHA1_backends.
+ */
+#include "../git-compat-util.h"
+#include "../hash.h"
+#include "../compat/hw-sha.h"
+
+#include "sha1.h"
+
+#ifdef HAVE_X86_SHA_NI
+/*
+ * Rounds 4*i to 4*i+3. w[] holds the message schedule for the current
+ * and the next three groups of rounds; as we go, each entry is
+ * replaced with the schedule for four groups later. The instructions
+ * compute E for the next group along with the rounds, so we alternate
+ * between two registers for it.
+ */
+#define SHA_NI_ROUNDS(i, e, e_next) do { \
+	if (!(i)) \
+		e = _mm_add_epi32(e, w[0]); \
+	else \
+		e = _mm_sha1nexte_epu32(e, w[(i) & 3]); \
+	e_next = abcd; \
+	if ((i) >= 3 && (i) <= 18) \
+		w[((i) + 1) & 3] = _mm_sha1msg2_epu32(w[((i) + 1) & 3], \
+						      w[(i) & 3]); \
+	abcd = _mm_sha1rnds4_epu32(abcd, e, (i) / 5); \
+	if ((i) >= 1 && (i) <= 16) \
+		w[((i) + 3) & 3] = _mm_sha1msg1_epu32(w[((i) + 3) & 3], \
+						      w[(i) & 3]); \
+	if ((i) >= 2 && (i) <= 17) \
+		w[((i) + 2) & 3] = _mm_xor_si128(w[((i) + 2) & 3], \
+						 w[(i) & 3]); \
+} while (0)
+
+X86_SHA_NI_TARGET
+void blk_SHA1_blocks_sha_ni(uint32_t *H, const unsigned char *data, size_t nr)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL,
+					     0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e0, e0_save, e1, w[4];
+	int i;
+
+	abcd = _mm_loadu_si128((const __m128i *)H);
+	abcd = _mm_shuffle_epi32(abcd, 0x1b);
+	e0 = _mm_set_epi32(H[4], 0, 0, 0);
+
+	for (; nr; nr--, data += 64) {
+		abcd_save = abcd;
+		e0_save = e0;
+
+		for (i = 0; i < 4; i++)
+			w[i] = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)(data + 16 * i)),
+				bswap);
+
+		SHA_NI_ROUNDS(0, e0, e1);
+		SHA_NI_ROUNDS(1, e1, e0);
+		SHA_NI_ROUNDS(2, e0, e1);
+		SHA_NI_ROUNDS(3, e1, e0);
+		SHA_NI_ROUNDS(4, e0, e1);
+		SHA_NI_ROUNDS(5, e1, e0);
+		SHA_NI_ROUNDS(6, e0, e1);
+		SHA_NI_ROUNDS(7, e1, e0);
+		SHA_NI_ROUNDS(8, e0, e1);
+		SHA_NI_ROUNDS(9, e1, e0);
+		SHA_NI_ROUNDS(10, e0, e1);
+		SHA_NI_ROUNDS(11, e1, e0);
+		SHA_NI_ROUNDS(12, e0, e1);
+		SHA_NI_ROUNDS(13, e1, e0);
+		SHA_NI_ROUNDS(14, e0, e1);
+		SHA_NI_ROUNDS(15, e1, e0);
+		SHA_NI_ROUNDS(16, e0, e1);
+		SHA_NI_ROUNDS(17, e1, e0);
+		SHA_NI_ROUNDS(18, e0, e1);
+		SHA_NI_ROUNDS(19, e1, e0);
+
+		e0 = _mm_sha1nexte_epu32(e0, e0_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	abcd = _mm_shuffle_epi32(abcd, 0x1b);
+	_mm_storeu_si128((__m128i *)H, abcd);
+	H[4] = _mm_extract_epi32(e0, 3);
+}
+#endif
+
+#ifdef HAVE_ARM_SHA
+static const uint32_t sha1_k[4] = {
+	0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6,
+};
+
+/*
+ * Rounds 4*i to 4*i+3, replacing w[i & 3] with the message schedule
+ * for four groups of rounds later.
+ */
+#define ARMV8_ROUNDS(i, e, e_next) do { \
+	wk = vaddq_u32(w[(i) & 3], vdupq_n_u32(sha1_k[(i) / 5])); \
+	e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0)); \
+	if ((i) < 5) \
+		abcd = vsha1cq_u32(abcd, e, wk); \
+	else if ((i) >= 10 && (i) < 15) \
+		abcd = vsha1mq_u32(abcd, e, wk); \
+	else \
+		abcd = vsha1pq_u32(abcd, e, wk); \
+	if ((i) < 16) \
+		w[(i) & 3] = vsha1su1q_u32( \
+			vsha1su0q_u32(w[(i) & 3], w[((i) + 1) & 3], \
+				      w[((i) + 2) & 3]), \
+			w[((i) + 3) & 3]); \
+} while (0)
+
+ARM_SHA_TARGET
+void blk_SHA1_blocks_armv8(uint32_t *H, const unsigned char *data, size_t nr)
+{
+	uint32x4_t abcd, abcd_save, wk, w[4];
+	uint32_t e0, e0_save, e1;
+	int i;
+
+	abcd = vld1q_u32(H);
+	e0 = H[4];
+
+	for (; nr; nr--, data += 64) {
+		abcd_save = abcd;
+		e0_save = e0;
+
+		for (i = 0; i < 4; i++)
+			w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+
+		ARMV8_ROUNDS(0, e0, e1);
+		ARMV8_ROUNDS(1, e1, e0);
+		ARMV8_ROUNDS(2, e0, e1);
+		ARMV8_ROUNDS(3, e1, e0);
+		ARMV8_ROUNDS(4, e0, e1);
+		ARMV8_ROUNDS(5, e1, e0);
+		ARMV8_ROUNDS(6, e0, e1);
+		ARMV8_ROUNDS(7, e1, e0);
+		ARMV8_ROUNDS(8, e0, e1);
+		ARMV8_ROUNDS(9, e1, e0);
+		ARMV8_ROUNDS(10, e0, e1);
+		ARMV8_ROUNDS(11, e1, e0);
+		ARMV8_ROUNDS(12, e0, e1);
+		ARMV8_ROUNDS(13, e1, e0);
+		ARMV8_ROUNDS(14, e0, e1);
+		ARMV8_ROUNDS(15, e1, e0);
+		ARMV8_ROUNDS(16, e0, e1);
+		ARMV8_ROUNDS(17, e1, e0);
+		ARMV8_ROUNDS(18, e0, e1);
+		ARMV8_ROUNDS(19, e1, e0);
+
+		e0 += e0_save;
+		abcd = vaddq_u32(abcd, abcd_save);
+	}
+
+	vst1q_u32(H, abcd);
+	H[4] = e0;
+}
+#endif
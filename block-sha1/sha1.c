@@ -8,6 +8,8 @@
 
 /* this is only to get definitions for memcpy(), ntohl() and htonl() */
 #include "../git-compat-util.h"
+#include "../hash.h"
+#include "../compat/hw-sha.h"
 
 #include "sha1.h"
 
@@ -62,16 +64,16 @@
 #define T_40_59(t, A, B, C, D, E) SHA_ROUND(t, SHA_MIX, ((B&C)+(D&(B^C))) , 0x8f1bbcdc, A, B, C, D, E )
 #define T_60_79(t, A, B, C, D, E) SHA_ROUND(t, SHA_MIX, (B^C^D) ,  0xca62c1d6, A, B, C, D, E )
 
-static void blk_SHA1_Block(blk_SHA_CTX *ctx, const void *block)
+static void blk_SHA1_Block(uint32_t *H, const void *block)
 {
 	unsigned int A,B,C,D,E;
 	unsigned int array[16];
 
-	A = ctx->H[0];
-	B = ctx->H[1];
-	C = ctx->H[2];
-	D = ctx->H[3];
-	E = ctx->H[4];
+	A = H[0];
+	B = H[1];
+	C = H[2];
+	D = H[3];
+	E = H[4];
 
 	/* Round 1 - iterations 0-16 take their input from 'block' */
 	T_0_15( 0, A, B, C, D, E);
@@ -163,11 +165,54 @@ static void blk_SHA1_Block(blk_SHA_CTX *ctx, const void *block)
 	T_60_79(78, C, D, E, A, B);
 	T_60_79(79, B, C, D, E, A);
 
-	ctx->H[0] += A;
-	ctx->H[1] += B;
-	ctx->H[2] += C;
-	ctx->H[3] += D;
-	ctx->H[4] += E;
+	H[0] += A;
+	H[1] += B;
+	H[2] += C;
+	H[3] += D;
+	H[4] += E;
+}
+
+void blk_SHA1_blocks_portable(uint32_t *H, const unsigned char *data, size_t nr)
+{
+	for (; nr; nr--, data += 64)
+		blk_SHA1_Block(H, data);
+}
+
+static int blk_SHA1_portable_supported(void)
+{
+	return 1;
+}
+
+#ifdef HAVE_X86_SHA_NI
+static int blk_SHA1_sha_ni_supported(void)
+{
+	return x86_have_sha_ni();
+}
+#endif
+
+#ifdef HAVE_ARM_SHA
+static int blk_SHA1_armv8_supported(void)
+{
+	return arm_have_sha1();
+}
+#endif
+
+const struct git_hash_backend blk_SHA1_backends[] = {
+#ifdef HAVE_X86_SHA_NI
+	{ "sha-ni", blk_SHA1_sha_ni_supported, blk_SHA1_blocks_sha_ni },
+#endif
+#ifdef HAVE_ARM_SHA
+	{ "armv8", blk_SHA1_armv8_supported, blk_SHA1_blocks_armv8 },
+#endif
+	{ "portable", blk_SHA1_portable_supported, blk_SHA1_blocks_portable },
+	{ NULL }
+};
+
+static git_hash_blocks_fn blk_SHA1_blocks = blk_SHA1_blocks_portable;
+
+void blk_SHA1_use_backend(const struct git_hash_backend *backend)
+{
+	blk_SHA1_blocks = backend->blocks;
 }
 
 void blk_SHA1_Init(blk_SHA_CTX *ctx)
@@ -199,12 +244,14 @@ void blk_SHA1_Update(blk_SHA_CTX *ctx, const void *data, size_t len)
 		data = ((const char *)data + left);
 		if (lenW)
 			return;
-		blk_SHA1_Block(ctx, ctx->W);
+		blk_SHA1_blocks(ctx->H, (const unsigned char *)ctx->W, 1);
 	}
-	while (len >= 64) {
-		blk_SHA1_Block(ctx, data);
-		data = ((const char *)data + 64);
-		len -= 64;
+	if (len >= 64) {
+		size_t nr = len / 64;
+
+		blk_SHA1_blocks(ctx->H, data, nr);
+		data = ((const char *)data + nr * 64);
+		len -= nr * 64;
 	}
 	if (len)
 		memcpy(ctx->W, data, len);
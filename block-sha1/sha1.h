@@ -6,9 +6,12 @@
  * none of the original Mozilla code remains.
  */
 
+#ifndef BLOCK_SHA1_SHA1_H
+#define BLOCK_SHA1_SHA1_H
+
 typedef struct {
 	unsigned long long size;
-	unsigned int H[5];
+	uint32_t H[5];
 	unsigned int W[16];
 } blk_SHA_CTX;
 
@@ -16,7 +19,24 @@ void blk_SHA1_Init(blk_SHA_CTX *ctx);
 void blk_SHA1_Update(blk_SHA_CTX *ctx, const void *dataIn, size_t len);
 void blk_SHA1_Final(unsigned char hashout[20], blk_SHA_CTX *ctx);
 
+extern const struct git_hash_backend blk_SHA1_backends[];
+void blk_SHA1_use_backend(const struct git_hash_backend *backend);
+
+void blk_SHA1_blocks_portable(uint32_t *H, const unsigned char *data, size_t nr);
+void blk_SHA1_blocks_sha_ni(uint32_t *H, const unsigned char *data, size_t nr);
+void blk_SHA1_blocks_armv8(uint32_t *H, const unsigned char *data, size_t nr);
+
+/*
+ * With SHA1_DC, sha1dc borrows the block functions above for the blocks
+ * that cannot be part of a collision attack; don't take over from it.
+ */
+#ifndef SHA1_DC
 #define platform_SHA_CTX	blk_SHA_CTX
 #define platform_SHA1_Init	blk_SHA1_Init
 #define platform_SHA1_Update	blk_SHA1_Update
 #define platform_SHA1_Final	blk_SHA1_Final
+#define platform_SHA1_backends	blk_SHA1_backends
+#define platform_SHA1_use_backend	blk_SHA1_use_backend
+#endif
+
+#endif
@@ -58,6 +58,48 @@ static int load_bloom_filter_from_graph(struct commit_graph *g,
 	return 1;
 }
 
+static int load_parent_bloom_filter_from_graph(struct commit_graph *g,
+					       struct bloom_filter *filter,
+					       uint32_t graph_pos,
+					       int nth_parent)
+{
+	uint32_t lex_pos, pos, end;
+	int i;
+
+	while (graph_pos < g->num_commits_in_base)
+		g = g->base_graph;
+
+	if (!g->chunk_merge_bloom_indexes)
+		return 0;
+
+	lex_pos = graph_pos - g->num_commits_in_base;
+
+	end = get_be32(g->chunk_merge_bloom_indexes + 4 * lex_pos);
+	if (lex_pos > 0)
+		pos = get_be32(g->chunk_merge_bloom_indexes + 4 * (lex_pos - 1));
+	else
+		pos = 0;
+	if (pos > end || end > g->merge_bloom_data_size)
+		return 0;
+
+	/* Each filter is preceded by its length, and the first is for the second parent. */
+	for (i = 1; end - pos >= 4; i++) {
+		uint32_t len = get_be32(g->chunk_merge_bloom_data + pos);
+
+		pos += 4;
+		if (len > end - pos)
+			return 0;
+		if (i == nth_parent) {
+			filter->len = len;
+			filter->data = (unsigned char *)(g->chunk_merge_bloom_data + pos);
+			return len > 0;
+		}
+		pos += len;
+	}
+
+	return 0;
+}
+
 /*
  * Calculate the murmur3 32-bit hash value for the given data
  * using the given seed.
@@ -143,6 +185,40 @@ void clear_bloom_key(struct bloom_key *key)
 	FREE_AND_NULL(key->hashes);
 }
 
+struct bloom_keyvec *bloom_keyvec_new(const char *path, size_t len,
+				      const struct bloom_filter_settings *settings)
+{
+	struct bloom_keyvec *vec;
+	size_t i, count = 1;
+
+	for (i = 0; i < len; i++)
+		if (path[i] == '/')
+			count++;
+
+	vec = xcalloc(1, st_add(sizeof(*vec),
+				st_mult(sizeof(struct bloom_key), count)));
+	vec->count = count;
+
+	fill_bloom_key(path, len, &vec->key[0], settings);
+	count = 1;
+	for (i = len - 1; i > 0; i--)
+		if (path[i] == '/')
+			fill_bloom_key(path, i, &vec->key[count++], settings);
+
+	return vec;
+}
+
+void bloom_keyvec_free(struct bloom_keyvec *vec)
+{
+	size_t i;
+
+	if (!vec)
+		return;
+	for (i = 0; i < vec->count; i++)
+		clear_bloom_key(&vec->key[i]);
+	free(vec);
+}
+
 void add_key_to_filter(const struct bloom_key *key,
 		       struct bloom_filter *filter,
 		       const struct bloom_filter_settings *settings)
@@ -183,49 +259,27 @@ static void init_truncated_large_filter(struct bloom_filter *filter)
 	filter->len = 1;
 }
 
-struct bloom_filter *get_or_compute_bloom_filter(struct repository *r,
-						 struct commit *c,
-						 int compute_if_not_present,
-						 const struct bloom_filter_settings *settings,
-						 enum bloom_filter_computed *computed)
+/*
+ * Fill "filter" with the paths that differ between "old" (or the empty
+ * tree if NULL) and "new", in newly allocated memory.
+ */
+static void compute_bloom_filter(struct repository *r,
+				 const struct object_id *old,
+				 const struct object_id *new,
+				 const struct bloom_filter_settings *settings,
+				 struct bloom_filter *filter,
+				 enum bloom_filter_computed *computed)
 {
-	struct bloom_filter *filter;
 	int i;
 	struct diff_options diffopt;
 
-	if (computed)
-		*computed = BLOOM_NOT_COMPUTED;
-
-	if (!bloom_filters.slab_size)
-		return NULL;
-
-	filter = bloom_filter_slab_at(&bloom_filters, c);
-
-	if (!filter->data) {
-		uint32_t graph_pos;
-		if (repo_find_commit_pos_in_graph(r, c, &graph_pos))
-			load_bloom_filter_from_graph(r->objects->commit_graph,
-						     filter, graph_pos);
-	}
-
-	if (filter->data && filter->len)
-		return filter;
-	if (!compute_if_not_present)
-		return NULL;
-
 	repo_diff_setup(r, &diffopt);
 	diffopt.flags.recursive = 1;
 	diffopt.detect_rename = 0;
 	diffopt.max_changes = settings->max_changed_paths;
 	diff_setup_done(&diffopt);
 
-	/* ensure commit is parsed so we have parent information */
-	repo_parse_commit(r, c);
-
-	if (c->parents)
-		diff_tree_oid(&c->parents->item->object.oid, &c->object.oid, "", &diffopt);
-	else
-		diff_tree_oid(NULL, &c->object.oid, "", &diffopt);
+	diff_tree_oid(old, new, "", &diffopt);
 	diffcore_std(&diffopt);
 
 	if (diff_queued_diff.nr <= settings->max_changed_paths) {
@@ -302,10 +356,76 @@ struct bloom_filter *get_or_compute_bloom_filter(struct repository *r,
 
 	free(diff_queued_diff.queue);
 	DIFF_QUEUE_CLEAR(&diff_queued_diff);
+}
+
+struct bloom_filter *get_or_compute_bloom_filter(struct repository *r,
+						 struct commit *c,
+						 int compute_if_not_present,
+						 const struct bloom_filter_settings *settings,
+						 enum bloom_filter_computed *computed)
+{
+	struct bloom_filter *filter;
+
+	if (computed)
+		*computed = BLOOM_NOT_COMPUTED;
+
+	if (!bloom_filters.slab_size)
+		return NULL;
+
+	filter = bloom_filter_slab_at(&bloom_filters, c);
+
+	if (!filter->data) {
+		uint32_t graph_pos;
+		if (repo_find_commit_pos_in_graph(r, c, &graph_pos))
+			load_bloom_filter_from_graph(r->objects->commit_graph,
+						     filter, graph_pos);
+	}
+
+	if (filter->data && filter->len)
+		return filter;
+	if (!compute_if_not_present)
+		return NULL;
 
+	/* ensure commit is parsed so we have parent information */
+	repo_parse_commit(r, c);
+
+	compute_bloom_filter(r, c->parents ? &c->parents->item->object.oid : NULL,
+			     &c->object.oid, settings, filter, computed);
 	return filter;
 }
 
+int get_or_compute_parent_bloom_filter(struct repository *r,
+				       struct commit *c, int nth_parent,
+				       int compute_if_not_present,
+				       const struct bloom_filter_settings *settings,
+				       struct bloom_filter *filter,
+				       enum bloom_filter_computed *computed)
+{
+	struct commit_list *parent;
+	uint32_t graph_pos;
+	int i;
+
+	if (computed)
+		*computed = BLOOM_NOT_COMPUTED;
+
+	if (repo_find_commit_pos_in_graph(r, c, &graph_pos) &&
+	    load_parent_bloom_filter_from_graph(r->objects->commit_graph,
+						filter, graph_pos, nth_parent))
+		return 1;
+	if (!compute_if_not_present)
+		return 0;
+
+	repo_parse_commit(r, c);
+	for (parent = c->parents, i = 0; parent && i < nth_parent; i++)
+		parent = parent->next;
+	if (!parent)
+		return 0;
+
+	compute_bloom_filter(r, &parent->item->object.oid, &c->object.oid,
+			     settings, filter, computed);
+	return 1;
+}
+
 int bloom_filter_contains(const struct bloom_filter *filter,
 			  const struct bloom_key *key,
 			  const struct bloom_filter_settings *settings)
@@ -325,3 +445,16 @@ int bloom_filter_contains(const struct bloom_filter *filter,
 
 	return 1;
 }
+
+int bloom_filter_contains_vec(const struct bloom_filter *filter,
+			      const struct bloom_keyvec *vec,
+			      const struct bloom_filter_settings *settings)
+{
+	int ret = 1;
+	size_t i;
+
+	for (i = 0; ret > 0 && i < vec->count; i++)
+		ret = bloom_filter_contains(filter, &vec->key[i], settings);
+
+	return ret;
+}
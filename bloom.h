@@ -83,6 +83,20 @@ void fill_bloom_key(const char *data,
 		    const struct bloom_filter_settings *settings);
 void clear_bloom_key(struct bloom_key *key);
 
+/*
+ * The keys a changed-path Bloom filter has for a path: one for the path
+ * itself and one for each of its leading directories, as the filter of
+ * a commit changing the path has all of them.
+ */
+struct bloom_keyvec {
+	size_t count;
+	struct bloom_key key[FLEX_ARRAY];
+};
+
+struct bloom_keyvec *bloom_keyvec_new(const char *path, size_t len,
+				      const struct bloom_filter_settings *settings);
+void bloom_keyvec_free(struct bloom_keyvec *vec);
+
 void add_key_to_filter(const struct bloom_key *key,
 		       struct bloom_filter *filter,
 		       const struct bloom_filter_settings *settings);
@@ -105,8 +119,34 @@ struct bloom_filter *get_or_compute_bloom_filter(struct repository *r,
 #define get_bloom_filter(r, c) get_or_compute_bloom_filter( \
 	(r), (c), 0, NULL, NULL)
 
+/*
+ * The changed-path Bloom filter of "c" against its "nth_parent" parent,
+ * counting from 0 as get_or_compute_bloom_filter() gives the one
+ * against parent 0. The filters of merges against their other parents
+ * are only in the commit-graph if it was written with them. Returns 1
+ * and fills "filter" if there is one; if it was computed, its data is
+ * newly allocated and BLOOM_COMPUTED is set in "computed".
+ */
+int get_or_compute_parent_bloom_filter(struct repository *r,
+				       struct commit *c, int nth_parent,
+				       int compute_if_not_present,
+				       const struct bloom_filter_settings *settings,
+				       struct bloom_filter *filter,
+				       enum bloom_filter_computed *computed);
+
+#define get_parent_bloom_filter(r, c, n, f) get_or_compute_parent_bloom_filter( \
+	(r), (c), (n), 0, NULL, (f), NULL)
+
 int bloom_filter_contains(const struct bloom_filter *filter,
 			  const struct bloom_key *key,
 			  const struct bloom_filter_settings *settings);
 
+/*
+ * Like bloom_filter_contains(), but for all of the keys in "vec": 0 if
+ * the filter definitely lacks one of them.
+ */
+int bloom_filter_contains_vec(const struct bloom_filter *filter,
+			      const struct bloom_keyvec *vec,
+			      const struct bloom_filter_settings *settings);
+
 #endif
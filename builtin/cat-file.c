@@ -17,6 +17,7 @@
 #include "object-store.h"
 #include "promisor-remote.h"
 #include "mailmap.h"
+#include "thread-utils.h"
 
 enum batch_mode {
 	BATCH_MODE_CONTENTS,
@@ -33,6 +34,7 @@ struct batch_options {
 	int unordered;
 	int transform_mode; /* may be 'w' or 'c' for --filters or --textconv */
 	int nul_terminated;
+	int threads;
 	const char *format;
 };
 
@@ -282,14 +284,19 @@ static int is_atom(const char *atom, const char *s, int slen)
 	return alen == slen && !memcmp(atom, s, alen);
 }
 
+/*
+ * The output may be formatted by the worker threads of --threads, so
+ * we cannot use the static buffers of oid_to_hex() here.
+ */
 static void expand_atom(struct strbuf *sb, const char *atom, int len,
 			void *vdata)
 {
 	struct expand_data *data = vdata;
+	char hex[GIT_MAX_HEXSZ + 1];
 
 	if (is_atom("objectname", atom, len)) {
 		if (!data->mark_query)
-			strbuf_addstr(sb, oid_to_hex(&data->oid));
+			strbuf_addstr(sb, oid_to_hex_r(hex, &data->oid));
 	} else if (is_atom("objecttype", atom, len)) {
 		if (data->mark_query)
 			data->info.typep = &data->type;
@@ -315,7 +322,7 @@ static void expand_atom(struct strbuf *sb, const char *atom, int len,
 			data->info.delta_base_oid = &data->delta_base_oid;
 		else
 			strbuf_addstr(sb,
-				      oid_to_hex(&data->delta_base_oid));
+				      oid_to_hex_r(hex, &data->delta_base_oid));
 	} else
 		die("unknown format element: %.*s", len, atom);
 }
@@ -344,76 +351,469 @@ static void batch_write(struct batch_options *opt, const void *data, int len)
 		write_or_die(1, data, len);
 }
 
-static void print_object_or_die(struct batch_options *opt, struct expand_data *data)
+/*
+ * Read the contents of the object described by "data", converted as
+ * requested by --textconv or --filters, or die.
+ */
+static void *batch_object_contents(struct batch_options *opt,
+				   struct expand_data *data,
+				   unsigned long *sizep)
 {
 	const struct object_id *oid = &data->oid;
+	enum object_type type;
+	unsigned long size;
+	void *contents;
+
+	if (data->type == OBJ_BLOB && opt->transform_mode) {
+		char *converted;
+
+		if (!data->rest)
+			die("missing path for '%s'", oid_to_hex(oid));
+
+		if (opt->transform_mode == 'w') {
+			if (filter_object(data->rest, 0100644, oid,
+					  &converted, sizep))
+				die("could not convert '%s' %s",
+				    oid_to_hex(oid), data->rest);
+		} else if (opt->transform_mode == 'c') {
+			if (!textconv_object(the_repository,
+					     data->rest, 0100644, oid,
+					     1, &converted, sizep))
+				converted = read_object_file(oid,
+							     &type,
+							     sizep);
+			if (!converted)
+				die("could not convert '%s' %s",
+				    oid_to_hex(oid), data->rest);
+		} else
+			BUG("invalid transform_mode: %c", opt->transform_mode);
+		return converted;
+	}
+
+	contents = read_object_file(oid, &type, &size);
+
+	if (use_mailmap && data->type != OBJ_BLOB) {
+		size_t s = size;
+		contents = replace_idents_using_mailmap(contents, &s);
+		size = cast_size_t_to_ulong(s);
+	}
+
+	if (!contents)
+		die("object %s disappeared", oid_to_hex(oid));
+	if (type != data->type)
+		die("object %s changed type!?", oid_to_hex(oid));
+	if (data->info.sizep && size != data->size && !use_mailmap)
+		die("object %s changed size!?", oid_to_hex(oid));
+
+	*sizep = size;
+	return contents;
+}
+
+static void print_object_or_die(struct batch_options *opt, struct expand_data *data)
+{
+	unsigned long size;
+	void *contents;
 
 	assert(data->info.typep);
 
 	if (data->type == OBJ_BLOB) {
 		if (opt->buffer_output)
 			fflush(stdout);
-		if (opt->transform_mode) {
-			char *contents;
-			unsigned long size;
-
-			if (!data->rest)
-				die("missing path for '%s'", oid_to_hex(oid));
-
-			if (opt->transform_mode == 'w') {
-				if (filter_object(data->rest, 0100644, oid,
-						  &contents, &size))
-					die("could not convert '%s' %s",
-					    oid_to_hex(oid), data->rest);
-			} else if (opt->transform_mode == 'c') {
-				enum object_type type;
-				if (!textconv_object(the_repository,
-						     data->rest, 0100644, oid,
-						     1, &contents, &size))
-					contents = read_object_file(oid,
-								    &type,
-								    &size);
-				if (!contents)
-					die("could not convert '%s' %s",
-					    oid_to_hex(oid), data->rest);
-			} else
-				BUG("invalid transform_mode: %c", opt->transform_mode);
-			batch_write(opt, contents, size);
-			free(contents);
+		if (!opt->transform_mode) {
+			stream_blob(&data->oid);
+			return;
+		}
+	}
+
+	contents = batch_object_contents(opt, data, &size);
+	batch_write(opt, contents, size);
+	free(contents);
+}
+
+static void print_default_format(struct strbuf *scratch, struct expand_data *data)
+{
+	char hex[GIT_MAX_HEXSZ + 1];
+
+	strbuf_addf(scratch, "%s %s %"PRIuMAX"\n", oid_to_hex_r(hex, &data->oid),
+		    type_name(data->type),
+		    (uintmax_t)data->size);
+}
+
+static void print_batch_header(struct strbuf *scratch,
+			       struct batch_options *opt,
+			       struct expand_data *data)
+{
+	if (!opt->format) {
+		print_default_format(scratch, data);
+	} else {
+		strbuf_expand(scratch, opt->format, expand_format, data);
+		strbuf_addch(scratch, '\n');
+	}
+}
+
+/*
+ * With --threads, the objects are looked up and read by worker threads.
+ * Each request takes a slot in the "todo" ring below, in input order;
+ * the output of a request is collected in its slot and written out
+ * once all requests before it have been written, so that the output
+ * is the same as without threads.
+ */
+struct batch_work_item {
+	struct expand_data data;
+	enum batch_mode mode;
+	char *obj_name;
+	char *rest;
+	struct packed_git *pack;
+	off_t offset;
+
+	/* The request was answered without a lookup, e.g. "missing". */
+	unsigned answered:1;
+	/* The blob contents are streamed after "out" when writing. */
+	unsigned stream:1;
+	unsigned done:1;
+	struct strbuf out;
+};
+
+#define TODO_SIZE 128
+static struct batch_work_item todo[TODO_SIZE];
+static int todo_start;
+static int todo_end;
+static int todo_done;
+static int all_work_added;
+
+static pthread_t *batch_threads;
+static int nr_batch_threads;
+static pthread_t batch_writer;
+
+static pthread_mutex_t batch_mutex;
+static pthread_cond_t cond_add;
+static pthread_cond_t cond_done;
+static pthread_cond_t cond_write;
+static pthread_cond_t cond_result;
+
+static void copy_expand_data(struct expand_data *dst,
+			     const struct expand_data *src)
+{
+	*dst = *src;
+	if (src->info.typep)
+		dst->info.typep = &dst->type;
+	if (src->info.sizep)
+		dst->info.sizep = &dst->size;
+	if (src->info.disk_sizep)
+		dst->info.disk_sizep = &dst->disk_size;
+	if (src->info.delta_base_oid)
+		dst->info.delta_base_oid = &dst->delta_base_oid;
+}
+
+static struct batch_work_item *get_batch_slot(void)
+{
+	struct batch_work_item *w;
+
+	pthread_mutex_lock(&batch_mutex);
+	while ((todo_end + 1) % ARRAY_SIZE(todo) == todo_start)
+		pthread_cond_wait(&cond_write, &batch_mutex);
+	w = &todo[todo_end];
+	pthread_mutex_unlock(&batch_mutex);
+
+	strbuf_reset(&w->out);
+	w->answered = 0;
+	w->stream = 0;
+	w->done = 0;
+	return w;
+}
+
+static void queue_batch_slot(struct batch_work_item *w)
+{
+	pthread_mutex_lock(&batch_mutex);
+	todo_end = (todo_end + 1) % ARRAY_SIZE(todo);
+	pthread_cond_signal(&cond_add);
+	pthread_mutex_unlock(&batch_mutex);
+}
+
+static void add_batch_work(struct batch_options *opt,
+			   struct expand_data *data,
+			   const char *obj_name,
+			   struct packed_git *pack, off_t offset)
+{
+	struct batch_work_item *w = get_batch_slot();
+
+	copy_expand_data(&w->data, data);
+	w->mode = opt->batch_mode;
+	free(w->obj_name);
+	w->obj_name = xstrdup_or_null(obj_name);
+	free(w->rest);
+	w->rest = xstrdup_or_null(data->rest);
+	w->data.rest = w->rest;
+	w->pack = pack;
+	w->offset = offset;
+
+	queue_batch_slot(w);
+}
+
+/*
+ * Answer a request that does not need any object lookup. With threads,
+ * the answer is queued to be written in order with the others.
+ */
+__attribute__((format (printf, 2, 3)))
+static void batch_answer(struct batch_options *opt, const char *fmt, ...)
+{
+	struct batch_work_item *w;
+	va_list ap;
+
+	if (opt->threads <= 1) {
+		va_start(ap, fmt);
+		vprintf(fmt, ap);
+		va_end(ap);
+		fflush(stdout);
+		return;
+	}
+
+	w = get_batch_slot();
+	va_start(ap, fmt);
+	strbuf_vaddf(&w->out, fmt, ap);
+	va_end(ap);
+	w->answered = 1;
+
+	queue_batch_slot(w);
+}
+
+static struct batch_work_item *get_batch_work(void)
+{
+	struct batch_work_item *w;
+
+	pthread_mutex_lock(&batch_mutex);
+	while (todo_done == todo_end && !all_work_added)
+		pthread_cond_wait(&cond_add, &batch_mutex);
+
+	if (todo_done == todo_end && all_work_added) {
+		/* Nothing left to do. */
+		w = NULL;
+	} else {
+		w = &todo[todo_done];
+		todo_done = (todo_done + 1) % ARRAY_SIZE(todo);
+	}
+	pthread_mutex_unlock(&batch_mutex);
+	return w;
+}
+
+static void run_batch_work(struct batch_options *opt,
+			   struct batch_work_item *w)
+{
+	struct expand_data *data = &w->data;
+	unsigned long size;
+	void *contents;
+	int ret = 0;
+
+	if (w->answered)
+		return;
+
+	if (!data->skip_object_info) {
+		if (w->pack) {
+			obj_read_lock();
+			ret = packed_object_info(the_repository, w->pack,
+						 w->offset, &data->info);
+			obj_read_unlock();
 		} else {
-			stream_blob(oid);
+			ret = oid_object_info_extended(the_repository,
+						       &data->oid, &data->info,
+						       OBJECT_INFO_LOOKUP_REPLACE);
 		}
 	}
-	else {
-		enum object_type type;
-		unsigned long size;
-		void *contents;
+	if (ret < 0) {
+		char hex[GIT_MAX_HEXSZ + 1];
 
-		contents = read_object_file(oid, &type, &size);
+		strbuf_addf(&w->out, "%s missing\n",
+			    w->obj_name ? w->obj_name :
+			    oid_to_hex_r(hex, &data->oid));
+		return;
+	}
 
-		if (use_mailmap) {
-			size_t s = size;
-			contents = replace_idents_using_mailmap(contents, &s);
-			size = cast_size_t_to_ulong(s);
+	print_batch_header(&w->out, opt, data);
+
+	if (w->mode != BATCH_MODE_CONTENTS)
+		return;
+
+	/* Large blobs are streamed, just like without threads. */
+	if (data->type == OBJ_BLOB && data->size > big_file_threshold) {
+		w->stream = 1;
+		return;
+	}
+
+	contents = batch_object_contents(opt, data, &size);
+	strbuf_add(&w->out, contents, size);
+	strbuf_addch(&w->out, '\n');
+	free(contents);
+}
+
+/*
+ * Stream a large blob to stdout. The object read lock is only held while
+ * reading, so that a slow reader of our output does not keep the worker
+ * threads from reading objects.
+ */
+static void stream_batch_blob(const struct object_id *oid)
+{
+	struct git_istream *st;
+	enum object_type type;
+	unsigned long sz;
+	char buf[1024 * 16];
+	ssize_t readlen;
+
+	obj_read_lock();
+	st = open_istream(the_repository, oid, &type, &sz, NULL);
+	obj_read_unlock();
+	if (!st || type != OBJ_BLOB)
+		goto fail;
+
+	for (;;) {
+		obj_read_lock();
+		readlen = read_istream(st, buf, sizeof(buf));
+		obj_read_unlock();
+		if (readlen < 0)
+			goto fail;
+		if (!readlen)
+			break;
+		if (write_in_full(1, buf, readlen) < 0)
+			goto fail;
+	}
+
+	obj_read_lock();
+	close_istream(st);
+	obj_read_unlock();
+	return;
+
+fail:
+	die("unable to stream %s to stdout", oid_to_hex(oid));
+}
+
+/*
+ * The single writer thread writes out finished requests in order. The
+ * slots between todo_start and the first unfinished one are not touched
+ * by anybody else until todo_start moves past them, so they are written
+ * without holding batch_mutex.
+ */
+static void *run_batch_writer(void *arg)
+{
+	struct batch_options *opt = arg;
+
+	pthread_mutex_lock(&batch_mutex);
+	for (;;) {
+		int start = todo_start, end = todo_start;
+
+		while (end != todo_done && todo[end].done)
+			end = (end + 1) % ARRAY_SIZE(todo);
+		if (start == end) {
+			if (all_work_added && todo_start == todo_end)
+				break;
+			pthread_cond_wait(&cond_done, &batch_mutex);
+			continue;
 		}
+		pthread_mutex_unlock(&batch_mutex);
+
+		for (; start != end; start = (start + 1) % ARRAY_SIZE(todo)) {
+			struct batch_work_item *w = &todo[start];
 
-		if (!contents)
-			die("object %s disappeared", oid_to_hex(oid));
-		if (type != data->type)
-			die("object %s changed type!?", oid_to_hex(oid));
-		if (data->info.sizep && size != data->size && !use_mailmap)
-			die("object %s changed size!?", oid_to_hex(oid));
+			batch_write(opt, w->out.buf, w->out.len);
+			if (w->stream) {
+				if (opt->buffer_output)
+					fflush(stdout);
+				stream_batch_blob(&w->data.oid);
+				batch_write(opt, "\n", 1);
+			}
+		}
 
-		batch_write(opt, contents, size);
-		free(contents);
+		pthread_mutex_lock(&batch_mutex);
+		todo_start = end;
+		pthread_cond_signal(&cond_write);
+		if (todo_start == todo_end)
+			pthread_cond_broadcast(&cond_result);
 	}
+	pthread_mutex_unlock(&batch_mutex);
+	return NULL;
 }
 
-static void print_default_format(struct strbuf *scratch, struct expand_data *data)
+static void *run_batch_thread(void *arg)
 {
-	strbuf_addf(scratch, "%s %s %"PRIuMAX"\n", oid_to_hex(&data->oid),
-		    type_name(data->type),
-		    (uintmax_t)data->size);
+	struct batch_options *opt = arg;
+	struct batch_work_item *w;
+
+	while ((w = get_batch_work())) {
+		run_batch_work(opt, w);
+
+		pthread_mutex_lock(&batch_mutex);
+		w->done = 1;
+		pthread_cond_signal(&cond_done);
+		pthread_mutex_unlock(&batch_mutex);
+	}
+	return NULL;
+}
+
+static void start_batch_threads(struct batch_options *opt)
+{
+	int i, err;
+
+	pthread_mutex_init(&batch_mutex, NULL);
+	pthread_cond_init(&cond_add, NULL);
+	pthread_cond_init(&cond_done, NULL);
+	pthread_cond_init(&cond_write, NULL);
+	pthread_cond_init(&cond_result, NULL);
+	enable_obj_read_lock();
+
+	for (i = 0; i < ARRAY_SIZE(todo); i++)
+		strbuf_init(&todo[i].out, 0);
+
+	nr_batch_threads = opt->threads;
+	CALLOC_ARRAY(batch_threads, nr_batch_threads);
+	for (i = 0; i < nr_batch_threads; i++) {
+		err = pthread_create(&batch_threads[i], NULL,
+					 run_batch_thread, opt);
+		if (err)
+			die(_("cat-file: failed to create thread: %s"),
+			    strerror(err));
+	}
+	err = pthread_create(&batch_writer, NULL, run_batch_writer, opt);
+	if (err)
+		die(_("cat-file: failed to create thread: %s"),
+		    strerror(err));
+}
+
+/* Wait until the output of all queued requests has been written. */
+static void wait_batch_work(void)
+{
+	pthread_mutex_lock(&batch_mutex);
+	while (todo_start != todo_end)
+		pthread_cond_wait(&cond_result, &batch_mutex);
+	pthread_mutex_unlock(&batch_mutex);
+}
+
+static void finish_batch_threads(void)
+{
+	int i;
+
+	wait_batch_work();
+
+	pthread_mutex_lock(&batch_mutex);
+	all_work_added = 1;
+	pthread_cond_broadcast(&cond_add);
+	pthread_cond_signal(&cond_done);
+	pthread_mutex_unlock(&batch_mutex);
+
+	for (i = 0; i < nr_batch_threads; i++)
+		pthread_join(batch_threads[i], NULL);
+	FREE_AND_NULL(batch_threads);
+	pthread_join(batch_writer, NULL);
+
+	for (i = 0; i < ARRAY_SIZE(todo); i++) {
+		strbuf_release(&todo[i].out);
+		FREE_AND_NULL(todo[i].obj_name);
+		FREE_AND_NULL(todo[i].rest);
+	}
+
+	pthread_mutex_destroy(&batch_mutex);
+	pthread_cond_destroy(&cond_add);
+	pthread_cond_destroy(&cond_done);
+	pthread_cond_destroy(&cond_write);
+	pthread_cond_destroy(&cond_result);
+	disable_obj_read_lock();
 }
 
 /*
@@ -428,6 +828,11 @@ static void batch_object_write(const char *obj_name,
 			       struct packed_git *pack,
 			       off_t offset)
 {
+	if (opt->threads > 1) {
+		add_batch_work(opt, data, obj_name, pack, offset);
+		return;
+	}
+
 	if (!data->skip_object_info) {
 		int ret;
 
@@ -447,14 +852,7 @@ static void batch_object_write(const char *obj_name,
 	}
 
 	strbuf_reset(scratch);
-
-	if (!opt->format) {
-		print_default_format(scratch, data);
-	} else {
-		strbuf_expand(scratch, opt->format, expand_format, data);
-		strbuf_addch(scratch, '\n');
-	}
-
+	print_batch_header(scratch, opt, data);
 	batch_write(opt, scratch->buf, scratch->len);
 
 	if (opt->batch_mode == BATCH_MODE_CONTENTS) {
@@ -472,42 +870,43 @@ static void batch_one_object(const char *obj_name,
 	int flags = opt->follow_symlinks ? GET_OID_FOLLOW_SYMLINKS : 0;
 	enum get_oid_result result;
 
+	/* Worker threads may be reading objects concurrently. */
+	obj_read_lock();
 	result = get_oid_with_context(the_repository, obj_name,
 				      flags, &data->oid, &ctx);
+	obj_read_unlock();
 	if (result != FOUND) {
 		switch (result) {
 		case MISSING_OBJECT:
-			printf("%s missing\n", obj_name);
+			batch_answer(opt, "%s missing\n", obj_name);
 			break;
 		case SHORT_NAME_AMBIGUOUS:
-			printf("%s ambiguous\n", obj_name);
+			batch_answer(opt, "%s ambiguous\n", obj_name);
 			break;
 		case DANGLING_SYMLINK:
-			printf("dangling %"PRIuMAX"\n%s\n",
-			       (uintmax_t)strlen(obj_name), obj_name);
+			batch_answer(opt, "dangling %"PRIuMAX"\n%s\n",
+				     (uintmax_t)strlen(obj_name), obj_name);
 			break;
 		case SYMLINK_LOOP:
-			printf("loop %"PRIuMAX"\n%s\n",
-			       (uintmax_t)strlen(obj_name), obj_name);
+			batch_answer(opt, "loop %"PRIuMAX"\n%s\n",
+				     (uintmax_t)strlen(obj_name), obj_name);
 			break;
 		case NOT_DIR:
-			printf("notdir %"PRIuMAX"\n%s\n",
-			       (uintmax_t)strlen(obj_name), obj_name);
+			batch_answer(opt, "notdir %"PRIuMAX"\n%s\n",
+				     (uintmax_t)strlen(obj_name), obj_name);
 			break;
 		default:
 			BUG("unknown get_sha1_with_context result %d\n",
 			       result);
 			break;
 		}
-		fflush(stdout);
 		return;
 	}
 
 	if (ctx.mode == 0) {
-		printf("symlink %"PRIuMAX"\n%s\n",
-		       (uintmax_t)ctx.symlink_path.len,
-		       ctx.symlink_path.buf);
-		fflush(stdout);
+		batch_answer(opt, "symlink %"PRIuMAX"\n%s\n",
+			     (uintmax_t)ctx.symlink_path.len,
+			     ctx.symlink_path.buf);
 		return;
 	}
 
@@ -619,6 +1018,8 @@ static void dispatch_calls(struct batch_options *opt,
 	for (i = 0; i < nr; i++)
 		cmd[i].fn(opt, cmd[i].line, output, data);
 
+	if (opt->threads > 1)
+		wait_batch_work();
 	fflush(stdout);
 }
 
@@ -752,6 +1153,24 @@ static int batch_objects(struct batch_options *opt)
 	if (opt->batch_mode == BATCH_MODE_CONTENTS)
 		data.info.typep = &data.type;
 
+	/*
+	 * Converting objects with --textconv or --filters is not
+	 * thread-safe.
+	 */
+	if (opt->transform_mode)
+		opt->threads = 1;
+	if (opt->threads > 1) {
+		/*
+		 * The worker threads need the size to decide whether to
+		 * read a blob or leave it to be streamed.
+		 */
+		if (opt->batch_mode != BATCH_MODE_INFO) {
+			data.info.typep = &data.type;
+			data.info.sizep = &data.size;
+		}
+		start_batch_threads(opt);
+	}
+
 	if (opt->all_objects) {
 		struct object_cb_data cb;
 		struct object_info empty = OBJECT_INFO_INIT;
@@ -789,6 +1208,8 @@ static int batch_objects(struct batch_options *opt)
 			oid_array_clear(&sa);
 		}
 
+		if (opt->threads > 1)
+			finish_batch_threads();
 		strbuf_release(&output);
 		return 0;
 	}
@@ -836,6 +1257,8 @@ static int batch_objects(struct batch_options *opt)
 	}
 
  cleanup:
+	if (opt->threads > 1)
+		finish_batch_threads();
 	strbuf_release(&input);
 	strbuf_release(&output);
 	warn_on_object_refname_ambiguity = save_warning;
@@ -893,7 +1316,7 @@ int cmd_cat_file(int argc, const char **argv, const char *prefix)
 		N_("git cat-file (-t | -s) [--allow-unknown-type] <object>"),
 		N_("git cat-file (--batch | --batch-check | --batch-command) [--batch-all-objects]\n"
 		   "             [--buffer] [--follow-symlinks] [--unordered]\n"
-		   "             [--textconv | --filters]"),
+		   "             [--threads=<n>] [--textconv | --filters]"),
 		N_("git cat-file (--textconv | --filters)\n"
 		   "             [<rev>:<path|tree-ish> | --path=<path|tree-ish> <rev>]"),
 		NULL
@@ -936,6 +1359,8 @@ int cmd_cat_file(int argc, const char **argv, const char *prefix)
 			 N_("follow in-tree symlinks")),
 		OPT_BOOL(0, "unordered", &batch.unordered,
 			 N_("do not order objects before emitting them")),
+		OPT_INTEGER(0, "threads", &batch.threads,
+			    N_("use <n> threads to look up and read objects")),
 		/* Textconv options, stand-ole*/
 		OPT_GROUP(N_("Emit object (blob or tree) with conversion or filter (stand-alone, or with batch)")),
 		OPT_CMDMODE(0, "textconv", &opt,
@@ -950,6 +1375,7 @@ int cmd_cat_file(int argc, const char **argv, const char *prefix)
 	git_config(git_cat_file_config, NULL);
 
 	batch.buffer_output = -1;
+	batch.threads = 1;
 
 	argc = parse_options(argc, argv, prefix, options, usage, 0);
 	opt_cw = (opt == 'c' || opt == 'w');
@@ -984,6 +1410,19 @@ int cmd_cat_file(int argc, const char **argv, const char *prefix)
 	else if (batch.nul_terminated)
 		usage_msg_optf(_("'%s' requires a batch mode"), usage, options,
 			       "-z");
+	else if (batch.threads != 1)
+		usage_msg_optf(_("'%s' requires a batch mode"), usage, options,
+			       "--threads");
+
+	if (batch.threads < 0)
+		die(_("invalid number of threads specified (%d)"),
+		    batch.threads);
+	if (!batch.threads)
+		batch.threads = online_cpus();
+	if (!HAVE_THREADS && batch.threads > 1) {
+		warning(_("no threads support, ignoring --threads"));
+		batch.threads = 1;
+	}
 
 	/* Batch defaults */
 	if (batch.buffer_output < 0)
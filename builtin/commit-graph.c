@@ -15,7 +15,10 @@
 #define BUILTIN_COMMIT_GRAPH_WRITE_USAGE \
 	N_("git commit-graph write [--object-dir <objdir>] [--append] " \
 	   "[--split[=<strategy>]] [--reachable|--stdin-packs|--stdin-commits] " \
-	   "[--changed-paths] [--[no-]max-new-filters <n>] [--[no-]progress] " \
+	   "[--changed-paths] [--[no-]merge-changed-paths] " \
+	   "[--[no-]max-new-filters <n>] " \
+	   "[--[no-]reachability-index] [--[no-]first-parent-skips] " \
+	   "[--[no-]idents] [--[no-]progress] " \
 	   "<split options>")
 
 static const char * builtin_commit_graph_verify_usage[] = {
@@ -44,6 +47,10 @@ static struct opts_commit_graph {
 	int shallow;
 	int progress;
 	int enable_changed_paths;
+	int enable_merge_changed_paths;
+	int enable_reachability_index;
+	int enable_first_parent_skips;
+	int enable_idents;
 } opts;
 
 static struct option common_opts[] = {
@@ -211,6 +218,14 @@ static int graph_write(int argc, const char **argv, const char *prefix)
 			N_("include all commits already in the commit-graph file")),
 		OPT_BOOL(0, "changed-paths", &opts.enable_changed_paths,
 			N_("enable computation for changed paths")),
+		OPT_BOOL(0, "merge-changed-paths", &opts.enable_merge_changed_paths,
+			N_("compute the changed paths of merges against all their parents")),
+		OPT_BOOL(0, "reachability-index", &opts.enable_reachability_index,
+			N_("write an index to answer reachability queries without walking")),
+		OPT_BOOL(0, "first-parent-skips", &opts.enable_first_parent_skips,
+			N_("write skips along the first-parent history of each commit")),
+		OPT_BOOL(0, "idents", &opts.enable_idents,
+			N_("write the author date and the idents of each commit")),
 		OPT_CALLBACK_F(0, "split", &write_opts.split_flags, NULL,
 			N_("allow writing an incremental commit-graph file"),
 			PARSE_OPT_OPTARG | PARSE_OPT_NONEG,
@@ -232,6 +247,10 @@ static int graph_write(int argc, const char **argv, const char *prefix)
 
 	opts.progress = isatty(2);
 	opts.enable_changed_paths = -1;
+	opts.enable_merge_changed_paths = -1;
+	opts.enable_reachability_index = -1;
+	opts.enable_first_parent_skips = -1;
+	opts.enable_idents = -1;
 	write_opts.size_multiple = 2;
 	write_opts.max_commits = 0;
 	write_opts.expire_time = 0;
@@ -262,6 +281,22 @@ static int graph_write(int argc, const char **argv, const char *prefix)
 	if (opts.enable_changed_paths == 1 ||
 	    git_env_bool(GIT_TEST_COMMIT_GRAPH_CHANGED_PATHS, 0))
 		flags |= COMMIT_GRAPH_WRITE_BLOOM_FILTERS;
+	if (!opts.enable_merge_changed_paths)
+		flags |= COMMIT_GRAPH_NO_WRITE_MERGE_BLOOM_FILTERS;
+	else if (opts.enable_merge_changed_paths == 1)
+		flags |= COMMIT_GRAPH_WRITE_MERGE_BLOOM_FILTERS;
+	if (!opts.enable_reachability_index)
+		flags |= COMMIT_GRAPH_NO_WRITE_REACHABILITY_INDEX;
+	else if (opts.enable_reachability_index == 1)
+		flags |= COMMIT_GRAPH_WRITE_REACHABILITY_INDEX;
+	if (!opts.enable_first_parent_skips)
+		flags |= COMMIT_GRAPH_NO_WRITE_FIRST_PARENT_SKIPS;
+	else if (opts.enable_first_parent_skips == 1)
+		flags |= COMMIT_GRAPH_WRITE_FIRST_PARENT_SKIPS;
+	if (!opts.enable_idents)
+		flags |= COMMIT_GRAPH_NO_WRITE_IDENTS;
+	else if (opts.enable_idents == 1)
+		flags |= COMMIT_GRAPH_WRITE_IDENTS;
 
 	odb = find_odb(the_repository, opts.obj_dir);
 
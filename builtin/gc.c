@@ -22,6 +22,7 @@
 #include "commit.h"
 #include "commit-graph.h"
 #include "packfile.h"
+#include "pack-base-cache.h"
 #include "object-store.h"
 #include "pack.h"
 #include "pack-objects.h"
@@ -704,6 +705,8 @@ int cmd_gc(int argc, const char **argv, const char *prefix)
 		clean_pack_garbage();
 	}
 
+	pack_base_cache_sweep(the_repository);
+
 	prepare_repo_settings(the_repository);
 	if (the_repository->settings.gc_write_commit_graph == 1)
 		write_commit_graph_reachable(the_repository->objects->odb,
@@ -1183,6 +1186,8 @@ static int maintenance_task_incremental_repack(struct maintenance_run_opts *opts
 		return 1;
 	if (multi_pack_index_repack(opts))
 		return 1;
+
+	pack_base_cache_sweep(the_repository);
 	return 0;
 }
 
@@ -162,6 +162,28 @@ static pthread_mutex_t deepest_delta_mutex;
 
 static pthread_key_t key;
 
+/*
+ * In the first pass, whole objects are hashed and checked by worker
+ * threads (see threaded_first_pass()), so that reading the pack does
+ * not have to wait for it. The reader queues them here.
+ *
+ * Guarded by queue_mutex.
+ */
+struct first_pass_job {
+	struct object_entry *obj;
+	void *data;
+};
+#define FIRST_PASS_QUEUE_SIZE 1024
+static struct first_pass_job first_pass_queue[FIRST_PASS_QUEUE_SIZE];
+static unsigned int queue_head, queue_tail;
+static size_t queue_bytes;
+static int queue_done;
+static int first_pass_threaded;
+
+static pthread_mutex_t queue_mutex;
+static pthread_cond_t queue_work_cond;
+static pthread_cond_t queue_space_cond;
+
 static inline void lock_mutex(pthread_mutex_t *mutex)
 {
 	if (threads_active)
@@ -452,16 +474,21 @@ static void *unpack_entry_data(off_t offset, unsigned long size,
 	char hdr[32];
 	int hdrlen;
 
-	if (!is_delta_type(type)) {
-		hdrlen = format_object_header(hdr, sizeof(hdr), type, size);
-		the_hash_algo->init_fn(&c);
-		the_hash_algo->update_fn(&c, hdr, hdrlen);
-	} else
-		oid = NULL;
 	if (type == OBJ_BLOB && size > big_file_threshold)
 		buf = fixed_buf;
-	else
+	else {
 		buf = xmallocz(size);
+		/* The worker threads will hash it, if there are any. */
+		if (first_pass_threaded)
+			oid = NULL;
+	}
+	if (is_delta_type(type))
+		oid = NULL;
+	if (oid) {
+		hdrlen = format_object_header(hdr, sizeof(hdr), type, size);
+		the_hash_algo->init_fn(&c);
+		the_hash_algo->update_fn(&c, hdr, hdrlen);
+	}
 
 	memset(&stream, 0, sizeof(stream));
 	git_inflate_init(&stream);
@@ -1142,11 +1169,97 @@ static void *threaded_second_pass(void *data)
 	return NULL;
 }
 
+static void *threaded_first_pass(void *data)
+{
+	set_thread_data(data);
+	for (;;) {
+		struct first_pass_job job;
+
+		pthread_mutex_lock(&queue_mutex);
+		while (queue_head == queue_tail && !queue_done)
+			pthread_cond_wait(&queue_work_cond, &queue_mutex);
+		if (queue_head == queue_tail) {
+			pthread_mutex_unlock(&queue_mutex);
+			break;
+		}
+		job = first_pass_queue[queue_head++ % FIRST_PASS_QUEUE_SIZE];
+		queue_bytes -= job.obj->size;
+		pthread_cond_signal(&queue_space_cond);
+		pthread_mutex_unlock(&queue_mutex);
+
+		hash_object_file(the_hash_algo, job.data, job.obj->size,
+				 job.obj->type, &job.obj->idx.oid);
+		sha1_object(job.data, NULL, job.obj->size, job.obj->type,
+			    &job.obj->idx.oid);
+		free(job.data);
+	}
+	return NULL;
+}
+
+/*
+ * Hand a whole object over to the worker threads, waiting for them to
+ * catch up if too many objects (or too much data) are queued already.
+ */
+static void queue_first_pass_job(struct object_entry *obj, void *data)
+{
+	pthread_mutex_lock(&queue_mutex);
+	while (queue_tail - queue_head == FIRST_PASS_QUEUE_SIZE ||
+	       (queue_head != queue_tail &&
+		queue_bytes + obj->size > delta_base_cache_limit))
+		pthread_cond_wait(&queue_space_cond, &queue_mutex);
+	first_pass_queue[queue_tail % FIRST_PASS_QUEUE_SIZE].obj = obj;
+	first_pass_queue[queue_tail % FIRST_PASS_QUEUE_SIZE].data = data;
+	queue_tail++;
+	queue_bytes += obj->size;
+	pthread_cond_signal(&queue_work_cond);
+	pthread_mutex_unlock(&queue_mutex);
+}
+
+static void start_first_pass_threads(void)
+{
+	int i;
+
+	init_thread();
+	pthread_mutex_init(&queue_mutex, NULL);
+	pthread_cond_init(&queue_work_cond, NULL);
+	pthread_cond_init(&queue_space_cond, NULL);
+	first_pass_threaded = 1;
+	for (i = 0; i < nr_threads; i++) {
+		int ret = pthread_create(&thread_data[i].thread, NULL,
+					 threaded_first_pass, thread_data + i);
+		if (ret)
+			die(_("unable to create thread: %s"), strerror(ret));
+	}
+}
+
+static void finish_first_pass_threads(void)
+{
+	int i;
+
+	if (!first_pass_threaded)
+		return;
+	pthread_mutex_lock(&queue_mutex);
+	queue_done = 1;
+	pthread_cond_broadcast(&queue_work_cond);
+	pthread_mutex_unlock(&queue_mutex);
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(thread_data[i].thread, NULL);
+	first_pass_threaded = 0;
+	pthread_cond_destroy(&queue_space_cond);
+	pthread_cond_destroy(&queue_work_cond);
+	pthread_mutex_destroy(&queue_mutex);
+	cleanup_thread();
+}
+
 /*
  * First pass:
  * - find locations of all objects;
  * - calculate SHA1 of all non-delta objects;
  * - remember base (SHA1 or offset) for all deltas.
+ *
+ * With threads, the reader only inflates the objects, which it has to
+ * do to find where the next one starts; hashing and checking the
+ * non-delta objects is left to the worker threads.
  */
 static void parse_pack_objects(unsigned char *hash)
 {
@@ -1160,6 +1273,8 @@ static void parse_pack_objects(unsigned char *hash)
 				progress_title ? progress_title :
 				from_stdin ? _("Receiving objects") : _("Indexing objects"),
 				nr_objects);
+	if (nr_threads > 1 || getenv("GIT_FORCE_THREADS"))
+		start_first_pass_threads();
 	for (i = 0; i < nr_objects; i++) {
 		struct object_entry *obj = &objects[i];
 		void *data = unpack_raw_entry(obj, &ofs_delta->offset,
@@ -1179,6 +1294,9 @@ static void parse_pack_objects(unsigned char *hash)
 			/* large blobs, check later */
 			obj->real_type = OBJ_BAD;
 			nr_delays++;
+		} else if (first_pass_threaded) {
+			queue_first_pass_job(obj, data);
+			data = NULL;
 		} else
 			sha1_object(data, NULL, obj->size, obj->type,
 				    &obj->idx.oid);
@@ -1186,6 +1304,7 @@ static void parse_pack_objects(unsigned char *hash)
 		display_progress(progress, i+1);
 	}
 	objects[i].idx.offset = consumed_bytes;
+	finish_first_pass_threads();
 	stop_progress(&progress);
 
 	/* Check pack integrity */
@@ -8,7 +8,7 @@
 
 #define BUILTIN_MIDX_WRITE_USAGE \
 	N_("git multi-pack-index [<options>] write [--preferred-pack=<pack>]" \
-	   "[--refs-snapshot=<path>]")
+	   "[--refs-snapshot=<path>] [--incremental]")
 
 #define BUILTIN_MIDX_VERIFY_USAGE \
 	N_("git multi-pack-index [<options>] verify")
@@ -95,6 +95,16 @@ static int git_multi_pack_index_write_config(const char *var, const char *value,
 			opts.flags &= ~MIDX_WRITE_BITMAP_LOOKUP_TABLE;
 	}
 
+	if (!strcmp(var, "pack.bitmapversion")) {
+		int version = git_config_int(var, value);
+		if (version != 1 && version != 2)
+			die(_("bad pack.bitmapVersion=%d"), version);
+		if (version == 2)
+			opts.flags |= MIDX_WRITE_BITMAP_ROARING;
+		else
+			opts.flags &= ~MIDX_WRITE_BITMAP_ROARING;
+	}
+
 	/*
 	 * We should never make a fall-back call to 'git_default_config', since
 	 * this was already called in 'cmd_multi_pack_index()'.
@@ -128,6 +138,9 @@ static int cmd_multi_pack_index_write(int argc, const char **argv,
 			 N_("write multi-pack index containing only given indexes")),
 		OPT_FILENAME(0, "refs-snapshot", &opts.refs_snapshot,
 			     N_("refs snapshot for selecting bitmap commits")),
+		OPT_BIT(0, "incremental", &opts.flags,
+			N_("write a new layer on top of the existing multi-pack-index"),
+			MIDX_WRITE_INCREMENTAL),
 		OPT_END(),
 	};
 
@@ -37,6 +37,7 @@
 #include "shallow.h"
 #include "promisor-remote.h"
 #include "pack-mtimes.h"
+#include "oidmap.h"
 
 /*
  * Objects we are going to pack are collected in the `to_pack` structure.
@@ -212,6 +213,8 @@ static int depth = 50;
 static int delta_search_threads;
 static int pack_to_stdout;
 static int sparse;
+static int path_walk;
+static int name_hash_version = 1;
 static int thin;
 static int num_preferred_base;
 static struct progress *progress_state;
@@ -229,10 +232,12 @@ static enum {
 	WRITE_BITMAP_TRUE,
 } write_bitmap_index;
 static uint16_t write_bitmap_options = BITMAP_OPT_HASH_CACHE;
+static uint16_t write_bitmap_version = 1;
 
 static int exclude_promisor_objects;
 
 static int use_delta_islands;
+static int write_island_marks;
 
 static unsigned long delta_cache_size = 0;
 static unsigned long max_delta_cache_size = DEFAULT_DELTA_CACHE_SIZE;
@@ -282,20 +287,21 @@ static void index_commit_for_bitmap(struct commit *commit)
 	indexed_commits[indexed_commits_nr++] = commit;
 }
 
-static void *get_delta(struct object_entry *entry)
+static void *get_delta(struct object_entry *entry, struct object_entry *base,
+		       unsigned long expect_size)
 {
 	unsigned long size, base_size, delta_size;
 	void *buf, *base_buf, *delta_buf;
 	enum object_type type;
 
+	packing_data_lock(&to_pack);
 	buf = read_object_file(&entry->idx.oid, &type, &size);
 	if (!buf)
 		die(_("unable to read %s"), oid_to_hex(&entry->idx.oid));
-	base_buf = read_object_file(&DELTA(entry)->idx.oid, &type,
-				    &base_size);
+	base_buf = read_object_file(&base->idx.oid, &type, &base_size);
 	if (!base_buf)
-		die("unable to read %s",
-		    oid_to_hex(&DELTA(entry)->idx.oid));
+		die("unable to read %s", oid_to_hex(&base->idx.oid));
+	packing_data_unlock(&to_pack);
 	delta_buf = diff_delta(base_buf, base_size,
 			       buf, size, &delta_size, 0);
 	/*
@@ -303,7 +309,7 @@ static void *get_delta(struct object_entry *entry)
 	 * memory reasons. Something is very wrong if this time we
 	 * recompute and create a different delta.
 	 */
-	if (!delta_buf || delta_size != DELTA_SIZE(entry))
+	if (!delta_buf || delta_size != expect_size)
 		BUG("delta size changed");
 	free(buf);
 	free(base_buf);
@@ -335,6 +341,143 @@ static unsigned long do_compress(void **pptr, unsigned long size)
 	return stream.total_out;
 }
 
+/*
+ * When writing the pack, worker threads read and deflate the objects
+ * that are about to be written (see fill_write_ahead()), so that the
+ * writer only has to copy the result into the pack. Objects are still
+ * written in the same order, with the same data, so the pack is the
+ * same as without threads.
+ */
+struct write_job {
+	struct oidmap_entry e;
+	struct object_entry *entry;
+	struct write_job *next;
+
+	/* Filled in when queued. */
+	struct object_entry *base;
+	unsigned long delta_size;
+	unsigned long in_flight;
+
+	/*
+	 * Filled in by deflate_write_job(): deflated data, and the
+	 * type and uncompressed size of what was deflated.
+	 */
+	enum {
+		WRITE_JOB_QUEUED,
+		WRITE_JOB_RUNNING,
+		WRITE_JOB_DONE
+	} state;
+	void *data;
+	unsigned long datalen;
+	unsigned long size;
+	enum object_type type;
+};
+
+static int write_ahead_active;
+static int nr_write_threads;
+static pthread_t *write_threads;
+
+/*
+ * Jobs that are queued, running or done but not yet written, and the
+ * queue of those no thread has picked up yet; protected by write_mutex.
+ */
+static struct oidmap write_jobs;
+static struct write_job *write_queue_head, **write_queue_tail = &write_queue_head;
+static size_t write_ahead_bytes;
+static unsigned write_ahead_nr;
+static int write_threads_done;
+
+static pthread_mutex_t write_mutex;
+static pthread_cond_t write_queue_cond;
+static pthread_cond_t write_done_cond;
+
+static void deflate_write_job(struct write_job *job)
+{
+	struct object_entry *entry = job->entry;
+	void *buf;
+
+	if (job->base) {
+		buf = job->data ? job->data :
+			get_delta(entry, job->base, job->delta_size);
+		job->size = job->delta_size;
+	} else {
+		packing_data_lock(&to_pack);
+		buf = read_object_file(&entry->idx.oid, &job->type, &job->size);
+		packing_data_unlock(&to_pack);
+		if (!buf)
+			die(_("unable to read %s"), oid_to_hex(&entry->idx.oid));
+	}
+	job->datalen = do_compress(&buf, job->size);
+	job->data = buf;
+}
+
+static void *threaded_write_ahead(void *arg UNUSED)
+{
+	pthread_mutex_lock(&write_mutex);
+	for (;;) {
+		struct write_job *job = write_queue_head;
+
+		if (!job) {
+			if (write_threads_done)
+				break;
+			pthread_cond_wait(&write_queue_cond, &write_mutex);
+			continue;
+		}
+		write_queue_head = job->next;
+		if (!write_queue_head)
+			write_queue_tail = &write_queue_head;
+		job->state = WRITE_JOB_RUNNING;
+		pthread_mutex_unlock(&write_mutex);
+
+		deflate_write_job(job);
+
+		pthread_mutex_lock(&write_mutex);
+		job->state = WRITE_JOB_DONE;
+		pthread_cond_broadcast(&write_done_cond);
+	}
+	pthread_mutex_unlock(&write_mutex);
+	return NULL;
+}
+
+/*
+ * Return the deflated data for "entry" if it was queued for the worker
+ * threads (doing the work here if no thread picked it up yet), or NULL.
+ * The caller owns the returned job.
+ */
+static struct write_job *take_write_job(struct object_entry *entry)
+{
+	struct write_job *job;
+
+	if (!write_ahead_active)
+		return NULL;
+
+	pthread_mutex_lock(&write_mutex);
+	job = oidmap_remove(&write_jobs, &entry->idx.oid);
+	if (!job) {
+		pthread_mutex_unlock(&write_mutex);
+		return NULL;
+	}
+	write_ahead_nr--;
+	write_ahead_bytes -= job->in_flight;
+	if (job->state == WRITE_JOB_QUEUED) {
+		struct write_job **pp = &write_queue_head;
+
+		while (*pp != job)
+			pp = &(*pp)->next;
+		*pp = job->next;
+		if (!*pp)
+			write_queue_tail = pp;
+		job->state = WRITE_JOB_RUNNING;
+		pthread_mutex_unlock(&write_mutex);
+		deflate_write_job(job);
+		return job;
+	}
+	while (job->state != WRITE_JOB_DONE)
+		pthread_cond_wait(&write_done_cond, &write_mutex);
+	pthread_mutex_unlock(&write_mutex);
+	return job;
+}
+
 static unsigned long write_large_blob_data(struct git_istream *st, struct hashfile *f,
 					   const struct object_id *oid)
 {
@@ -446,8 +589,26 @@ static unsigned long write_no_reuse_object(struct hashfile *f, struct object_ent
 	void *buf;
 	struct git_istream *st = NULL;
 	const unsigned hashsz = the_hash_algo->rawsz;
+	struct write_job *job = take_write_job(entry);
+
+	if (job && !!job->base != !!usable_delta) {
+		/* The delta was dropped after all. */
+		free(job->data);
+		FREE_AND_NULL(job);
+	}
 
-	if (!usable_delta) {
+	if (job) {
+		buf = job->data;
+		size = job->size;
+		datalen = job->datalen;
+		if (!usable_delta)
+			type = job->type;
+		else
+			type = (allow_ofs_delta && DELTA(entry)->idx.offset) ?
+				OBJ_OFS_DELTA : OBJ_REF_DELTA;
+		free(job);
+	} else if (!usable_delta) {
+		packing_data_lock(&to_pack);
 		if (oe_type(entry) == OBJ_BLOB &&
 		    oe_size_greater_than(&to_pack, entry, big_file_threshold) &&
 		    (st = open_istream(the_repository, &entry->idx.oid, &type,
@@ -459,6 +620,7 @@ static unsigned long write_no_reuse_object(struct hashfile *f, struct object_ent
 				die(_("unable to read %s"),
 				    oid_to_hex(&entry->idx.oid));
 		}
+		packing_data_unlock(&to_pack);
 		/*
 		 * make sure no cached delta data remains from a
 		 * previous attempt before a pack split occurred.
@@ -472,13 +634,15 @@ static unsigned long write_no_reuse_object(struct hashfile *f, struct object_ent
 		type = (allow_ofs_delta && DELTA(entry)->idx.offset) ?
 			OBJ_OFS_DELTA : OBJ_REF_DELTA;
 	} else {
-		buf = get_delta(entry);
+		buf = get_delta(entry, DELTA(entry), DELTA_SIZE(entry));
 		size = DELTA_SIZE(entry);
 		type = (allow_ofs_delta && DELTA(entry)->idx.offset) ?
 			OBJ_OFS_DELTA : OBJ_REF_DELTA;
 	}
 
-	if (st)	/* large blob case, just assume we don't compress well */
+	if (job)
+		; /* already deflated */
+	else if (st)	/* large blob case, just assume we don't compress well */
 		datalen = size;
 	else if (entry->z_delta_size)
 		datalen = entry->z_delta_size;
@@ -536,8 +700,10 @@ static unsigned long write_no_reuse_object(struct hashfile *f, struct object_ent
 		hashwrite(f, header, hdrlen);
 	}
 	if (st) {
+		packing_data_lock(&to_pack);
 		datalen = write_large_blob_data(st, f, &entry->idx.oid);
 		close_istream(st);
+		packing_data_unlock(&to_pack);
 	} else {
 		hashwrite(f, buf, datalen);
 		free(buf);
@@ -631,6 +797,28 @@ static off_t write_reuse_object(struct hashfile *f, struct object_entry *entry,
 	return hdrlen + datalen;
 }
 
+/* Can we copy the data of "entry" from the pack it is in? */
+static int want_reuse_object(struct object_entry *entry, int usable_delta)
+{
+	if (!reuse_object)
+		return 0;	/* explicit */
+	else if (!IN_PACK(entry))
+		return 0;	/* can't reuse what we don't have */
+	else if (oe_type(entry) == OBJ_REF_DELTA ||
+		 oe_type(entry) == OBJ_OFS_DELTA)
+				/* check_object() decided it for us ... */
+		return usable_delta;
+				/* ... but pack split may override that */
+	else if (oe_type(entry) != entry->in_pack_type)
+		return 0;	/* pack has delta which is unusable */
+	else if (DELTA(entry))
+		return 0;	/* we want to pack afresh */
+	else
+		return 1;	/* we have it in-pack undeltified,
+				 * and we do not need to deltify it.
+				 */
+}
+
 /* Return 0 if we will bust the pack-size limit */
 static off_t write_object(struct hashfile *f,
 			  struct object_entry *entry,
@@ -638,7 +826,7 @@ static off_t write_object(struct hashfile *f,
 {
 	unsigned long limit;
 	off_t len;
-	int usable_delta, to_reuse;
+	int usable_delta;
 
 	if (!pack_to_stdout)
 		crc32_begin(f);
@@ -666,28 +854,13 @@ static off_t write_object(struct hashfile *f,
 	else
 		usable_delta = 0;	/* base could end up in another pack */
 
-	if (!reuse_object)
-		to_reuse = 0;	/* explicit */
-	else if (!IN_PACK(entry))
-		to_reuse = 0;	/* can't reuse what we don't have */
-	else if (oe_type(entry) == OBJ_REF_DELTA ||
-		 oe_type(entry) == OBJ_OFS_DELTA)
-				/* check_object() decided it for us ... */
-		to_reuse = usable_delta;
-				/* ... but pack split may override that */
-	else if (oe_type(entry) != entry->in_pack_type)
-		to_reuse = 0;	/* pack has delta which is unusable */
-	else if (DELTA(entry))
-		to_reuse = 0;	/* we want to pack afresh */
-	else
-		to_reuse = 1;	/* we have it in-pack undeltified,
-				 * and we do not need to deltify it.
-				 */
-
-	if (!to_reuse)
+	if (!want_reuse_object(entry, usable_delta))
 		len = write_no_reuse_object(f, entry, limit, usable_delta);
-	else
+	else {
+		packing_data_lock(&to_pack);
 		len = write_reuse_object(f, entry, limit, usable_delta);
+		packing_data_unlock(&to_pack);
+	}
 	if (!len)
 		return 0;
 
@@ -759,6 +932,116 @@ static enum write_one_status write_one(struct hashfile *f,
 	return WRITE_ONE_WRITTEN;
 }
 
+/* Start with this many objects, or this much data, in flight. */
+#define WRITE_AHEAD_OBJECTS 1024
+#define WRITE_AHEAD_BYTES (64 * 1024 * 1024)
+
+static unsigned write_ahead_pos;
+
+/*
+ * Queue the objects following write_order[pos] whose data the writer
+ * would deflate itself for the worker threads.
+ *
+ * Without a pack size limit, whether an object is stored as a delta
+ * is known up front; only breaking a delta cycle in write_one() can
+ * change it, in which case the writer throws the job away.
+ */
+static void fill_write_ahead(struct object_entry **write_order, unsigned pos)
+{
+	if (!write_ahead_active)
+		return;
+	if (write_ahead_pos < pos)
+		write_ahead_pos = pos;
+
+	pthread_mutex_lock(&write_mutex);
+	while (write_ahead_pos < to_pack.nr_objects &&
+	       write_ahead_nr < WRITE_AHEAD_OBJECTS &&
+	       write_ahead_bytes < WRITE_AHEAD_BYTES) {
+		struct object_entry *e = write_order[write_ahead_pos++];
+		struct write_job *job;
+
+		if (e->idx.offset || e->preferred_base ||
+		    want_reuse_object(e, !!DELTA(e)))
+			continue;
+		if (DELTA(e) ? e->z_delta_size :
+		    oe_type(e) == OBJ_BLOB &&
+		    oe_size_greater_than(&to_pack, e, big_file_threshold))
+			continue;
+
+		CALLOC_ARRAY(job, 1);
+		oidcpy(&job->e.oid, &e->idx.oid);
+		job->entry = e;
+		if (DELTA(e)) {
+			job->base = DELTA(e);
+			job->delta_size = DELTA_SIZE(e);
+			job->data = e->delta_data;
+			e->delta_data = NULL;
+			job->in_flight = job->delta_size;
+		} else
+			job->in_flight = SIZE(e);
+		write_ahead_bytes += job->in_flight;
+		write_ahead_nr++;
+		oidmap_put(&write_jobs, job);
+
+		*write_queue_tail = job;
+		write_queue_tail = &job->next;
+		pthread_cond_signal(&write_queue_cond);
+	}
+	pthread_mutex_unlock(&write_mutex);
+}
+
+static void start_write_threads(void)
+{
+	int i;
+
+	/*
+	 * With a size limit, what ends up in which pack (and whether
+	 * deltas are usable) is only decided as we write.
+	 */
+	if (!HAVE_THREADS || delta_search_threads <= 1 || pack_size_limit)
+		return;
+
+	pthread_mutex_init(&write_mutex, NULL);
+	pthread_cond_init(&write_queue_cond, NULL);
+	pthread_cond_init(&write_done_cond, NULL);
+	oidmap_init(&write_jobs, 0);
+	write_ahead_active = 1;
+
+	nr_write_threads = delta_search_threads;
+	CALLOC_ARRAY(write_threads, nr_write_threads);
+	for (i = 0; i < nr_write_threads; i++) {
+		int ret = pthread_create(&write_threads[i], NULL,
+					 threaded_write_ahead, NULL);
+		if (ret)
+			die(_("unable to create thread: %s"), strerror(ret));
+	}
+}
+
+static void stop_write_threads(void)
+{
+	int i;
+
+	if (!write_ahead_active)
+		return;
+
+	pthread_mutex_lock(&write_mutex);
+	write_threads_done = 1;
+	pthread_cond_broadcast(&write_queue_cond);
+	pthread_mutex_unlock(&write_mutex);
+	for (i = 0; i < nr_write_threads; i++)
+		pthread_join(write_threads[i], NULL);
+	FREE_AND_NULL(write_threads);
+
+	if (write_ahead_nr)
+		BUG("%u objects deflated for writing but not written",
+		    write_ahead_nr);
+	oidmap_free(&write_jobs, 0);
+	pthread_cond_destroy(&write_done_cond);
+	pthread_cond_destroy(&write_queue_cond);
+	pthread_mutex_destroy(&write_mutex);
+	write_ahead_active = 0;
+}
+
 static int mark_tagged(const char *path UNUSED, const struct object_id *oid,
 		       int flag UNUSED, void *cb_data UNUSED)
 {
@@ -1193,12 +1476,15 @@ static void write_pack_file(void)
 		}
 
 		nr_written = 0;
+		start_write_threads();
 		for (; i < to_pack.nr_objects; i++) {
 			struct object_entry *e = write_order[i];
+			fill_write_ahead(write_order, i);
 			if (write_one(f, e, &offset) == WRITE_ONE_BREAK)
 				break;
 			display_progress(progress_state, written);
 		}
+		stop_write_threads();
 
 		if (pack_to_stdout) {
 			/*
@@ -1228,6 +1514,7 @@ static void write_pack_file(void)
 					warning(_(no_split_warning));
 				write_bitmap_index = 0;
 			}
+			write_island_marks = 0;
 		}
 
 		if (!pack_to_stdout) {
@@ -1278,6 +1565,7 @@ static void write_pack_file(void)
 				stop_progress(&progress_state);
 
 				bitmap_writer_show_progress(progress);
+				bitmap_writer_set_version(write_bitmap_version);
 				bitmap_writer_select_commits(indexed_commits, indexed_commits_nr, -1);
 				if (bitmap_writer_build(&to_pack) < 0)
 					die(_("failed to write bitmap index"));
@@ -1287,6 +1575,15 @@ static void write_pack_file(void)
 				strbuf_setlen(&tmpname, tmpname_len);
 			}
 
+			if (write_island_marks) {
+				size_t tmpname_len = tmpname.len;
+
+				strbuf_addstr(&tmpname, "islands");
+				write_island_marks_file(written_list, nr_written,
+							hash, tmpname.buf);
+				strbuf_setlen(&tmpname, tmpname_len);
+			}
+
 			rename_tmp_packfile_idx(&tmpname, &idx_tmp_name);
 
 			free(idx_tmp_name);
@@ -1562,6 +1859,7 @@ static const char no_closure_warning[] = N_(
 static int add_object_entry(const struct object_id *oid, enum object_type type,
 			    const char *name, int exclude)
 {
+	struct object_entry *entry;
 	struct packed_git *found_pack = NULL;
 	off_t found_offset = 0;
 
@@ -1577,12 +1875,16 @@ static int add_object_entry(const struct object_id *oid, enum object_type type,
 				warning(_(no_closure_warning));
 			write_bitmap_index = 0;
 		}
+		write_island_marks = 0;
 		return 0;
 	}
 
-	create_object_entry(oid, type, pack_name_hash(name),
-			    exclude, name && no_try_delta(name),
-			    found_pack, found_offset);
+	entry = create_object_entry(oid, type,
+				    pack_name_hash_version(name, name_hash_version),
+				    exclude, name && no_try_delta(name),
+				    found_pack, found_offset);
+	if (path_walk && name)
+		oe_set_path_hash(&to_pack, entry, pack_full_name_hash(name));
 	return 1;
 }
 
@@ -1796,7 +2098,7 @@ static void add_preferred_base_object(const char *name)
 {
 	struct pbase_tree *it;
 	int cmplen;
-	unsigned hash = pack_name_hash(name);
+	unsigned hash = pack_name_hash_version(name, name_hash_version);
 
 	if (!num_preferred_base || check_pbase_path(hash))
 		return;
@@ -2322,6 +2624,9 @@ static void get_object_details(void)
 	free(sorted_by_offset);
 }
 
+/* Set while find_deltas_by_path() looks for deltas within each path. */
+static int delta_search_by_path;
+
 /*
  * We search for deltas in a list sorted by type, by filename hash, and then
  * by size, so that we see progressively smaller and smaller files.
@@ -2481,6 +2786,13 @@ static int try_delta(struct unpacked *trg, struct unpacked *src,
 	if (oe_type(trg_entry) != oe_type(src_entry))
 		return -1;
 
+	/*
+	 * When searching by path, the list is sorted by path, so
+	 * the rest of the window holds other paths, too.
+	 */
+	if (delta_search_by_path && trg_entry->hash != src_entry->hash)
+		return -1;
+
 	/*
 	 * We do not bother to try a delta that we discarded on an
 	 * earlier try, but only when reusing delta data.  Note that
@@ -3045,6 +3357,83 @@ static int add_ref_tag(const char *tag UNUSED, const struct object_id *oid,
 	return 0;
 }
 
+/*
+ * Exchange the name hash of each object with the hash of its full path,
+ * so that type_size_sort() and ll_find_deltas() go by the latter.
+ */
+static void swap_path_hash(struct object_entry **list, unsigned n)
+{
+	unsigned i;
+
+	for (i = 0; i < n; i++) {
+		uint32_t *path_hash = &to_pack.path_hash[list[i] - to_pack.objects];
+		uint32_t tmp = list[i]->hash;
+
+		list[i]->hash = *path_hash;
+		*path_hash = tmp;
+	}
+}
+
+/*
+ * With --path-walk, first look for deltas between the versions of each
+ * path (e.g. "docs/CHANGELOG.md"), before looking among all the files
+ * with a similar name (e.g. all "CHANGELOG.md" files), which do not
+ * necessarily have much in common. Remove the objects we found a delta
+ * for from "list" and "nr_deltas", and return the new size of "list",
+ * for the usual search to go over the rest.
+ */
+static unsigned find_deltas_by_path(struct object_entry **list, unsigned n,
+				    uint32_t *nr_deltas, int window, int depth)
+{
+	struct object_entry **by_path;
+	unsigned i, nr = 0, nr_left = 0, nr_done = 0;
+	uint32_t nr_path_deltas = 0;
+
+	ALLOC_ARRAY(by_path, n);
+	for (i = 0; i < n; i++) {
+		if (!oe_path_hash(&to_pack, list[i]))
+			continue;
+		by_path[nr++] = list[i];
+		if (!list[i]->preferred_base)
+			nr_path_deltas++;
+	}
+
+	if (nr_path_deltas && nr > 1) {
+		if (progress)
+			progress_state = start_progress(_("Compressing objects by path"),
+							nr_path_deltas);
+		swap_path_hash(by_path, nr);
+		delta_search_by_path = 1;
+		QSORT(by_path, nr, type_size_sort);
+		ll_find_deltas(by_path, nr, window+1, depth, &nr_done);
+		delta_search_by_path = 0;
+		swap_path_hash(by_path, nr);
+		stop_progress(&progress_state);
+		if (nr_done != nr_path_deltas)
+			die(_("inconsistency with delta count"));
+	}
+	free(by_path);
+
+	for (i = 0; i < n; i++) {
+		struct object_entry *e = list[i];
+
+		if (!DELTA(e)) {
+			list[nr_left++] = e;
+			continue;
+		}
+
+		/*
+		 * Link the new delta to its base, so that find_deltas()
+		 * takes its depth into account should the base become a
+		 * delta, too.
+		 */
+		e->delta_sibling_idx = DELTA(e)->delta_child_idx;
+		SET_DELTA_CHILD(DELTA(e), e);
+		(*nr_deltas)--;
+	}
+	return nr_left;
+}
+
 static void prepare_pack(int window, int depth)
 {
 	struct object_entry **delta_list;
@@ -3106,6 +3495,9 @@ static void prepare_pack(int window, int depth)
 		delta_list[n++] = entry;
 	}
 
+	if (path_walk && to_pack.path_hash && nr_deltas && n > 1)
+		n = find_deltas_by_path(delta_list, n, &nr_deltas, window, depth);
+
 	if (nr_deltas && n > 1) {
 		unsigned nr_done = 0;
 
@@ -3150,6 +3542,11 @@ static int git_pack_config(const char *k, const char *v, void *cb)
 			write_bitmap_options &= ~BITMAP_OPT_HASH_CACHE;
 	}
 
+	if (!strcmp(k, "pack.writeislandmarks")) {
+		write_island_marks = git_config_bool(k, v);
+		return 0;
+	}
+
 	if (!strcmp(k, "pack.writebitmaplookuptable")) {
 		if (git_config_bool(k, v))
 			write_bitmap_options |= BITMAP_OPT_LOOKUP_TABLE;
@@ -3157,6 +3554,22 @@ static int git_pack_config(const char *k, const char *v, void *cb)
 			write_bitmap_options &= ~BITMAP_OPT_LOOKUP_TABLE;
 	}
 
+	if (!strcmp(k, "pack.bitmapversion")) {
+		int version = git_config_int(k, v);
+		if (version != 1 && version != 2)
+			die(_("bad pack.bitmapVersion=%d"), version);
+		write_bitmap_version = version;
+		return 0;
+	}
+
+	if (!strcmp(k, "pack.usepathwalk")) {
+		path_walk = git_config_bool(k, v);
+		return 0;
+	}
+	if (!strcmp(k, "pack.namehashversion")) {
+		name_hash_version = git_config_int(k, v);
+		return 0;
+	}
 	if (!strcmp(k, "pack.usebitmaps")) {
 		use_bitmap_index_default = git_config_bool(k, v);
 		return 0;
@@ -4244,6 +4657,10 @@ int cmd_pack_objects(int argc, const char **argv, const char *prefix)
 		  PARSE_OPT_OPTARG, option_parse_cruft_expiration),
 		OPT_BOOL(0, "sparse", &sparse,
 			 N_("use the sparse reachability algorithm")),
+		OPT_BOOL(0, "path-walk", &path_walk,
+			 N_("look for deltas between versions of the same path first")),
+		OPT_INTEGER(0, "name-hash-version", &name_hash_version,
+			    N_("use the specified name-hash function to group similar objects")),
 		OPT_BOOL(0, "thin", &thin,
 			 N_("create thin packs")),
 		OPT_BOOL(0, "shallow", &shallow,
@@ -4380,6 +4797,9 @@ int cmd_pack_objects(int argc, const char **argv, const char *prefix)
 	if (!pack_to_stdout && thin)
 		die(_("--thin cannot be used to build an indexable pack"));
 
+	if (name_hash_version < 1 || name_hash_version > 2)
+		die(_("invalid --name-hash-version option: %d"), name_hash_version);
+
 	if (keep_unreachable && unpack_unreachable)
 		die(_("options '%s' and '%s' cannot be used together"), "--keep-unreachable", "--unpack-unreachable");
 	if (!rev_list_all || !rev_list_reflog || !rev_list_index)
@@ -4426,6 +4846,16 @@ int cmd_pack_objects(int argc, const char **argv, const char *prefix)
 	if (pack_to_stdout || !rev_list_all)
 		write_bitmap_index = 0;
 
+	/*
+	 * The marks are only reusable if the pack has all reachable
+	 * objects; see also want_object_in_pack() failing in
+	 * add_object_entry().
+	 */
+	if (!use_delta_islands || pack_to_stdout || !rev_list_all ||
+	    rev_list_unpacked || incremental || cruft ||
+	    (pfd.have_revs && pfd.revs.filter.choice))
+		write_island_marks = 0;
+
 	if (use_delta_islands)
 		strvec_push(&rp, "--topo-order");
 
@@ -4459,6 +4889,7 @@ int cmd_pack_objects(int argc, const char **argv, const char *prefix)
 	trace2_region_enter("pack-objects", "enumerate-objects",
 			    the_repository);
 	prepare_packing_data(the_repository, &to_pack);
+	to_pack.name_hash_version = name_hash_version;
 
 	if (progress && !cruft)
 		progress_state = start_progress(_("Enumerating objects"), 0);
@@ -54,6 +54,8 @@ struct pack_objects_args {
 	int no_reuse_object;
 	int quiet;
 	int local;
+	int path_walk;
+	int name_hash_version;
 };
 
 static int repack_config(const char *var, const char *value, void *cb)
@@ -207,6 +209,11 @@ static void prepare_pack_objects(struct child_process *cmd,
 		strvec_pushf(&cmd->args, "--no-reuse-object");
 	if (args->local)
 		strvec_push(&cmd->args,  "--local");
+	if (args->path_walk)
+		strvec_push(&cmd->args,  "--path-walk");
+	if (args->name_hash_version)
+		strvec_pushf(&cmd->args, "--name-hash-version=%d",
+			     args->name_hash_version);
 	if (args->quiet)
 		strvec_push(&cmd->args,  "--quiet");
 	if (delta_base_offset)
@@ -243,6 +250,7 @@ static struct {
 	{".rev", 1},
 	{".mtimes", 1},
 	{".bitmap", 1},
+	{".islands", 1},
 	{".promisor", 1},
 	{".idx"},
 };
@@ -508,6 +516,181 @@ static void clear_pack_geometry(struct pack_geometry *geometry)
 	geometry->split = 0;
 }
 
+/*
+ * Read the names of the packs written by "cmd" into "names", and wait
+ * for it to finish.
+ */
+static int finish_pack_objects(struct child_process *cmd,
+			       struct string_list *names)
+{
+	struct strbuf line = STRBUF_INIT;
+	FILE *out;
+
+	out = xfdopen(cmd->out, "r");
+	while (strbuf_getline_lf(&line, out) != EOF) {
+		if (line.len != the_hash_algo->hexsz)
+			die(_("repack: Expecting full hex object ID lines only from pack-objects."));
+		string_list_append(names, line.buf);
+	}
+	fclose(out);
+	strbuf_release(&line);
+
+	return finish_command(cmd);
+}
+
+static void remove_tmp_pack(const char *name)
+{
+	int ext;
+
+	for (ext = 0; ext < ARRAY_SIZE(exts); ext++)
+		unlink(mkpath("%s-%s%s", packtmp, name, exts[ext].name));
+}
+
+/*
+ * Roll up the packs geometry->pack[start..end) into a new pack, along
+ * with the packs already written by this repack (listed in "names"),
+ * which the new pack replaces.
+ */
+static int geometry_rollup(const struct child_process *template,
+			   struct pack_geometry *geometry,
+			   uint32_t start, uint32_t end,
+			   struct string_list *names)
+{
+	struct child_process cmd = CHILD_PROCESS_INIT;
+	struct string_list written = STRING_LIST_INIT_DUP;
+	struct string_list_item *item;
+	FILE *in;
+	uint32_t i;
+	int ret;
+
+	strvec_pushv(&cmd.args, template->args.v);
+	cmd.git_cmd = 1;
+	cmd.in = -1;
+	cmd.out = -1;
+
+	ret = start_command(&cmd);
+	if (ret)
+		return ret;
+
+	in = xfdopen(cmd.in, "w");
+	/*
+	 * The resulting pack should contain all objects in packs that
+	 * are going to be rolled up, but exclude objects in packs which
+	 * are being left alone (for now).
+	 */
+	for_each_string_list_item(item, names)
+		fprintf(in, "%s-%s.pack\n", packtmp_name, item->string);
+	for (i = start; i < end; i++)
+		fprintf(in, "%s\n", pack_basename(geometry->pack[i]));
+	for (i = end; i < geometry->pack_nr; i++)
+		fprintf(in, "^%s\n", pack_basename(geometry->pack[i]));
+	fclose(in);
+
+	ret = finish_pack_objects(&cmd, &written);
+	if (!ret) {
+		for_each_string_list_item(item, names)
+			if (!unsorted_string_list_has_string(&written,
+							     item->string))
+				remove_tmp_pack(item->string);
+		string_list_clear(names, 0);
+		for_each_string_list_item(item, &written)
+			string_list_append(names, item->string);
+	}
+
+	string_list_clear(&written, 0);
+	return ret;
+}
+
+/*
+ * Roll up the packs to the left of geometry->split, or as many of the
+ * smallest ones as "max_bytes" and "max_time" (in seconds) allow.
+ *
+ * Without a time limit, all of them are rolled up at once. With one,
+ * they are rolled up in batches, each at least as large as the pack
+ * resulting from the previous batches so that no object is copied more
+ * than a few times, and we stop before a batch that is not expected to
+ * finish in time, judging from how fast the previous ones went. The
+ * first batch is always done.
+ *
+ * The packs that were not rolled up are left alone, and geometry->split
+ * is updated accordingly; a later repack picks them up again.
+ */
+static int geometric_repack(const struct child_process *cmd,
+			    struct pack_geometry *geometry,
+			    struct string_list *names,
+			    unsigned long max_bytes, int max_time)
+{
+	uint64_t start_time = getnanotime();
+	uint32_t limit = geometry->split, done = 0, i;
+	off_t rolled_up = 0, copied = 0, deferred = 0;
+	int ret = 0;
+
+	if (max_bytes) {
+		off_t total = 0;
+
+		for (limit = 0; limit < geometry->split; limit++) {
+			total += geometry->pack[limit]->pack_size;
+			if (total > max_bytes)
+				break;
+		}
+	}
+
+	do {
+		uint32_t end = done;
+		off_t batch = 0;
+
+		while (end < limit &&
+		       (!max_time || end == done || batch < rolled_up))
+			batch += geometry->pack[end++]->pack_size;
+
+		if (max_time && done) {
+			uint64_t elapsed = getnanotime() - start_time;
+			uint64_t estimate = copied ?
+				(double)elapsed * (rolled_up + batch) / copied : 0;
+
+			if (elapsed + estimate > max_time * 1000000000ULL)
+				break;
+		}
+
+		trace2_region_enter("repack", "geometric-rollup", the_repository);
+		trace2_data_intmax("repack", the_repository,
+				   "geometric-rollup/packs", end - done);
+		ret = geometry_rollup(cmd, geometry, done, end, names);
+		trace2_region_leave("repack", "geometric-rollup", the_repository);
+		if (ret)
+			return ret;
+
+		copied += rolled_up + batch;
+		rolled_up += batch;
+		done = end;
+	} while (done < limit);
+
+	for (i = done; i < geometry->split; i++)
+		deferred += geometry->pack[i]->pack_size;
+
+	trace2_data_intmax("repack", the_repository,
+			   "geometric/rolled_up_packs", done);
+	trace2_data_intmax("repack", the_repository,
+			   "geometric/rolled_up_bytes", rolled_up);
+	trace2_data_intmax("repack", the_repository,
+			   "geometric/deferred_packs", geometry->split - done);
+	trace2_data_intmax("repack", the_repository,
+			   "geometric/deferred_bytes", deferred);
+
+	geometry->split = done;
+	return 0;
+}
+
+static int has_incremental_midx(void)
+{
+	struct multi_pack_index *m;
+
+	for (m = get_multi_pack_index(the_repository); m; m = m->next)
+		if (m->local)
+			return m->incremental;
+	return 0;
+}
+
 struct midx_snapshot_ref_data {
 	struct tempfile *f;
 	struct oidset seen;
@@ -617,7 +800,8 @@ static void midx_included_packs(struct string_list *include,
 static int write_midx_included_packs(struct string_list *include,
 				     struct pack_geometry *geometry,
 				     const char *refs_snapshot,
-				     int show_progress, int write_bitmaps)
+				     int show_progress, int write_bitmaps,
+				     int incremental)
 {
 	struct child_process cmd = CHILD_PROCESS_INIT;
 	struct string_list_item *item;
@@ -642,7 +826,13 @@ static int write_midx_included_packs(struct string_list *include,
 	if (write_bitmaps)
 		strvec_push(&cmd.args, "--bitmap");
 
-	if (largest)
+	/*
+	 * The largest pack is usually in a layer which stays as it is,
+	 * and only the bottom layer has a preferred pack anyway.
+	 */
+	if (incremental)
+		strvec_push(&cmd.args, "--incremental");
+	else if (largest)
 		strvec_pushf(&cmd.args, "--preferred-pack=%s",
 			     pack_basename(largest));
 
@@ -730,11 +920,10 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 	struct string_list existing_nonkept_packs = STRING_LIST_INIT_DUP;
 	struct string_list existing_kept_packs = STRING_LIST_INIT_DUP;
 	struct pack_geometry *geometry = NULL;
-	struct strbuf line = STRBUF_INIT;
 	struct tempfile *refs_snapshot = NULL;
 	int i, ext, ret;
-	FILE *out;
 	int show_progress;
+	int incremental_midx = 0;
 
 	/* variables to be filled by option parsing */
 	int delete_redundant = 0;
@@ -744,6 +933,8 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 	struct pack_objects_args po_args = {NULL};
 	struct pack_objects_args cruft_po_args = {NULL};
 	int geometric_factor = 0;
+	unsigned long max_bytes = 0;
+	int max_time = 0;
 	int write_midx = 0;
 
 	struct option builtin_repack_options[] = {
@@ -768,6 +959,10 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 		OPT__QUIET(&po_args.quiet, N_("be quiet")),
 		OPT_BOOL('l', "local", &po_args.local,
 				N_("pass --local to git-pack-objects")),
+		OPT_BOOL(0, "path-walk", &po_args.path_walk,
+				N_("pass --path-walk to git-pack-objects")),
+		OPT_INTEGER(0, "name-hash-version", &po_args.name_hash_version,
+				N_("specify the name-hash version to use for grouping similar objects by path")),
 		OPT_BOOL('b', "write-bitmap-index", &write_bitmaps,
 				N_("write bitmap index")),
 		OPT_BOOL('i', "delta-islands", &use_delta_islands,
@@ -792,6 +987,10 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 				N_("do not repack this pack")),
 		OPT_INTEGER('g', "geometric", &geometric_factor,
 			    N_("find a geometric progression with factor <N>")),
+		OPT_MAGNITUDE(0, "max-bytes", &max_bytes,
+			      N_("with --geometric, roll up at most this many bytes of packs")),
+		OPT_INTEGER(0, "max-time", &max_time,
+			    N_("with --geometric, stop rolling up packs after about <n> seconds")),
 		OPT_BOOL('m', "write-midx", &write_midx,
 			   N_("write a multi-pack index of the resulting packs")),
 		OPT_END()
@@ -805,6 +1004,13 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 	if (delete_redundant && repository_format_precious_objects)
 		die(_("cannot delete packs in a precious-objects repo"));
 
+	if (max_bytes && !geometric_factor)
+		die(_("the option '%s' requires '%s'"), "--max-bytes", "--geometric");
+	if (max_time && !geometric_factor)
+		die(_("the option '%s' requires '%s'"), "--max-time", "--geometric");
+	if (max_time < 0)
+		die(_("--max-time cannot be negative"));
+
 	if (keep_unreachable &&
 	    (unpack_unreachable || (pack_everything & LOOSEN_UNREACHABLE)))
 		die(_("options '%s' and '%s' cannot be used together"), "--keep-unreachable", "-A");
@@ -857,6 +1063,10 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 			die(_("options '%s' and '%s' cannot be used together"), "--geometric", "-A/-a");
 		init_pack_geometry(&geometry, &existing_kept_packs);
 		split_pack_geometry(geometry, geometric_factor);
+
+		/* Keep adding layers to an existing MIDX chain. */
+		if (write_midx)
+			incremental_midx = has_incremental_midx();
 	}
 
 	sigchain_push_common(remove_pack_on_signal);
@@ -927,39 +1137,22 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 		strvec_push(&cmd.args, "--incremental");
 	}
 
-	if (geometry)
-		cmd.in = -1;
-	else
+	if (geometry) {
+		ret = geometric_repack(&cmd, geometry, &names,
+				       max_bytes, max_time);
+		if (ret)
+			return ret;
+	} else {
 		cmd.no_stdin = 1;
 
-	ret = start_command(&cmd);
-	if (ret)
-		return ret;
-
-	if (geometry) {
-		FILE *in = xfdopen(cmd.in, "w");
-		/*
-		 * The resulting pack should contain all objects in packs that
-		 * are going to be rolled up, but exclude objects in packs which
-		 * are being left alone.
-		 */
-		for (i = 0; i < geometry->split; i++)
-			fprintf(in, "%s\n", pack_basename(geometry->pack[i]));
-		for (i = geometry->split; i < geometry->pack_nr; i++)
-			fprintf(in, "^%s\n", pack_basename(geometry->pack[i]));
-		fclose(in);
-	}
+		ret = start_command(&cmd);
+		if (ret)
+			return ret;
 
-	out = xfdopen(cmd.out, "r");
-	while (strbuf_getline_lf(&line, out) != EOF) {
-		if (line.len != the_hash_algo->hexsz)
-			die(_("repack: Expecting full hex object ID lines only from pack-objects."));
-		string_list_append(&names, line.buf);
+		ret = finish_pack_objects(&cmd, &names);
+		if (ret)
+			return ret;
 	}
-	fclose(out);
-	ret = finish_command(&cmd);
-	if (ret)
-		return ret;
 
 	if (!names.nr && !po_args.quiet)
 		printf_ln(_("Nothing new to pack."));
@@ -983,6 +1176,8 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 
 		cruft_po_args.local = po_args.local;
 		cruft_po_args.quiet = po_args.quiet;
+		cruft_po_args.path_walk = po_args.path_walk;
+		cruft_po_args.name_hash_version = po_args.name_hash_version;
 
 		ret = write_cruft_pack(&cruft_po_args, pack_prefix, &names,
 				       &existing_nonkept_packs,
@@ -1057,7 +1252,8 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 
 		ret = write_midx_included_packs(&include, geometry,
 						refs_snapshot ? get_tempfile_path(refs_snapshot) : NULL,
-						show_progress, write_bitmaps > 0);
+						show_progress, write_bitmaps > 0,
+						incremental_midx);
 
 		string_list_clear(&include, 0);
 
@@ -1119,7 +1315,6 @@ int cmd_repack(int argc, const char **argv, const char *prefix)
 	string_list_clear(&existing_nonkept_packs, 0);
 	string_list_clear(&existing_kept_packs, 0);
 	clear_pack_geometry(geometry);
-	strbuf_release(&line);
 
 	return 0;
 }
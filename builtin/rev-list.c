@@ -1,6 +1,7 @@
 #include "cache.h"
 #include "config.h"
 #include "commit.h"
+#include "commit-graph.h"
 #include "diff.h"
 #include "revision.h"
 #include "list-objects.h"
@@ -18,6 +19,7 @@
 #include "reflog-walk.h"
 #include "oidset.h"
 #include "packfile.h"
+#include "strvec.h"
 
 static const char rev_list_usage[] =
 "git rev-list [<options>] <commit-id>... [-- <path>...]\n"
@@ -54,6 +56,7 @@ static const char rev_list_usage[] =
 "    --abbrev-commit\n"
 "    --left-right\n"
 "    --count\n"
+"    --batch\n"
 "  special purpose:\n"
 "    --bisect\n"
 "    --bisect-vars\n"
@@ -409,6 +412,25 @@ static inline int parse_missing_action_value(const char *value)
 	return 0;
 }
 
+/* With --batch, the bitmap index shared by all the queries. */
+static struct bitmap_index *batch_bitmap;
+
+static struct bitmap_index *bitmap_walk(struct rev_info *revs,
+					int filter_provided_objects)
+{
+	if (!batch_bitmap)
+		return prepare_bitmap_walk(revs, filter_provided_objects);
+	if (prepare_bitmap_walk_on(batch_bitmap, revs, filter_provided_objects))
+		return NULL;
+	return batch_bitmap;
+}
+
+static void bitmap_walk_done(struct bitmap_index *bitmap_git)
+{
+	if (bitmap_git != batch_bitmap)
+		free_bitmap_index(bitmap_git);
+}
+
 static int try_bitmap_count(struct rev_info *revs,
 			    int filter_provided_objects)
 {
@@ -445,7 +467,7 @@ static int try_bitmap_count(struct rev_info *revs,
 	 */
 	max_count = revs->max_count;
 
-	bitmap_git = prepare_bitmap_walk(revs, filter_provided_objects);
+	bitmap_git = bitmap_walk(revs, filter_provided_objects);
 	if (!bitmap_git)
 		return -1;
 
@@ -457,10 +479,98 @@ static int try_bitmap_count(struct rev_info *revs,
 		commit_count = max_count;
 
 	printf("%d\n", commit_count + tree_count + blob_count + tag_count);
-	free_bitmap_index(bitmap_git);
+	bitmap_walk_done(bitmap_git);
 	return 0;
 }
 
+/*
+ * Return 1 if the command line "argv" has no option but those which
+ * try_first_parent_count() knows how to answer. Any other option may
+ * change which commits are counted, and listing the ones known to be
+ * safe keeps new options from giving wrong counts.
+ */
+static int first_parent_count_options_only(int argc, const char **argv)
+{
+	static const char *options[] = {
+		"--first-parent", "--count", "--use-bitmap-index",
+		"--all", "--branches", "--tags", "--remotes",
+		"--max-count", "-n", "--skip",
+	};
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		size_t j;
+
+		if (!strcmp(arg, "--"))
+			return i == argc - 1;
+		if (!strcmp(arg, "--end-of-options"))
+			return 1;
+		if (*arg != '-' || isdigit(arg[1]))
+			continue;
+
+		for (j = 0; j < ARRAY_SIZE(options); j++) {
+			const char *rest;
+
+			if (skip_prefix(arg, options[j], &rest) &&
+			    (!*rest || *rest == '=' ||
+			     (!strcmp(options[j], "-n") && isdigit(*rest))))
+				break;
+		}
+		if (j == ARRAY_SIZE(options))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * "--first-parent --count" from positive tips only can be answered
+ * from the first-parent skips of the commit-graph, without walking
+ * the history of each tip.
+ */
+static int try_first_parent_count(struct rev_info *revs,
+				  int options_only)
+{
+	struct commit **tips;
+	uint32_t count;
+	int max_count = revs->max_count;
+	size_t i, nr = 0;
+	int ret = -1;
+
+	if (!options_only || !revs->count || !revs->first_parent_only ||
+	    revs->prune_data.nr)
+		return -1;
+
+	ALLOC_ARRAY(tips, revs->pending.nr);
+	for (i = 0; i < revs->pending.nr; i++) {
+		struct object_array_entry *e = &revs->pending.objects[i];
+		struct commit *c;
+
+		if (e->item->flags & UNINTERESTING)
+			goto cleanup;
+		c = lookup_commit_reference_gently(the_repository,
+						   &e->item->oid, 1);
+		if (!c || repo_parse_commit(the_repository, c))
+			goto cleanup;
+		tips[nr++] = c;
+	}
+
+	if (commit_graph_count_first_parents(the_repository, tips, nr, &count))
+		goto cleanup;
+
+	if (revs->skip_count > 0)
+		count = count > revs->skip_count ? count - revs->skip_count : 0;
+	if (max_count >= 0 && max_count < count)
+		count = max_count;
+
+	printf("%"PRIu32"\n", count);
+	ret = 0;
+
+cleanup:
+	free(tips);
+	return ret;
+}
+
 static int try_bitmap_traversal(struct rev_info *revs,
 				int filter_provided_objects)
 {
@@ -491,15 +601,119 @@ static int try_bitmap_disk_usage(struct rev_info *revs,
 	if (!show_disk_usage)
 		return -1;
 
-	bitmap_git = prepare_bitmap_walk(revs, filter_provided_objects);
+	bitmap_git = bitmap_walk(revs, filter_provided_objects);
 	if (!bitmap_git)
 		return -1;
 
 	size_from_bitmap = get_disk_usage_from_bitmap(bitmap_git, revs);
 	print_disk_usage(size_from_bitmap);
+	bitmap_walk_done(bitmap_git);
 	return 0;
 }
 
+/*
+ * Set up "revs" for one line of --batch input, taken as more arguments to
+ * the command line ("base"). Revisions on the line are looked up here
+ * rather than by setup_revisions(), which would die on a bad one.
+ */
+static int setup_batch_query(struct rev_info *revs, const struct strvec *base,
+			     const char *line, struct strbuf *err)
+{
+	struct strvec args = STRVEC_INIT;
+	struct strvec words = STRVEC_INIT;
+	const char **av;
+	int flags = 0;
+	int i, ret = -1;
+
+	strvec_pushv(&args, base->v);
+	strvec_split(&words, line);
+	for (i = 0; i < words.nr; i++) {
+		if (!strcmp(words.v[i], "--")) {
+			strbuf_addstr(err, _("pathspecs are not supported"));
+			goto out;
+		}
+		if (*words.v[i] == '-')
+			strvec_push(&args, words.v[i]);
+	}
+
+	/* setup_revisions() shuffles the array it is given */
+	ALLOC_ARRAY(av, args.nr + 1);
+	COPY_ARRAY(av, args.v, args.nr + 1);
+	i = setup_revisions(args.nr, av, revs, NULL);
+	if (i > 1)
+		strbuf_addf(err, _("unknown argument '%s'"), av[1]);
+	free(av);
+	if (i > 1)
+		goto out;
+	if (revs->prune_data.nr) {
+		strbuf_addstr(err, _("pathspecs are not supported"));
+		goto out;
+	}
+
+	revs->ignore_missing = 1;
+	for (i = 0; i < words.nr; i++) {
+		const char *arg = words.v[i];
+		unsigned int nr = revs->pending.nr;
+
+		if (!strcmp(arg, "--not")) {
+			flags ^= UNINTERESTING | BOTTOM;
+			continue;
+		}
+		if (*arg == '-')
+			continue;
+		if (handle_revision_arg(arg, revs, flags,
+					REVARG_CANNOT_BE_FILENAME) ||
+		    revs->pending.nr == nr) {
+			strbuf_addf(err, _("bad revision '%s'"), arg);
+			goto out;
+		}
+	}
+	ret = 0;
+
+out:
+	strvec_clear(&args);
+	strvec_clear(&words);
+	return ret;
+}
+
+/*
+ * Answer --count or --disk-usage for each line of stdin. A line that
+ * cannot be answered gets an "error: <reason>" line instead.
+ */
+static void batch_bitmap_queries(const struct strvec *argv, const char *prefix,
+				 int filter_provided_objects)
+{
+	struct strbuf line = STRBUF_INIT;
+	struct strbuf err = STRBUF_INIT;
+
+	batch_bitmap = prepare_bitmap_git(the_repository);
+	if (!batch_bitmap)
+		die(_("--batch requires a reachability bitmap"));
+
+	while (strbuf_getline(&line, stdin) != EOF) {
+		struct rev_info revs;
+
+		strbuf_reset(&err);
+		repo_init_revisions(the_repository, &revs, prefix);
+		if (!setup_batch_query(&revs, argv, line.buf, &err) &&
+		    try_bitmap_count(&revs, filter_provided_objects) &&
+		    try_bitmap_disk_usage(&revs, filter_provided_objects))
+			strbuf_addstr(&err, _("cannot use bitmaps for this query"));
+		if (err.len)
+			printf("error: %s\n", err.buf);
+		fflush(stdout);
+
+		/* including UNINTERESTING, unlike reset_revision_walk() */
+		clear_object_flags(ALL_REV_FLAGS);
+		release_revisions(&revs);
+	}
+
+	free_bitmap_index(batch_bitmap);
+	batch_bitmap = NULL;
+	strbuf_release(&line);
+	strbuf_release(&err);
+}
+
 int cmd_rev_list(int argc, const char **argv, const char *prefix)
 {
 	struct rev_info revs;
@@ -513,6 +727,9 @@ int cmd_rev_list(int argc, const char **argv, const char *prefix)
 	int bisect_find_all = 0;
 	int use_bitmap_index = 0;
 	int filter_provided_objects = 0;
+	int first_parent_count_ok;
+	struct strvec batch_argv = STRVEC_INIT;
+	const char **batch_raw_argv = NULL;
 	const char *show_progress = NULL;
 	int ret = 0;
 
@@ -556,8 +773,36 @@ int cmd_rev_list(int argc, const char **argv, const char *prefix)
 	if (arg_missing_action)
 		revs.do_not_die_on_missing_tree = 1;
 
+	/*
+	 * With --batch, each line of stdin is parsed along with the
+	 * arguments that setup_revisions() understands.
+	 */
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--"))
+			break;
+		if (!strcmp(argv[i], "--batch")) {
+			ALLOC_ARRAY(batch_raw_argv, argc + 1);
+			COPY_ARRAY(batch_raw_argv, argv, argc + 1);
+			break;
+		}
+	}
+
+	first_parent_count_ok = first_parent_count_options_only(argc, argv);
+
 	argc = setup_revisions(argc, argv, &revs, &s_r_opt);
 
+	/* setup_revisions() moved the arguments it did not know to the front */
+	for (i = 0; batch_raw_argv && batch_raw_argv[i]; i++) {
+		int j;
+
+		for (j = 1; j < argc; j++)
+			if (argv[j] == batch_raw_argv[i])
+				break;
+		if (j == argc)
+			strvec_push(&batch_argv, batch_raw_argv[i]);
+	}
+	FREE_AND_NULL(batch_raw_argv);
+
 	memset(&info, 0, sizeof(info));
 	info.revs = &revs;
 	if (revs.bisect)
@@ -596,6 +841,8 @@ int cmd_rev_list(int argc, const char **argv, const char *prefix)
 			use_bitmap_index = 1;
 			continue;
 		}
+		if (!strcmp(arg, "--batch"))
+			continue; /* already handled above */
 		if (!strcmp(arg, "--test-bitmap")) {
 			test_bitmap_walk(&revs);
 			goto cleanup;
@@ -675,6 +922,20 @@ int cmd_rev_list(int argc, const char **argv, const char *prefix)
 		/* Only --header was specified */
 		revs.commit_format = CMIT_FMT_RAW;
 
+	if (batch_argv.nr) {
+		if (!use_bitmap_index)
+			die(_("the option '%s' requires '%s'"),
+			    "--batch", "--use-bitmap-index");
+		if (!revs.count && !show_disk_usage)
+			die(_("--batch requires --count or --disk-usage"));
+		if (revs.read_from_stdin)
+			die(_("options '%s' and '%s' cannot be used together"),
+			    "--batch", "--stdin");
+		batch_bitmap_queries(&batch_argv, prefix,
+				     filter_provided_objects);
+		goto cleanup;
+	}
+
 	if ((!revs.commits && reflog_walk_empty(revs.reflog_info) &&
 	     (!(revs.tag_objects || revs.tree_objects || revs.blob_objects) &&
 	      !revs.pending.nr) &&
@@ -708,6 +969,9 @@ int cmd_rev_list(int argc, const char **argv, const char *prefix)
 			goto cleanup;
 	}
 
+	if (!try_first_parent_count(&revs, first_parent_count_ok))
+		goto cleanup;
+
 	if (prepare_revision_walk(&revs))
 		die("revision walk setup failed");
 	if (revs.tree_objects)
@@ -785,5 +1049,6 @@ int cmd_rev_list(int argc, const char **argv, const char *prefix)
 
 cleanup:
 	release_revisions(&revs);
+	strvec_clear(&batch_argv);
 	return ret;
 }
@@ -12,9 +12,18 @@
 #include "tmp-objdir.h"
 #include "packfile.h"
 #include "object-store.h"
+#include "khash.h"
+#include "config.h"
+#include "thread-utils.h"
+#include "trace2.h"
 
 static int odb_transaction_nesting;
 
+#ifndef NO_PTHREADS
+/* The thread that began the outermost ODB transaction. */
+static pthread_t odb_transaction_thread;
+#endif
+
 static struct tmp_objdir *bulk_fsync_objdir;
 
 static struct bulk_checkin_packfile {
@@ -26,6 +35,8 @@ static struct bulk_checkin_packfile {
 	struct pack_idx_entry **written;
 	uint32_t alloc_written;
 	uint32_t nr_written;
+	/* Position of each written object in "written". */
+	kh_oid_pos_t *written_pos;
 } bulk_checkin_packfile;
 
 static void finish_tmp_packfile(struct strbuf *basename,
@@ -78,6 +89,7 @@ static void flush_bulk_checkin_packfile(struct bulk_checkin_packfile *state)
 
 clear_exit:
 	free(state->written);
+	kh_destroy_oid_pos(state->written_pos);
 	memset(state, 0, sizeof(*state));
 
 	strbuf_release(&packname);
@@ -119,23 +131,43 @@ static void flush_batch_fsync(void)
 	bulk_fsync_objdir = NULL;
 }
 
-static int already_written(struct bulk_checkin_packfile *state, struct object_id *oid)
+static int already_written(struct bulk_checkin_packfile *state,
+			   const struct object_id *oid)
 {
-	int i;
-
-	/* The object may already exist in the repository */
-	if (has_object_file(oid))
+	/* We may have written it to this pack already */
+	if (state->written_pos &&
+	    kh_get_oid_pos(state->written_pos, *oid) != kh_end(state->written_pos))
 		return 1;
 
-	/* Might want to keep the list sorted */
-	for (i = 0; i < state->nr_written; i++)
-		if (oideq(&state->written[i]->oid, oid))
-			return 1;
+	/*
+	 * The object may already exist in the repository. With many
+	 * objects in a transaction, we cannot afford to rescan the pack
+	 * directory for each of them.
+	 */
+	if (has_object_file_with_flags(oid, OBJECT_INFO_QUICK |
+					    OBJECT_INFO_SKIP_FETCH_OBJECT))
+		return 1;
 
 	/* This is a new object we need to keep */
 	return 0;
 }
 
+static void record_written(struct bulk_checkin_packfile *state,
+			   struct pack_idx_entry *idx)
+{
+	khiter_t pos;
+	int hash_ret;
+
+	ALLOC_GROW(state->written,
+		   state->nr_written + 1,
+		   state->alloc_written);
+	if (!state->written_pos)
+		state->written_pos = kh_init_oid_pos();
+	pos = kh_put_oid_pos(state->written_pos, idx->oid, &hash_ret);
+	kh_value(state->written_pos, pos) = state->nr_written;
+	state->written[state->nr_written++] = idx;
+}
+
 /*
  * Read the contents from fd for size bytes, streaming it to the
  * packfile in state while updating the hash in ctx. Signal a failure
@@ -150,10 +182,15 @@ static int already_written(struct bulk_checkin_packfile *state, struct object_id
  * again. This way, the caller does not have to checkpoint its hash
  * status before calling us just in case we ask it to call us again
  * with a new pack.
+ *
+ * If "buf" is not NULL, the contents are taken from there rather than
+ * read from fd, and are not hashed (ctx and already_hashed_to are
+ * unused).
  */
 static int stream_to_pack(struct bulk_checkin_packfile *state,
 			  git_hash_ctx *ctx, off_t *already_hashed_to,
-			  int fd, size_t size, enum object_type type,
+			  int fd, const void *buf, size_t size,
+			  enum object_type type,
 			  const char *path, unsigned flags)
 {
 	git_zstream s;
@@ -170,6 +207,12 @@ static int stream_to_pack(struct bulk_checkin_packfile *state,
 	s.next_out = obuf + hdrlen;
 	s.avail_out = sizeof(obuf) - hdrlen;
 
+	if (buf) {
+		s.next_in = (unsigned char *)buf;
+		s.avail_in = size;
+		size = 0;
+	}
+
 	while (status != Z_STREAM_END) {
 		if (size && !s.avail_in) {
 			ssize_t rsize = size < sizeof(ibuf) ? size : sizeof(ibuf);
@@ -279,7 +322,7 @@ static int deflate_to_pack(struct bulk_checkin_packfile *state,
 			crc32_begin(state->f);
 		}
 		if (!stream_to_pack(state, &ctx, &already_hashed_to,
-				    fd, size, type, path, flags))
+				    fd, NULL, size, type, path, flags))
 			break;
 		/*
 		 * Writing this object to the current pack will make
@@ -305,14 +348,400 @@ static int deflate_to_pack(struct bulk_checkin_packfile *state,
 		free(idx);
 	} else {
 		oidcpy(&idx->oid, result_oid);
-		ALLOC_GROW(state->written,
-			   state->nr_written + 1,
-			   state->alloc_written);
-		state->written[state->nr_written++] = idx;
+		record_written(state, idx);
+	}
+	return 0;
+}
+
+/*
+ * Like deflate_to_pack(), but for an object whose contents are in
+ * memory and whose name the caller already computed.
+ */
+static void deflate_buf_to_pack(struct bulk_checkin_packfile *state,
+				const struct object_id *oid,
+				const void *buf, size_t size,
+				enum object_type type)
+{
+	struct hashfile_checkpoint checkpoint = {0};
+	struct pack_idx_entry *idx;
+
+	if (already_written(state, oid))
+		return;
+
+	CALLOC_ARRAY(idx, 1);
+	while (1) {
+		prepare_to_stream(state, HASH_WRITE_OBJECT);
+		hashfile_checkpoint(state->f, &checkpoint);
+		idx->offset = state->offset;
+		crc32_begin(state->f);
+		if (!stream_to_pack(state, NULL, NULL, -1, buf, size, type,
+				    oid_to_hex(oid), HASH_WRITE_OBJECT))
+			break;
+		hashfile_truncate(state->f, &checkpoint);
+		state->offset = checkpoint.offset;
+		flush_bulk_checkin_packfile(state);
+	}
+	idx->crc32 = crc32_end(state->f);
+	oidcpy(&idx->oid, oid);
+	record_written(state, idx);
+}
+
+int use_bulk_checkin_pack(void)
+{
+	static int enabled = -1;
+
+	if (!odb_transaction_nesting)
+		return 0;
+	if (enabled < 0 &&
+	    git_config_get_bool("core.bulkcheckinpack", &enabled))
+		enabled = 0;
+	return enabled;
+}
+
+void write_object_bulk_checkin(const struct object_id *oid,
+			       const void *buf, size_t size,
+			       enum object_type type)
+{
+	deflate_buf_to_pack(&bulk_checkin_packfile, oid, buf, size, type);
+}
+
+/*
+ * The state of a transaction is not protected against concurrent
+ * access, so only the thread that began it may wait for or flush the
+ * objects written in it.
+ */
+static int in_odb_transaction_thread(void)
+{
+	if (!odb_transaction_nesting)
+		return 0;
+#ifndef NO_PTHREADS
+	if (!pthread_equal(odb_transaction_thread, pthread_self()))
+		return 0;
+#endif
+	return 1;
+}
+
+static void *inflate_bulk_checkin_object(const unsigned char *in, size_t len,
+					 unsigned long size)
+{
+	git_zstream stream;
+	unsigned char *buf = xmallocz_gently(size);
+	int st;
+
+	if (!buf)
+		return NULL;
+
+	memset(&stream, 0, sizeof(stream));
+	stream.next_in = (unsigned char *)in;
+	stream.avail_in = len;
+	stream.next_out = buf;
+	stream.avail_out = size;
+
+	git_inflate_init(&stream);
+	do {
+		st = git_inflate(&stream, Z_FINISH);
+	} while (st == Z_OK);
+	git_inflate_end(&stream);
+
+	if (st != Z_STREAM_END || stream.total_out != size) {
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+int read_object_bulk_checkin(const struct object_id *oid,
+			     struct object_info *oi)
+{
+	struct bulk_checkin_packfile *state = &bulk_checkin_packfile;
+	enum object_type type;
+	unsigned long size, hdrlen;
+	unsigned char *data;
+	off_t start, end;
+	khiter_t pos;
+	uint32_t i;
+	int ret = -1;
+
+	if (!in_odb_transaction_thread() || !state->written_pos)
+		return -1;
+	pos = kh_get_oid_pos(state->written_pos, *oid);
+	if (pos == kh_end(state->written_pos))
+		return -1;
+
+	/*
+	 * The objects are appended one after the other and are never
+	 * deltified, so each one ends where the next one starts.
+	 */
+	i = kh_value(state->written_pos, pos);
+	start = state->written[i]->offset;
+	end = i + 1 < state->nr_written ?
+		state->written[i + 1]->offset : state->offset;
+
+	/* Make what we have written so far readable from the file. */
+	hashflush(state->f);
+
+	data = xmalloc(end - start);
+	if (pread_in_full(state->f->fd, data, end - start, start) != end - start) {
+		error_errno(_("unable to read back %s from '%s'"),
+			    oid_to_hex(oid), state->pack_tmp_name);
+		goto out;
+	}
+	hdrlen = unpack_object_header_buffer(data, end - start, &type, &size);
+	if (!hdrlen) {
+		error(_("bad object header for %s in '%s'"),
+		      oid_to_hex(oid), state->pack_tmp_name);
+		goto out;
+	}
+
+	if (oi->contentp) {
+		*oi->contentp = inflate_bulk_checkin_object(data + hdrlen,
+							    end - start - hdrlen,
+							    size);
+		if (!*oi->contentp) {
+			error(_("unable to unpack %s from '%s'"),
+			      oid_to_hex(oid), state->pack_tmp_name);
+			goto out;
+		}
+	}
+	if (oi->typep)
+		*oi->typep = type;
+	if (oi->sizep)
+		*oi->sizep = size;
+	if (oi->disk_sizep)
+		*oi->disk_sizep = end - start;
+	if (oi->delta_base_oid)
+		oidclr(oi->delta_base_oid);
+	if (oi->type_name)
+		strbuf_addstr(oi->type_name, type_name(type));
+	/* There is no packed_git for a pack that is still being written. */
+	oi->whence = OI_CACHED;
+	ret = 0;
+
+out:
+	free(data);
+	return ret;
+}
+
+int wait_object_bulk_checkin(void)
+{
+	if (!in_odb_transaction_thread())
+		return 0;
+	return wait_loose_object_bulk_checkin();
+}
+
+/*
+ * Within an ODB transaction, new loose blobs can be compressed and
+ * written out by a pool of worker threads ("core.bulkCheckinThreads"),
+ * while the caller goes on to hash the next one. The transaction waits
+ * for them before it makes the objects visible (and, with
+ * core.fsyncMethod=batch, before it issues its single flush).
+ */
+struct loose_object_job {
+	struct loose_object_job *next;
+	struct object_id oid;
+	char *hdr;
+	int hdrlen;
+	void *buf;
+	unsigned long len;
+	unsigned flags;
+};
+
+/* Stop queueing when this much object data is waiting to be written. */
+#define LOOSE_OBJECT_QUEUE_LIMIT (64 * 1024 * 1024)
+
+static struct {
+	int initialized;
+	int nr_threads;
+	pthread_t *threads;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+	struct loose_object_job *head, **tail;
+	int pending;
+	size_t pending_bytes;
+	int failed;
+	int shutdown;
+
+	/* Only touched by the main thread. */
+	struct oidset queued;
+} loose_writer;
+
+static void *loose_object_worker(void *data UNUSED)
+{
+	trace2_thread_start("bulk-checkin");
+
+	pthread_mutex_lock(&loose_writer.mutex);
+	for (;;) {
+		struct loose_object_job *job;
+		int ret;
+
+		while (!loose_writer.head && !loose_writer.shutdown)
+			pthread_cond_wait(&loose_writer.work_cond,
+					  &loose_writer.mutex);
+		if (!loose_writer.head)
+			break;
+
+		job = loose_writer.head;
+		loose_writer.head = job->next;
+		if (!loose_writer.head)
+			loose_writer.tail = &loose_writer.head;
+		pthread_mutex_unlock(&loose_writer.mutex);
+
+		ret = write_loose_object_reentrant(&job->oid, job->hdr,
+						   job->hdrlen, job->buf,
+						   job->len, job->flags);
+
+		pthread_mutex_lock(&loose_writer.mutex);
+		if (ret)
+			loose_writer.failed++;
+		loose_writer.pending--;
+		loose_writer.pending_bytes -= job->len;
+		pthread_cond_broadcast(&loose_writer.done_cond);
+
+		free(job->hdr);
+		free(job->buf);
+		free(job);
+	}
+	pthread_mutex_unlock(&loose_writer.mutex);
+
+	trace2_thread_exit();
+	return NULL;
+}
+
+static int start_loose_object_writers(void)
+{
+	int i, nr;
+
+	if (loose_writer.initialized)
+		return !!loose_writer.nr_threads;
+	loose_writer.initialized = 1;
+
+	if (git_config_get_int("core.bulkcheckinthreads", &nr))
+		nr = 1;
+	if (nr < 0)
+		die(_("invalid number of threads specified (%d) for %s"),
+		    nr, "core.bulkCheckinThreads");
+	if (!nr)
+		nr = online_cpus();
+	if (!HAVE_THREADS || nr <= 1)
+		return 0;
+
+	/*
+	 * These are initialized lazily by the code paths that the
+	 * workers use; do it before there is more than one thread.
+	 */
+	get_shared_repository();
+
+	pthread_mutex_init(&loose_writer.mutex, NULL);
+	pthread_cond_init(&loose_writer.work_cond, NULL);
+	pthread_cond_init(&loose_writer.done_cond, NULL);
+	loose_writer.tail = &loose_writer.head;
+	oidset_init(&loose_writer.queued, 0);
+
+	CALLOC_ARRAY(loose_writer.threads, nr);
+	for (i = 0; i < nr; i++) {
+		int err = pthread_create(&loose_writer.threads[i], NULL,
+					 loose_object_worker, NULL);
+		if (err)
+			die(_("unable to create thread: %s"), strerror(err));
+		loose_writer.nr_threads++;
+	}
+	return 1;
+}
+
+static void stop_loose_object_writers(void)
+{
+	int i;
+
+	if (!loose_writer.nr_threads) {
+		loose_writer.initialized = 0;
+		return;
 	}
+
+	wait_loose_object_bulk_checkin();
+
+	pthread_mutex_lock(&loose_writer.mutex);
+	loose_writer.shutdown = 1;
+	pthread_cond_broadcast(&loose_writer.work_cond);
+	pthread_mutex_unlock(&loose_writer.mutex);
+
+	for (i = 0; i < loose_writer.nr_threads; i++)
+		pthread_join(loose_writer.threads[i], NULL);
+	free(loose_writer.threads);
+
+	pthread_mutex_destroy(&loose_writer.mutex);
+	pthread_cond_destroy(&loose_writer.work_cond);
+	pthread_cond_destroy(&loose_writer.done_cond);
+	oidset_clear(&loose_writer.queued);
+	memset(&loose_writer, 0, sizeof(loose_writer));
+}
+
+int queue_loose_object_bulk_checkin(const struct object_id *oid,
+				    const char *hdr, int hdrlen,
+				    const void *buf, unsigned long len,
+				    unsigned flags)
+{
+	struct loose_object_job *job;
+
+	if (!odb_transaction_nesting || !start_loose_object_writers())
+		return -1;
+
+	/* The same contents may well be added more than once. */
+	if (oidset_insert(&loose_writer.queued, oid))
+		return 0;
+
+	if (batch_fsync_enabled(FSYNC_COMPONENT_LOOSE_OBJECT))
+		prepare_loose_object_bulk_checkin();
+
+	CALLOC_ARRAY(job, 1);
+	oidcpy(&job->oid, oid);
+	job->hdr = xmemdupz(hdr, hdrlen);
+	job->hdrlen = hdrlen;
+	job->buf = xmemdupz(buf, len);
+	job->len = len;
+	job->flags = flags;
+
+	pthread_mutex_lock(&loose_writer.mutex);
+	while (loose_writer.pending &&
+	       loose_writer.pending_bytes + len > LOOSE_OBJECT_QUEUE_LIMIT)
+		pthread_cond_wait(&loose_writer.done_cond, &loose_writer.mutex);
+	*loose_writer.tail = job;
+	loose_writer.tail = &job->next;
+	loose_writer.pending++;
+	loose_writer.pending_bytes += len;
+	pthread_cond_signal(&loose_writer.work_cond);
+	pthread_mutex_unlock(&loose_writer.mutex);
+
 	return 0;
 }
 
+int wait_loose_object_bulk_checkin(void)
+{
+	int waited = 0;
+
+	if (!loose_writer.nr_threads)
+		return 0;
+
+	pthread_mutex_lock(&loose_writer.mutex);
+	while (loose_writer.pending) {
+		waited = 1;
+		pthread_cond_wait(&loose_writer.done_cond, &loose_writer.mutex);
+	}
+	pthread_mutex_unlock(&loose_writer.mutex);
+
+	if (loose_writer.failed)
+		die(Q_("unable to write %d loose object",
+		       "unable to write %d loose objects",
+		       loose_writer.failed),
+		    loose_writer.failed);
+
+	/* Readers may have cached the loose objects before we wrote them. */
+	if (waited)
+		odb_clear_loose_cache(the_repository->objects->odb);
+	return waited;
+}
+
 void prepare_loose_object_bulk_checkin(void)
 {
 	/*
@@ -320,8 +749,13 @@ void prepare_loose_object_bulk_checkin(void)
 	 * the first time an object might be added, since
 	 * callers may not know whether any objects will be
 	 * added at the time they call begin_odb_transaction.
+	 *
+	 * When new blobs go to a packfile, the few remaining loose
+	 * objects are synced one by one, so that the pack does not
+	 * end up in the temporary object directory.
 	 */
-	if (!odb_transaction_nesting || bulk_fsync_objdir)
+	if (!odb_transaction_nesting || bulk_fsync_objdir ||
+	    use_bulk_checkin_pack())
 		return;
 
 	bulk_fsync_objdir = tmp_objdir_create("bulk-fsync");
@@ -359,11 +793,16 @@ int index_bulk_checkin(struct object_id *oid,
 
 void begin_odb_transaction(void)
 {
+#ifndef NO_PTHREADS
+	if (!odb_transaction_nesting)
+		odb_transaction_thread = pthread_self();
+#endif
 	odb_transaction_nesting += 1;
 }
 
 void flush_odb_transaction(void)
 {
+	wait_loose_object_bulk_checkin();
 	flush_batch_fsync();
 	flush_bulk_checkin_packfile(&bulk_checkin_packfile);
 }
@@ -378,4 +817,5 @@ void end_odb_transaction(void)
 		return;
 
 	flush_odb_transaction();
+	stop_loose_object_writers();
 }
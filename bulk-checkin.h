@@ -6,13 +6,68 @@
 
 #include "cache.h"
 
+struct object_info;
+
 void prepare_loose_object_bulk_checkin(void);
 void fsync_loose_object_bulk_checkin(int fd, const char *filename);
 
+/*
+ * Hand a new loose object to the worker threads of the current ODB
+ * transaction, which write it out in the background; "buf" is copied.
+ * Returns 0 if the object was queued (or already was), and -1 if
+ * there is no transaction or no worker threads are configured, in
+ * which case the caller has to write the object itself.
+ */
+int queue_loose_object_bulk_checkin(const struct object_id *oid,
+				    const char *hdr, int hdrlen,
+				    const void *buf, unsigned long len,
+				    unsigned flags);
+
+/*
+ * Wait until all queued loose objects have been written. Returns 1 if
+ * there were any to wait for.
+ */
+int wait_loose_object_bulk_checkin(void);
+
 int index_bulk_checkin(struct object_id *oid,
 		       int fd, size_t size, enum object_type type,
 		       const char *path, unsigned flags);
 
+/*
+ * Returns true if new blobs should go to the packfile of the current
+ * ODB transaction instead of becoming loose objects, no matter their
+ * size ("core.bulkCheckinPack").
+ */
+int use_bulk_checkin_pack(void);
+
+/*
+ * Write the object "oid", whose contents are in "buf", to the packfile
+ * of the current ODB transaction.
+ */
+void write_object_bulk_checkin(const struct object_id *oid,
+			       const void *buf, size_t size,
+			       enum object_type type);
+
+/*
+ * Look up "oid" in the packfile of the current ODB transaction, which
+ * has not been finished yet, and fill in "oi" like
+ * oid_object_info_extended() does. Returns 0 if the object was found,
+ * and -1 otherwise.
+ */
+int read_object_bulk_checkin(const struct object_id *oid,
+			     struct object_info *oi);
+
+/*
+ * Wait until the loose objects queued in the current ODB transaction
+ * have been written. Returns 1 if there were any to wait for.
+ */
+int wait_object_bulk_checkin(void);
+
+/*
+ * The two functions above do nothing when called from any thread but
+ * the one that began the transaction.
+ */
+
 /*
  * Tell the object database to optimize for adding
  * multiple objects. end_odb_transaction must be called
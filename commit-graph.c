@@ -20,6 +20,8 @@
 #include "json-writer.h"
 #include "trace2.h"
 #include "chunk-format.h"
+#include "strmap.h"
+#include "utf8.h"
 
 void git_test_write_commit_graph_or_die(void)
 {
@@ -44,9 +46,20 @@ void git_test_write_commit_graph_or_die(void)
 #define GRAPH_CHUNKID_EXTRAEDGES 0x45444745 /* "EDGE" */
 #define GRAPH_CHUNKID_BLOOMINDEXES 0x42494458 /* "BIDX" */
 #define GRAPH_CHUNKID_BLOOMDATA 0x42444154 /* "BDAT" */
+#define GRAPH_CHUNKID_MERGE_BLOOMINDEXES 0x424d4958 /* "BMIX" */
+#define GRAPH_CHUNKID_MERGE_BLOOMDATA 0x424d4454 /* "BMDT" */
 #define GRAPH_CHUNKID_BASE 0x42415345 /* "BASE" */
+#define GRAPH_CHUNKID_REACHABILITY 0x52494458 /* "RIDX" */
+#define GRAPH_CHUNKID_FIRST_PARENT_SKIPS 0x4650534b /* "FPSK" */
+#define GRAPH_CHUNKID_IDENTS 0x49444e54 /* "IDNT" */
+#define GRAPH_CHUNKID_IDENT_INDEX 0x49444958 /* "IDIX" */
+#define GRAPH_CHUNKID_IDENT_DATA 0x49444454 /* "IDDT" */
 
 #define GRAPH_DATA_WIDTH (the_hash_algo->rawsz + 16)
+#define GRAPH_REACHABILITY_WIDTH 12
+#define GRAPH_FIRST_PARENT_WIDTH 16
+#define GRAPH_IDENTS_WIDTH 16
+#define GRAPH_IDENT_NONE 0xffffffff
 
 #define GRAPH_VERSION_1 0x1
 #define GRAPH_VERSION GRAPH_VERSION_1
@@ -322,6 +335,90 @@ static int graph_read_bloom_data(const unsigned char *chunk_start,
 	return 0;
 }
 
+static int graph_read_merge_bloom_indexes(const unsigned char *chunk_start,
+					  size_t chunk_size, void *data)
+{
+	struct commit_graph *g = data;
+
+	if (chunk_size != st_mult(g->num_commits, sizeof(uint32_t))) {
+		warning(_("commit-graph merge Bloom filter index has the wrong size; ignoring it"));
+		return 0;
+	}
+	g->chunk_merge_bloom_indexes = chunk_start;
+	return 0;
+}
+
+static int graph_read_merge_bloom_data(const unsigned char *chunk_start,
+				       size_t chunk_size, void *data)
+{
+	struct commit_graph *g = data;
+	g->chunk_merge_bloom_data = chunk_start;
+	g->merge_bloom_data_size = chunk_size;
+	return 0;
+}
+
+static int graph_read_reachability_index(const unsigned char *chunk_start,
+					 size_t chunk_size, void *data)
+{
+	struct commit_graph *g = data;
+
+	if (chunk_size != st_mult(g->num_commits, GRAPH_REACHABILITY_WIDTH)) {
+		warning(_("commit-graph reachability index has the wrong size; ignoring it"));
+		return 0;
+	}
+	g->chunk_reachability_index = chunk_start;
+	return 0;
+}
+
+static int graph_read_first_parent_skips(const unsigned char *chunk_start,
+					 size_t chunk_size, void *data)
+{
+	struct commit_graph *g = data;
+
+	if (chunk_size != st_mult(g->num_commits, GRAPH_FIRST_PARENT_WIDTH)) {
+		warning(_("commit-graph first-parent skips have the wrong size; ignoring them"));
+		return 0;
+	}
+	g->chunk_first_parent_skips = chunk_start;
+	return 0;
+}
+
+static int graph_read_idents(const unsigned char *chunk_start,
+			     size_t chunk_size, void *data)
+{
+	struct commit_graph *g = data;
+
+	if (chunk_size != st_mult(g->num_commits, GRAPH_IDENTS_WIDTH)) {
+		warning(_("commit-graph idents have the wrong size; ignoring them"));
+		return 0;
+	}
+	g->chunk_idents = chunk_start;
+	return 0;
+}
+
+static int graph_read_ident_index(const unsigned char *chunk_start,
+				  size_t chunk_size, void *data)
+{
+	struct commit_graph *g = data;
+
+	if (chunk_size % sizeof(uint32_t)) {
+		warning(_("commit-graph ident index has the wrong size; ignoring it"));
+		return 0;
+	}
+	g->chunk_ident_index = chunk_start;
+	g->num_idents = chunk_size / sizeof(uint32_t);
+	return 0;
+}
+
+static int graph_read_ident_data(const unsigned char *chunk_start,
+				 size_t chunk_size, void *data)
+{
+	struct commit_graph *g = data;
+	g->chunk_ident_data = chunk_start;
+	g->ident_data_size = chunk_size;
+	return 0;
+}
+
 struct commit_graph *parse_commit_graph(struct repo_settings *s,
 					void *graph_map, size_t graph_size)
 {
@@ -404,6 +501,24 @@ struct commit_graph *parse_commit_graph(struct repo_settings *s,
 			   &graph->chunk_bloom_indexes);
 		read_chunk(cf, GRAPH_CHUNKID_BLOOMDATA,
 			   graph_read_bloom_data, graph);
+		read_chunk(cf, GRAPH_CHUNKID_MERGE_BLOOMINDEXES,
+			   graph_read_merge_bloom_indexes, graph);
+		read_chunk(cf, GRAPH_CHUNKID_MERGE_BLOOMDATA,
+			   graph_read_merge_bloom_data, graph);
+	}
+
+	if (s->commit_graph_read_reachability_index)
+		read_chunk(cf, GRAPH_CHUNKID_REACHABILITY,
+			   graph_read_reachability_index, graph);
+	if (s->commit_graph_read_first_parent_skips)
+		read_chunk(cf, GRAPH_CHUNKID_FIRST_PARENT_SKIPS,
+			   graph_read_first_parent_skips, graph);
+	if (s->commit_graph_read_idents) {
+		read_chunk(cf, GRAPH_CHUNKID_IDENTS, graph_read_idents, graph);
+		read_chunk(cf, GRAPH_CHUNKID_IDENT_INDEX,
+			   graph_read_ident_index, graph);
+		read_chunk(cf, GRAPH_CHUNKID_IDENT_DATA,
+			   graph_read_ident_data, graph);
 	}
 
 	if (graph->chunk_bloom_indexes && graph->chunk_bloom_data) {
@@ -415,6 +530,23 @@ struct commit_graph *parse_commit_graph(struct repo_settings *s,
 		FREE_AND_NULL(graph->bloom_filter_settings);
 	}
 
+	if (!graph->chunk_bloom_data || !graph->chunk_merge_bloom_indexes ||
+	    !graph->chunk_merge_bloom_data) {
+		/* The merge filters use the settings of the others. */
+		graph->chunk_merge_bloom_indexes = NULL;
+		graph->chunk_merge_bloom_data = NULL;
+		graph->merge_bloom_data_size = 0;
+	}
+
+	if (!graph->chunk_idents || !graph->chunk_ident_index ||
+	    !graph->chunk_ident_data) {
+		/* Likewise, the idents are of no use without all three. */
+		graph->chunk_idents = NULL;
+		graph->chunk_ident_index = NULL;
+		graph->chunk_ident_data = NULL;
+		graph->num_idents = 0;
+	}
+
 	oidread(&graph->oid, graph->data + graph->data_len - graph->hash_len);
 
 	if (verify_commit_graph_lite(graph))
@@ -704,6 +836,123 @@ struct bloom_filter_settings *get_bloom_filter_settings(struct repository *r)
 	return NULL;
 }
 
+static int label_reaches(struct commit_graph *g, uint32_t pos,
+			 uint32_t to_post)
+{
+	const unsigned char *label = g->chunk_reachability_index +
+		st_mult(pos - g->num_commits_in_base, GRAPH_REACHABILITY_WIDTH);
+
+	/* Everything a commit reaches is finished before it... */
+	if (to_post > get_be32(label))
+		return 0;
+	/* ...including its subtree of the search forest... */
+	if (to_post >= get_be32(label + 4))
+		return 1;
+	/* ...and nothing before the lowest commit it reaches. */
+	if (to_post < get_be32(label + 8))
+		return 0;
+	return -1;
+}
+
+/*
+ * How many commits commit_graph_reaches() looks at before giving up
+ * when the labels cannot tell right away.
+ */
+#define REACHABILITY_SEARCH_LIMIT 256
+
+int commit_graph_reaches(struct repository *r,
+			 struct commit *from, struct commit *to)
+{
+	struct commit_graph *g = r->objects->commit_graph;
+	uint32_t from_pos = commit_graph_position(from);
+	uint32_t to_pos = commit_graph_position(to);
+	uint32_t stack[REACHABILITY_SEARCH_LIMIT];
+	uint32_t to_post;
+	int ret, nr = 0, searched = 0;
+
+	if (from == to)
+		return 1;
+	if (from_pos == COMMIT_NOT_FROM_GRAPH ||
+	    to_pos == COMMIT_NOT_FROM_GRAPH)
+		return -1;
+
+	while (g && from_pos < g->num_commits_in_base)
+		g = g->base_graph;
+	if (!g)
+		return -1;
+
+	/*
+	 * The parents of the commits in a layer are in that layer or
+	 * below it, so nothing in a layer above that of "from" can be
+	 * reached from it, and nothing in its layer can be reached
+	 * through the layers below.
+	 */
+	if (to_pos >= g->num_commits_in_base + g->num_commits)
+		return 0;
+	if (to_pos < g->num_commits_in_base || !g->chunk_reachability_index)
+		return -1;
+
+	to_post = get_be32(g->chunk_reachability_index +
+			   st_mult(to_pos - g->num_commits_in_base,
+				   GRAPH_REACHABILITY_WIDTH));
+	ret = label_reaches(g, from_pos, to_post);
+	if (ret >= 0)
+		return ret;
+
+	/*
+	 * Otherwise search the parents for one whose labels tell that
+	 * it reaches "to", skipping those whose labels tell it does not.
+	 */
+	stack[nr++] = from_pos;
+	while (nr) {
+		const unsigned char *commit_data;
+		const unsigned char *extra = NULL;
+		uint32_t edge, parents[2];
+		int i, nr_parents = 0;
+
+		if (++searched > REACHABILITY_SEARCH_LIMIT)
+			return -1;
+
+		commit_data = g->chunk_commit_data +
+			st_mult(GRAPH_DATA_WIDTH, stack[--nr] - g->num_commits_in_base);
+		edge = get_be32(commit_data + g->hash_len);
+		if (edge != GRAPH_PARENT_NONE)
+			parents[nr_parents++] = edge;
+		edge = get_be32(commit_data + g->hash_len + 4);
+		if (edge & GRAPH_EXTRA_EDGES_NEEDED)
+			extra = g->chunk_extra_edges +
+				st_mult(4, edge & GRAPH_EDGE_LAST_MASK);
+		else if (edge != GRAPH_PARENT_NONE)
+			parents[nr_parents++] = edge;
+
+		for (i = 0; ; i++) {
+			uint32_t pos;
+
+			if (i < nr_parents)
+				pos = parents[i];
+			else if (extra) {
+				edge = get_be32(extra);
+				extra = edge & GRAPH_LAST_EDGE ? NULL : extra + 4;
+				pos = edge & GRAPH_EDGE_LAST_MASK;
+			} else
+				break;
+
+			if (pos < g->num_commits_in_base)
+				continue;
+			switch (label_reaches(g, pos, to_post)) {
+			case 1:
+				return 1;
+			case 0:
+				continue;
+			}
+			if (nr == REACHABILITY_SEARCH_LIMIT)
+				return -1;
+			stack[nr++] = pos;
+		}
+	}
+	return 0;
+}
+
 static void close_commit_graph_one(struct commit_graph *g)
 {
 	if (!g)
@@ -861,6 +1110,377 @@ static int fill_commit_in_graph(struct repository *r,
 	return 1;
 }
 
+struct first_parent_skip {
+	uint32_t depth;
+	uint32_t jump;
+	uint32_t first_parent;
+	timestamp_t min_date;
+	timestamp_t date;
+};
+
+static int read_first_parent_skip(struct commit_graph *g, uint32_t pos,
+				  struct first_parent_skip *skip)
+{
+	const unsigned char *entry, *commit_data;
+	uint32_t lex_index;
+
+	while (g && pos < g->num_commits_in_base)
+		g = g->base_graph;
+	if (!g || !g->chunk_first_parent_skips ||
+	    pos >= g->num_commits_in_base + g->num_commits)
+		return -1;
+	lex_index = pos - g->num_commits_in_base;
+
+	entry = g->chunk_first_parent_skips +
+		st_mult(lex_index, GRAPH_FIRST_PARENT_WIDTH);
+	skip->depth = get_be32(entry);
+	skip->jump = get_be32(entry + 4);
+	skip->min_date = get_be64(entry + 8);
+
+	commit_data = g->chunk_commit_data + st_mult(GRAPH_DATA_WIDTH, lex_index);
+	skip->first_parent = get_be32(commit_data + g->hash_len);
+	skip->date = ((timestamp_t)(get_be32(commit_data + g->hash_len + 8) & 0x3) << 32) |
+		     get_be32(commit_data + g->hash_len + 12);
+	return 0;
+}
+
+/*
+ * Follow the first parents of the commit at "pos" down to the one at
+ * "depth", taking the skip whenever it does not go past it. Returns 1
+ * and fills "result" if there is one, 0 if there is none, and -1 if we
+ * lack the skips (or they make no sense).
+ */
+static int first_parent_at(struct commit_graph *g, uint32_t pos,
+			   uint32_t depth, uint32_t *result)
+{
+	struct first_parent_skip cur, next;
+
+	if (read_first_parent_skip(g, pos, &cur))
+		return -1;
+	if (cur.depth < depth)
+		return 0;
+
+	while (cur.depth > depth) {
+		uint32_t next_pos = cur.jump;
+
+		if (read_first_parent_skip(g, next_pos, &next) ||
+		    next.depth < depth) {
+			next_pos = cur.first_parent;
+			if (read_first_parent_skip(g, next_pos, &next))
+				return -1;
+		}
+		if (next.depth >= cur.depth)
+			return -1;
+		pos = next_pos;
+		cur = next;
+	}
+
+	*result = pos;
+	return 1;
+}
+
+static struct commit *commit_at_graph_pos(struct repository *r, uint32_t pos)
+{
+	struct object_id oid;
+
+	load_oid_from_graph(r->objects->commit_graph, pos, &oid);
+	return lookup_commit(r, &oid);
+}
+
+int commit_graph_first_parent_depth(struct repository *r, struct commit *c,
+				    uint32_t *depth)
+{
+	struct first_parent_skip skip;
+	uint32_t pos = commit_graph_position(c);
+
+	if (pos == COMMIT_NOT_FROM_GRAPH ||
+	    read_first_parent_skip(r->objects->commit_graph, pos, &skip))
+		return -1;
+	*depth = skip.depth;
+	return 0;
+}
+
+int commit_graph_first_parent_at(struct repository *r, struct commit *c,
+				 uint32_t depth, struct commit **result)
+{
+	uint32_t pos = commit_graph_position(c);
+	int ret;
+
+	if (pos == COMMIT_NOT_FROM_GRAPH)
+		return -1;
+	ret = first_parent_at(r->objects->commit_graph, pos, depth, &pos);
+	if (ret < 0)
+		return -1;
+	*result = ret ? commit_at_graph_pos(r, pos) : NULL;
+	return 0;
+}
+
+int commit_graph_first_parent_until(struct repository *r, struct commit *c,
+				    timestamp_t date, struct commit **result)
+{
+	struct commit_graph *g = r->objects->commit_graph;
+	struct first_parent_skip cur;
+	uint32_t pos = commit_graph_position(c);
+	uint32_t last_depth = UINT32_MAX;
+
+	if (pos == COMMIT_NOT_FROM_GRAPH)
+		return -1;
+
+	for (;;) {
+		if (read_first_parent_skip(g, pos, &cur) ||
+		    cur.depth >= last_depth)
+			return -1;
+		if (cur.date <= date) {
+			*result = commit_at_graph_pos(r, pos);
+			return 0;
+		}
+		if (!cur.depth) {
+			*result = NULL;
+			return 0;
+		}
+
+		/* Skip all of the commits that are too new at once. */
+		pos = cur.min_date > date ? cur.jump : cur.first_parent;
+		last_depth = cur.depth;
+	}
+}
+
+/*
+ * Return the number of commits that the first-parent histories of the
+ * commits at "a" and "b" have in common, or -1 if we cannot tell.
+ */
+static int64_t first_parent_overlap(struct commit_graph *g,
+				    uint32_t a, uint32_t b, uint32_t depth)
+{
+	uint32_t a_at, b_at, lo, hi;
+
+	/* "depth" is that of the shallower one of the two. */
+	if (first_parent_at(g, a, depth, &a_at) != 1 ||
+	    first_parent_at(g, b, depth, &b_at) != 1)
+		return -1;
+	if (a_at == b_at)
+		return (int64_t)depth + 1;
+
+	/* Otherwise binary search for the deepest common commit. */
+	if (first_parent_at(g, a, 0, &a_at) != 1 ||
+	    first_parent_at(g, b, 0, &b_at) != 1)
+		return -1;
+	if (a_at != b_at)
+		return 0;
+	lo = 0;
+	hi = depth;
+	while (hi - lo > 1) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (first_parent_at(g, a, mid, &a_at) != 1 ||
+		    first_parent_at(g, b, mid, &b_at) != 1)
+			return -1;
+		if (a_at == b_at)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return (int64_t)lo + 1;
+}
+
+/*
+ * The most tips commit_graph_count_first_parents() compares pairwise;
+ * past this, walking their histories is faster.
+ */
+#define FIRST_PARENT_COUNT_MAX_TIPS 32
+
+int commit_graph_count_first_parents(struct repository *r,
+				     struct commit **tips, size_t nr,
+				     uint32_t *count)
+{
+	struct commit_graph *g = r->objects->commit_graph;
+	uint32_t *pos, *depth;
+	uint64_t total = 0;
+	size_t i, j;
+	int ret = -1;
+
+	if (nr > FIRST_PARENT_COUNT_MAX_TIPS)
+		return -1;
+
+	ALLOC_ARRAY(pos, nr);
+	ALLOC_ARRAY(depth, nr);
+	for (i = 0; i < nr; i++) {
+		struct first_parent_skip skip;
+
+		pos[i] = commit_graph_position(tips[i]);
+		if (pos[i] == COMMIT_NOT_FROM_GRAPH ||
+		    read_first_parent_skip(g, pos[i], &skip))
+			goto cleanup;
+		depth[i] = skip.depth;
+	}
+
+	/*
+	 * The first-parent histories form a forest, so each tip adds
+	 * the commits of its history that are not in the longest of
+	 * its overlaps with those before it.
+	 */
+	for (i = 0; i < nr; i++) {
+		int64_t overlap = 0;
+
+		for (j = 0; j < i; j++) {
+			uint32_t shallower = depth[i] < depth[j] ? depth[i] : depth[j];
+			int64_t o;
+
+			if (shallower + 1 <= overlap)
+				continue;
+			o = first_parent_overlap(g, pos[i], pos[j], shallower);
+			if (o < 0)
+				goto cleanup;
+			if (o > overlap)
+				overlap = o;
+		}
+		total += depth[i] + 1 - overlap;
+	}
+
+	if (total > UINT32_MAX)
+		goto cleanup;
+	*count = total;
+	ret = 0;
+
+cleanup:
+	free(pos);
+	free(depth);
+	return ret;
+}
+
+/*
+ * Find the author date of the commit in "buffer", as
+ * record_author_date() does, and the author and committer idents as
+ * "git log --author" and "--committer" match them, which is up to the
+ * last '>' of the header. The idents are left NULL if the commit is
+ * not in UTF-8 or they are malformed.
+ */
+static void parse_commit_idents(const char *buffer, timestamp_t *author_date,
+				const char **author, size_t *author_len,
+				const char **committer, size_t *committer_len)
+{
+	struct ident_split ident;
+	const char *line, *encoding;
+	size_t len;
+
+	*author_date = 0;
+	*author = *committer = NULL;
+	*author_len = *committer_len = 0;
+
+	line = find_commit_header(buffer, "author", &len);
+	if (line && !split_ident_line(&ident, line, len) &&
+	    ident.date_begin && ident.date_end) {
+		char *date_end;
+		timestamp_t date = parse_timestamp(ident.date_begin, &date_end, 10);
+
+		if (date_end == ident.date_end)
+			*author_date = date;
+	}
+
+	encoding = find_commit_header(buffer, "encoding", &len);
+	if (encoding) {
+		char *name = xmemdupz(encoding, len);
+		int utf8 = is_encoding_utf8(name);
+
+		free(name);
+		if (!utf8)
+			return;
+	}
+
+	line = find_commit_header(buffer, "author", &len);
+	while (line && len && line[len - 1] != '>')
+		len--;
+	if (!line || !len)
+		return;
+	*author = line;
+	*author_len = len;
+
+	line = find_commit_header(buffer, "committer", &len);
+	while (line && len && line[len - 1] != '>')
+		len--;
+	if (!line || !len) {
+		*author = NULL;
+		*author_len = 0;
+		return;
+	}
+	*committer = line;
+	*committer_len = len;
+}
+
+static const unsigned char *graph_idents_entry(struct commit_graph *g,
+					       struct commit *c,
+					       struct commit_graph **gp)
+{
+	uint32_t pos = commit_graph_position(c);
+
+	if (pos == COMMIT_NOT_FROM_GRAPH)
+		return NULL;
+	while (g && pos < g->num_commits_in_base)
+		g = g->base_graph;
+	if (!g || !g->chunk_idents ||
+	    pos >= g->num_commits_in_base + g->num_commits)
+		return NULL;
+
+	*gp = g;
+	return g->chunk_idents +
+		st_mult(pos - g->num_commits_in_base, GRAPH_IDENTS_WIDTH);
+}
+
+static int graph_ident(struct commit_graph *g, uint32_t id,
+		       const char **ident, size_t *len)
+{
+	uint32_t start, end;
+
+	if (id >= g->num_idents)
+		return -1;
+	start = id ? get_be32(g->chunk_ident_index + st_mult(id - 1, 4)) : 0;
+	end = get_be32(g->chunk_ident_index + st_mult(id, 4));
+	if (start > end || end > g->ident_data_size)
+		return -1;
+
+	*ident = (const char *)g->chunk_ident_data + start;
+	*len = end - start;
+	return 0;
+}
+
+static int author_date_one(struct commit_graph *g, struct commit *c,
+			   timestamp_t *date)
+{
+	const unsigned char *entry = graph_idents_entry(g, c, &g);
+
+	if (!entry)
+		return -1;
+	*date = get_be64(entry);
+	return 0;
+}
+
+int commit_graph_author_date(struct repository *r, struct commit *c,
+			     timestamp_t *date)
+{
+	return author_date_one(r->objects->commit_graph, c, date);
+}
+
+static int idents_one(struct commit_graph *g, struct commit *c,
+		      const char **author, size_t *author_len,
+		      const char **committer, size_t *committer_len)
+{
+	const unsigned char *entry = graph_idents_entry(g, c, &g);
+
+	if (!entry ||
+	    graph_ident(g, get_be32(entry + 8), author, author_len) ||
+	    graph_ident(g, get_be32(entry + 12), committer, committer_len))
+		return -1;
+	return 0;
+}
+
+int commit_graph_idents(struct repository *r, struct commit *c,
+			const char **author, size_t *author_len,
+			const char **committer, size_t *committer_len)
+{
+	return idents_one(r->objects->commit_graph, c, author, author_len,
+			  committer, committer_len);
+}
+
 static int search_commit_pos_in_graph(const struct object_id *id, struct commit_graph *g, uint32_t *pos)
 {
 	struct commit_graph *cur_g = g;
@@ -1026,6 +1646,10 @@ struct write_commit_graph_context {
 		 report_progress:1,
 		 split:1,
 		 changed_paths:1,
+		 merge_bloom_filters:1,
+		 reachability_index:1,
+		 first_parent_skips:1,
+		 idents:1,
 		 order_by_pack:1,
 		 write_generation_data:1,
 		 trust_generation_numbers:1;
@@ -1034,11 +1658,20 @@ struct write_commit_graph_context {
 	const struct commit_graph_opts *opts;
 	size_t total_bloom_filter_data_size;
 	const struct bloom_filter_settings *bloom_settings;
+	uint32_t *reachability_labels;
+	struct first_parent_skip *skip_entries;
+	struct commit_idents *ident_entries;
+	uint32_t *ident_ends;
+	uint32_t nr_idents, alloc_idents;
+	struct strbuf ident_data;
+	uint32_t *merge_bloom_ends;
+	struct strbuf merge_bloom_data;
 
 	int count_bloom_filter_computed;
 	int count_bloom_filter_not_computed;
 	int count_bloom_filter_trunc_empty;
 	int count_bloom_filter_trunc_large;
+	int count_merge_bloom_filter_computed;
 };
 
 static int write_graph_chunk_fanout(struct hashfile *f,
@@ -1234,6 +1867,83 @@ static int write_graph_chunk_generation_data_overflow(struct hashfile *f,
 	return 0;
 }
 
+static int write_graph_chunk_reachability_index(struct hashfile *f,
+						void *data)
+{
+	struct write_commit_graph_context *ctx = data;
+	uint32_t *label = ctx->reachability_labels;
+	size_t i;
+
+	for (i = 0; i < ctx->commits.nr; i++, label += 3) {
+		display_progress(ctx->progress, ++ctx->progress_cnt);
+		hashwrite_be32(f, label[0]);
+		hashwrite_be32(f, label[1]);
+		hashwrite_be32(f, label[2]);
+	}
+
+	return 0;
+}
+
+struct commit_idents {
+	timestamp_t author_date;
+	uint32_t author;
+	uint32_t committer;
+};
+
+static int write_graph_chunk_idents(struct hashfile *f, void *data)
+{
+	struct write_commit_graph_context *ctx = data;
+	size_t i;
+
+	for (i = 0; i < ctx->commits.nr; i++) {
+		struct commit_idents *idents = &ctx->ident_entries[i];
+
+		display_progress(ctx->progress, ++ctx->progress_cnt);
+		hashwrite_be64(f, idents->author_date);
+		hashwrite_be32(f, idents->author);
+		hashwrite_be32(f, idents->committer);
+	}
+
+	return 0;
+}
+
+static int write_graph_chunk_ident_index(struct hashfile *f, void *data)
+{
+	struct write_commit_graph_context *ctx = data;
+	uint32_t i;
+
+	for (i = 0; i < ctx->nr_idents; i++)
+		hashwrite_be32(f, ctx->ident_ends[i]);
+
+	return 0;
+}
+
+static int write_graph_chunk_ident_data(struct hashfile *f, void *data)
+{
+	struct write_commit_graph_context *ctx = data;
+
+	hashwrite(f, ctx->ident_data.buf, ctx->ident_data.len);
+	return 0;
+}
+
+static int write_graph_chunk_first_parent_skips(struct hashfile *f,
+						void *data)
+{
+	struct write_commit_graph_context *ctx = data;
+	size_t i;
+
+	for (i = 0; i < ctx->commits.nr; i++) {
+		struct first_parent_skip *skip = &ctx->skip_entries[i];
+
+		display_progress(ctx->progress, ++ctx->progress_cnt);
+		hashwrite_be32(f, skip->depth);
+		hashwrite_be32(f, skip->jump);
+		hashwrite_be64(f, skip->min_date);
+	}
+
+	return 0;
+}
+
 static int write_graph_chunk_extra_edges(struct hashfile *f,
 					 void *data)
 {
@@ -1309,6 +2019,28 @@ static int write_graph_chunk_bloom_indexes(struct hashfile *f,
 	return 0;
 }
 
+static int write_graph_chunk_merge_bloom_indexes(struct hashfile *f,
+						 void *data)
+{
+	struct write_commit_graph_context *ctx = data;
+	uint32_t i;
+
+	for (i = 0; i < ctx->commits.nr; i++) {
+		display_progress(ctx->progress, ++ctx->progress_cnt);
+		hashwrite_be32(f, ctx->merge_bloom_ends[i]);
+	}
+
+	return 0;
+}
+
+static int write_graph_chunk_merge_bloom_data(struct hashfile *f,
+					      void *data)
+{
+	struct write_commit_graph_context *ctx = data;
+	hashwrite(f, ctx->merge_bloom_data.buf, ctx->merge_bloom_data.len);
+	return 0;
+}
+
 static void trace2_bloom_filter_settings(struct write_commit_graph_context *ctx)
 {
 	struct json_writer jw = JSON_WRITER_INIT;
@@ -1634,6 +2366,380 @@ static void compute_bloom_filters(struct write_commit_graph_context *ctx)
 	stop_progress(&progress);
 }
 
+/*
+ * For each merge with a changed-path Bloom filter, record its filters
+ * against the other parents, each preceded by its length. A merge gets
+ * either all of them or none.
+ */
+static void compute_merge_bloom_filters(struct write_commit_graph_context *ctx)
+{
+	int i;
+	struct progress *progress = NULL;
+	int max_new_filters;
+
+	if (ctx->report_progress)
+		progress = start_delayed_progress(
+			_("Computing merge changed paths Bloom filters"),
+			ctx->commits.nr);
+
+	max_new_filters = ctx->opts && ctx->opts->max_new_filters >= 0 ?
+		ctx->opts->max_new_filters : INT_MAX;
+
+	CALLOC_ARRAY(ctx->merge_bloom_ends, ctx->commits.nr);
+	for (i = 0; i < ctx->commits.nr; i++) {
+		struct commit *c = ctx->commits.list[i];
+		struct commit_list *parent;
+		size_t start = ctx->merge_bloom_data.len;
+		int nth_parent;
+
+		if (c->parents && c->parents->next &&
+		    get_bloom_filter(ctx->r, c)) {
+			for (parent = c->parents->next, nth_parent = 1; parent;
+			     parent = parent->next, nth_parent++) {
+				struct bloom_filter filter = { 0 };
+				enum bloom_filter_computed computed = 0;
+				uint32_t len;
+				int compute = ctx->count_bloom_filter_computed +
+					ctx->count_merge_bloom_filter_computed < max_new_filters;
+
+				if (!get_or_compute_parent_bloom_filter(
+					ctx->r, c, nth_parent, compute,
+					ctx->bloom_settings, &filter, &computed)) {
+					strbuf_setlen(&ctx->merge_bloom_data, start);
+					break;
+				}
+
+				len = htonl(filter.len);
+				strbuf_add(&ctx->merge_bloom_data, &len, sizeof(len));
+				strbuf_add(&ctx->merge_bloom_data, filter.data, filter.len);
+				if (computed & BLOOM_COMPUTED) {
+					ctx->count_merge_bloom_filter_computed++;
+					free(filter.data);
+				}
+			}
+		}
+
+		if (ctx->merge_bloom_data.len > UINT32_MAX)
+			die(_("too many merge Bloom filters to write in the commit-graph"));
+		ctx->merge_bloom_ends[i] = ctx->merge_bloom_data.len;
+		display_progress(progress, i + 1);
+	}
+
+	if (trace2_is_enabled())
+		trace2_data_intmax("commit-graph", ctx->r, "merge-filter-computed",
+				   ctx->count_merge_bloom_filter_computed);
+
+	stop_progress(&progress);
+}
+
+struct reachability_tip {
+	uint32_t pos;
+	uint32_t level;
+};
+
+static int reachability_tip_cmp(const void *va, const void *vb)
+{
+	const struct reachability_tip *a = va, *b = vb;
+
+	/* Deepest histories first, so that they get the longest subtrees. */
+	if (a->level != b->level)
+		return a->level < b->level ? 1 : -1;
+	return a->pos < b->pos ? -1 : a->pos > b->pos;
+}
+
+/*
+ * Label each commit in the new layer with three numbers, found by a
+ * depth-first search along the parent edges within the layer that
+ * starts at the commits without children:
+ *
+ *  - its position in the post-order of the search,
+ *  - the lowest such position in its subtree of the search forest,
+ *    all of which it can reach, and
+ *  - the lowest such position among all the commits it can reach.
+ *
+ * See commit_graph_reaches() for how these are used.
+ */
+static void compute_reachability_index(struct write_commit_graph_context *ctx)
+{
+	uint32_t nr = ctx->commits.nr;
+	uint32_t *parent_start, *parents = NULL;
+	uint32_t *stack, *next_parent, *label;
+	struct reachability_tip *tips;
+	unsigned char *seen;
+	uint32_t i, nr_parents = 0, nr_tips = 0, depth = 0, post = 0;
+	size_t parents_alloc = 0;
+
+	if (ctx->report_progress)
+		ctx->progress = start_delayed_progress(
+					_("Computing commit graph reachability index"),
+					nr);
+
+	ALLOC_ARRAY(parent_start, st_add(nr, 1));
+	CALLOC_ARRAY(seen, nr);
+	for (i = 0; i < nr; i++) {
+		struct commit_list *p;
+
+		parent_start[i] = nr_parents;
+		for (p = ctx->commits.list[i]->parents; p; p = p->next) {
+			int pos = oid_pos(&p->item->object.oid, ctx->commits.list,
+					  ctx->commits.nr, commit_to_oid);
+
+			/* Parents in the base layers are not labeled. */
+			if (pos < 0)
+				continue;
+			ALLOC_GROW(parents, nr_parents + 1, parents_alloc);
+			parents[nr_parents++] = pos;
+			seen[pos] = 1;
+		}
+	}
+	parent_start[nr] = nr_parents;
+
+	ALLOC_ARRAY(tips, nr);
+	for (i = 0; i < nr; i++) {
+		if (seen[i])
+			continue;
+		tips[nr_tips].pos = i;
+		tips[nr_tips].level = *topo_level_slab_at(ctx->topo_levels,
+							  ctx->commits.list[i]);
+		nr_tips++;
+	}
+	QSORT(tips, nr_tips, reachability_tip_cmp);
+	memset(seen, 0, nr);
+
+	CALLOC_ARRAY(ctx->reachability_labels, st_mult(nr, 3));
+	label = ctx->reachability_labels;
+	ALLOC_ARRAY(stack, nr);
+	ALLOC_ARRAY(next_parent, nr);
+
+	for (i = 0; i < nr_tips; i++) {
+		uint32_t tip = tips[i].pos;
+
+		seen[tip] = 1;
+		stack[depth] = tip;
+		next_parent[depth++] = parent_start[tip];
+		label[3 * tip + 1] = post;
+
+		while (depth) {
+			uint32_t cur = stack[depth - 1];
+			uint32_t j, low;
+
+			if (next_parent[depth - 1] < parent_start[cur + 1]) {
+				uint32_t p = parents[next_parent[depth - 1]++];
+
+				if (seen[p])
+					continue;
+				seen[p] = 1;
+				stack[depth] = p;
+				next_parent[depth++] = parent_start[p];
+				label[3 * p + 1] = post;
+				continue;
+			}
+
+			/* All parents are labeled; so is the subtree. */
+			depth--;
+			low = label[3 * cur + 1];
+			for (j = parent_start[cur]; j < parent_start[cur + 1]; j++)
+				if (label[3 * parents[j] + 2] < low)
+					low = label[3 * parents[j] + 2];
+			label[3 * cur] = post++;
+			label[3 * cur + 2] = low;
+			display_progress(ctx->progress, post);
+		}
+	}
+
+	if (post != nr)
+		BUG("reachability index labeled %"PRIu32" of %"PRIu32" commits",
+		    post, nr);
+
+	free(parent_start);
+	free(parents);
+	free(seen);
+	free(tips);
+	free(stack);
+	free(next_parent);
+	stop_progress(&ctx->progress);
+}
+
+static void get_first_parent_skip(struct write_commit_graph_context *ctx,
+				  uint32_t pos, struct first_parent_skip *skip)
+{
+	if (pos >= ctx->new_num_commits_in_base)
+		*skip = ctx->skip_entries[pos - ctx->new_num_commits_in_base];
+	else if (read_first_parent_skip(ctx->new_base_graph, pos, skip))
+		BUG("no first-parent skip for graph position %"PRIu32, pos);
+}
+
+static void compute_first_parent_skip(struct write_commit_graph_context *ctx,
+				      uint32_t lex_index)
+{
+	struct commit *c = ctx->commits.list[lex_index];
+	struct first_parent_skip *skip = &ctx->skip_entries[lex_index];
+	struct first_parent_skip parent, jump, next;
+	uint32_t parent_pos;
+	int pos;
+
+	skip->date = skip->min_date = c->date;
+	if (!c->parents) {
+		skip->depth = 0;
+		skip->jump = ctx->new_num_commits_in_base + lex_index;
+		return;
+	}
+
+	pos = oid_pos(&c->parents->item->object.oid, ctx->commits.list,
+		      ctx->commits.nr, commit_to_oid);
+	if (pos >= 0)
+		parent_pos = ctx->new_num_commits_in_base + pos;
+	else if (!find_commit_pos_in_graph(c->parents->item,
+					   ctx->new_base_graph, &parent_pos))
+		BUG("missing parent %s for commit %s",
+		    oid_to_hex(&c->parents->item->object.oid),
+		    oid_to_hex(&c->object.oid));
+
+	get_first_parent_skip(ctx, parent_pos, &parent);
+	skip->depth = parent.depth + 1;
+	skip->first_parent = parent_pos;
+	skip->jump = parent_pos;
+	if (!parent.depth)
+		return;
+
+	/*
+	 * Take the skips of the parent and the one after it at once if
+	 * they are the same length.
+	 */
+	get_first_parent_skip(ctx, parent.jump, &jump);
+	if (!jump.depth)
+		return;
+	get_first_parent_skip(ctx, jump.jump, &next);
+	if (parent.depth - jump.depth != jump.depth - next.depth)
+		return;
+	skip->jump = jump.jump;
+	if (parent.min_date < skip->min_date)
+		skip->min_date = parent.min_date;
+	if (jump.min_date < skip->min_date)
+		skip->min_date = jump.min_date;
+}
+
+/*
+ * Give each commit in the new layer a skip along its first-parent
+ * history, as in the "skew-binary random-access lists" of Myers: a
+ * commit skips to where the skip of its parent's skip leads if the
+ * parent's skip and that one are of the same length, and to its parent
+ * otherwise. This gets every commit in the history within a
+ * logarithmic number of skips and single steps. Each skip also records
+ * the oldest commit date among the commits it skips.
+ */
+static void compute_first_parent_skips(struct write_commit_graph_context *ctx)
+{
+	uint32_t nr = ctx->commits.nr;
+	uint32_t *stack, depth = 0, i;
+	unsigned char *done;
+	struct commit_graph *g;
+
+	for (g = ctx->new_base_graph; g; g = g->base_graph) {
+		if (!g->chunk_first_parent_skips) {
+			warning(_("commit-graph layers below have no first-parent skips; not writing them"));
+			ctx->first_parent_skips = 0;
+			return;
+		}
+	}
+
+	if (ctx->report_progress)
+		ctx->progress = start_delayed_progress(
+					_("Computing commit graph first-parent skips"),
+					nr);
+
+	CALLOC_ARRAY(ctx->skip_entries, nr);
+	CALLOC_ARRAY(done, nr);
+	ALLOC_ARRAY(stack, nr);
+
+	for (i = 0; i < nr; i++) {
+		int pos = i;
+
+		/* Parents first, down to one we have done already. */
+		while (pos >= 0 && !done[pos]) {
+			struct commit_list *parents = ctx->commits.list[pos]->parents;
+
+			done[pos] = 1;
+			stack[depth++] = pos;
+			if (!parents)
+				break;
+			pos = oid_pos(&parents->item->object.oid, ctx->commits.list,
+				      ctx->commits.nr, commit_to_oid);
+		}
+		while (depth) {
+			compute_first_parent_skip(ctx, stack[--depth]);
+			display_progress(ctx->progress, ++ctx->progress_cnt);
+		}
+	}
+
+	free(stack);
+	free(done);
+	stop_progress(&ctx->progress);
+}
+
+static uint32_t intern_ident(struct write_commit_graph_context *ctx,
+			     struct strintmap *ids,
+			     const char *ident, size_t len)
+{
+	struct strbuf key = STRBUF_INIT;
+	int id;
+
+	if (!ident)
+		return GRAPH_IDENT_NONE;
+
+	strbuf_add(&key, ident, len);
+	id = strintmap_get(ids, key.buf);
+	if (id < 0) {
+		if (ctx->ident_data.len + len > UINT32_MAX)
+			die(_("too many idents to write in the commit-graph"));
+		id = ctx->nr_idents;
+		strbuf_add(&ctx->ident_data, ident, len);
+		ALLOC_GROW(ctx->ident_ends, ctx->nr_idents + 1, ctx->alloc_idents);
+		ctx->ident_ends[ctx->nr_idents++] = ctx->ident_data.len;
+		strintmap_set(ids, key.buf, id);
+	}
+	strbuf_release(&key);
+	return id;
+}
+
+/*
+ * Record the author date and the author and committer idents of each
+ * commit, each distinct ident stored only once.
+ */
+static void compute_idents(struct write_commit_graph_context *ctx)
+{
+	struct strintmap ids = STRINTMAP_INIT;
+	uint32_t i;
+
+	strintmap_init(&ids, -1);
+	if (ctx->report_progress)
+		ctx->progress = start_delayed_progress(
+					_("Collecting commit idents"),
+					ctx->commits.nr);
+
+	CALLOC_ARRAY(ctx->ident_entries, ctx->commits.nr);
+	for (i = 0; i < ctx->commits.nr; i++) {
+		struct commit *c = ctx->commits.list[i];
+		struct commit_idents *idents = &ctx->ident_entries[i];
+		const char *buffer = repo_get_commit_buffer(ctx->r, c, NULL);
+		const char *author, *committer;
+		size_t author_len, committer_len;
+
+		parse_commit_idents(buffer, &idents->author_date,
+				    &author, &author_len,
+				    &committer, &committer_len);
+		idents->author = intern_ident(ctx, &ids, author, author_len);
+		idents->committer = intern_ident(ctx, &ids, committer,
+						 committer_len);
+		repo_unuse_commit_buffer(ctx->r, c, buffer);
+
+		display_progress(ctx->progress, i + 1);
+	}
+
+	strintmap_clear(&ids);
+	stop_progress(&ctx->progress);
+}
+
 struct refs_cb_data {
 	struct oidset *commits;
 	struct progress *progress;
@@ -1909,6 +3015,33 @@ static int write_commit_graph_file(struct write_commit_graph_context *ctx)
 				+ ctx->total_bloom_filter_data_size,
 			  write_graph_chunk_bloom_data);
 	}
+	if (ctx->merge_bloom_filters) {
+		add_chunk(cf, GRAPH_CHUNKID_MERGE_BLOOMINDEXES,
+			  st_mult(sizeof(uint32_t), ctx->commits.nr),
+			  write_graph_chunk_merge_bloom_indexes);
+		add_chunk(cf, GRAPH_CHUNKID_MERGE_BLOOMDATA,
+			  ctx->merge_bloom_data.len,
+			  write_graph_chunk_merge_bloom_data);
+	}
+	if (ctx->reachability_index)
+		add_chunk(cf, GRAPH_CHUNKID_REACHABILITY,
+			  st_mult(GRAPH_REACHABILITY_WIDTH, ctx->commits.nr),
+			  write_graph_chunk_reachability_index);
+	if (ctx->first_parent_skips)
+		add_chunk(cf, GRAPH_CHUNKID_FIRST_PARENT_SKIPS,
+			  st_mult(GRAPH_FIRST_PARENT_WIDTH, ctx->commits.nr),
+			  write_graph_chunk_first_parent_skips);
+	if (ctx->idents) {
+		add_chunk(cf, GRAPH_CHUNKID_IDENTS,
+			  st_mult(GRAPH_IDENTS_WIDTH, ctx->commits.nr),
+			  write_graph_chunk_idents);
+		add_chunk(cf, GRAPH_CHUNKID_IDENT_INDEX,
+			  st_mult(sizeof(uint32_t), ctx->nr_idents),
+			  write_graph_chunk_ident_index);
+		add_chunk(cf, GRAPH_CHUNKID_IDENT_DATA,
+			  ctx->ident_data.len,
+			  write_graph_chunk_ident_data);
+	}
 	if (ctx->num_commit_graphs_after > 1)
 		add_chunk(cf, GRAPH_CHUNKID_BASE,
 			  hashsz * (ctx->num_commit_graphs_after - 1),
@@ -2302,6 +3435,8 @@ int write_commit_graph(struct object_directory *odb,
 	ctx->total_bloom_filter_data_size = 0;
 	ctx->write_generation_data = (get_configured_generation_version(r) == 2);
 	ctx->num_generation_data_overflows = 0;
+	strbuf_init(&ctx->ident_data, 0);
+	strbuf_init(&ctx->merge_bloom_data, 0);
 
 	bloom_settings.bits_per_entry = git_env_ulong("GIT_TEST_BLOOM_SETTINGS_BITS_PER_ENTRY",
 						      bloom_settings.bits_per_entry);
@@ -2338,6 +3473,48 @@ int write_commit_graph(struct object_directory *odb,
 		}
 	}
 
+	if (flags & COMMIT_GRAPH_WRITE_MERGE_BLOOM_FILTERS)
+		ctx->merge_bloom_filters = 1;
+	if (!(flags & COMMIT_GRAPH_NO_WRITE_MERGE_BLOOM_FILTERS)) {
+		struct commit_graph *g = ctx->r->objects->commit_graph;
+
+		/* Keep the merge filters if we have them already. */
+		if (g && g->chunk_merge_bloom_indexes)
+			ctx->merge_bloom_filters = 1;
+	}
+	if (!ctx->changed_paths)
+		ctx->merge_bloom_filters = 0;
+
+	if (flags & COMMIT_GRAPH_WRITE_REACHABILITY_INDEX)
+		ctx->reachability_index = 1;
+	if (!(flags & COMMIT_GRAPH_NO_WRITE_REACHABILITY_INDEX)) {
+		struct commit_graph *g = ctx->r->objects->commit_graph;
+
+		/* Keep the reachability index if we have one already. */
+		if (g && g->chunk_reachability_index)
+			ctx->reachability_index = 1;
+	}
+
+	if (flags & COMMIT_GRAPH_WRITE_FIRST_PARENT_SKIPS)
+		ctx->first_parent_skips = 1;
+	if (!(flags & COMMIT_GRAPH_NO_WRITE_FIRST_PARENT_SKIPS)) {
+		struct commit_graph *g = ctx->r->objects->commit_graph;
+
+		/* Keep the first-parent skips if we have them already. */
+		if (g && g->chunk_first_parent_skips)
+			ctx->first_parent_skips = 1;
+	}
+
+	if (flags & COMMIT_GRAPH_WRITE_IDENTS)
+		ctx->idents = 1;
+	if (!(flags & COMMIT_GRAPH_NO_WRITE_IDENTS)) {
+		struct commit_graph *g = ctx->r->objects->commit_graph;
+
+		/* Keep the idents if we have them already. */
+		if (g && g->chunk_idents)
+			ctx->idents = 1;
+	}
+
 	if (ctx->split) {
 		struct commit_graph *g = ctx->r->objects->commit_graph;
 
@@ -2418,6 +3595,18 @@ int write_commit_graph(struct object_directory *odb,
 	if (ctx->changed_paths)
 		compute_bloom_filters(ctx);
 
+	if (ctx->merge_bloom_filters)
+		compute_merge_bloom_filters(ctx);
+
+	if (ctx->reachability_index)
+		compute_reachability_index(ctx);
+
+	if (ctx->first_parent_skips)
+		compute_first_parent_skips(ctx);
+
+	if (ctx->idents)
+		compute_idents(ctx);
+
 	res = write_commit_graph_file(ctx);
 
 	if (ctx->split)
@@ -2428,6 +3617,13 @@ int write_commit_graph(struct object_directory *odb,
 cleanup:
 	free(ctx->graph_name);
 	free(ctx->commits.list);
+	free(ctx->reachability_labels);
+	free(ctx->skip_entries);
+	free(ctx->ident_entries);
+	free(ctx->ident_ends);
+	strbuf_release(&ctx->ident_data);
+	free(ctx->merge_bloom_ends);
+	strbuf_release(&ctx->merge_bloom_data);
 	oid_array_clear(&ctx->oids);
 	clear_topo_level_slab(&topo_levels);
 
@@ -2473,6 +3669,94 @@ static int commit_graph_checksum_valid(struct commit_graph *g)
 	return hashfile_checksum_valid(g->data, g->data_len);
 }
 
+static void verify_reachability_index(struct commit_graph *g,
+				      struct commit *c, struct commit *parent)
+{
+	const unsigned char *label, *parent_label;
+	uint32_t pos = commit_graph_position(c);
+	uint32_t parent_pos = commit_graph_position(parent);
+
+	if (!g->chunk_reachability_index ||
+	    parent_pos == COMMIT_NOT_FROM_GRAPH ||
+	    parent_pos < g->num_commits_in_base)
+		return;
+
+	label = g->chunk_reachability_index +
+		st_mult(pos - g->num_commits_in_base, GRAPH_REACHABILITY_WIDTH);
+	parent_label = g->chunk_reachability_index +
+		st_mult(parent_pos - g->num_commits_in_base, GRAPH_REACHABILITY_WIDTH);
+
+	if (get_be32(parent_label) >= get_be32(label) ||
+	    get_be32(parent_label + 8) < get_be32(label + 8))
+		graph_report(_("commit-graph reachability index for commit %s does not cover its parent %s"),
+			     oid_to_hex(&c->object.oid),
+			     oid_to_hex(&parent->object.oid));
+}
+
+static void verify_first_parent_skip(struct commit_graph *g, struct commit *c)
+{
+	struct first_parent_skip skip, parent, jump;
+	uint32_t pos = commit_graph_position(c);
+
+	if (!g->chunk_first_parent_skips ||
+	    read_first_parent_skip(g, pos, &skip))
+		return;
+
+	if (!c->parents) {
+		if (skip.depth || skip.jump != pos)
+			graph_report(_("commit-graph first-parent skip for root commit %s is not empty"),
+				     oid_to_hex(&c->object.oid));
+		return;
+	}
+
+	if (read_first_parent_skip(g, skip.first_parent, &parent) ||
+	    read_first_parent_skip(g, skip.jump, &jump) ||
+	    jump.depth >= skip.depth || skip.min_date > skip.date)
+		graph_report(_("commit-graph first-parent skip for commit %s is invalid"),
+			     oid_to_hex(&c->object.oid));
+	else if (skip.depth != parent.depth + 1)
+		graph_report(_("commit-graph first-parent depth for commit %s is %"PRIu32" != %"PRIu32),
+			     oid_to_hex(&c->object.oid), skip.depth,
+			     parent.depth + 1);
+}
+
+static void verify_idents(struct repository *r, struct commit_graph *g,
+			  struct commit *graph_commit, struct commit *odb_commit)
+{
+	const char *buffer, *author, *committer, *graph_author, *graph_committer;
+	size_t author_len, committer_len, graph_author_len, graph_committer_len;
+	timestamp_t author_date, graph_author_date;
+
+	if (!g->chunk_idents ||
+	    author_date_one(g, graph_commit, &graph_author_date))
+		return;
+
+	buffer = repo_get_commit_buffer(r, odb_commit, NULL);
+	parse_commit_idents(buffer, &author_date, &author, &author_len,
+			    &committer, &committer_len);
+
+	if (author_date != graph_author_date)
+		graph_report(_("commit-graph author date for commit %s is %"PRItime" != %"PRItime),
+			     oid_to_hex(&odb_commit->object.oid),
+			     graph_author_date, author_date);
+
+	if (idents_one(g, graph_commit,
+		       &graph_author, &graph_author_len,
+		       &graph_committer, &graph_committer_len)) {
+		if (author)
+			graph_report(_("commit-graph is missing the idents of commit %s"),
+				     oid_to_hex(&odb_commit->object.oid));
+	} else if (!author ||
+		   author_len != graph_author_len ||
+		   memcmp(author, graph_author, author_len) ||
+		   committer_len != graph_committer_len ||
+		   memcmp(committer, graph_committer, committer_len))
+		graph_report(_("commit-graph idents for commit %s do not match"),
+			     oid_to_hex(&odb_commit->object.oid));
+
+	repo_unuse_commit_buffer(r, odb_commit, buffer);
+}
+
 int verify_commit_graph(struct repository *r, struct commit_graph *g, int flags)
 {
 	uint32_t i, cur_fanout_pos = 0;
@@ -2575,6 +3859,8 @@ int verify_commit_graph(struct repository *r, struct commit_graph *g, int flags)
 
 			/* parse parent in case it is in a base graph */
 			parse_commit_in_graph_one(r, g, graph_parents->item);
+			verify_reachability_index(g, graph_commit,
+						  graph_parents->item);
 
 			if (!oideq(&graph_parents->item->object.oid, &odb_parents->item->object.oid))
 				graph_report(_("commit-graph parent for %s is %s != %s"),
@@ -2594,6 +3880,9 @@ int verify_commit_graph(struct repository *r, struct commit_graph *g, int flags)
 			graph_report(_("commit-graph parent list for commit %s terminates early"),
 				     oid_to_hex(&cur_oid));
 
+		verify_first_parent_skip(g, graph_commit);
+		verify_idents(r, g, graph_commit, odb_commit);
+
 		if (!commit_graph_generation(graph_commit)) {
 			if (generation_zero == GENERATION_NUMBER_EXISTS)
 				graph_report(_("commit-graph has generation number zero for commit %s, but non-zero elsewhere"),
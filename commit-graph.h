@@ -98,6 +98,16 @@ struct commit_graph {
 	const unsigned char *chunk_base_graphs;
 	const unsigned char *chunk_bloom_indexes;
 	const unsigned char *chunk_bloom_data;
+	const unsigned char *chunk_merge_bloom_indexes;
+	const unsigned char *chunk_merge_bloom_data;
+	size_t merge_bloom_data_size;
+	const unsigned char *chunk_reachability_index;
+	const unsigned char *chunk_first_parent_skips;
+	const unsigned char *chunk_idents;
+	const unsigned char *chunk_ident_index;
+	const unsigned char *chunk_ident_data;
+	uint32_t num_idents;
+	size_t ident_data_size;
 
 	struct topo_level_slab *topo_levels;
 	struct bloom_filter_settings *bloom_filter_settings;
@@ -130,12 +140,84 @@ int corrected_commit_dates_enabled(struct repository *r);
 
 struct bloom_filter_settings *get_bloom_filter_settings(struct repository *r);
 
+/*
+ * Use the reachability index of the commit-graph to find out whether
+ * "to" can be reached from "from" without walking. Both commits must
+ * have been parsed. Returns 1 if it can, 0 if it cannot, and -1 if the
+ * commit-graph cannot tell.
+ */
+int commit_graph_reaches(struct repository *r,
+			 struct commit *from, struct commit *to);
+
+/*
+ * The first-parent skips of the commit-graph let us move along the
+ * first-parent history of a commit in logarithmic steps. Each of these
+ * returns -1 if the commit-graph does not have them for "c", and 0
+ * otherwise.
+ *
+ * commit_graph_first_parent_depth() gives the number of commits
+ * before "c" in its first-parent history, i.e., 0 for a root commit.
+ */
+int commit_graph_first_parent_depth(struct repository *r, struct commit *c,
+				    uint32_t *depth);
+
+/*
+ * Find the commit in the first-parent history of "c" whose own depth is
+ * "depth", or NULL if "c" is not that deep.
+ */
+int commit_graph_first_parent_at(struct repository *r, struct commit *c,
+				 uint32_t depth, struct commit **result);
+
+/*
+ * Find the first commit in the first-parent history of "c", starting
+ * with "c" itself, whose commit date is not after "date", or NULL if
+ * there is none.
+ */
+int commit_graph_first_parent_until(struct repository *r, struct commit *c,
+				    timestamp_t date, struct commit **result);
+
+/*
+ * Count the commits in the union of the first-parent histories of the
+ * "nr" commits in "tips", as "git rev-list --first-parent --count" does.
+ * As this compares the histories of every pair of tips, it gives up
+ * (returning -1) on more than a few dozen of them, where a walk is
+ * faster.
+ */
+int commit_graph_count_first_parents(struct repository *r,
+				     struct commit **tips, size_t nr,
+				     uint32_t *count);
+
+/*
+ * The commit-graph may store the author date of each commit, and its
+ * author and committer idents as "git log --author" and "--committer"
+ * match them: "Name <email>", without the date. Each of these returns
+ * 0 if it has the answer for "c", and -1 otherwise.
+ */
+int commit_graph_author_date(struct repository *r, struct commit *c,
+			     timestamp_t *date);
+
+/*
+ * The idents point into the commit-graph and are not NUL-terminated.
+ * They are only available for commits in UTF-8.
+ */
+int commit_graph_idents(struct repository *r, struct commit *c,
+			const char **author, size_t *author_len,
+			const char **committer, size_t *committer_len);
+
 enum commit_graph_write_flags {
 	COMMIT_GRAPH_WRITE_APPEND     = (1 << 0),
 	COMMIT_GRAPH_WRITE_PROGRESS   = (1 << 1),
 	COMMIT_GRAPH_WRITE_SPLIT      = (1 << 2),
 	COMMIT_GRAPH_WRITE_BLOOM_FILTERS = (1 << 3),
 	COMMIT_GRAPH_NO_WRITE_BLOOM_FILTERS = (1 << 4),
+	COMMIT_GRAPH_WRITE_REACHABILITY_INDEX = (1 << 5),
+	COMMIT_GRAPH_NO_WRITE_REACHABILITY_INDEX = (1 << 6),
+	COMMIT_GRAPH_WRITE_FIRST_PARENT_SKIPS = (1 << 7),
+	COMMIT_GRAPH_NO_WRITE_FIRST_PARENT_SKIPS = (1 << 8),
+	COMMIT_GRAPH_WRITE_IDENTS = (1 << 9),
+	COMMIT_GRAPH_NO_WRITE_IDENTS = (1 << 10),
+	COMMIT_GRAPH_WRITE_MERGE_BLOOM_FILTERS = (1 << 11),
+	COMMIT_GRAPH_NO_WRITE_MERGE_BLOOM_FILTERS = (1 << 12),
 };
 
 enum commit_graph_split_flags {
@@ -17,6 +17,27 @@
 
 static const unsigned all_flags = (PARENT1 | PARENT2 | STALE | RESULT);
 
+/*
+ * Ask the reachability index of the commit-graph whether "commit" can
+ * reach any of "list". Returns 1 if it can, 0 if it cannot, and -1 if
+ * the index cannot tell.
+ */
+static int reaches_any(struct repository *r, struct commit *commit,
+		       const struct commit_list *list)
+{
+	int ret = 0;
+
+	for (; list; list = list->next) {
+		switch (commit_graph_reaches(r, commit, list->item)) {
+		case 1:
+			return 1;
+		case -1:
+			ret = -1;
+		}
+	}
+	return ret;
+}
+
 static int compare_commits_by_gen(const void *_a, const void *_b)
 {
 	const struct commit *a = *(const struct commit * const *)_a;
@@ -373,6 +394,32 @@ static int remove_redundant(struct repository *r, struct commit **array, int cnt
 	return remove_redundant_no_gen(r, array, cnt);
 }
 
+/*
+ * If one of "a" and "b" is in the first-parent history of the other,
+ * it is their only merge base, which the first-parent skips of the
+ * commit-graph find without a walk.
+ */
+static struct commit *first_parent_merge_base(struct repository *r,
+					      struct commit *a,
+					      struct commit *b)
+{
+	struct commit *at;
+	uint32_t depth_a, depth_b;
+
+	if (repo_parse_commit(r, a) || repo_parse_commit(r, b) ||
+	    commit_graph_first_parent_depth(r, a, &depth_a) ||
+	    commit_graph_first_parent_depth(r, b, &depth_b))
+		return NULL;
+
+	if (depth_a < depth_b)
+		SWAP(a, b);
+	if (commit_graph_first_parent_at(r, a, depth_a < depth_b ?
+					 depth_a : depth_b, &at) ||
+	    at != b)
+		return NULL;
+	return b;
+}
+
 static struct commit_list *get_merge_bases_many_0(struct repository *r,
 						  struct commit *one,
 						  int n,
@@ -384,6 +431,16 @@ static struct commit_list *get_merge_bases_many_0(struct repository *r,
 	struct commit_list *result;
 	int cnt, i;
 
+	if (n == 1) {
+		struct commit *base = first_parent_merge_base(r, one, twos[0]);
+
+		if (base) {
+			result = NULL;
+			commit_list_insert(base, &result);
+			return result;
+		}
+	}
+
 	result = merge_bases_many(r, one, n, twos);
 	for (i = 0; i < n; i++) {
 		if (one == twos[i])
@@ -475,14 +532,26 @@ int repo_in_merge_bases_many(struct repository *r, struct commit *commit,
 			     int nr_reference, struct commit **reference)
 {
 	struct commit_list *bases;
-	int ret = 0, i;
+	struct commit **unknown;
+	int ret = 0, i, nr_unknown = 0;
 	timestamp_t generation, max_generation = GENERATION_NUMBER_ZERO;
 
 	if (repo_parse_commit(r, commit))
 		return ret;
+	ALLOC_ARRAY(unknown, nr_reference);
 	for (i = 0; i < nr_reference; i++) {
 		if (repo_parse_commit(r, reference[i]))
-			return ret;
+			goto cleanup;
+
+		/* Only walk from where the reachability index cannot tell. */
+		switch (commit_graph_reaches(r, reference[i], commit)) {
+		case 1:
+			ret = 1;
+			goto cleanup;
+		case 0:
+			continue;
+		}
+		unknown[nr_unknown++] = reference[i];
 
 		generation = commit_graph_generation(reference[i]);
 		if (generation > max_generation)
@@ -490,17 +559,19 @@ int repo_in_merge_bases_many(struct repository *r, struct commit *commit,
 	}
 
 	generation = commit_graph_generation(commit);
-	if (generation > max_generation)
-		return ret;
+	if (!nr_unknown || generation > max_generation)
+		goto cleanup;
 
 	bases = paint_down_to_common(r, commit,
-				     nr_reference, reference,
+				     nr_unknown, unknown,
 				     generation);
 	if (commit->object.flags & PARENT2)
 		ret = 1;
 	clear_commit_marks(commit, all_flags);
-	clear_commit_marks_many(nr_reference, reference, all_flags);
+	clear_commit_marks_many(nr_unknown, unknown, all_flags);
 	free_commit_list(bases);
+cleanup:
+	free(unknown);
 	return ret;
 }
 
@@ -645,6 +716,15 @@ static enum contains_result contains_test(struct commit *candidate,
 	if (commit_graph_generation(candidate) < cutoff)
 		return CONTAINS_NO;
 
+	switch (reaches_any(the_repository, candidate, want)) {
+	case 1:
+		*cached = CONTAINS_YES;
+		return CONTAINS_YES;
+	case 0:
+		*cached = CONTAINS_NO;
+		return CONTAINS_NO;
+	}
+
 	return CONTAINS_UNKNOWN;
 }
 
@@ -824,8 +904,6 @@ int can_all_from_reach(struct commit_list *from, struct commit_list *to,
 	timestamp_t min_generation = GENERATION_NUMBER_INFINITY;
 
 	while (from_iter) {
-		add_object_array(&from_iter->item->object, NULL, &from_objs);
-
 		if (!parse_commit(from_iter->item)) {
 			timestamp_t generation;
 			if (from_iter->item->date < min_commit_date)
@@ -855,9 +933,23 @@ int can_all_from_reach(struct commit_list *from, struct commit_list *to,
 		to_iter = to_iter->next;
 	}
 
-	result = can_all_from_reach_with_flag(&from_objs, PARENT2, PARENT1,
+	/* Only walk from where the reachability index cannot tell. */
+	for (from_iter = from; from_iter; from_iter = from_iter->next) {
+		switch (reaches_any(the_repository, from_iter->item, to)) {
+		case 1:
+			continue;
+		case 0:
+			result = 0;
+			goto cleanup;
+		}
+		add_object_array(&from_iter->item->object, NULL, &from_objs);
+	}
+
+	result = !from_objs.nr ||
+		 can_all_from_reach_with_flag(&from_objs, PARENT2, PARENT1,
 					      min_commit_date, min_generation);
 
+cleanup:
 	while (from) {
 		clear_commit_marks(from->item, PARENT1);
 		from = from->next;
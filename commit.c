@@ -741,13 +741,19 @@ define_commit_slab(author_date_slab, timestamp_t);
 void record_author_date(struct author_date_slab *author_date,
 			struct commit *commit)
 {
-	const char *buffer = get_commit_buffer(commit, NULL);
+	const char *buffer;
 	struct ident_split ident;
 	const char *ident_line;
 	size_t ident_len;
 	char *date_end;
 	timestamp_t date;
 
+	if (!commit_graph_author_date(the_repository, commit, &date)) {
+		*(author_date_slab_at(author_date, commit)) = date;
+		return;
+	}
+
+	buffer = get_commit_buffer(commit, NULL);
 	ident_line = find_commit_header(buffer, "author", &ident_len);
 	if (!ident_line)
 		goto fail_exit; /* no author line */
@@ -0,0 +1,104 @@
+#ifndef COMPAT_CPU_FEATURES_H
+#define COMPAT_CPU_FEATURES_H
+
+/*
+ * Runtime checks for optional CPU features. Code that uses them is
+ * compiled for the extended instruction set by way of the target
+ * attribute, so that the rest of Git still runs on any CPU, and is
+ * only called after the helpers below said that the CPU we are
+ * running on has them.
+ *
+ * HAVE_X86_CPUID is defined where the x86 helpers are available, and
+ * HAVE_ARM_NEON on AArch64, whose baseline includes the NEON vector
+ * instructions.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define HAVE_X86_CPUID
+#define X86_AVX2_TARGET __attribute__((target("avx2")))
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+static inline int x86_have_sha_ni(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	/* SSSE3 and SSE4.1 are needed to shuffle the message words. */
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+	    !(ecx & (1 << 9)) || !(ecx & (1 << 19)))
+		return 0;
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return !!(ebx & (1 << 29));
+}
+
+static inline int x86_have_avx2(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	/* The OS has to save the upper halves of the registers, too. */
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+	    !(ecx & (1 << 27)) || !(ecx & (1 << 28)))
+		return 0;
+	__asm__("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+	if ((eax & 6) != 6)
+		return 0;
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return !!(ebx & (1 << 5));
+}
+
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__)
+
+#define HAVE_ARM_NEON
+
+#include <arm_neon.h>
+
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+
+static inline int arm_have_sha1(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_SHA1);
+}
+
+static inline int arm_have_sha2(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_SHA2);
+}
+#elif defined(__APPLE__) || defined(__ARM_FEATURE_CRYPTO)
+/*
+ * All 64-bit Apple CPUs have the cryptographic extension; elsewhere,
+ * trust the compiler flags to match the target.
+ */
+static inline int arm_have_sha1(void)
+{
+	return 1;
+}
+
+static inline int arm_have_sha2(void)
+{
+	return 1;
+}
+#else
+static inline int arm_have_sha1(void)
+{
+	return 0;
+}
+
+static inline int arm_have_sha2(void)
+{
+	return 0;
+}
+#endif
+
+#endif
+
+#endif /* COMPAT_CPU_FEATURES_H */
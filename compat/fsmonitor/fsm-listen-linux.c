@@ -0,0 +1,599 @@
+#include "cache.h"
+#include "dir.h"
+#include "hashmap.h"
+#include "fsmonitor.h"
+#include "fsm-listen.h"
+#include "fsmonitor--daemon.h"
+#include <sys/inotify.h>
+#include <poll.h>
+
+/*
+ * inotify(7) only watches individual directories, so we have to
+ * create (and maintain) a watch for every directory in the worktree
+ * ourselves.  Each watch descriptor ("wd") maps back to the absolute
+ * path of the directory it was created for, so that we can turn the
+ * (wd, name) pairs in the event stream into pathnames.
+ *
+ * Within the ".git" directory (or the external <gitdir>) we only
+ * watch the cookie directory, since nothing else in there is of any
+ * interest to clients.
+ */
+
+#define FSM_INOTIFY_MASK (IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MODIFY | \
+			  IN_MOVED_FROM | IN_MOVED_TO | \
+			  IN_DELETE_SELF | IN_MOVE_SELF)
+
+#define FSM_INOTIFY_FLAGS (IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+
+struct watch_entry {
+	struct hashmap_entry ent;
+	int wd;
+	char *dir;
+};
+
+struct fsm_listen_data
+{
+	int fd_inotify;
+	int fd_stop[2];
+
+	struct hashmap watches;
+
+	int wd_worktree;
+	int wd_gitdir;
+
+	enum shutdown_style {
+		SHUTDOWN_EVENT = 0,
+		FORCE_SHUTDOWN,
+		FORCE_ERROR_STOP,
+	} shutdown_style;
+};
+
+static int watch_entry_cmp(const void *cmp_data,
+			   const struct hashmap_entry *eptr,
+			   const struct hashmap_entry *entry_or_key,
+			   const void *keydata)
+{
+	const struct watch_entry *a, *b;
+
+	a = container_of(eptr, const struct watch_entry, ent);
+	b = container_of(entry_or_key, const struct watch_entry, ent);
+
+	return a->wd != b->wd;
+}
+
+static struct watch_entry *find_watch(struct fsm_listen_data *data, int wd)
+{
+	struct watch_entry key;
+
+	hashmap_entry_init(&key.ent, memhash(&wd, sizeof(wd)));
+	key.wd = wd;
+
+	return hashmap_get_entry(&data->watches, &key, ent, NULL);
+}
+
+static void free_watch(struct watch_entry *w)
+{
+	if (!w)
+		return;
+	free(w->dir);
+	free(w);
+}
+
+/*
+ * Create a (non-recursive) watch on the given directory.
+ *
+ * Returns the watch descriptor, 0 if the directory vanished before we
+ * got around to watching it, or -1 on error.
+ */
+static int add_watch(struct fsm_listen_data *data, const char *path)
+{
+	struct watch_entry *w;
+	int wd;
+
+	wd = inotify_add_watch(data->fd_inotify, path,
+			       FSM_INOTIFY_MASK | FSM_INOTIFY_FLAGS);
+	if (wd < 0) {
+		if (errno == ENOENT || errno == ENOTDIR)
+			return 0;
+		if (errno == ENOSPC)
+			return error(_("inotify watch limit reached for '%s'; "
+				       "consider raising fs.inotify.max_user_watches"),
+				     path);
+		return error_errno(_("inotify_add_watch('%s') failed"), path);
+	}
+
+	/*
+	 * Watching the same inode twice hands back the existing
+	 * descriptor; just make sure it refers to the current name.
+	 */
+	w = find_watch(data, wd);
+	if (w) {
+		free(w->dir);
+		w->dir = xstrdup(path);
+		return wd;
+	}
+
+	CALLOC_ARRAY(w, 1);
+	hashmap_entry_init(&w->ent, memhash(&wd, sizeof(wd)));
+	w->wd = wd;
+	w->dir = xstrdup(path);
+	hashmap_add(&data->watches, &w->ent);
+
+	return wd;
+}
+
+/*
+ * Remove the watches on the given directory and all of the
+ * directories below it, e.g. after it was renamed away.
+ */
+static void remove_watches_recursive(struct fsm_listen_data *data,
+				     const char *path)
+{
+	struct hashmap_iter iter;
+	struct watch_entry *w;
+	struct watch_entry **doomed = NULL;
+	size_t doomed_nr = 0, doomed_alloc = 0, k;
+	size_t len = strlen(path);
+
+	hashmap_for_each_entry(&data->watches, &iter, w, ent) {
+		if (strncmp(w->dir, path, len) ||
+		    (w->dir[len] && w->dir[len] != '/'))
+			continue;
+		ALLOC_GROW(doomed, doomed_nr + 1, doomed_alloc);
+		doomed[doomed_nr++] = w;
+	}
+
+	for (k = 0; k < doomed_nr; k++) {
+		w = doomed[k];
+		trace_printf_key(&trace_fsmonitor, "unwatch: '%s'", w->dir);
+		/* This fails harmlessly if the kernel already dropped it. */
+		inotify_rm_watch(data->fd_inotify, w->wd);
+		hashmap_remove(&data->watches, &w->ent, NULL);
+		free_watch(w);
+	}
+	free(doomed);
+}
+
+static int is_directory_entry(struct dirent *de, const char *path)
+{
+	struct stat st;
+
+	if (DTYPE(de) != DT_UNKNOWN)
+		return DTYPE(de) == DT_DIR;
+	return !lstat(path, &st) && S_ISDIR(st.st_mode);
+}
+
+/*
+ * Watch the given directory inside the worktree and (recursively)
+ * every directory below it, skipping over ".git".
+ */
+static int add_watches_recursive(struct fsmonitor_daemon_state *state,
+				 struct strbuf *path)
+{
+	struct fsm_listen_data *data = state->listen_data;
+	struct dirent *de;
+	DIR *dir;
+	size_t len;
+	int ret = 0;
+
+	ret = add_watch(data, path->buf);
+	if (ret <= 0)
+		return ret;
+	ret = 0;
+
+	dir = opendir(path->buf);
+	if (!dir) {
+		if (errno == ENOENT || errno == ENOTDIR)
+			return 0;
+		return error_errno(_("opendir('%s') failed"), path->buf);
+	}
+
+	len = path->len;
+	while ((de = readdir_skip_dot_and_dotdot(dir))) {
+		strbuf_setlen(path, len);
+		strbuf_addch(path, '/');
+		strbuf_addstr(path, de->d_name);
+
+		if (!is_directory_entry(de, path->buf))
+			continue;
+		if (fsmonitor_classify_path_absolute(state, path->buf) !=
+		    IS_WORKDIR_PATH)
+			continue;
+
+		if (add_watches_recursive(state, path) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	strbuf_setlen(path, len);
+
+	closedir(dir);
+	return ret;
+}
+
+/*
+ * Create the full set of watches: the worktree and everything below
+ * it, plus the cookie directory (and the external <gitdir> itself so
+ * that we notice when it goes away).
+ */
+static int add_all_watches(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data = state->listen_data;
+	struct strbuf path = STRBUF_INIT;
+	int ret = -1;
+
+	strbuf_addbuf(&path, &state->path_worktree_watch);
+	if (add_watches_recursive(state, &path) < 0)
+		goto done;
+	/* This just looks up the watch that we created above. */
+	data->wd_worktree = add_watch(data, state->path_worktree_watch.buf);
+	if (data->wd_worktree <= 0)
+		goto done;
+
+	if (state->nr_paths_watching > 1) {
+		data->wd_gitdir = add_watch(data, state->path_gitdir_watch.buf);
+		if (data->wd_gitdir <= 0)
+			goto done;
+	}
+
+	/* The cookie prefix has a trailing slash. */
+	strbuf_reset(&path);
+	strbuf_add(&path, state->path_cookie_prefix.buf,
+		   state->path_cookie_prefix.len - 1);
+	if (add_watch(data, path.buf) <= 0)
+		goto done;
+
+	trace_printf_key(&trace_fsmonitor, "inotify: watching %u directories",
+			 hashmap_get_size(&data->watches));
+	ret = 0;
+
+done:
+	strbuf_release(&path);
+	return ret;
+}
+
+static void log_mask_set(const char *path, uint32_t mask)
+{
+	struct strbuf msg = STRBUF_INIT;
+
+	if (mask & IN_ACCESS)
+		strbuf_addstr(&msg, "IN_ACCESS|");
+	if (mask & IN_MODIFY)
+		strbuf_addstr(&msg, "IN_MODIFY|");
+	if (mask & IN_ATTRIB)
+		strbuf_addstr(&msg, "IN_ATTRIB|");
+	if (mask & IN_CLOSE_WRITE)
+		strbuf_addstr(&msg, "IN_CLOSE_WRITE|");
+	if (mask & IN_CLOSE_NOWRITE)
+		strbuf_addstr(&msg, "IN_CLOSE_NOWRITE|");
+	if (mask & IN_OPEN)
+		strbuf_addstr(&msg, "IN_OPEN|");
+	if (mask & IN_MOVED_FROM)
+		strbuf_addstr(&msg, "IN_MOVED_FROM|");
+	if (mask & IN_MOVED_TO)
+		strbuf_addstr(&msg, "IN_MOVED_TO|");
+	if (mask & IN_CREATE)
+		strbuf_addstr(&msg, "IN_CREATE|");
+	if (mask & IN_DELETE)
+		strbuf_addstr(&msg, "IN_DELETE|");
+	if (mask & IN_DELETE_SELF)
+		strbuf_addstr(&msg, "IN_DELETE_SELF|");
+	if (mask & IN_MOVE_SELF)
+		strbuf_addstr(&msg, "IN_MOVE_SELF|");
+	if (mask & IN_UNMOUNT)
+		strbuf_addstr(&msg, "IN_UNMOUNT|");
+	if (mask & IN_Q_OVERFLOW)
+		strbuf_addstr(&msg, "IN_Q_OVERFLOW|");
+	if (mask & IN_IGNORED)
+		strbuf_addstr(&msg, "IN_IGNORED|");
+	if (mask & IN_ISDIR)
+		strbuf_addstr(&msg, "IN_ISDIR|");
+
+	trace_printf_key(&trace_fsmonitor, "inotify_event: '%s', mask=0x%x %s",
+			 path, mask, msg.buf);
+
+	strbuf_release(&msg);
+}
+
+/*
+ * Drain the inotify queue and publish the changes found in each
+ * chunk that we read from it.
+ *
+ * Returns 0 when the queue is empty, otherwise the shutdown style.
+ */
+static enum shutdown_style process_events(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data = state->listen_data;
+	union {
+		struct inotify_event ev;
+		char buf[64 * 1024];
+	} u;
+	struct strbuf path = STRBUF_INIT;
+	struct strbuf tmp = STRBUF_INIT;
+	struct fsmonitor_batch *batch = NULL;
+	struct string_list cookie_list = STRING_LIST_INIT_DUP;
+	enum shutdown_style result = SHUTDOWN_EVENT;
+
+	for (;;) {
+		ssize_t len = read(data->fd_inotify, u.buf, sizeof(u.buf));
+		char *p;
+
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			error_errno(_("reading inotify events failed"));
+			result = FORCE_ERROR_STOP;
+			goto done;
+		}
+		if (!len)
+			break;
+
+		for (p = u.buf; p < u.buf + len;
+		     p += sizeof(struct inotify_event) +
+			  ((struct inotify_event *)p)->len) {
+			const struct inotify_event *ev = (void *)p;
+			struct watch_entry *w;
+			const char *rel;
+
+			if (ev->mask & IN_Q_OVERFLOW) {
+				/*
+				 * We lost events, maybe including the
+				 * creation of new directories.  Flush
+				 * our state and rescan so that we watch
+				 * all directories again.
+				 */
+				trace_printf_key(&trace_fsmonitor,
+						 "inotify: queue overflow");
+				fsmonitor_force_resync(state);
+				fsmonitor_batch__free_list(batch);
+				string_list_clear(&cookie_list, 0);
+				batch = NULL;
+				if (add_all_watches(state)) {
+					result = FORCE_ERROR_STOP;
+					goto done;
+				}
+				continue;
+			}
+
+			w = find_watch(data, ev->wd);
+			if (!w)
+				continue;
+
+			strbuf_reset(&path);
+			strbuf_addstr(&path, w->dir);
+			if (ev->len) {
+				strbuf_addch(&path, '/');
+				strbuf_addstr(&path, ev->name);
+			}
+
+			if (trace_pass_fl(&trace_fsmonitor))
+				log_mask_set(path.buf, ev->mask);
+
+			if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF |
+					IN_UNMOUNT | IN_IGNORED)) {
+				if (ev->wd == data->wd_worktree) {
+					trace_printf_key(&trace_fsmonitor,
+							 "event: worktree root removed");
+					result = FORCE_SHUTDOWN;
+					goto done;
+				}
+				if (ev->wd == data->wd_gitdir) {
+					trace_printf_key(&trace_fsmonitor,
+							 "event: gitdir removed");
+					result = FORCE_SHUTDOWN;
+					goto done;
+				}
+				if (ev->mask & IN_IGNORED) {
+					hashmap_remove(&data->watches, &w->ent, NULL);
+					free_watch(w);
+				}
+				/*
+				 * Anything else is reported by the parent
+				 * directory's watch.
+				 */
+				continue;
+			}
+
+			switch (fsmonitor_classify_path_absolute(state, path.buf)) {
+
+			case IS_INSIDE_DOT_GIT_WITH_COOKIE_PREFIX:
+			case IS_INSIDE_GITDIR_WITH_COOKIE_PREFIX:
+				/* special case cookie files within .git or gitdir */
+
+				/* Use just the filename of the cookie file. */
+				string_list_append(&cookie_list, ev->name);
+				break;
+
+			case IS_INSIDE_DOT_GIT:
+			case IS_INSIDE_GITDIR:
+				/* ignore all other paths inside of .git or gitdir */
+				break;
+
+			case IS_DOT_GIT:
+			case IS_GITDIR:
+				/*
+				 * If .git directory is deleted or renamed away,
+				 * we have to quit.
+				 */
+				if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+					trace_printf_key(&trace_fsmonitor,
+							 "event: gitdir removed");
+					result = FORCE_SHUTDOWN;
+					goto done;
+				}
+				break;
+
+			case IS_WORKDIR_PATH:
+				/* queue normal pathnames */
+				rel = path.buf + state->path_worktree_watch.len + 1;
+
+				if (!batch)
+					batch = fsmonitor_batch__new();
+
+				if (!(ev->mask & IN_ISDIR)) {
+					fsmonitor_batch__add_path(batch, rel);
+					break;
+				}
+
+				/*
+				 * Keep our watches in sync with the directory
+				 * tree.  A new directory may already contain
+				 * files that we never saw events for, so the
+				 * client must invalidate everything below it;
+				 * the trailing slash tells it to do so.
+				 */
+				if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+					remove_watches_recursive(data, path.buf);
+				if (ev->mask & (IN_CREATE | IN_MOVED_TO) &&
+				    add_watches_recursive(state, &path) < 0) {
+					result = FORCE_ERROR_STOP;
+					goto done;
+				}
+
+				strbuf_reset(&tmp);
+				strbuf_addstr(&tmp, rel);
+				strbuf_addch(&tmp, '/');
+				fsmonitor_batch__add_path(batch, tmp.buf);
+				break;
+
+			case IS_OUTSIDE_CONE:
+			default:
+				trace_printf_key(&trace_fsmonitor,
+						 "ignoring '%s'", path.buf);
+				break;
+			}
+		}
+
+		fsmonitor_publish(state, batch, &cookie_list);
+		string_list_clear(&cookie_list, 0);
+		batch = NULL;
+	}
+
+done:
+	fsmonitor_batch__free_list(batch);
+	string_list_clear(&cookie_list, 0);
+	strbuf_release(&path);
+	strbuf_release(&tmp);
+	return result;
+}
+
+int fsm_listen__ctor(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data;
+
+	CALLOC_ARRAY(data, 1);
+	state->listen_data = data;
+	data->fd_stop[0] = data->fd_stop[1] = -1;
+	hashmap_init(&data->watches, watch_entry_cmp, NULL, 0);
+
+	data->fd_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (data->fd_inotify < 0) {
+		error_errno(_("inotify_init1() failed"));
+		goto failed;
+	}
+
+	if (pipe(data->fd_stop) < 0) {
+		error_errno(_("could not create pipe"));
+		goto failed;
+	}
+
+	if (add_all_watches(state))
+		goto failed;
+
+	return 0;
+
+failed:
+	error(_("Unable to create inotify watches."));
+	fsm_listen__dtor(state);
+	return -1;
+}
+
+void fsm_listen__dtor(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data;
+	struct hashmap_iter iter;
+	struct watch_entry *w;
+
+	if (!state || !state->listen_data)
+		return;
+
+	data = state->listen_data;
+
+	hashmap_for_each_entry(&data->watches, &iter, w, ent)
+		free(w->dir);
+	hashmap_clear_and_free(&data->watches, struct watch_entry, ent);
+
+	if (data->fd_inotify >= 0)
+		close(data->fd_inotify);
+	if (data->fd_stop[0] >= 0)
+		close(data->fd_stop[0]);
+	if (data->fd_stop[1] >= 0)
+		close(data->fd_stop[1]);
+
+	FREE_AND_NULL(state->listen_data);
+}
+
+void fsm_listen__stop_async(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data;
+
+	data = state->listen_data;
+	data->shutdown_style = SHUTDOWN_EVENT;
+
+	if (write(data->fd_stop[1], "q", 1) < 0)
+		error_errno(_("could not stop the inotify listener"));
+}
+
+void fsm_listen__loop(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data;
+	struct pollfd pfd[2];
+
+	data = state->listen_data;
+
+	for (;;) {
+		pfd[0].fd = data->fd_inotify;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = data->fd_stop[0];
+		pfd[1].events = POLLIN;
+
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			error_errno(_("poll() on inotify fd failed"));
+			data->shutdown_style = FORCE_ERROR_STOP;
+			break;
+		}
+
+		if (pfd[1].revents)
+			break;
+
+		if (pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			error(_("inotify fd is no longer usable"));
+			data->shutdown_style = FORCE_ERROR_STOP;
+			break;
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			enum shutdown_style style = process_events(state);
+			if (style != SHUTDOWN_EVENT) {
+				data->shutdown_style = style;
+				break;
+			}
+		}
+	}
+
+	switch (data->shutdown_style) {
+	case FORCE_ERROR_STOP:
+		state->listen_error_code = -1;
+		/* fall thru */
+	case FORCE_SHUTDOWN:
+		ipc_server_stop_async(state->ipc_server_data);
+		/* fall thru */
+	case SHUTDOWN_EVENT:
+	default:
+		break;
+	}
+}
@@ -0,0 +1,100 @@
+#include "fsmonitor.h"
+#include "fsmonitor-path-utils.h"
+#include <errno.h>
+#include <sys/vfs.h>
+
+/*
+ * statfs(2) on Linux only reports the magic number of the filesystem
+ * type, so map the ones that we care about to the names used by the
+ * other platforms.  Remote filesystems do not deliver inotify events
+ * for changes made by other clients, so they must be reported as such.
+ */
+static const struct fs_type {
+	unsigned long magic;
+	const char *name;
+	int is_remote;
+} fs_types[] = {
+	{ 0xEF53, "ext4", 0 },
+	{ 0x9123683E, "btrfs", 0 },
+	{ 0x58465342, "xfs", 0 },
+	{ 0x01021994, "tmpfs", 0 },
+	{ 0x794C7630, "overlayfs", 0 },
+	{ 0x2FC12FC1, "zfs", 0 },
+	{ 0xF2F52010, "f2fs", 0 },
+	{ 0x4d44, "msdos", 0 },
+	{ 0x2011BAB0, "exfat", 0 },
+	{ 0x5346544e, "ntfs", 0 },
+	{ 0x6969, "nfs", 1 },
+	{ 0x517B, "smb", 1 },
+	{ 0xFE534D42, "smb2", 1 },
+	{ 0xFF534D42, "cifs", 1 },
+	{ 0x73757245, "coda", 1 },
+	{ 0x5346414F, "afs", 1 },
+	{ 0x6B414653, "afs", 1 },
+	{ 0x01021997, "9p", 1 },
+	{ 0x00C36400, "ceph", 1 },
+	{ 0x47504653, "gpfs", 1 },
+	{ 0x0BD00BD0, "lustre", 1 },
+};
+
+int fsmonitor__get_fs_info(const char *path, struct fs_info *fs_info)
+{
+	struct statfs fs;
+	size_t k;
+
+	if (statfs(path, &fs) == -1) {
+		int saved_errno = errno;
+		trace_printf_key(&trace_fsmonitor, "statfs('%s') failed: %s",
+				 path, strerror(saved_errno));
+		errno = saved_errno;
+		return -1;
+	}
+
+	fs_info->is_remote = 0;
+	fs_info->typename = NULL;
+	for (k = 0; k < ARRAY_SIZE(fs_types); k++) {
+		if ((unsigned long)fs.f_type == fs_types[k].magic) {
+			fs_info->is_remote = fs_types[k].is_remote;
+			fs_info->typename = xstrdup(fs_types[k].name);
+			break;
+		}
+	}
+	if (!fs_info->typename)
+		fs_info->typename = xstrfmt("0x%08lx", (unsigned long)fs.f_type);
+
+	trace_printf_key(&trace_fsmonitor,
+			 "statfs('%s') [type 0x%08lx] '%s'",
+			 path, (unsigned long)fs.f_type, fs_info->typename);
+
+	trace_printf_key(&trace_fsmonitor,
+			 "'%s' is_remote: %d",
+			 path, fs_info->is_remote);
+	return 0;
+}
+
+int fsmonitor__is_fs_remote(const char *path)
+{
+	struct fs_info fs;
+	if (fsmonitor__get_fs_info(path, &fs))
+		return -1;
+
+	free(fs.typename);
+
+	return fs.is_remote;
+}
+
+/*
+ * No-op for now.  Linux has no equivalent of the synthetic firmlinks
+ * that macOS uses, and inotify reports paths relative to the watched
+ * directories, which we already know by their real name.
+ */
+int fsmonitor__get_alias(const char *path, struct alias_info *info)
+{
+	return 0;
+}
+
+char *fsmonitor__resolve_alias(const char *path,
+	const struct alias_info *info)
+{
+	return NULL;
+}
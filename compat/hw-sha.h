@@ -0,0 +1,29 @@
+#ifndef COMPAT_HW_SHA_H
+#define COMPAT_HW_SHA_H
+
+/*
+ * Support for the SHA instructions of x86 (SHA-NI) and of ARMv8 (the
+ * cryptographic extension), and for the AVX2 vector instructions of
+ * x86, which sha1dc can use.  See compat/cpu-features.h for how they
+ * are detected at runtime.
+ *
+ * Define NO_HW_SHA if your compiler cannot build these.
+ */
+
+#include "cpu-features.h"
+
+#if !defined(NO_HW_SHA) && defined(HAVE_X86_CPUID)
+#define HAVE_X86_SHA_NI
+#define X86_SHA_NI_TARGET __attribute__((target("sha,sse4.1")))
+#endif
+
+#if !defined(NO_HW_SHA) && defined(HAVE_ARM_NEON)
+#define HAVE_ARM_SHA
+#ifdef __clang__
+#define ARM_SHA_TARGET __attribute__((target("crypto")))
+#else
+#define ARM_SHA_TARGET __attribute__((target("+crypto")))
+#endif
+#endif
+
+#endif /* COMPAT_HW_SHA_H */
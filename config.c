@@ -23,6 +23,7 @@
 #include "color.h"
 #include "refs.h"
 #include "worktree.h"
+#include "thread-utils.h"
 
 struct config_source {
 	struct config_source *prev;
@@ -1614,6 +1615,16 @@ static int git_default_core_config(const char *var, const char *value, void *cb)
 		return 0;
 	}
 
+	if (!strcmp(var, "core.deltainflatethreads")) {
+		delta_inflate_threads = git_config_int(var, value);
+		if (delta_inflate_threads < 0)
+			return error(_("invalid number of threads specified (%d) for %s"),
+				     delta_inflate_threads, var);
+		if (!delta_inflate_threads)
+			delta_inflate_threads = online_cpus();
+		return 0;
+	}
+
 	if (!strcmp(var, "core.autocrlf")) {
 		if (value && !strcasecmp(value, "input")) {
 			auto_crlf = AUTO_CRLF_INPUT;
@@ -19,6 +19,11 @@
 #include "delta-islands.h"
 #include "oid-array.h"
 #include "config.h"
+#include "hashmap.h"
+#include "packfile.h"
+#include "object-store.h"
+#include "csum-file.h"
+#include "chunk-format.h"
 
 KHASH_INIT(str, const char *, void *, 1, kh_str_hash_func, kh_str_hash_equal)
 
@@ -33,12 +38,31 @@ struct remote_island {
 	struct oid_array oids;
 };
 
+/*
+ * Bitmaps are shared between all objects which belong to the same set of
+ * islands; once a bitmap is in island_bitmap_pool (see
+ * island_bitmap_intern()), it is never modified in place.
+ */
 struct island_bitmap {
+	struct hashmap_entry ent;
 	uint32_t refcount;
+	unsigned interned : 1;
+	uint32_t pos;
 	uint32_t bits[FLEX_ARRAY];
 };
 
 static uint32_t island_bitmap_size;
+static struct hashmap island_bitmap_pool;
+
+/* The tip hash of each island, indexed by its bit in the bitmaps. */
+static uint64_t *island_ids;
+
+/*
+ * The islands whose marks have to be computed by walking the objects
+ * being packed, or NULL if all of them do. Marks of the other islands
+ * were loaded from an .islands file.
+ */
+static struct island_bitmap *island_dirty;
 
 /*
  * Allocate a new bitmap; if "old" is not NULL, the new bitmap will be a copy
@@ -53,6 +77,55 @@ static struct island_bitmap *island_bitmap_new(const struct island_bitmap *old)
 		memcpy(b, old, size);
 
 	b->refcount = 1;
+	b->interned = 0;
+	b->pos = 0;
+	return b;
+}
+
+static void island_bitmap_unref(struct island_bitmap *b)
+{
+	if (--b->refcount)
+		return;
+	if (b->interned)
+		hashmap_remove(&island_bitmap_pool, &b->ent, NULL);
+	free(b);
+}
+
+static int island_bitmap_cmp(const void *cmp_data UNUSED,
+			     const struct hashmap_entry *eptr,
+			     const struct hashmap_entry *entry_or_key,
+			     const void *keydata UNUSED)
+{
+	const struct island_bitmap *a, *b;
+
+	a = container_of(eptr, const struct island_bitmap, ent);
+	b = container_of(entry_or_key, const struct island_bitmap, ent);
+
+	return memcmp(a->bits, b->bits, island_bitmap_size * 4);
+}
+
+/*
+ * Return the shared bitmap with the same bits as "b", taking over the
+ * caller's reference to "b"; if there is none yet, "b" itself becomes
+ * the shared one.
+ */
+static struct island_bitmap *island_bitmap_intern(struct island_bitmap *b)
+{
+	struct island_bitmap *shared;
+
+	if (b->interned)
+		return b;
+
+	hashmap_entry_init(&b->ent, memhash(b->bits, island_bitmap_size * 4));
+	shared = hashmap_get_entry(&island_bitmap_pool, b, ent, NULL);
+	if (shared) {
+		shared->refcount++;
+		island_bitmap_unref(b);
+		return shared;
+	}
+
+	b->interned = 1;
+	hashmap_add(&island_bitmap_pool, &b->ent);
 	return b;
 }
 
@@ -64,6 +137,29 @@ static void island_bitmap_or(struct island_bitmap *a, const struct island_bitmap
 		a->bits[i] |= b->bits[i];
 }
 
+static int island_bitmap_intersects(const struct island_bitmap *a,
+				    const struct island_bitmap *b)
+{
+	uint32_t i;
+
+	for (i = 0; i < island_bitmap_size; ++i)
+		if (a->bits[i] & b->bits[i])
+			return 1;
+
+	return 0;
+}
+
+static int island_bitmap_is_empty(const struct island_bitmap *self)
+{
+	uint32_t i;
+
+	for (i = 0; i < island_bitmap_size; ++i)
+		if (self->bits[i])
+			return 0;
+
+	return 1;
+}
+
 static int island_bitmap_is_subset(struct island_bitmap *self,
 		struct island_bitmap *super)
 {
@@ -88,6 +184,11 @@ static void island_bitmap_set(struct island_bitmap *self, uint32_t i)
 	self->bits[ISLAND_BITMAP_BLOCK(i)] |= ISLAND_BITMAP_MASK(i);
 }
 
+static void island_bitmap_unset(struct island_bitmap *self, uint32_t i)
+{
+	self->bits[ISLAND_BITMAP_BLOCK(i)] &= ~ISLAND_BITMAP_MASK(i);
+}
+
 static int island_bitmap_get(struct island_bitmap *self, uint32_t i)
 {
 	return (self->bits[ISLAND_BITMAP_BLOCK(i)] & ISLAND_BITMAP_MASK(i)) != 0;
@@ -161,16 +262,17 @@ static struct island_bitmap *create_or_get_island_marks(struct object *obj)
 	return kh_value(island_marks, pos);
 }
 
-static void set_island_marks(struct object *obj, struct island_bitmap *marks)
+static void set_island_marks(const struct object_id *oid,
+			     struct island_bitmap *marks)
 {
-	struct island_bitmap *b;
+	struct island_bitmap *b, *merged;
 	khiter_t pos;
 	int hash_ret;
 
-	pos = kh_put_oid_map(island_marks, obj->oid, &hash_ret);
+	pos = kh_put_oid_map(island_marks, *oid, &hash_ret);
 	if (hash_ret) {
 		/*
-		 * We don't have one yet; make a copy-on-write of the
+		 * We don't have one yet; share the bitmap of the
 		 * parent.
 		 */
 		marks->refcount++;
@@ -178,16 +280,19 @@ static void set_island_marks(struct object *obj, struct island_bitmap *marks)
 		return;
 	}
 
+	b = kh_value(island_marks, pos);
+	if (island_bitmap_is_subset(marks, b))
+		return;
+
 	/*
-	 * We do have it. Make sure we split any copy-on-write before
-	 * updating.
+	 * We do have it, but need more islands. Shared bitmaps are not
+	 * modified, so build the union and look for an existing bitmap
+	 * with the same bits.
 	 */
-	b = kh_value(island_marks, pos);
-	if (b->refcount > 1) {
-		b->refcount--;
-		b = kh_value(island_marks, pos) = island_bitmap_new(b);
-	}
-	island_bitmap_or(b, marks);
+	merged = island_bitmap_new(b);
+	island_bitmap_or(merged, marks);
+	kh_value(island_marks, pos) = island_bitmap_intern(merged);
+	island_bitmap_unref(b);
 }
 
 static void mark_remote_island_1(struct repository *r,
@@ -223,7 +328,7 @@ static void mark_remote_island_1(struct repository *r,
 	if (is_core_island)
 		island_counter_core = island_counter;
 
-	island_counter++;
+	island_ids[island_counter++] = rl->hash;
 }
 
 struct tree_islands_todo {
@@ -284,6 +389,9 @@ void resolve_tree_islands(struct repository *r,
 			continue;
 
 		root_marks = kh_value(island_marks, pos);
+		if (island_dirty &&
+		    !island_bitmap_intersects(root_marks, island_dirty))
+			continue;
 
 		tree = lookup_tree(r, &ent->idx.oid);
 		if (!tree || parse_tree(tree) < 0)
@@ -300,7 +408,7 @@ void resolve_tree_islands(struct repository *r,
 			if (!obj)
 				continue;
 
-			set_island_marks(obj, root_marks);
+			set_island_marks(&obj->oid, root_marks);
 		}
 
 		free_tree_buffer(tree);
@@ -445,6 +553,7 @@ static void deduplicate_islands(struct repository *r)
 	}
 
 	island_bitmap_size = (island_count / 32) + 1;
+	ALLOC_ARRAY(island_ids, island_count);
 	core = get_core_island();
 
 	for (i = 0; i < island_count; ++i) {
@@ -454,19 +563,323 @@ static void deduplicate_islands(struct repository *r)
 	free(list);
 }
 
+/*
+ * Before any marks are propagated, every object has a bitmap of its own;
+ * move them all into the pool.
+ */
+static void intern_island_marks(void)
+{
+	khiter_t pos;
+
+	for (pos = kh_begin(island_marks); pos != kh_end(island_marks); pos++) {
+		if (!kh_exist(island_marks, pos))
+			continue;
+		kh_value(island_marks, pos) =
+			island_bitmap_intern(kh_value(island_marks, pos));
+	}
+}
+
+#define ISLAND_MARKS_SIGNATURE 0x49534c44 /* "ISLD" */
+#define ISLAND_MARKS_VERSION 1
+#define ISLAND_MARKS_HEADER_SIZE 20
+#define ISLAND_MARKS_NONE 0xffffffff
+
+struct island_id_entry {
+	uint64_t id;
+	uint32_t bit;
+};
+
+static int island_id_cmp(const void *va, const void *vb)
+{
+	const struct island_id_entry *a = va, *b = vb;
+
+	if (a->id < b->id)
+		return -1;
+	return a->id > b->id;
+}
+
+/*
+ * Find the local pack with the most recent .islands file, which is the
+ * one written by the last repack.
+ */
+static struct packed_git *find_island_marks_pack(struct repository *r,
+						 struct strbuf *path)
+{
+	struct packed_git *p, *found = NULL;
+	struct strbuf buf = STRBUF_INIT;
+	struct stat st;
+	time_t mtime = 0;
+
+	for (p = get_all_packs(r); p; p = p->next) {
+		size_t len;
+
+		if (!p->pack_local || !strip_suffix(p->pack_name, ".pack", &len))
+			continue;
+
+		strbuf_reset(&buf);
+		strbuf_add(&buf, p->pack_name, len);
+		strbuf_addstr(&buf, ".islands");
+		if (stat(buf.buf, &st) || (found && st.st_mtime <= mtime))
+			continue;
+
+		found = p;
+		mtime = st.st_mtime;
+		strbuf_reset(path);
+		strbuf_addbuf(path, &buf);
+	}
+
+	strbuf_release(&buf);
+	return found;
+}
+
+/*
+ * Load the marks of the islands whose tips have not changed since the
+ * .islands file was written. Those islands reach the same objects as
+ * then, so we do not need to walk them again; all the others are marked
+ * as dirty.
+ */
+static void load_island_marks_file(struct repository *r, int progress)
+{
+	struct strbuf path = STRBUF_INIT;
+	struct packed_git *p;
+	struct progress *progress_state = NULL;
+	struct island_id_entry *ids = NULL;
+	struct island_bitmap **sets = NULL;
+	const unsigned char *data = NULL;
+	const unsigned char *marks;
+	uint32_t nr_islands, nr_sets, words, i, j, stable = 0;
+	size_t size = 0, expected_size;
+	struct stat st;
+	int fd;
+
+	p = find_island_marks_pack(r, &path);
+	if (!p || open_pack_index(p))
+		goto cleanup;
+
+	fd = git_open(path.buf);
+	if (fd < 0)
+		goto cleanup;
+	if (fstat(fd, &st)) {
+		error_errno(_("failed to read %s"), path.buf);
+		close(fd);
+		goto cleanup;
+	}
+	size = xsize_t(st.st_size);
+	if (size < ISLAND_MARKS_HEADER_SIZE) {
+		error(_("island marks file %s is too small"), path.buf);
+		close(fd);
+		goto cleanup;
+	}
+	data = xmmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (get_be32(data) != ISLAND_MARKS_SIGNATURE) {
+		error(_("island marks file %s has unknown signature"), path.buf);
+		goto cleanup;
+	}
+	if (get_be32(data + 4) != ISLAND_MARKS_VERSION) {
+		error(_("island marks file %s has unsupported version %"PRIu32),
+		      path.buf, get_be32(data + 4));
+		goto cleanup;
+	}
+	if (get_be32(data + 8) != oid_version(the_hash_algo)) {
+		error(_("island marks file %s has unsupported hash id %"PRIu32),
+		      path.buf, get_be32(data + 8));
+		goto cleanup;
+	}
+
+	nr_islands = get_be32(data + 12);
+	nr_sets = get_be32(data + 16);
+	words = (nr_islands / 32) + 1;
+
+	expected_size = ISLAND_MARKS_HEADER_SIZE;
+	expected_size = st_add(expected_size, st_mult(8, nr_islands));
+	expected_size = st_add(expected_size,
+			       st_mult(st_mult(4, words), nr_sets));
+	expected_size = st_add(expected_size, st_mult(4, p->num_objects));
+	expected_size = st_add(expected_size, 2 * the_hash_algo->rawsz);
+	if (size != expected_size) {
+		error(_("island marks file %s is corrupt"), path.buf);
+		goto cleanup;
+	}
+	if (!hasheq(data + size - 2 * the_hash_algo->rawsz, p->hash)) {
+		error(_("island marks file %s does not match its pack"), path.buf);
+		goto cleanup;
+	}
+
+	/* Map the islands of the file to ours by their tips. */
+	ALLOC_ARRAY(ids, island_counter);
+	for (i = 0; i < island_counter; i++) {
+		ids[i].id = island_ids[i];
+		ids[i].bit = i;
+	}
+	QSORT(ids, island_counter, island_id_cmp);
+
+	island_dirty = island_bitmap_new(NULL);
+	for (i = 0; i < island_counter; i++)
+		island_bitmap_set(island_dirty, i);
+
+	ALLOC_ARRAY(sets, nr_sets);
+	for (i = 0; i < nr_sets; i++)
+		sets[i] = island_bitmap_new(NULL);
+
+	for (j = 0; j < nr_islands; j++) {
+		struct island_id_entry key, *found;
+		const unsigned char *word;
+
+		key.id = get_be64(data + ISLAND_MARKS_HEADER_SIZE + 8 * j);
+		found = bsearch(&key, ids, island_counter, sizeof(*ids),
+				island_id_cmp);
+		if (!found || !island_bitmap_get(island_dirty, found->bit))
+			continue;
+
+		island_bitmap_unset(island_dirty, found->bit);
+		stable++;
+
+		word = data + ISLAND_MARKS_HEADER_SIZE + 8 * nr_islands +
+			4 * ISLAND_BITMAP_BLOCK(j);
+		for (i = 0; i < nr_sets; i++)
+			if (get_be32(word + 4 * words * i) & ISLAND_BITMAP_MASK(j))
+				island_bitmap_set(sets[i], found->bit);
+	}
+
+	for (i = 0; i < nr_sets; i++)
+		sets[i] = island_bitmap_intern(sets[i]);
+
+	if (progress)
+		progress_state = start_progress(_("Loading island marks"),
+						p->num_objects);
+
+	marks = data + ISLAND_MARKS_HEADER_SIZE + 8 * nr_islands +
+		4 * words * nr_sets;
+	for (i = 0; stable && i < p->num_objects; i++) {
+		uint32_t set = get_be32(marks + 4 * i);
+		struct object_id oid;
+
+		display_progress(progress_state, i + 1);
+
+		if (set == ISLAND_MARKS_NONE)
+			continue;
+		if (set >= nr_sets) {
+			error(_("island marks file %s is corrupt"), path.buf);
+			break;
+		}
+		if (island_bitmap_is_empty(sets[set]))
+			continue;
+
+		nth_packed_object_id(&oid, p, i);
+		set_island_marks(&oid, sets[set]);
+	}
+	stop_progress(&progress_state);
+
+	trace2_data_intmax("delta-islands", r, "islands/stable", stable);
+
+	if (i < p->num_objects && stable) {
+		/* We hit a bad entry; do not trust any of it. */
+		FREE_AND_NULL(island_dirty);
+	}
+
+cleanup:
+	if (sets) {
+		for (i = 0; i < nr_sets; i++)
+			island_bitmap_unref(sets[i]);
+		free(sets);
+	}
+	free(ids);
+	if (data)
+		munmap((void *)data, size);
+	strbuf_release(&path);
+}
+
 void load_delta_islands(struct repository *r, int progress)
 {
 	island_marks = kh_init_oid_map();
 	remote_islands = kh_init_str();
 
+	hashmap_init(&island_bitmap_pool, island_bitmap_cmp, NULL, 0);
+
 	git_config(island_config_callback, NULL);
 	for_each_ref(find_island_for_ref, NULL);
 	deduplicate_islands(r);
+	intern_island_marks();
+	load_island_marks_file(r, progress);
 
 	if (progress)
 		fprintf(stderr, _("Marked %d islands, done.\n"), island_counter);
 }
 
+void write_island_marks_file(struct pack_idx_entry **index,
+			     uint32_t index_nr,
+			     const unsigned char *pack_hash,
+			     const char *filename)
+{
+	struct island_bitmap **sets = NULL;
+	uint32_t *marks, sets_nr = 0, sets_alloc = 0, i, j;
+	struct strbuf tmp_file = STRBUF_INIT;
+	struct hashfile *f;
+	int fd;
+
+	if (!island_marks)
+		BUG("write_island_marks_file() without islands");
+
+	/* Number the distinct bitmaps of the objects, starting with 1. */
+	ALLOC_ARRAY(marks, index_nr);
+	for (i = 0; i < index_nr; i++) {
+		khiter_t pos = kh_get_oid_map(island_marks, index[i]->oid);
+		struct island_bitmap *b;
+
+		marks[i] = ISLAND_MARKS_NONE;
+		if (pos >= kh_end(island_marks))
+			continue;
+
+		b = kh_value(island_marks, pos);
+		if (!b->pos) {
+			ALLOC_GROW(sets, sets_nr + 1, sets_alloc);
+			sets[sets_nr++] = b;
+			b->pos = sets_nr;
+		}
+		marks[i] = b->pos - 1;
+	}
+
+	fd = odb_mkstemp(&tmp_file, "pack/tmp_islands_XXXXXX");
+	f = hashfd(fd, tmp_file.buf);
+
+	hashwrite_be32(f, ISLAND_MARKS_SIGNATURE);
+	hashwrite_be32(f, ISLAND_MARKS_VERSION);
+	hashwrite_be32(f, oid_version(the_hash_algo));
+	hashwrite_be32(f, island_counter);
+	hashwrite_be32(f, sets_nr);
+
+	for (i = 0; i < island_counter; i++)
+		hashwrite_be64(f, island_ids[i]);
+	for (i = 0; i < sets_nr; i++) {
+		for (j = 0; j < island_bitmap_size; j++)
+			hashwrite_be32(f, sets[i]->bits[j]);
+		sets[i]->pos = 0;
+	}
+	for (i = 0; i < index_nr; i++)
+		hashwrite_be32(f, marks[i]);
+
+	hashwrite(f, pack_hash, the_hash_algo->rawsz);
+
+	if (adjust_shared_perm(tmp_file.buf))
+		die_errno(_("unable to make temporary island marks file readable"));
+
+	finalize_hashfile(f, NULL, FSYNC_COMPONENT_PACK_METADATA,
+			  CSUM_HASH_IN_STREAM | CSUM_FSYNC | CSUM_CLOSE);
+
+	if (rename(tmp_file.buf, filename))
+		die_errno(_("unable to rename temporary island marks file to '%s'"),
+			  filename);
+
+	trace2_data_intmax("delta-islands", the_repository,
+			   "islands/distinct_marks", sets_nr);
+
+	strbuf_release(&tmp_file);
+	free(marks);
+	free(sets);
+}
+
 void propagate_island_marks(struct commit *commit)
 {
 	khiter_t pos = kh_get_oid_map(island_marks, commit->object.oid);
@@ -475,10 +888,15 @@ void propagate_island_marks(struct commit *commit)
 		struct commit_list *p;
 		struct island_bitmap *root_marks = kh_value(island_marks, pos);
 
+		/* The .islands file already passed these on to our history. */
+		if (island_dirty &&
+		    !island_bitmap_intersects(root_marks, island_dirty))
+			return;
+
 		parse_commit(commit);
-		set_island_marks(&get_commit_tree(commit)->object, root_marks);
+		set_island_marks(get_commit_tree_oid(commit), root_marks);
 		for (p = commit->parents; p; p = p->next)
-			set_island_marks(&p->item->object, root_marks);
+			set_island_marks(&p->item->object.oid, root_marks);
 	}
 }
 
@@ -4,6 +4,7 @@
 struct commit;
 struct object_id;
 struct packing_data;
+struct pack_idx_entry;
 struct repository;
 
 int island_delta_cmp(const struct object_id *a, const struct object_id *b);
@@ -15,4 +16,14 @@ void load_delta_islands(struct repository *r, int progress);
 void propagate_island_marks(struct commit *commit);
 int compute_pack_layers(struct packing_data *to_pack);
 
+/*
+ * Write the island marks of the objects in "index" (sorted as in the pack
+ * index) to "filename", an .islands file. A later load_delta_islands()
+ * reuses them for the islands whose tips have not changed since.
+ */
+void write_island_marks_file(struct pack_idx_entry **index,
+			     uint32_t index_nr,
+			     const unsigned char *pack_hash,
+			     const char *filename);
+
 #endif /* DELTA_ISLANDS_H */
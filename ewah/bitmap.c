@@ -17,11 +17,223 @@
  * along with this program; if not, see <http://www.gnu.org/licenses/>.
  */
 #include "cache.h"
+#include "compat/cpu-features.h"
 #include "ewok.h"
+#include "ewok_rlw.h"
 
 #define EWAH_MASK(x) ((eword_t)1 << (x % BITS_IN_EWORD))
 #define EWAH_BLOCK(x) (x / BITS_IN_EWORD)
 
+static void or_words_portable(eword_t *dst, const eword_t *src, size_t nr)
+{
+	size_t i;
+
+	for (i = 0; i < nr; i++)
+		dst[i] |= src[i];
+}
+
+static void and_not_words_portable(eword_t *dst, const eword_t *src, size_t nr)
+{
+	size_t i;
+
+	for (i = 0; i < nr; i++)
+		dst[i] &= ~src[i];
+}
+
+static size_t popcount_words_portable(const eword_t *words, size_t nr)
+{
+	size_t i, count = 0;
+
+	for (i = 0; i < nr; i++)
+		count += ewah_bit_popcount64(words[i]);
+	return count;
+}
+
+static int portable_supported(void)
+{
+	return 1;
+}
+
+#if defined(HAVE_X86_CPUID) || defined(HAVE_ARM_NEON)
+/*
+ * The vector extension of GCC and clang gives us the OR and AND-NOT
+ * loops for any vector unit; they are built once per target below.
+ * Loads and stores go through memcpy(), as the words of a bitmap are
+ * only 8-byte aligned.
+ */
+typedef eword_t bitmap_vec __attribute__((vector_size(32)));
+#define BITMAP_VEC_WORDS (sizeof(bitmap_vec) / sizeof(eword_t))
+
+static inline __attribute__((always_inline))
+void or_words_vec(eword_t *dst, const eword_t *src, size_t nr)
+{
+	size_t i;
+
+	for (i = 0; i + BITMAP_VEC_WORDS <= nr; i += BITMAP_VEC_WORDS) {
+		bitmap_vec a, b;
+		memcpy(&a, dst + i, sizeof(a));
+		memcpy(&b, src + i, sizeof(b));
+		a |= b;
+		memcpy(dst + i, &a, sizeof(a));
+	}
+	for (; i < nr; i++)
+		dst[i] |= src[i];
+}
+
+static inline __attribute__((always_inline))
+void and_not_words_vec(eword_t *dst, const eword_t *src, size_t nr)
+{
+	size_t i;
+
+	for (i = 0; i + BITMAP_VEC_WORDS <= nr; i += BITMAP_VEC_WORDS) {
+		bitmap_vec a, b;
+		memcpy(&a, dst + i, sizeof(a));
+		memcpy(&b, src + i, sizeof(b));
+		a &= ~b;
+		memcpy(dst + i, &a, sizeof(a));
+	}
+	for (; i < nr; i++)
+		dst[i] &= ~src[i];
+}
+#endif
+
+#ifdef HAVE_X86_CPUID
+X86_AVX2_TARGET
+static void or_words_avx2(eword_t *dst, const eword_t *src, size_t nr)
+{
+	or_words_vec(dst, src, nr);
+}
+
+X86_AVX2_TARGET
+static void and_not_words_avx2(eword_t *dst, const eword_t *src, size_t nr)
+{
+	and_not_words_vec(dst, src, nr);
+}
+
+/*
+ * Count the bits of each nibble with a table lookup (vpshufb), as
+ * described by Mula, Kurz and Lemire in "Faster Population Counts Using
+ * AVX2 Instructions" (2018). The per-byte counts are summed into 64-bit
+ * lanes (vpsadbw) before they can overflow.
+ */
+X86_AVX2_TARGET
+static size_t popcount_words_avx2(const eword_t *words, size_t nr)
+{
+	const __m256i lookup = _mm256_setr_epi8(
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+	__m256i total = _mm256_setzero_si256();
+	uint64_t lanes[4];
+	size_t i = 0, count;
+
+	while (i + 4 <= nr) {
+		/* a byte can count up to 8 bits 31 times */
+		size_t end = nr - i > 4 * 31 ? i + 4 * 31 : nr;
+		__m256i local = _mm256_setzero_si256();
+
+		for (; i + 4 <= end; i += 4) {
+			__m256i v = _mm256_loadu_si256((const __m256i *)(words + i));
+			__m256i lo = _mm256_and_si256(v, low_mask);
+			__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4),
+						      low_mask);
+			local = _mm256_add_epi8(local,
+				_mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+						_mm256_shuffle_epi8(lookup, hi)));
+		}
+		total = _mm256_add_epi64(total,
+			_mm256_sad_epu8(local, _mm256_setzero_si256()));
+	}
+
+	/* _mm256_extract_epi64() is only there on x86-64 */
+	_mm256_storeu_si256((__m256i *)lanes, total);
+	count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	for (; i < nr; i++)
+		count += ewah_bit_popcount64(words[i]);
+	return count;
+}
+
+static int avx2_supported(void)
+{
+	return x86_have_avx2();
+}
+#endif
+
+#ifdef HAVE_ARM_NEON
+/* NEON is part of the baseline of AArch64. */
+static void or_words_neon(eword_t *dst, const eword_t *src, size_t nr)
+{
+	or_words_vec(dst, src, nr);
+}
+
+static void and_not_words_neon(eword_t *dst, const eword_t *src, size_t nr)
+{
+	and_not_words_vec(dst, src, nr);
+}
+
+static size_t popcount_words_neon(const eword_t *words, size_t nr)
+{
+	uint64x2_t total = vdupq_n_u64(0);
+	size_t i, count;
+
+	for (i = 0; i + 2 <= nr; i += 2) {
+		uint8x16_t v = vld1q_u8((const uint8_t *)(words + i));
+		total = vaddq_u64(total,
+				  vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vcntq_u8(v)))));
+	}
+
+	count = vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1);
+	for (; i < nr; i++)
+		count += ewah_bit_popcount64(words[i]);
+	return count;
+}
+#endif
+
+const struct ewah_backend ewah_backends[] = {
+#ifdef HAVE_X86_CPUID
+	{ "avx2", avx2_supported, or_words_avx2, and_not_words_avx2,
+	  popcount_words_avx2 },
+#endif
+#ifdef HAVE_ARM_NEON
+	{ "neon", portable_supported, or_words_neon, and_not_words_neon,
+	  popcount_words_neon },
+#endif
+	{ "portable", portable_supported, or_words_portable,
+	  and_not_words_portable, popcount_words_portable },
+	{ NULL }
+};
+
+static const struct ewah_backend *ewah_backend;
+
+void ewah_use_backend(const struct ewah_backend *backend)
+{
+	ewah_backend = backend;
+}
+
+static const struct ewah_backend *get_ewah_backend(void)
+{
+	const char *name;
+	const struct ewah_backend *b;
+
+	if (ewah_backend)
+		return ewah_backend;
+
+	name = getenv("GIT_TEST_EWAH_BACKEND");
+	for (b = ewah_backends; b->name; b++) {
+		if (name && strcmp(b->name, name))
+			continue;
+		if (b->supported())
+			break;
+		if (name)
+			die(_("bitmap backend '%s' is not supported"), name);
+	}
+	if (!b->name)
+		die(_("unknown bitmap backend '%s'"), name);
+
+	ewah_backend = b;
+	return b;
+}
+
 struct bitmap *bitmap_word_alloc(size_t word_alloc)
 {
 	struct bitmap *bitmap = xmalloc(sizeof(struct bitmap));
@@ -123,50 +335,62 @@ void bitmap_and_not(struct bitmap *self, struct bitmap *other)
 	const size_t count = (self->word_alloc < other->word_alloc) ?
 		self->word_alloc : other->word_alloc;
 
-	size_t i;
-
-	for (i = 0; i < count; ++i)
-		self->words[i] &= ~other->words[i];
+	get_ewah_backend()->and_not_words(self->words, other->words, count);
 }
 
 void bitmap_or(struct bitmap *self, const struct bitmap *other)
 {
-	size_t i;
-
 	bitmap_grow(self, other->word_alloc);
-	for (i = 0; i < other->word_alloc; i++)
-		self->words[i] |= other->words[i];
+	get_ewah_backend()->or_words(self->words, other->words, other->word_alloc);
 }
 
-void bitmap_or_ewah(struct bitmap *self, struct ewah_bitmap *other)
+static void bitmap_ensure_words(struct bitmap *self, size_t word_alloc)
 {
 	size_t original_size = self->word_alloc;
-	size_t other_final = (other->bit_size / BITS_IN_EWORD) + 1;
-	size_t i = 0;
-	struct ewah_iterator it;
-	eword_t word;
 
-	if (self->word_alloc < other_final) {
-		self->word_alloc = other_final;
+	if (self->word_alloc < word_alloc) {
+		self->word_alloc = word_alloc;
 		REALLOC_ARRAY(self->words, self->word_alloc);
 		memset(self->words + original_size, 0x0,
 			(self->word_alloc - original_size) * sizeof(eword_t));
 	}
+}
 
-	ewah_iterator_init(&it, other);
-
-	while (ewah_iterator_next(&word, &it))
-		self->words[i++] |= word;
+void bitmap_or_ewah(struct bitmap *self, struct ewah_bitmap *other)
+{
+	const struct ewah_backend *backend = get_ewah_backend();
+	size_t pointer = 0, i = 0;
+
+	bitmap_ensure_words(self, (other->bit_size / BITS_IN_EWORD) + 1);
+
+	/*
+	 * Rather than going through the words one by one with an
+	 * ewah_iterator, fill whole runs of ones at once, skip runs of
+	 * zeroes, and OR each stretch of literal words with the
+	 * (vectorized) word loop.
+	 */
+	while (pointer < other->buffer_size) {
+		const eword_t *rlw = other->buffer + pointer;
+		size_t running = rlw_get_running_len(rlw);
+		size_t literals = rlw_get_literal_words(rlw);
+
+		if (literals > other->buffer_size - pointer - 1)
+			literals = other->buffer_size - pointer - 1;
+		bitmap_ensure_words(self, st_add3(i, running, literals));
+
+		if (rlw_get_run_bit(rlw))
+			memset(self->words + i, 0xff, running * sizeof(eword_t));
+		i += running;
+
+		backend->or_words(self->words + i, rlw + 1, literals);
+		i += literals;
+		pointer += 1 + literals;
+	}
 }
 
 size_t bitmap_popcount(struct bitmap *self)
 {
-	size_t i, count = 0;
-
-	for (i = 0; i < self->word_alloc; ++i)
-		count += ewah_bit_popcount64(self->words[i]);
-
-	return count;
+	return get_ewah_backend()->popcount_words(self->words, self->word_alloc);
 }
 
 int bitmap_equals(struct bitmap *self, struct bitmap *other)
@@ -190,4 +190,71 @@ void bitmap_or(struct bitmap *self, const struct bitmap *other);
 
 size_t bitmap_popcount(struct bitmap *self);
 
+/**
+ * The word loops behind bitmap_or(), bitmap_and_not(), bitmap_or_ewah()
+ * and bitmap_popcount(), with vectorized versions for some CPUs. The
+ * first entry of ewah_backends[] that the CPU supports is used, unless
+ * GIT_TEST_EWAH_BACKEND names another one.
+ */
+struct ewah_backend {
+	const char *name;
+	int (*supported)(void);
+	void (*or_words)(eword_t *dst, const eword_t *src, size_t nr);
+	void (*and_not_words)(eword_t *dst, const eword_t *src, size_t nr);
+	size_t (*popcount_words)(const eword_t *words, size_t nr);
+};
+
+extern const struct ewah_backend ewah_backends[];
+void ewah_use_backend(const struct ewah_backend *backend);
+
+/**
+ * Roaring bitmaps (see roaring.c) store the bits of every chunk of 2^16
+ * positions in one container, as an array, a bitset or a list of runs.
+ */
+enum roaring_container_type {
+	ROARING_ARRAY = 1,
+	ROARING_BITSET = 2,
+	ROARING_RUN = 3,
+};
+
+struct roaring_container {
+	uint16_t key;
+	uint8_t type;
+	/* number of values, of runs, or of set bits for a bitset */
+	uint32_t nr;
+	/* sorted values, or (start, length - 1) pairs for runs */
+	uint16_t *values;
+	eword_t *words;
+};
+
+struct roaring_bitmap {
+	struct roaring_container *containers;
+	size_t nr, alloc;
+};
+
+struct roaring_bitmap *roaring_new(void);
+void roaring_free(struct roaring_bitmap *self);
+
+int roaring_serialize_to(struct roaring_bitmap *self,
+			 int (*write_fun)(void *out, const void *buf, size_t len),
+			 void *out);
+size_t roaring_serialized_size(struct roaring_bitmap *self);
+ssize_t roaring_read_mmap(struct roaring_bitmap *self, const void *map, size_t len);
+
+/**
+ * One past the highest bit set in the bitmap.
+ */
+size_t roaring_bit_size(struct roaring_bitmap *self);
+
+/**
+ * Store the symmetric difference of "a" and "b" in the (empty) bitmap
+ * "out", one pair of containers at a time.
+ */
+void roaring_xor(struct roaring_bitmap *a, struct roaring_bitmap *b,
+		 struct roaring_bitmap *out);
+
+struct roaring_bitmap *bitmap_to_roaring(struct bitmap *bitmap);
+struct bitmap *roaring_to_bitmap(struct roaring_bitmap *roaring);
+void bitmap_or_roaring(struct bitmap *self, struct roaring_bitmap *other);
+
 #endif
@@ -0,0 +1,571 @@
+/*
+ * Roaring bitmaps, as described by Chambi, Lemire, Kaser and Godin in
+ * "Better bitmap performance with Roaring bitmaps" (2016), and later
+ * extended with run containers.
+ *
+ * The bit positions are split into chunks of 2^16 bits; for every chunk
+ * with at least one bit set we store a "container", keyed by the upper
+ * 16 bits of the positions it covers, using whichever of these three
+ * representations is the smallest:
+ *
+ *  - a sorted array of the lower 16 bits of the set positions,
+ *  - a plain bitset of 2^16 bits,
+ *  - a sorted list of runs of set bits, as (start, length - 1) pairs.
+ *
+ * Unlike with EWAH, a single chunk of a roaring bitmap can be found
+ * and combined with another one without going through all the chunks
+ * before it, and sparse chunks do not cost a full word per set bit.
+ */
+#include "cache.h"
+#include "ewok.h"
+
+#define ROARING_CHUNK_BITS (1 << 16)
+#define ROARING_CHUNK_WORDS (ROARING_CHUNK_BITS / BITS_IN_EWORD)
+#define ROARING_ARRAY_MAX 4096
+
+#define ROARING_MASK(x) ((eword_t)1 << ((x) % BITS_IN_EWORD))
+#define ROARING_BLOCK(x) ((x) / BITS_IN_EWORD)
+
+struct roaring_bitmap *roaring_new(void)
+{
+	struct roaring_bitmap *self;
+	CALLOC_ARRAY(self, 1);
+	return self;
+}
+
+static void container_release(struct roaring_container *c)
+{
+	free(c->values);
+	free(c->words);
+	c->values = NULL;
+	c->words = NULL;
+}
+
+void roaring_free(struct roaring_bitmap *self)
+{
+	size_t i;
+
+	if (!self)
+		return;
+
+	for (i = 0; i < self->nr; i++)
+		container_release(&self->containers[i]);
+	free(self->containers);
+	free(self);
+}
+
+static struct roaring_container *roaring_append(struct roaring_bitmap *self,
+						uint16_t key)
+{
+	struct roaring_container *c;
+
+	ALLOC_GROW(self->containers, self->nr + 1, self->alloc);
+	c = &self->containers[self->nr++];
+	memset(c, 0, sizeof(*c));
+	c->key = key;
+	return c;
+}
+
+/* Return the first position at or after "pos" whose bit is "set". */
+static uint32_t chunk_next_bit(const eword_t *words, uint32_t pos, int set)
+{
+	size_t block = ROARING_BLOCK(pos);
+	eword_t word;
+
+	if (pos >= ROARING_CHUNK_BITS)
+		return ROARING_CHUNK_BITS;
+
+	word = set ? words[block] : ~words[block];
+	word &= ~(eword_t)0 << (pos % BITS_IN_EWORD);
+	while (!word) {
+		if (++block == ROARING_CHUNK_WORDS)
+			return ROARING_CHUNK_BITS;
+		word = set ? words[block] : ~words[block];
+	}
+	return block * BITS_IN_EWORD + ewah_bit_ctz64(word);
+}
+
+/* Set (or toggle) the bits in [start, end) of a chunk. */
+static void chunk_set_range(eword_t *words, uint32_t start, uint32_t end,
+			    int toggle)
+{
+	size_t first = ROARING_BLOCK(start), last = ROARING_BLOCK(end - 1);
+	eword_t first_mask = ~(eword_t)0 << (start % BITS_IN_EWORD);
+	eword_t last_mask = ~(eword_t)0 >> (BITS_IN_EWORD - 1 - (end - 1) % BITS_IN_EWORD);
+	size_t i;
+
+	if (first == last) {
+		first_mask &= last_mask;
+		if (toggle)
+			words[first] ^= first_mask;
+		else
+			words[first] |= first_mask;
+		return;
+	}
+
+	if (toggle) {
+		words[first] ^= first_mask;
+		for (i = first + 1; i < last; i++)
+			words[i] = ~words[i];
+		words[last] ^= last_mask;
+	} else {
+		words[first] |= first_mask;
+		for (i = first + 1; i < last; i++)
+			words[i] = ~(eword_t)0;
+		words[last] |= last_mask;
+	}
+}
+
+/*
+ * Fill "c" with the bits of a chunk, picking the smallest of the three
+ * representations. Returns 0 (and leaves "c" alone) if no bit is set.
+ */
+static int container_from_words(struct roaring_container *c,
+				const eword_t *words)
+{
+	uint32_t cardinality = 0, runs = 0, pos, end;
+	size_t array_size, run_size, bitset_size, i;
+	eword_t carry = 0;
+
+	for (i = 0; i < ROARING_CHUNK_WORDS; i++) {
+		eword_t word = words[i];
+		cardinality += ewah_bit_popcount64(word);
+		runs += ewah_bit_popcount64(word & ~((word << 1) | carry));
+		carry = word >> (BITS_IN_EWORD - 1);
+	}
+	if (!cardinality)
+		return 0;
+
+	array_size = cardinality <= ROARING_ARRAY_MAX ?
+		cardinality * sizeof(uint16_t) : SIZE_MAX;
+	run_size = runs * 2 * sizeof(uint16_t);
+	bitset_size = ROARING_CHUNK_WORDS * sizeof(eword_t);
+
+	if (array_size <= run_size && array_size <= bitset_size) {
+		c->type = ROARING_ARRAY;
+		c->nr = cardinality;
+		ALLOC_ARRAY(c->values, cardinality);
+		for (i = 0, pos = chunk_next_bit(words, 0, 1);
+		     pos < ROARING_CHUNK_BITS;
+		     pos = chunk_next_bit(words, pos + 1, 1))
+			c->values[i++] = pos;
+	} else if (run_size < bitset_size) {
+		c->type = ROARING_RUN;
+		c->nr = runs;
+		ALLOC_ARRAY(c->values, 2 * runs);
+		for (i = 0, pos = chunk_next_bit(words, 0, 1);
+		     pos < ROARING_CHUNK_BITS;
+		     pos = chunk_next_bit(words, end, 1)) {
+			end = chunk_next_bit(words, pos, 0);
+			c->values[i++] = pos;
+			c->values[i++] = end - pos - 1;
+		}
+	} else {
+		c->type = ROARING_BITSET;
+		c->nr = cardinality;
+		ALLOC_ARRAY(c->words, ROARING_CHUNK_WORDS);
+		COPY_ARRAY(c->words, words, ROARING_CHUNK_WORDS);
+	}
+	return 1;
+}
+
+/*
+ * OR (or XOR, with "toggle") the bits of "c" into the first "nr" words
+ * of a chunk; the container must not have any bits beyond them.
+ */
+static void container_apply(const struct roaring_container *c,
+			    eword_t *words, size_t nr, int toggle)
+{
+	uint32_t i;
+
+	switch (c->type) {
+	case ROARING_ARRAY:
+		for (i = 0; i < c->nr; i++) {
+			uint16_t v = c->values[i];
+			if (toggle)
+				words[ROARING_BLOCK(v)] ^= ROARING_MASK(v);
+			else
+				words[ROARING_BLOCK(v)] |= ROARING_MASK(v);
+		}
+		break;
+	case ROARING_RUN:
+		for (i = 0; i < c->nr; i++) {
+			uint32_t start = c->values[2 * i];
+			chunk_set_range(words, start,
+					start + c->values[2 * i + 1] + 1,
+					toggle);
+		}
+		break;
+	case ROARING_BITSET:
+		for (i = 0; i < nr; i++) {
+			if (toggle)
+				words[i] ^= c->words[i];
+			else
+				words[i] |= c->words[i];
+		}
+		break;
+	default:
+		BUG("unknown roaring container type %d", c->type);
+	}
+}
+
+/* One past the highest bit set in "c", relative to its chunk. */
+static uint32_t container_bit_size(const struct roaring_container *c)
+{
+	size_t i;
+	uint32_t bits;
+	eword_t word;
+
+	switch (c->type) {
+	case ROARING_ARRAY:
+		return c->values[c->nr - 1] + 1;
+	case ROARING_RUN:
+		return c->values[2 * c->nr - 2] + c->values[2 * c->nr - 1] + 1;
+	case ROARING_BITSET:
+		for (i = ROARING_CHUNK_WORDS; i > 0; i--) {
+			if (!c->words[i - 1])
+				continue;
+			for (bits = 0, word = c->words[i - 1]; word; word >>= 1)
+				bits++;
+			return (i - 1) * BITS_IN_EWORD + bits;
+		}
+		return 0;
+	default:
+		BUG("unknown roaring container type %d", c->type);
+	}
+}
+
+size_t roaring_bit_size(struct roaring_bitmap *self)
+{
+	struct roaring_container *last;
+
+	if (!self->nr)
+		return 0;
+	last = &self->containers[self->nr - 1];
+	return (size_t)last->key * ROARING_CHUNK_BITS + container_bit_size(last);
+}
+
+static void container_copy(struct roaring_container *dst,
+			   const struct roaring_container *src)
+{
+	*dst = *src;
+	if (src->type == ROARING_BITSET) {
+		dst->words = xmalloc(st_mult(ROARING_CHUNK_WORDS, sizeof(eword_t)));
+		COPY_ARRAY(dst->words, src->words, ROARING_CHUNK_WORDS);
+	} else {
+		size_t nr = src->type == ROARING_RUN ? 2 * src->nr : src->nr;
+		ALLOC_ARRAY(dst->values, nr);
+		COPY_ARRAY(dst->values, src->values, nr);
+	}
+}
+
+/* Symmetric difference of two arrays, if it is still small enough. */
+static int container_xor_arrays(struct roaring_container *out,
+				const struct roaring_container *a,
+				const struct roaring_container *b)
+{
+	uint32_t i = 0, j = 0, nr = 0;
+	uint16_t *values;
+
+	if (a->type != ROARING_ARRAY || b->type != ROARING_ARRAY ||
+	    a->nr + b->nr > ROARING_ARRAY_MAX)
+		return -1;
+
+	ALLOC_ARRAY(values, a->nr + b->nr);
+	while (i < a->nr && j < b->nr) {
+		if (a->values[i] < b->values[j])
+			values[nr++] = a->values[i++];
+		else if (a->values[i] > b->values[j])
+			values[nr++] = b->values[j++];
+		else {
+			i++;
+			j++;
+		}
+	}
+	while (i < a->nr)
+		values[nr++] = a->values[i++];
+	while (j < b->nr)
+		values[nr++] = b->values[j++];
+
+	if (!nr) {
+		free(values);
+		return 0;
+	}
+	out->type = ROARING_ARRAY;
+	out->nr = nr;
+	out->values = values;
+	return 1;
+}
+
+void roaring_xor(struct roaring_bitmap *a, struct roaring_bitmap *b,
+		 struct roaring_bitmap *out)
+{
+	eword_t *chunk = NULL;
+	size_t i = 0, j = 0;
+
+	while (i < a->nr || j < b->nr) {
+		struct roaring_container *ca = i < a->nr ? &a->containers[i] : NULL;
+		struct roaring_container *cb = j < b->nr ? &b->containers[j] : NULL;
+		struct roaring_container tmp = { 0 };
+		int ret;
+
+		if (!cb || (ca && ca->key < cb->key)) {
+			container_copy(roaring_append(out, ca->key), ca);
+			i++;
+			continue;
+		}
+		if (!ca || cb->key < ca->key) {
+			container_copy(roaring_append(out, cb->key), cb);
+			j++;
+			continue;
+		}
+
+		ret = container_xor_arrays(&tmp, ca, cb);
+		if (ret < 0) {
+			if (!chunk)
+				ALLOC_ARRAY(chunk, ROARING_CHUNK_WORDS);
+			memset(chunk, 0, ROARING_CHUNK_WORDS * sizeof(eword_t));
+			container_apply(ca, chunk, ROARING_CHUNK_WORDS, 0);
+			container_apply(cb, chunk, ROARING_CHUNK_WORDS, 1);
+			ret = container_from_words(&tmp, chunk);
+		}
+		if (ret) {
+			tmp.key = ca->key;
+			*roaring_append(out, ca->key) = tmp;
+		}
+		i++;
+		j++;
+	}
+
+	free(chunk);
+}
+
+struct roaring_bitmap *bitmap_to_roaring(struct bitmap *bitmap)
+{
+	struct roaring_bitmap *self = roaring_new();
+	eword_t *chunk = NULL;
+	size_t start;
+
+	for (start = 0; start < bitmap->word_alloc; start += ROARING_CHUNK_WORDS) {
+		struct roaring_container c = { 0 };
+		const eword_t *words = bitmap->words + start;
+
+		if (bitmap->word_alloc - start < ROARING_CHUNK_WORDS) {
+			size_t nr = bitmap->word_alloc - start;
+			CALLOC_ARRAY(chunk, ROARING_CHUNK_WORDS);
+			COPY_ARRAY(chunk, words, nr);
+			words = chunk;
+		}
+		if (container_from_words(&c, words)) {
+			c.key = start / ROARING_CHUNK_WORDS;
+			*roaring_append(self, c.key) = c;
+		}
+	}
+
+	free(chunk);
+	return self;
+}
+
+void bitmap_or_roaring(struct bitmap *self, struct roaring_bitmap *other)
+{
+	size_t original_size = self->word_alloc;
+	size_t other_final = DIV_ROUND_UP(roaring_bit_size(other), BITS_IN_EWORD);
+	size_t i;
+
+	if (self->word_alloc < other_final) {
+		self->word_alloc = other_final;
+		REALLOC_ARRAY(self->words, self->word_alloc);
+		memset(self->words + original_size, 0x0,
+			(self->word_alloc - original_size) * sizeof(eword_t));
+	}
+
+	for (i = 0; i < other->nr; i++) {
+		struct roaring_container *c = &other->containers[i];
+		size_t start = (size_t)c->key * ROARING_CHUNK_WORDS;
+		size_t nr = self->word_alloc - start;
+
+		container_apply(c, self->words + start,
+				nr < ROARING_CHUNK_WORDS ? nr : ROARING_CHUNK_WORDS,
+				0);
+	}
+}
+
+struct bitmap *roaring_to_bitmap(struct roaring_bitmap *roaring)
+{
+	struct bitmap *bitmap = bitmap_word_alloc(0);
+	bitmap_or_roaring(bitmap, roaring);
+	return bitmap;
+}
+
+static size_t container_payload_size(const struct roaring_container *c)
+{
+	switch (c->type) {
+	case ROARING_ARRAY:
+		return c->nr * sizeof(uint16_t);
+	case ROARING_RUN:
+		return 2 * c->nr * sizeof(uint16_t);
+	case ROARING_BITSET:
+		return ROARING_CHUNK_WORDS * sizeof(eword_t);
+	default:
+		BUG("unknown roaring container type %d", c->type);
+	}
+}
+
+/*
+ * The serialized form, in network byte order, is:
+ *
+ *   32 bit -- number of containers
+ *   for each container:
+ *     16 bit -- key
+ *      8 bit -- type
+ *      8 bit -- reserved, zero
+ *     32 bit -- number of values (array), runs (run) or set bits (bitset)
+ *     the values, (start, length - 1) pairs or 64-bit words
+ */
+size_t roaring_serialized_size(struct roaring_bitmap *self)
+{
+	size_t i, size = 4;
+
+	for (i = 0; i < self->nr; i++)
+		size += 8 + container_payload_size(&self->containers[i]);
+	return size;
+}
+
+int roaring_serialize_to(struct roaring_bitmap *self,
+			 int (*write_fun)(void *, const void *, size_t),
+			 void *data)
+{
+	unsigned char header[8];
+	size_t i, j;
+
+	put_be32(header, self->nr);
+	if (write_fun(data, header, 4) != 4)
+		return -1;
+
+	for (i = 0; i < self->nr; i++) {
+		struct roaring_container *c = &self->containers[i];
+		size_t len = container_payload_size(c);
+		void *payload;
+
+		header[0] = c->key >> 8;
+		header[1] = c->key & 0xff;
+		header[2] = c->type;
+		header[3] = 0;
+		put_be32(header + 4, c->nr);
+		if (write_fun(data, header, 8) != 8)
+			return -1;
+
+		payload = xmalloc(len);
+		if (c->type == ROARING_BITSET) {
+			eword_t *words = payload;
+			for (j = 0; j < ROARING_CHUNK_WORDS; j++)
+				words[j] = htonll(c->words[j]);
+		} else {
+			uint16_t *values = payload;
+			for (j = 0; j < len / sizeof(uint16_t); j++)
+				values[j] = htons(c->values[j]);
+		}
+		if (write_fun(data, payload, len) != len) {
+			free(payload);
+			return -1;
+		}
+		free(payload);
+	}
+
+	return roaring_serialized_size(self);
+}
+
+static int container_check(const struct roaring_container *c)
+{
+	uint32_t i, end = 0;
+
+	switch (c->type) {
+	case ROARING_ARRAY:
+		for (i = 1; i < c->nr; i++)
+			if (c->values[i - 1] >= c->values[i])
+				return error("corrupt roaring bitmap: unsorted array");
+		break;
+	case ROARING_RUN:
+		for (i = 0; i < c->nr; i++) {
+			uint32_t start = c->values[2 * i];
+			if ((i && start <= end) ||
+			    start + c->values[2 * i + 1] >= ROARING_CHUNK_BITS)
+				return error("corrupt roaring bitmap: invalid run");
+			end = start + c->values[2 * i + 1] + 1;
+		}
+		break;
+	}
+	return 0;
+}
+
+ssize_t roaring_read_mmap(struct roaring_bitmap *self, const void *map,
+			  size_t len)
+{
+	const uint8_t *ptr = map;
+	uint32_t nr, i, j;
+
+	if (len < 4)
+		return error("corrupt roaring bitmap: eof before container count");
+	nr = get_be32(ptr);
+	ptr += 4;
+	len -= 4;
+
+	for (i = 0; i < nr; i++) {
+		struct roaring_container *c;
+		uint16_t key;
+		size_t data_len;
+
+		if (len < 8)
+			return error("corrupt roaring bitmap: eof in container header");
+		key = get_be16(ptr);
+		if (self->nr && key <= self->containers[self->nr - 1].key)
+			return error("corrupt roaring bitmap: unsorted containers");
+
+		c = roaring_append(self, key);
+		c->type = ptr[2];
+		c->nr = get_be32(ptr + 4);
+		ptr += 8;
+		len -= 8;
+
+		if (!c->nr && c->type != ROARING_BITSET)
+			return error("corrupt roaring bitmap: empty container");
+		switch (c->type) {
+		case ROARING_ARRAY:
+			if (c->nr > ROARING_ARRAY_MAX)
+				return error("corrupt roaring bitmap: array too large");
+			break;
+		case ROARING_RUN:
+			if (c->nr > ROARING_CHUNK_BITS / 2)
+				return error("corrupt roaring bitmap: too many runs");
+			break;
+		case ROARING_BITSET:
+			break;
+		default:
+			return error("corrupt roaring bitmap: unknown container type %d",
+				     c->type);
+		}
+
+		data_len = container_payload_size(c);
+		if (len < data_len)
+			return error("corrupt roaring bitmap: eof in data "
+				     "(%"PRIuMAX" bytes short)",
+				     (uintmax_t)(data_len - len));
+
+		if (c->type == ROARING_BITSET) {
+			ALLOC_ARRAY(c->words, ROARING_CHUNK_WORDS);
+			memcpy(c->words, ptr, data_len);
+			for (j = 0; j < ROARING_CHUNK_WORDS; j++)
+				c->words[j] = ntohll(c->words[j]);
+		} else {
+			ALLOC_ARRAY(c->values, data_len / sizeof(uint16_t));
+			for (j = 0; j < data_len / sizeof(uint16_t); j++)
+				c->values[j] = get_be16(ptr + j * sizeof(uint16_t));
+			if (container_check(c) < 0)
+				return -1;
+		}
+		ptr += data_len;
+		len -= data_len;
+	}
+
+	return ptr - (const uint8_t *)map;
+}
@@ -4,6 +4,30 @@
 #include "git-compat-util.h"
 #include "repository.h"
 
+/*
+ * Our own implementations of SHA-1 and SHA-256 can choose between
+ * several block functions at runtime, e.g. to use the SHA instructions
+ * of the CPU they run on. A block function feeds "nr" consecutive
+ * blocks starting at "data" into "state".
+ */
+typedef void (*git_hash_blocks_fn)(uint32_t *state, const unsigned char *data,
+				   size_t nr);
+
+struct git_hash_backend {
+	/* The name of the backend, e.g. "portable" or "sha-ni". */
+	const char *name;
+
+	/* Returns true if the backend can be used on this machine. */
+	int (*supported)(void);
+
+	/*
+	 * NULL for the "sha1dc" backend of SHA1_DC builds, which hashes
+	 * everything with the original collision-detecting code.
+	 */
+	git_hash_blocks_fn blocks;
+};
+
+
 #if defined(SHA1_APPLE)
 #include <CommonCrypto/CommonDigest.h>
 #elif defined(SHA1_OPENSSL)
@@ -179,6 +203,16 @@ struct git_hash_algo {
 
 	/* The all-zeros OID. */
 	const struct object_id *null_oid;
+
+	/*
+	 * The backends the implementation of this hash can choose from,
+	 * terminated by an entry without a name, or NULL if there is no
+	 * choice (e.g. because it comes from an external library).
+	 */
+	const struct git_hash_backend *backends;
+
+	/* Use the given backend from now on. */
+	void (*use_backend_fn)(const struct git_hash_backend *backend);
 };
 extern const struct git_hash_algo hash_algos[GIT_HASH_NALGOS];
 
@@ -197,6 +231,13 @@ static inline int hash_algo_by_ptr(const struct git_hash_algo *p)
 	return p - hash_algos;
 }
 
+/*
+ * Make "algop" use "backend", one of its "backends", from now on. By
+ * default, the first backend that is supported on this machine is used.
+ */
+void hash_algo_use_backend(const struct git_hash_algo *algop,
+			   const struct git_hash_backend *backend);
+
 #define the_hash_algo the_repository->hash_algo
 
 const struct object_id *null_oid(void);
@@ -23,6 +23,7 @@
 #define MIDX_BYTE_FILE_VERSION 4
 #define MIDX_BYTE_HASH_VERSION 5
 #define MIDX_BYTE_NUM_CHUNKS 6
+#define MIDX_BYTE_NUM_BASES 7
 #define MIDX_BYTE_NUM_PACKS 8
 #define MIDX_HEADER_SIZE 12
 #define MIDX_MIN_SIZE (MIDX_HEADER_SIZE + the_hash_algo->rawsz)
@@ -34,6 +35,7 @@
 #define MIDX_CHUNKID_OBJECTOFFSETS 0x4f4f4646 /* "OOFF" */
 #define MIDX_CHUNKID_LARGEOFFSETS 0x4c4f4646 /* "LOFF" */
 #define MIDX_CHUNKID_REVINDEX 0x52494458 /* "RIDX" */
+#define MIDX_CHUNKID_BASEMIDXS 0x42415345 /* "BASE" */
 #define MIDX_CHUNK_FANOUT_SIZE (sizeof(uint32_t) * 256)
 #define MIDX_CHUNK_OFFSET_WIDTH (2 * sizeof(uint32_t))
 #define MIDX_CHUNK_LARGE_OFFSET_WIDTH (sizeof(uint64_t))
@@ -53,10 +55,33 @@ void get_midx_filename(struct strbuf *out, const char *object_dir)
 
 void get_midx_rev_filename(struct strbuf *out, struct multi_pack_index *m)
 {
+	if (m->incremental) {
+		get_split_midx_filename_ext(out, m->object_dir,
+					    get_midx_checksum(m), "rev");
+		return;
+	}
 	get_midx_filename(out, m->object_dir);
 	strbuf_addf(out, "-%s.rev", hash_to_hex(get_midx_checksum(m)));
 }
 
+void get_midx_chain_dirname(struct strbuf *out, const char *object_dir)
+{
+	strbuf_addf(out, "%s/pack/multi-pack-index.d", object_dir);
+}
+
+void get_midx_chain_filename(struct strbuf *out, const char *object_dir)
+{
+	get_midx_chain_dirname(out, object_dir);
+	strbuf_addstr(out, "/multi-pack-index-chain");
+}
+
+void get_split_midx_filename_ext(struct strbuf *out, const char *object_dir,
+				 const unsigned char *hash, const char *ext)
+{
+	get_midx_chain_dirname(out, object_dir);
+	strbuf_addf(out, "/multi-pack-index-%s.%s", hash_to_hex(hash), ext);
+}
+
 static int midx_read_oid_fanout(const unsigned char *chunk_start,
 				size_t chunk_size, void *data)
 {
@@ -70,7 +95,22 @@ static int midx_read_oid_fanout(const unsigned char *chunk_start,
 	return 0;
 }
 
-struct multi_pack_index *load_multi_pack_index(const char *object_dir, int local)
+static int midx_read_base_midxs(const unsigned char *chunk_start,
+				size_t chunk_size, void *data)
+{
+	struct multi_pack_index *m = data;
+	m->chunk_base_midxs = chunk_start;
+
+	if (chunk_size != (size_t)m->num_bases * m->hash_len) {
+		error(_("multi-pack-index base chunk is of the wrong size"));
+		return 1;
+	}
+	return 0;
+}
+
+static struct multi_pack_index *load_multi_pack_index_one(const char *object_dir,
+							  const char *midx_name,
+							  int local)
 {
 	struct multi_pack_index *m = NULL;
 	int fd;
@@ -78,31 +118,26 @@ struct multi_pack_index *load_multi_pack_index(const char *object_dir, int local
 	size_t midx_size;
 	void *midx_map = NULL;
 	uint32_t hash_version;
-	struct strbuf midx_name = STRBUF_INIT;
 	uint32_t i;
 	const char *cur_pack_name;
 	struct chunkfile *cf = NULL;
 
-	get_midx_filename(&midx_name, object_dir);
-
-	fd = git_open(midx_name.buf);
+	fd = git_open(midx_name);
 
 	if (fd < 0)
 		goto cleanup_fail;
 	if (fstat(fd, &st)) {
-		error_errno(_("failed to read %s"), midx_name.buf);
+		error_errno(_("failed to read %s"), midx_name);
 		goto cleanup_fail;
 	}
 
 	midx_size = xsize_t(st.st_size);
 
 	if (midx_size < MIDX_MIN_SIZE) {
-		error(_("multi-pack-index file %s is too small"), midx_name.buf);
+		error(_("multi-pack-index file %s is too small"), midx_name);
 		goto cleanup_fail;
 	}
 
-	strbuf_release(&midx_name);
-
 	midx_map = xmmap(NULL, midx_size, PROT_READ, MAP_PRIVATE, fd, 0);
 	close(fd);
 
@@ -130,6 +165,7 @@ struct multi_pack_index *load_multi_pack_index(const char *object_dir, int local
 	m->hash_len = the_hash_algo->rawsz;
 
 	m->num_chunks = m->data[MIDX_BYTE_NUM_CHUNKS];
+	m->num_bases = m->data[MIDX_BYTE_NUM_BASES];
 
 	m->num_packs = get_be32(m->data + MIDX_BYTE_NUM_PACKS);
 
@@ -150,6 +186,10 @@ struct multi_pack_index *load_multi_pack_index(const char *object_dir, int local
 
 	pair_chunk(cf, MIDX_CHUNKID_LARGEOFFSETS, &m->chunk_large_offsets);
 
+	if (m->num_bases &&
+	    read_chunk(cf, MIDX_CHUNKID_BASEMIDXS, midx_read_base_midxs, m))
+		goto cleanup_fail;
+
 	if (git_env_bool("GIT_TEST_MIDX_READ_RIDX", 1))
 		pair_chunk(cf, MIDX_CHUNKID_REVINDEX, &m->chunk_revindex);
 
@@ -178,7 +218,6 @@ struct multi_pack_index *load_multi_pack_index(const char *object_dir, int local
 
 cleanup_fail:
 	free(m);
-	strbuf_release(&midx_name);
 	free_chunkfile(cf);
 	if (midx_map)
 		munmap(midx_map, midx_size);
@@ -187,6 +226,117 @@ struct multi_pack_index *load_multi_pack_index(const char *object_dir, int local
 	return NULL;
 }
 
+/*
+ * Check that the layer 'm' was written on top of exactly the layers
+ * 'base' (and below) of the chain, in that order.
+ */
+static int midx_layer_matches_base(struct multi_pack_index *m,
+				   struct multi_pack_index *base)
+{
+	struct multi_pack_index *b;
+	uint32_t nr = 0;
+
+	for (b = base; b; b = b->base_midx)
+		nr++;
+	if (m->num_bases != nr)
+		return 0;
+
+	for (b = base; b; b = b->base_midx) {
+		nr--;
+		if (!hasheq(m->chunk_base_midxs + (size_t)nr * m->hash_len,
+			    get_midx_checksum(b)))
+			return 0;
+	}
+	return 1;
+}
+
+static struct multi_pack_index *load_multi_pack_index_chain(const char *object_dir,
+							    int local)
+{
+	struct strbuf chain_name = STRBUF_INIT;
+	struct strbuf line = STRBUF_INIT;
+	struct strbuf layer_name = STRBUF_INIT;
+	struct multi_pack_index *m = NULL;
+	FILE *fp;
+
+	get_midx_chain_filename(&chain_name, object_dir);
+	fp = fopen(chain_name.buf, "r");
+	if (!fp) {
+		if (errno != ENOENT)
+			warning_errno(_("unable to open %s"), chain_name.buf);
+		goto cleanup;
+	}
+
+	while (strbuf_getline_lf(&line, fp) != EOF) {
+		struct multi_pack_index *layer;
+		struct object_id oid;
+
+		if (line.len != the_hash_algo->hexsz ||
+		    get_oid_hex(line.buf, &oid)) {
+			warning(_("invalid multi-pack-index chain: line '%s' not a hash"),
+				line.buf);
+			goto fail;
+		}
+
+		strbuf_reset(&layer_name);
+		get_split_midx_filename_ext(&layer_name, object_dir,
+					    oid.hash, "midx");
+		layer = load_multi_pack_index_one(object_dir, layer_name.buf,
+						  local);
+		if (!layer) {
+			warning(_("unable to find all multi-pack-index files"));
+			goto fail;
+		}
+		if (!hasheq(get_midx_checksum(layer), oid.hash) ||
+		    !midx_layer_matches_base(layer, m)) {
+			warning(_("multi-pack-index chain does not match %s"),
+				layer_name.buf);
+			close_midx(layer);
+			goto fail;
+		}
+
+		layer->incremental = 1;
+		layer->base_midx = m;
+		layer->next = m;
+		if (m)
+			layer->num_objects_in_base = m->num_objects_in_base +
+						     m->num_objects;
+		m = layer;
+	}
+	goto cleanup;
+
+fail:
+	close_midx(m);
+	m = NULL;
+cleanup:
+	if (fp)
+		fclose(fp);
+	strbuf_release(&chain_name);
+	strbuf_release(&line);
+	strbuf_release(&layer_name);
+	return m;
+}
+
+struct multi_pack_index *load_multi_pack_index(const char *object_dir, int local)
+{
+	struct strbuf midx_name = STRBUF_INIT;
+	struct multi_pack_index *m;
+
+	get_midx_filename(&midx_name, object_dir);
+	m = load_multi_pack_index_one(object_dir, midx_name.buf, local);
+	strbuf_release(&midx_name);
+
+	if (m && m->num_bases) {
+		error(_("multi-pack-index has %d base layers, but is not part of a chain"),
+		      m->num_bases);
+		close_midx(m);
+		return NULL;
+	}
+	if (!m)
+		m = load_multi_pack_index_chain(object_dir, local);
+	return m;
+}
+
 void close_midx(struct multi_pack_index *m)
 {
 	uint32_t i;
@@ -351,7 +501,8 @@ static int cmp_idx_or_pack_name(const char *idx_or_pack_name,
 	return strcmp(idx_or_pack_name, idx_name);
 }
 
-int midx_contains_pack(struct multi_pack_index *m, const char *idx_or_pack_name)
+static int midx_layer_contains_pack(struct multi_pack_index *m,
+				    const char *idx_or_pack_name)
 {
 	uint32_t first = 0, last = m->num_packs;
 
@@ -374,6 +525,14 @@ int midx_contains_pack(struct multi_pack_index *m, const char *idx_or_pack_name)
 	return 0;
 }
 
+int midx_contains_pack(struct multi_pack_index *m, const char *idx_or_pack_name)
+{
+	for (; m; m = m->base_midx)
+		if (midx_layer_contains_pack(m, idx_or_pack_name))
+			return 1;
+	return 0;
+}
+
 int prepare_multi_pack_index_one(struct repository *r, const char *object_dir, int local)
 {
 	struct multi_pack_index *m;
@@ -392,7 +551,12 @@ int prepare_multi_pack_index_one(struct repository *r, const char *object_dir, i
 	if (m) {
 		struct multi_pack_index *mp = r->objects->multi_pack_index;
 		if (mp) {
-			m->next = mp->next;
+			struct multi_pack_index *last = m;
+
+			/* the layers of a chain all go in, tip first */
+			while (last->next)
+				last = last->next;
+			last->next = mp->next;
 			mp->next = m;
 		} else
 			r->objects->multi_pack_index = m;
@@ -404,13 +568,14 @@ int prepare_multi_pack_index_one(struct repository *r, const char *object_dir, i
 
 static size_t write_midx_header(struct hashfile *f,
 				unsigned char num_chunks,
+				unsigned char num_bases,
 				uint32_t num_packs)
 {
 	hashwrite_be32(f, MIDX_SIGNATURE);
 	hashwrite_u8(f, MIDX_VERSION);
 	hashwrite_u8(f, oid_version(the_hash_algo));
 	hashwrite_u8(f, num_chunks);
-	hashwrite_u8(f, 0); /* unused */
+	hashwrite_u8(f, num_bases);
 	hashwrite_be32(f, num_packs);
 
 	return MIDX_HEADER_SIZE;
@@ -443,6 +608,8 @@ struct write_midx_context {
 	uint32_t nr;
 	uint32_t alloc;
 	struct multi_pack_index *m;
+	struct multi_pack_index *base_midx;
+	uint32_t num_bases;
 	struct progress *progress;
 	unsigned pack_paths_checked;
 
@@ -483,6 +650,9 @@ static void add_pack_to_midx(const char *full_path, size_t full_path_len,
 		 */
 		if (ctx->m && midx_contains_pack(ctx->m, file_name))
 			return;
+		else if (ctx->base_midx &&
+			 midx_contains_pack(ctx->base_midx, file_name))
+			return;
 		else if (ctx->to_include &&
 			 !string_list_has_string(ctx->to_include, file_name))
 			return;
@@ -728,6 +898,28 @@ static struct pack_midx_entry *get_sorted_entries(struct multi_pack_index *m,
 	return deduplicated_entries;
 }
 
+/*
+ * Drop the objects which a layer of an incremental MIDX chain already
+ * has from the entries of the layer being written on top of it.
+ */
+static void remove_objects_in_base(struct write_midx_context *ctx)
+{
+	uint32_t i, nr = 0;
+
+	for (i = 0; i < ctx->entries_nr; i++) {
+		struct multi_pack_index *m;
+
+		for (m = ctx->base_midx; m; m = m->base_midx)
+			if (bsearch_midx(&ctx->entries[i].oid, m, NULL))
+				break;
+		if (m)
+			continue;
+
+		ctx->entries[nr++] = ctx->entries[i];
+	}
+	ctx->entries_nr = nr;
+}
+
 static int write_midx_pack_names(struct hashfile *f, void *data)
 {
 	struct write_midx_context *ctx = data;
@@ -886,6 +1078,36 @@ static int write_midx_revindex(struct hashfile *f,
 	return 0;
 }
 
+/* Write the checksums of 'm' and the layers below it, bottom first. */
+static void write_midx_layer_hashes(struct hashfile *f,
+				    struct multi_pack_index *m)
+{
+	if (!m)
+		return;
+	write_midx_layer_hashes(f, m->base_midx);
+	hashwrite(f, get_midx_checksum(m), m->hash_len);
+}
+
+static int write_midx_base_midxs(struct hashfile *f,
+				 void *data)
+{
+	struct write_midx_context *ctx = data;
+
+	write_midx_layer_hashes(f, ctx->base_midx);
+
+	return 0;
+}
+
+/* Append the hex checksums of 'm' and the layers below it, bottom first. */
+static void get_midx_chain_hashes(struct string_list *out,
+				  struct multi_pack_index *m)
+{
+	if (!m)
+		return;
+	get_midx_chain_hashes(out, m->base_midx);
+	string_list_append(out, hash_to_hex(get_midx_checksum(m)));
+}
+
 struct midx_pack_order_data {
 	uint32_t nr;
 	uint32_t pack;
@@ -952,6 +1174,39 @@ static void write_midx_reverse_index(char *midx_name, unsigned char *midx_hash,
 
 static void clear_midx_files_ext(const char *object_dir, const char *ext,
 				 unsigned char *keep_hash);
+static void clear_incremental_midx_files_ext(const char *object_dir,
+					     const char *ext,
+					     struct string_list *keep_hashes);
+static void clear_incremental_midx_files(const char *object_dir);
+
+/*
+ * When writing a new layer of the packs in "packs_to_include" (if any) on
+ * top of the chain "m", the layers that index a pack which is not
+ * included anymore have to be rewritten, together with all the layers
+ * above them. Return the topmost layer that can stay, or NULL if the
+ * whole chain has to be rewritten.
+ */
+static struct multi_pack_index *midx_included_base(struct multi_pack_index *m,
+						   struct string_list *packs_to_include)
+{
+	struct multi_pack_index *base = m;
+
+	if (!packs_to_include)
+		return m;
+
+	for (; m; m = m->base_midx) {
+		uint32_t i;
+
+		for (i = 0; i < m->num_packs; i++)
+			if (!string_list_has_string(packs_to_include,
+						    m->pack_names[i]))
+				break;
+		if (i < m->num_packs)
+			base = m->base_midx;
+	}
+
+	return base;
+}
 
 static int midx_checksum_valid(struct multi_pack_index *m)
 {
@@ -1108,6 +1363,7 @@ static int write_midx_bitmap(const char *midx_name,
 			     struct commit **commits,
 			     uint32_t commits_nr,
 			     uint32_t *pack_order,
+			     struct multi_pack_index *base_midx,
 			     unsigned flags)
 {
 	int ret, i;
@@ -1116,6 +1372,17 @@ static int write_midx_bitmap(const char *midx_name,
 	char *bitmap_name = xstrfmt("%s-%s.bitmap", midx_name,
 					hash_to_hex(midx_hash));
 
+	if (base_midx) {
+		struct bitmap_index *base = prepare_midx_bitmap_git(base_midx);
+		if (!base) {
+			error(_("cannot write an incremental bitmap without one for its base"));
+			free(bitmap_name);
+			return -1;
+		}
+		bitmap_writer_set_base(base, base_midx->num_objects_in_base +
+					     base_midx->num_objects);
+	}
+
 	if (flags & MIDX_WRITE_BITMAP_HASH_CACHE)
 		options |= BITMAP_OPT_HASH_CACHE;
 
@@ -1132,6 +1399,7 @@ static int write_midx_bitmap(const char *midx_name,
 		index[i] = &pdata->objects[i].idx;
 
 	bitmap_writer_show_progress(flags & MIDX_PROGRESS);
+	bitmap_writer_set_version(flags & MIDX_WRITE_BITMAP_ROARING ? 2 : 1);
 	bitmap_writer_build_type_index(pdata, index, pdata->nr_objects);
 
 	/*
@@ -1189,6 +1457,47 @@ static struct multi_pack_index *lookup_multi_pack_index(struct repository *r,
 	return result;
 }
 
+static void hold_midx_chain_lock(struct lock_file *lk, const char *object_dir)
+{
+	struct strbuf name = STRBUF_INIT;
+
+	get_midx_chain_filename(&name, object_dir);
+	hold_lock_file_for_update(lk, name.buf, LOCK_DIE_ON_ERROR);
+	strbuf_release(&name);
+}
+
+/*
+ * Write the layers "chain" (as hex checksums, bottom first) to the chain
+ * file locked by "lk", and remove the files of all other layers.
+ */
+static void write_midx_chain(struct lock_file *lk, const char *object_dir,
+			     struct string_list *chain)
+{
+	struct strbuf single = STRBUF_INIT;
+	int fd = get_lock_file_fd(lk);
+	size_t i;
+
+	for (i = 0; i < chain->nr; i++)
+		if (write_in_full(fd, chain->items[i].string,
+				  strlen(chain->items[i].string)) < 0 ||
+		    write_in_full(fd, "\n", 1) < 0)
+			die_errno(_("could not write multi-pack-index chain"));
+
+	if (commit_lock_file(lk) < 0)
+		die_errno(_("could not write multi-pack-index"));
+
+	/* a single MIDX would hide the chain; it is covered anyway */
+	get_midx_filename(&single, object_dir);
+	unlink_or_warn(single.buf);
+	strbuf_release(&single);
+
+	clear_midx_files_ext(object_dir, ".bitmap", NULL);
+	clear_midx_files_ext(object_dir, ".rev", NULL);
+	clear_incremental_midx_files_ext(object_dir, ".midx", chain);
+	clear_incremental_midx_files_ext(object_dir, ".bitmap", chain);
+	clear_incremental_midx_files_ext(object_dir, ".rev", chain);
+}
+
 static int write_midx_internal(const char *object_dir,
 			       struct string_list *packs_to_include,
 			       struct string_list *packs_to_drop,
@@ -1206,17 +1515,30 @@ static int write_midx_internal(const char *object_dir,
 	int dropped_packs = 0;
 	int result = 0;
 	struct chunkfile *cf;
-
-	get_midx_filename(&midx_name, object_dir);
+	struct tempfile *incr = NULL;
+	struct string_list chain = STRING_LIST_INIT_DUP;
+	int close_store = 0;
+	int replaced_layers = 0;
+
+	if (flags & MIDX_WRITE_INCREMENTAL) {
+		if (packs_to_drop)
+			BUG("cannot expire packs from an incremental MIDX");
+		/* the name of a layer and its files goes on from here */
+		get_midx_chain_dirname(&midx_name, object_dir);
+		strbuf_addstr(&midx_name, "/multi-pack-index");
+	} else
+		get_midx_filename(&midx_name, object_dir);
 	if (safe_create_leading_directories(midx_name.buf))
 		die_errno(_("unable to create leading directories of %s"),
 			  midx_name.buf);
 
-	if (!packs_to_include) {
+	if (!packs_to_include || (flags & MIDX_WRITE_INCREMENTAL)) {
 		/*
 		 * Only reference an existing MIDX when not filtering which
 		 * packs to include, since all packs and objects are copied
-		 * blindly from an existing MIDX if one is present.
+		 * blindly from an existing MIDX if one is present. A chain
+		 * is the exception: its layers are kept as they are, see
+		 * midx_included_base().
 		 */
 		ctx.m = lookup_multi_pack_index(the_repository, object_dir);
 	}
@@ -1226,6 +1548,44 @@ static int write_midx_internal(const char *object_dir,
 		ctx.m = NULL;
 	}
 
+	if (ctx.m && ctx.m->incremental) {
+		/*
+		 * Nothing is copied from an existing chain: a new layer
+		 * only indexes the packs which are not in it yet, while
+		 * writing a single MIDX in its place indexes all packs
+		 * again.
+		 */
+		if (flags & MIDX_WRITE_INCREMENTAL) {
+			ctx.base_midx = midx_included_base(ctx.m,
+							   packs_to_include);
+			if (ctx.base_midx != ctx.m)
+				replaced_layers = 1;
+		} else
+			close_store = 1;
+		ctx.m = NULL;
+	}
+	if (ctx.m && packs_to_include) {
+		/*
+		 * Replace a single MIDX by the first layer of a new chain
+		 * with only the given packs.
+		 */
+		ctx.m = NULL;
+	}
+	if (ctx.m)
+		close_store = 1;
+
+	if (ctx.base_midx) {
+		struct multi_pack_index *b;
+
+		for (b = ctx.base_midx; b; b = b->base_midx)
+			ctx.num_bases++;
+		if (ctx.num_bases > UCHAR_MAX) {
+			error(_("too many multi-pack-index layers"));
+			result = 1;
+			goto cleanup;
+		}
+	}
+
 	ctx.nr = 0;
 	ctx.alloc = ctx.m ? ctx.m->num_packs : 16;
 	ctx.info = NULL;
@@ -1295,6 +1655,11 @@ static int write_midx_internal(const char *object_dir,
 		}
 	}
 
+	if (ctx.base_midx && !ctx.nr && !replaced_layers) {
+		/* All packs are in the chain already; no layer to add. */
+		goto cleanup;
+	}
+
 	if (preferred_pack_name) {
 		int found = 0;
 		for (i = 0; i < ctx.nr; i++) {
@@ -1361,6 +1726,25 @@ static int write_midx_internal(const char *object_dir,
 
 	ctx.entries = get_sorted_entries(ctx.m, ctx.info, ctx.nr, &ctx.entries_nr,
 					 ctx.preferred_pack_idx);
+	if (ctx.base_midx) {
+		remove_objects_in_base(&ctx);
+
+		if (!ctx.entries_nr) {
+			/*
+			 * The new packs only hold objects which the chain
+			 * has already. A layer without objects cannot have
+			 * a bitmap, and then no layer above it could get
+			 * one either, so do not add it; only drop the
+			 * layers it was going to replace, if any.
+			 */
+			if (replaced_layers) {
+				hold_midx_chain_lock(&lk, object_dir);
+				get_midx_chain_hashes(&chain, ctx.base_midx);
+				write_midx_chain(&lk, object_dir, &chain);
+			}
+			goto cleanup;
+		}
+	}
 
 	ctx.large_offsets_needed = 0;
 	for (i = 0; i < ctx.entries_nr; i++) {
@@ -1439,8 +1823,27 @@ static int write_midx_internal(const char *object_dir,
 		pack_name_concat_len += MIDX_CHUNK_ALIGNMENT -
 					(pack_name_concat_len % MIDX_CHUNK_ALIGNMENT);
 
-	hold_lock_file_for_update(&lk, midx_name.buf, LOCK_DIE_ON_ERROR);
-	f = hashfd(get_lock_file_fd(&lk), get_lock_file_path(&lk));
+	if (flags & MIDX_WRITE_INCREMENTAL) {
+		struct strbuf name = STRBUF_INIT;
+
+		/*
+		 * The layer is named after its checksum, so it is written
+		 * to a temporary file first; the lock is on the chain.
+		 */
+		hold_midx_chain_lock(&lk, object_dir);
+
+		get_midx_chain_dirname(&name, object_dir);
+		strbuf_addstr(&name, "/tmp_midx_XXXXXX");
+		incr = mks_tempfile_m(name.buf, 0444);
+		if (!incr)
+			die_errno(_("unable to create temporary multi-pack-index layer"));
+		strbuf_release(&name);
+
+		f = hashfd(get_tempfile_fd(incr), get_tempfile_path(incr));
+	} else {
+		hold_lock_file_for_update(&lk, midx_name.buf, LOCK_DIE_ON_ERROR);
+		f = hashfd(get_lock_file_fd(&lk), get_lock_file_path(&lk));
+	}
 
 	if (ctx.nr - dropped_packs == 0) {
 		error(_("no pack files to index."));
@@ -1479,7 +1882,13 @@ static int write_midx_internal(const char *object_dir,
 			  write_midx_revindex);
 	}
 
-	write_midx_header(f, get_num_chunks(cf), ctx.nr - dropped_packs);
+	if (ctx.num_bases)
+		add_chunk(cf, MIDX_CHUNKID_BASEMIDXS,
+			  (size_t)ctx.num_bases * the_hash_algo->rawsz,
+			  write_midx_base_midxs);
+
+	write_midx_header(f, get_num_chunks(cf), ctx.num_bases,
+			  ctx.nr - dropped_packs);
 	write_chunkfile(cf, &ctx);
 
 	finalize_hashfile(f, midx_hash, FSYNC_COMPONENT_PACK_METADATA,
@@ -1513,7 +1922,7 @@ static int write_midx_internal(const char *object_dir,
 
 		if (write_midx_bitmap(midx_name.buf, midx_hash, &pdata,
 				      commits, commits_nr, ctx.pack_order,
-				      flags) < 0) {
+				      ctx.base_midx, flags) < 0) {
 			error(_("could not write multi-pack bitmap"));
 			result = 1;
 			goto cleanup;
@@ -1524,14 +1933,35 @@ static int write_midx_internal(const char *object_dir,
 	 * have been freed in the previous if block.
 	 */
 
-	if (ctx.m)
+	if (close_store)
 		close_object_store(the_repository->objects);
 
-	if (commit_lock_file(&lk) < 0)
-		die_errno(_("could not write multi-pack-index"));
+	if (flags & MIDX_WRITE_INCREMENTAL) {
+		struct strbuf layer_name = STRBUF_INIT;
 
-	clear_midx_files_ext(object_dir, ".bitmap", midx_hash);
-	clear_midx_files_ext(object_dir, ".rev", midx_hash);
+		/*
+		 * The layer only goes in place once its bitmap (if any)
+		 * has been written, so that a failure does not leave it
+		 * behind outside of the chain.
+		 */
+		get_split_midx_filename_ext(&layer_name, object_dir,
+					    midx_hash, "midx");
+		if (rename_tempfile(&incr, layer_name.buf) < 0)
+			die_errno(_("unable to rename new multi-pack-index layer to '%s'"),
+				  layer_name.buf);
+		strbuf_release(&layer_name);
+
+		get_midx_chain_hashes(&chain, ctx.base_midx);
+		string_list_append(&chain, hash_to_hex(midx_hash));
+		write_midx_chain(&lk, object_dir, &chain);
+	} else {
+		if (commit_lock_file(&lk) < 0)
+			die_errno(_("could not write multi-pack-index"));
+
+		clear_midx_files_ext(object_dir, ".bitmap", midx_hash);
+		clear_midx_files_ext(object_dir, ".rev", midx_hash);
+		clear_incremental_midx_files(object_dir);
+	}
 
 cleanup:
 	for (i = 0; i < ctx.nr; i++) {
@@ -1547,6 +1977,8 @@ static int write_midx_internal(const char *object_dir,
 	free(ctx.pack_perm);
 	free(ctx.pack_order);
 	strbuf_release(&midx_name);
+	string_list_clear(&chain, 0);
+	delete_tempfile(&incr);
 
 	return result;
 }
@@ -1608,6 +2040,68 @@ static void clear_midx_files_ext(const char *object_dir, const char *ext,
 	free(data.keep);
 }
 
+static void clear_incremental_midx_files_ext(const char *object_dir,
+					     const char *ext,
+					     struct string_list *keep_hashes)
+{
+	struct strbuf path = STRBUF_INIT;
+	struct strbuf hex = STRBUF_INIT;
+	size_t dirlen;
+	DIR *dir;
+	struct dirent *de;
+
+	get_midx_chain_dirname(&path, object_dir);
+	dir = opendir(path.buf);
+	if (!dir) {
+		strbuf_release(&path);
+		return;
+	}
+	strbuf_addch(&path, '/');
+	dirlen = path.len;
+
+	while ((de = readdir_skip_dot_and_dotdot(dir))) {
+		const char *rest;
+		size_t len;
+
+		if (!skip_prefix(de->d_name, "multi-pack-index-", &rest) ||
+		    !strip_suffix(rest, ext, &len))
+			continue;
+
+		strbuf_reset(&hex);
+		strbuf_add(&hex, rest, len);
+		if (keep_hashes &&
+		    unsorted_string_list_has_string(keep_hashes, hex.buf))
+			continue;
+
+		strbuf_setlen(&path, dirlen);
+		strbuf_addstr(&path, de->d_name);
+		if (unlink(path.buf))
+			die_errno(_("failed to remove %s"), path.buf);
+	}
+
+	closedir(dir);
+	strbuf_release(&path);
+	strbuf_release(&hex);
+}
+
+static void clear_incremental_midx_files(const char *object_dir)
+{
+	struct strbuf path = STRBUF_INIT;
+
+	clear_incremental_midx_files_ext(object_dir, ".midx", NULL);
+	clear_incremental_midx_files_ext(object_dir, ".bitmap", NULL);
+	clear_incremental_midx_files_ext(object_dir, ".rev", NULL);
+
+	get_midx_chain_filename(&path, object_dir);
+	unlink_or_warn(path.buf);
+
+	strbuf_reset(&path);
+	get_midx_chain_dirname(&path, object_dir);
+	rmdir(path.buf);
+
+	strbuf_release(&path);
+}
+
 void clear_midx_file(struct repository *r)
 {
 	struct strbuf midx = STRBUF_INIT;
@@ -1624,6 +2118,7 @@ void clear_midx_file(struct repository *r)
 
 	clear_midx_files_ext(r->objects->odb->path, ".bitmap", NULL);
 	clear_midx_files_ext(r->objects->odb->path, ".rev", NULL);
+	clear_incremental_midx_files(r->objects->odb->path);
 
 	strbuf_release(&midx);
 }
@@ -1667,28 +2162,12 @@ static int compare_pair_pos_vs_id(const void *_a, const void *_b)
 			display_progress(progress, _n); \
 	} while (0)
 
-int verify_midx_file(struct repository *r, const char *object_dir, unsigned flags)
+static void verify_midx_layer(struct repository *r, struct multi_pack_index *m,
+			      unsigned flags)
 {
 	struct pair_pos_vs_id *pairs = NULL;
 	uint32_t i;
 	struct progress *progress = NULL;
-	struct multi_pack_index *m = load_multi_pack_index(object_dir, 1);
-	verify_midx_error = 0;
-
-	if (!m) {
-		int result = 0;
-		struct stat sb;
-		struct strbuf filename = STRBUF_INIT;
-
-		get_midx_filename(&filename, object_dir);
-
-		if (!stat(filename.buf, &sb)) {
-			error(_("multi-pack-index file exists, but failed to parse"));
-			result = 1;
-		}
-		strbuf_release(&filename);
-		return result;
-	}
 
 	if (!midx_checksum_valid(m))
 		midx_report(_("incorrect checksum"));
@@ -1714,7 +2193,9 @@ int verify_midx_file(struct repository *r, const char *object_dir, unsigned flag
 	}
 
 	if (m->num_objects == 0) {
-		midx_report(_("the midx contains no oid"));
+		/* a layer may have nothing that the ones below lack */
+		if (!m->num_bases)
+			midx_report(_("the midx contains no oid"));
 		/*
 		 * Remaining tests assume that we have objects, so we can
 		 * return here.
@@ -1799,6 +2280,40 @@ int verify_midx_file(struct repository *r, const char *object_dir, unsigned flag
 
 cleanup:
 	free(pairs);
+}
+
+
+int verify_midx_file(struct repository *r, const char *object_dir, unsigned flags)
+{
+	struct multi_pack_index *m = load_multi_pack_index(object_dir, 1);
+	struct multi_pack_index *layer;
+	verify_midx_error = 0;
+
+	if (!m) {
+		int result = 0;
+		struct stat sb;
+		struct strbuf filename = STRBUF_INIT;
+
+		get_midx_filename(&filename, object_dir);
+
+		if (!stat(filename.buf, &sb)) {
+			error(_("multi-pack-index file exists, but failed to parse"));
+			result = 1;
+		}
+
+		strbuf_reset(&filename);
+		get_midx_chain_filename(&filename, object_dir);
+		if (!result && !stat(filename.buf, &sb)) {
+			error(_("multi-pack-index chain exists, but failed to parse"));
+			result = 1;
+		}
+		strbuf_release(&filename);
+		return result;
+	}
+
+	for (layer = m; layer; layer = layer->base_midx)
+		verify_midx_layer(r, layer, flags);
+
 	close_midx(m);
 
 	return verify_midx_error;
@@ -1814,6 +2329,9 @@ int expire_midx_packs(struct repository *r, const char *object_dir, unsigned fla
 	if (!m)
 		return 0;
 
+	if (m->incremental)
+		return error(_("cannot expire packs from an incremental multi-pack-index"));
+
 	CALLOC_ARRAY(count, m->num_packs);
 
 	if (flags & MIDX_PROGRESS)
@@ -1992,6 +2510,9 @@ int midx_repack(struct repository *r, const char *object_dir, size_t batch_size,
 	if (!m)
 		return 0;
 
+	if (m->incremental)
+		return error(_("cannot repack an incremental multi-pack-index"));
+
 	CALLOC_ARRAY(include_pack, m->num_packs);
 
 	if (batch_size) {
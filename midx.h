@@ -26,17 +26,29 @@ struct multi_pack_index {
 	unsigned char version;
 	unsigned char hash_len;
 	unsigned char num_chunks;
+	unsigned char num_bases;
 	uint32_t num_packs;
 	uint32_t num_objects;
 
 	int local;
 
+	/*
+	 * Set for the layers of an incremental multi-pack-index chain;
+	 * each layer only indexes objects which are not in any layer
+	 * below it, and 'base_midx' points to the layer just below
+	 * (which is also 'next').
+	 */
+	unsigned incremental : 1;
+	struct multi_pack_index *base_midx;
+	uint32_t num_objects_in_base;
+
 	const unsigned char *chunk_pack_names;
 	const uint32_t *chunk_oid_fanout;
 	const unsigned char *chunk_oid_lookup;
 	const unsigned char *chunk_object_offsets;
 	const unsigned char *chunk_large_offsets;
 	const unsigned char *chunk_revindex;
+	const unsigned char *chunk_base_midxs;
 
 	const char **pack_names;
 	struct packed_git **packs;
@@ -48,10 +60,16 @@ struct multi_pack_index {
 #define MIDX_WRITE_BITMAP (1 << 2)
 #define MIDX_WRITE_BITMAP_HASH_CACHE (1 << 3)
 #define MIDX_WRITE_BITMAP_LOOKUP_TABLE (1 << 4)
+#define MIDX_WRITE_INCREMENTAL (1 << 5)
+#define MIDX_WRITE_BITMAP_ROARING (1 << 6)
 
 const unsigned char *get_midx_checksum(struct multi_pack_index *m);
 void get_midx_filename(struct strbuf *out, const char *object_dir);
 void get_midx_rev_filename(struct strbuf *out, struct multi_pack_index *m);
+void get_midx_chain_dirname(struct strbuf *out, const char *object_dir);
+void get_midx_chain_filename(struct strbuf *out, const char *object_dir);
+void get_split_midx_filename_ext(struct strbuf *out, const char *object_dir,
+				 const unsigned char *hash, const char *ext);
 
 struct multi_pack_index *load_multi_pack_index(const char *object_dir, int local);
 int prepare_midx_pack(struct repository *r, struct multi_pack_index *m, uint32_t pack_int_id);
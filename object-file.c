@@ -81,8 +81,35 @@ static const struct object_id null_oid_sha256 = {
 	.algo = GIT_HASH_SHA256,
 };
 
+static const struct git_hash_backend *hash_backends_used[GIT_HASH_NALGOS];
+
+void hash_algo_use_backend(const struct git_hash_algo *algop,
+			   const struct git_hash_backend *backend)
+{
+	hash_backends_used[hash_algo_by_ptr(algop)] = backend;
+	algop->use_backend_fn(backend);
+}
+
+/* Pick the fastest backend the first time a hash is computed. */
+static void prepare_hash_backend(int algo)
+{
+	const struct git_hash_algo *algop = &hash_algos[algo];
+	const struct git_hash_backend *b;
+
+	if (hash_backends_used[algo] || !algop->backends)
+		return;
+
+	for (b = algop->backends; b->name; b++)
+		if (b->supported())
+			break;
+	if (!b->name)
+		BUG("no supported %s backend", algop->name);
+	hash_algo_use_backend(algop, b);
+}
+
 static void git_hash_sha1_init(git_hash_ctx *ctx)
 {
+	prepare_hash_backend(GIT_HASH_SHA1);
 	git_SHA1_Init(&ctx->sha1);
 }
 
@@ -111,6 +138,7 @@ static void git_hash_sha1_final_oid(struct object_id *oid, git_hash_ctx *ctx)
 
 static void git_hash_sha256_init(git_hash_ctx *ctx)
 {
+	prepare_hash_backend(GIT_HASH_SHA256);
 	git_SHA256_Init(&ctx->sha256);
 }
 
@@ -195,6 +223,10 @@ const struct git_hash_algo hash_algos[GIT_HASH_NALGOS] = {
 		.empty_tree = &empty_tree_oid,
 		.empty_blob = &empty_blob_oid,
 		.null_oid = &null_oid_sha1,
+#ifdef platform_SHA1_backends
+		.backends = platform_SHA1_backends,
+		.use_backend_fn = platform_SHA1_use_backend,
+#endif
 	},
 	{
 		.name = "sha256",
@@ -210,6 +242,10 @@ const struct git_hash_algo hash_algos[GIT_HASH_NALGOS] = {
 		.empty_tree = &empty_tree_oid_sha256,
 		.empty_blob = &empty_blob_oid_sha256,
 		.null_oid = &null_oid_sha256,
+#ifdef platform_SHA256_backends
+		.backends = platform_SHA256_backends,
+		.use_backend_fn = platform_SHA256_use_backend,
+#endif
 	}
 };
 
@@ -1577,6 +1613,14 @@ static int do_oid_object_info_extended(struct repository *r,
 		if (!loose_object_info(r, real, oi, flags))
 			return 0;
 
+		/* It may have been added in an unfinished ODB transaction. */
+		if (r == the_repository) {
+			if (!read_object_bulk_checkin(real, oi))
+				return 0;
+			if (wait_object_bulk_checkin())
+				continue;
+		}
+
 		/* Not a loose object; someone else may have just packed it. */
 		if (!(flags & OBJECT_INFO_QUICK)) {
 			reprepare_packed_git(r);
@@ -2037,24 +2081,21 @@ static int end_loose_object_common(git_hash_ctx *c, git_zstream *stream,
 	return Z_OK;
 }
 
-static int write_loose_object(const struct object_id *oid, char *hdr,
-			      int hdrlen, const void *buf, unsigned long len,
-			      time_t mtime, unsigned flags)
+static int write_loose_object_1(const struct object_id *oid, char *hdr,
+				int hdrlen, const void *buf, unsigned long len,
+				time_t mtime, unsigned flags,
+				struct strbuf *tmp_file, struct strbuf *filename)
 {
 	int fd, ret;
 	unsigned char compressed[4096];
 	git_zstream stream;
 	git_hash_ctx c;
 	struct object_id parano_oid;
-	static struct strbuf tmp_file = STRBUF_INIT;
-	static struct strbuf filename = STRBUF_INIT;
-
-	if (batch_fsync_enabled(FSYNC_COMPONENT_LOOSE_OBJECT))
-		prepare_loose_object_bulk_checkin();
+	char hex[GIT_MAX_HEXSZ + 1];
 
-	loose_object_path(the_repository, &filename, oid);
+	loose_object_path(the_repository, filename, oid);
 
-	fd = start_loose_object_common(&tmp_file, filename.buf, flags,
+	fd = start_loose_object_common(tmp_file, filename->buf, flags,
 				       &stream, compressed, sizeof(compressed),
 				       &c, hdr, hdrlen);
 	if (fd < 0)
@@ -2070,29 +2111,59 @@ static int write_loose_object(const struct object_id *oid, char *hdr,
 						compressed, sizeof(compressed));
 	} while (ret == Z_OK);
 
+	/* This may run in a bulk-checkin worker thread. */
 	if (ret != Z_STREAM_END)
-		die(_("unable to deflate new object %s (%d)"), oid_to_hex(oid),
-		    ret);
+		die(_("unable to deflate new object %s (%d)"),
+		    oid_to_hex_r(hex, oid), ret);
 	ret = end_loose_object_common(&c, &stream, &parano_oid);
 	if (ret != Z_OK)
-		die(_("deflateEnd on object %s failed (%d)"), oid_to_hex(oid),
-		    ret);
+		die(_("deflateEnd on object %s failed (%d)"),
+		    oid_to_hex_r(hex, oid), ret);
 	if (!oideq(oid, &parano_oid))
 		die(_("confused by unstable object source data for %s"),
-		    oid_to_hex(oid));
+		    oid_to_hex_r(hex, oid));
 
-	close_loose_object(fd, tmp_file.buf);
+	close_loose_object(fd, tmp_file->buf);
 
 	if (mtime) {
 		struct utimbuf utb;
 		utb.actime = mtime;
 		utb.modtime = mtime;
-		if (utime(tmp_file.buf, &utb) < 0 &&
+		if (utime(tmp_file->buf, &utb) < 0 &&
 		    !(flags & HASH_SILENT))
-			warning_errno(_("failed utime() on %s"), tmp_file.buf);
+			warning_errno(_("failed utime() on %s"), tmp_file->buf);
 	}
 
-	return finalize_object_file(tmp_file.buf, filename.buf);
+	return finalize_object_file(tmp_file->buf, filename->buf);
+}
+
+static int write_loose_object(const struct object_id *oid, char *hdr,
+			      int hdrlen, const void *buf, unsigned long len,
+			      time_t mtime, unsigned flags)
+{
+	static struct strbuf tmp_file = STRBUF_INIT;
+	static struct strbuf filename = STRBUF_INIT;
+
+	if (batch_fsync_enabled(FSYNC_COMPONENT_LOOSE_OBJECT))
+		prepare_loose_object_bulk_checkin();
+
+	return write_loose_object_1(oid, hdr, hdrlen, buf, len, mtime, flags,
+				    &tmp_file, &filename);
+}
+
+int write_loose_object_reentrant(const struct object_id *oid, char *hdr,
+				 int hdrlen, const void *buf,
+				 unsigned long len, unsigned flags)
+{
+	struct strbuf tmp_file = STRBUF_INIT;
+	struct strbuf filename = STRBUF_INIT;
+	int ret;
+
+	ret = write_loose_object_1(oid, hdr, hdrlen, buf, len, 0, flags,
+				   &tmp_file, &filename);
+	strbuf_release(&tmp_file);
+	strbuf_release(&filename);
+	return ret;
 }
 
 static int freshen_loose_object(const struct object_id *oid)
@@ -2233,6 +2304,13 @@ int write_object_file_flags(const void *buf, unsigned long len,
 				  &hdrlen);
 	if (freshen_packed_object(oid) || freshen_loose_object(oid))
 		return 0;
+	if (type == OBJ_BLOB && use_bulk_checkin_pack()) {
+		write_object_bulk_checkin(oid, buf, len, type);
+		return 0;
+	}
+	if (type == OBJ_BLOB &&
+	    !queue_loose_object_bulk_checkin(oid, hdr, hdrlen, buf, len, flags))
+		return 0;
 	return write_loose_object(oid, hdr, hdrlen, buf, len, 0, flags);
 }
 
@@ -2484,7 +2562,9 @@ int index_fd(struct index_state *istate, struct object_id *oid,
 		ret = index_stream_convert_blob(istate, oid, fd, path, flags);
 	else if (!S_ISREG(st->st_mode))
 		ret = index_pipe(istate, oid, fd, type, path, flags);
-	else if (st->st_size <= big_file_threshold || type != OBJ_BLOB ||
+	else if ((st->st_size <= big_file_threshold &&
+		  !use_bulk_checkin_pack()) ||
+		 type != OBJ_BLOB ||
 		 (path && would_convert_to_git(istate, path)))
 		ret = index_core(istate, oid, fd, xsize_t(st->st_size),
 				 type, path, flags);
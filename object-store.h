@@ -278,6 +278,15 @@ int write_object_file_literally(const void *buf, unsigned long len,
 int stream_loose_object(struct input_stream *in_stream, size_t len,
 			struct object_id *oid);
 
+/*
+ * Write the loose object "oid" whose header and contents have already
+ * been prepared, without touching any global state. Used to write
+ * objects from the worker threads of an ODB transaction.
+ */
+int write_loose_object_reentrant(const struct object_id *oid, char *hdr,
+				 int hdrlen, const void *buf,
+				 unsigned long len, unsigned flags);
+
 /*
  * Add an object file to the in-memory object store, without writing it
  * to disk.
@@ -19,6 +19,9 @@ int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
 	 */
 	the_repository->settings.commit_graph_generation_version = 2;
 	the_repository->settings.commit_graph_read_changed_paths = 1;
+	the_repository->settings.commit_graph_read_reachability_index = 1;
+	the_repository->settings.commit_graph_read_first_parent_skips = 1;
+	the_repository->settings.commit_graph_read_idents = 1;
 	g = parse_commit_graph(&the_repository->settings, (void *)data, size);
 	repo_clear(the_repository);
 	free_commit_graph(g);
@@ -0,0 +1,460 @@
+#include "cache.h"
+#include "config.h"
+#include "dir.h"
+#include "lockfile.h"
+#include "object-store.h"
+#include "packfile.h"
+#include "pack-base-cache.h"
+#include "trace2.h"
+
+#define PACK_BASE_CACHE_DIR "info/delta-base-cache"
+#define PACK_BASE_CACHE_HEADER_SIZE 16
+#define PACK_BASE_CACHE_TRAILER_SIZE 4
+#define PACK_BASE_CACHE_TMP_PREFIX "tmp_dbc_"
+#define PACK_BASE_CACHE_SIZE_FILE "size"
+
+/*
+ * Bases that took fewer deltas than this to reconstruct are cheap
+ * enough to reconstruct again.
+ */
+#define PACK_BASE_CACHE_MIN_DEPTH 4
+
+/* Leftover temporary files older than this (in seconds) are removed. */
+#define PACK_BASE_CACHE_TMP_EXPIRY (60 * 60)
+
+/* Refresh the mtime of an entry on a hit if it is older than this. */
+#define PACK_BASE_CACHE_TOUCH_INTERVAL 60
+
+static struct {
+	intmax_t hit;
+	intmax_t miss;
+	intmax_t write;
+	intmax_t full;
+	intmax_t evict;
+	intmax_t corrupt;
+} stats;
+
+static int pack_base_cache_enabled(struct repository *r)
+{
+	if (!r->gitdir)
+		return 0;
+	prepare_repo_settings(r);
+	return r->settings.pack_base_cache;
+}
+
+static int pack_base_cache_usable(struct repository *r, struct packed_git *p)
+{
+	/* Packs that are not named after their contents cannot be keyed. */
+	return pack_base_cache_enabled(r) && !hasheq(p->hash, null_oid()->hash);
+}
+
+static void pack_base_cache_dir(struct strbuf *buf, struct repository *r)
+{
+	strbuf_addf(buf, "%s/" PACK_BASE_CACHE_DIR, r->objects->odb->path);
+}
+
+/*
+ * The total size of the entries is kept in PACK_BASE_CACHE_SIZE_FILE,
+ * so that writers can stay within the limit without scanning the whole
+ * cache. It is only updated under its lock, which writers take for
+ * the whole write, and which pack_base_cache_sweep() takes to correct
+ * it.
+ */
+static void pack_base_cache_size_path(struct strbuf *buf, struct repository *r)
+{
+	pack_base_cache_dir(buf, r);
+	strbuf_addstr(buf, "/" PACK_BASE_CACHE_SIZE_FILE);
+}
+
+static uintmax_t read_cache_size(const char *path)
+{
+	struct strbuf buf = STRBUF_INIT;
+	uintmax_t size = 0;
+
+	if (strbuf_read_file(&buf, path, 0) > 0)
+		size = strtoumax(buf.buf, NULL, 10);
+	strbuf_release(&buf);
+	return size;
+}
+
+static int write_cache_size(struct lock_file *lk, uintmax_t size)
+{
+	struct strbuf buf = STRBUF_INIT;
+	int ret = 0;
+
+	strbuf_addf(&buf, "%"PRIuMAX"\n", size);
+	if (write_in_full(get_lock_file_fd(lk), buf.buf, buf.len) < 0 ||
+	    commit_lock_file(lk) < 0)
+		ret = -1;
+	strbuf_release(&buf);
+	return ret;
+}
+
+static void pack_base_cache_path(struct strbuf *buf, struct repository *r,
+				 struct packed_git *p, off_t offset)
+{
+	pack_base_cache_dir(buf, r);
+	strbuf_addf(buf, "/%s/%016"PRIxMAX,
+		    hash_to_hex(p->hash), (uintmax_t)offset);
+}
+
+/*
+ * The entries are only a cache of what is in the packs, so a CRC is
+ * enough to notice a damaged file, and much cheaper than hashing every
+ * hit with the repository's hash function.
+ */
+static uint32_t entry_crc32(uint32_t crc, const unsigned char *data, size_t len)
+{
+	while (len) {
+		uInt n = len > (1U << 30) ? (1U << 30) : len;
+
+		crc = crc32(crc, data, n);
+		data += n;
+		len -= n;
+	}
+	return crc;
+}
+
+void *pack_base_cache_read(struct repository *r, struct packed_git *p,
+			   off_t offset, enum object_type *type,
+			   unsigned long *size)
+{
+	struct strbuf path = STRBUF_INIT;
+	const unsigned char *map;
+	size_t len;
+	uint64_t data_size;
+	struct stat st;
+	void *ret = NULL;
+	int fd;
+
+	if (!pack_base_cache_usable(r, p))
+		return NULL;
+
+	pack_base_cache_path(&path, r, p, offset);
+
+	fd = git_open(path.buf);
+	if (fd < 0) {
+		stats.miss++;
+		goto cleanup;
+	}
+	if (fstat(fd, &st) ||
+	    st.st_size < PACK_BASE_CACHE_HEADER_SIZE + PACK_BASE_CACHE_TRAILER_SIZE) {
+		close(fd);
+		goto corrupt;
+	}
+
+	len = xsize_t(st.st_size);
+	map = xmmap_gently(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		stats.miss++;
+		goto cleanup;
+	}
+
+	data_size = get_be64(map + 8);
+	if (get_be32(map) != PACK_BASE_CACHE_SIGNATURE ||
+	    data_size != len - PACK_BASE_CACHE_HEADER_SIZE - PACK_BASE_CACHE_TRAILER_SIZE ||
+	    get_be32(map + len - PACK_BASE_CACHE_TRAILER_SIZE) !=
+	    entry_crc32(crc32(0, NULL, 0), map,
+			len - PACK_BASE_CACHE_TRAILER_SIZE)) {
+		munmap((void *)map, len);
+		goto corrupt;
+	}
+
+	*type = get_be32(map + 4);
+	*size = data_size;
+	ret = xmemdupz(map + PACK_BASE_CACHE_HEADER_SIZE, data_size);
+	munmap((void *)map, len);
+	stats.hit++;
+
+	/* Keep frequently used entries from being evicted. */
+	if (time(NULL) - st.st_mtime > PACK_BASE_CACHE_TOUCH_INTERVAL)
+		utime(path.buf, NULL);
+
+	goto cleanup;
+
+corrupt:
+	stats.corrupt++;
+	unlink(path.buf);
+
+cleanup:
+	strbuf_release(&path);
+	return ret;
+}
+
+struct sweep_entry {
+	char *path;
+	off_t size;
+	time_t mtime;
+};
+
+static int sweep_entry_cmp(const void *va, const void *vb)
+{
+	const struct sweep_entry *a = va, *b = vb;
+
+	if (a->mtime != b->mtime)
+		return a->mtime < b->mtime ? -1 : 1;
+	return strcmp(a->path, b->path);
+}
+
+/*
+ * Whether the pack named "hex" is gone from every object directory.
+ * Anything we cannot prove is gone, like a pack that another process
+ * has just written, is kept.
+ */
+static int pack_is_gone(struct repository *r, const char *hex)
+{
+	unsigned char hash[GIT_MAX_RAWSZ];
+	struct object_directory *odb;
+	struct strbuf path = STRBUF_INIT;
+	int gone = 1;
+
+	if (strlen(hex) != the_hash_algo->hexsz ||
+	    hex_to_bytes(hash, hex, the_hash_algo->rawsz))
+		return 0;
+
+	prepare_alt_odb(r);
+	for (odb = r->objects->odb; gone && odb; odb = odb->next) {
+		struct stat st;
+
+		strbuf_reset(&path);
+		strbuf_addf(&path, "%s/pack/pack-%s.pack", odb->path, hex);
+		if (!stat(path.buf, &st) || errno != ENOENT)
+			gone = 0;
+	}
+
+	strbuf_release(&path);
+	return gone;
+}
+
+/*
+ * Collect the entries of one pack directory, or remove them all if the
+ * pack is gone.
+ */
+static void sweep_pack_dir(struct strbuf *path, int keep,
+			   struct sweep_entry **entries,
+			   size_t *nr, size_t *alloc)
+{
+	struct dirent *de;
+	size_t baselen = path->len;
+	DIR *dir = opendir(path->buf);
+
+	if (!dir)
+		return;
+
+	while ((de = readdir_skip_dot_and_dotdot(dir))) {
+		struct stat st;
+
+		strbuf_setlen(path, baselen);
+		strbuf_addf(path, "/%s", de->d_name);
+
+		if (!keep) {
+			unlink(path->buf);
+			continue;
+		}
+		if (lstat(path->buf, &st) || !S_ISREG(st.st_mode))
+			continue;
+
+		ALLOC_GROW(*entries, *nr + 1, *alloc);
+		(*entries)[*nr].path = xstrdup(path->buf);
+		(*entries)[*nr].size = st.st_size;
+		(*entries)[*nr].mtime = st.st_mtime;
+		(*nr)++;
+	}
+	closedir(dir);
+
+	strbuf_setlen(path, baselen);
+	if (!keep)
+		rmdir(path->buf);
+}
+
+void pack_base_cache_sweep(struct repository *r)
+{
+	struct sweep_entry *entries = NULL;
+	size_t nr = 0, alloc = 0, i;
+	uintmax_t total = 0, limit;
+	struct strbuf path = STRBUF_INIT;
+	struct lock_file lk = LOCK_INIT;
+	struct dirent *de;
+	time_t now = time(NULL);
+	size_t baselen;
+	struct stat st;
+	DIR *dir;
+
+	if (!pack_base_cache_enabled(r))
+		return;
+	limit = r->settings.pack_base_cache_limit;
+
+	trace2_region_enter("pack-base-cache", "sweep", r);
+
+	/*
+	 * A lock left behind by a process that died would keep everybody
+	 * from writing to the cache.
+	 */
+	pack_base_cache_size_path(&path, r);
+	strbuf_addstr(&path, LOCK_SUFFIX);
+	if (!lstat(path.buf, &st) &&
+	    now - st.st_mtime > PACK_BASE_CACHE_TMP_EXPIRY)
+		unlink(path.buf);
+	strbuf_setlen(&path, path.len - LOCK_SUFFIX_LEN);
+
+	/* Somebody is writing to the cache; leave it to the next sweep. */
+	if (hold_lock_file_for_update(&lk, path.buf, 0) < 0)
+		goto done;
+
+	strbuf_reset(&path);
+	pack_base_cache_dir(&path, r);
+	baselen = path.len;
+
+	dir = opendir(path.buf);
+	if (!dir)
+		goto done;
+	while ((de = readdir_skip_dot_and_dotdot(dir))) {
+		strbuf_setlen(&path, baselen);
+		strbuf_addf(&path, "/%s", de->d_name);
+
+		if (starts_with(de->d_name, PACK_BASE_CACHE_TMP_PREFIX)) {
+			if (!lstat(path.buf, &st) &&
+			    now - st.st_mtime > PACK_BASE_CACHE_TMP_EXPIRY)
+				unlink(path.buf);
+			continue;
+		}
+		if (lstat(path.buf, &st) || !S_ISDIR(st.st_mode))
+			continue;
+
+		sweep_pack_dir(&path, !pack_is_gone(r, de->d_name),
+			       &entries, &nr, &alloc);
+	}
+	closedir(dir);
+
+	for (i = 0; i < nr; i++)
+		total += entries[i].size;
+
+	if (total > limit) {
+		uintmax_t target = limit / 4 * 3;
+
+		QSORT(entries, nr, sweep_entry_cmp);
+		for (i = 0; i < nr && total > target; i++) {
+			if (unlink(entries[i].path))
+				continue;
+			total -= entries[i].size;
+			stats.evict++;
+		}
+	}
+
+	write_cache_size(&lk, total);
+
+done:
+	rollback_lock_file(&lk);
+	for (i = 0; i < nr; i++)
+		free(entries[i].path);
+	free(entries);
+	strbuf_release(&path);
+
+	trace2_region_leave("pack-base-cache", "sweep", r);
+}
+
+static int write_entry(int fd, enum object_type type,
+		       const void *data, unsigned long size)
+{
+	unsigned char hdr[PACK_BASE_CACHE_HEADER_SIZE];
+	unsigned char trailer[PACK_BASE_CACHE_TRAILER_SIZE];
+	uint32_t crc;
+
+	put_be32(hdr, PACK_BASE_CACHE_SIGNATURE);
+	put_be32(hdr + 4, type);
+	put_be64(hdr + 8, size);
+
+	crc = entry_crc32(crc32(0, NULL, 0), hdr, sizeof(hdr));
+	crc = entry_crc32(crc, data, size);
+	put_be32(trailer, crc);
+
+	if (write_in_full(fd, hdr, sizeof(hdr)) < 0 ||
+	    write_in_full(fd, data, size) < 0 ||
+	    write_in_full(fd, trailer, sizeof(trailer)) < 0)
+		return -1;
+	return 0;
+}
+
+void pack_base_cache_write(struct repository *r, struct packed_git *p,
+			   off_t offset, enum object_type type,
+			   const void *data, unsigned long size,
+			   unsigned depth)
+{
+	struct strbuf tmp = STRBUF_INIT;
+	struct strbuf path = STRBUF_INIT;
+	struct lock_file lk = LOCK_INIT;
+	uintmax_t total, entry_size;
+	int fd;
+
+	if (depth < PACK_BASE_CACHE_MIN_DEPTH || !pack_base_cache_usable(r, p))
+		return;
+
+	/* A single huge object should not flush the whole cache. */
+	if (size > r->settings.pack_base_cache_limit / 4)
+		return;
+
+	pack_base_cache_size_path(&path, r);
+	if (hold_lock_file_for_update(&lk, path.buf, 0) < 0) {
+		if (errno != ENOENT ||
+		    safe_create_leading_directories(path.buf) != SCLD_OK ||
+		    hold_lock_file_for_update(&lk, path.buf, 0) < 0)
+			goto cleanup;
+	}
+
+	entry_size = PACK_BASE_CACHE_HEADER_SIZE + (uintmax_t)size +
+		     PACK_BASE_CACHE_TRAILER_SIZE;
+	total = read_cache_size(path.buf);
+	if (total + entry_size > r->settings.pack_base_cache_limit) {
+		stats.full++;
+		goto cleanup;
+	}
+
+	pack_base_cache_dir(&tmp, r);
+	strbuf_addstr(&tmp, "/" PACK_BASE_CACHE_TMP_PREFIX "XXXXXX");
+	fd = git_mkstemp_mode(tmp.buf, 0444);
+	if (fd < 0)
+		goto cleanup;
+
+	if (write_entry(fd, type, data, size) < 0) {
+		close(fd);
+		unlink(tmp.buf);
+		goto cleanup;
+	}
+	if (close(fd) < 0 || adjust_shared_perm(tmp.buf)) {
+		unlink(tmp.buf);
+		goto cleanup;
+	}
+
+	strbuf_reset(&path);
+	pack_base_cache_path(&path, r, p, offset);
+	if (safe_create_leading_directories(path.buf) != SCLD_OK ||
+	    rename(tmp.buf, path.buf)) {
+		unlink(tmp.buf);
+		goto cleanup;
+	}
+
+	write_cache_size(&lk, total + entry_size);
+	stats.write++;
+
+cleanup:
+	rollback_lock_file(&lk);
+	strbuf_release(&tmp);
+	strbuf_release(&path);
+}
+
+static void log_trace_pack_base_cache_if(const char *key, intmax_t value)
+{
+	if (value)
+		trace2_data_intmax("pack-base-cache", the_repository, key, value);
+}
+
+void trace_pack_base_cache_stats(void)
+{
+	log_trace_pack_base_cache_if("hit", stats.hit);
+	log_trace_pack_base_cache_if("miss", stats.miss);
+	log_trace_pack_base_cache_if("write", stats.write);
+	log_trace_pack_base_cache_if("full", stats.full);
+	log_trace_pack_base_cache_if("evict", stats.evict);
+	log_trace_pack_base_cache_if("corrupt", stats.corrupt);
+}
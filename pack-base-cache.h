@@ -0,0 +1,65 @@
+#ifndef PACK_BASE_CACHE_H
+#define PACK_BASE_CACHE_H
+
+#include "git-compat-util.h"
+#include "object.h"
+
+#define PACK_BASE_CACHE_SIGNATURE 0x44424331 /* "DBC1" */
+
+struct packed_git;
+struct repository;
+
+/*
+ * A persistent cache of reconstructed delta base objects, shared by
+ * all processes that read from a repository.  Enabled with
+ * "core.persistentDeltaBaseCache".
+ *
+ * Each cached base lives in its own file
+ *
+ *   $GIT_OBJECT_DIRECTORY/info/delta-base-cache/<pack-hash>/<offset>
+ *
+ * which consists of a 4-byte signature, the 4-byte object type and the
+ * 8-byte object size (all in network order), followed by the object
+ * contents and a trailing CRC-32 over everything before it.
+ *
+ * Pack names are derived from their contents, so an entry can never go
+ * stale; entries of packs that no longer exist, as well as the least
+ * recently used ones beyond "core.persistentDeltaBaseCacheLimit", are
+ * removed by pack_base_cache_sweep(). Writers keep track of the total
+ * size of the entries and stop adding to the cache at the limit.
+ */
+
+/*
+ * Look up the reconstructed object at "offset" in "p". Returns a newly
+ * allocated, NUL-terminated buffer with its contents and fills in
+ * "type" and "size", or returns NULL if the object is not cached.
+ */
+void *pack_base_cache_read(struct repository *r, struct packed_git *p,
+			   off_t offset, enum object_type *type,
+			   unsigned long *size);
+
+/*
+ * Store the reconstructed object at "offset" in "p", which took "depth"
+ * deltas to reconstruct, unless that is too few to be worth it or the
+ * cache is full. Errors are not fatal (and not reported); the object
+ * simply does not get cached.
+ */
+void pack_base_cache_write(struct repository *r, struct packed_git *p,
+			   off_t offset, enum object_type type,
+			   const void *data, unsigned long size,
+			   unsigned depth);
+
+/*
+ * Remove the entries of packs that are gone from every object
+ * directory, and evict the least recently used entries until the cache
+ * is well below its limit. This is maintenance work for "git gc" and
+ * "git maintenance", not for the paths that read objects.
+ */
+void pack_base_cache_sweep(struct repository *r);
+
+/*
+ * Emit trace2 data about the cache hits and misses of this process.
+ */
+void trace_pack_base_cache_stats(void);
+
+#endif
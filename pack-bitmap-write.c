@@ -13,16 +13,34 @@
 #include "pack-objects.h"
 #include "commit-reach.h"
 #include "prio-queue.h"
+#include "refs.h"
+#include "config.h"
+#include "oidset.h"
+#include "wildmatch.h"
 
 struct bitmapped_commit {
 	struct commit *commit;
 	struct ewah_bitmap *bitmap;
 	struct ewah_bitmap *write_as;
+	/* the same, for version 2 */
+	struct roaring_bitmap *roaring;
+	struct roaring_bitmap *roaring_write_as;
 	int flags;
 	int xor_offset;
 	uint32_t commit_pos;
 };
 
+/*
+ * A "pseudo-merge": a group of ref tips with the bitmap of their
+ * commits and the bitmap of all that is reachable from them.
+ */
+struct pseudo_merge {
+	struct commit **commits;
+	size_t commits_nr, commits_alloc;
+	struct ewah_bitmap *commit_bits;
+	struct ewah_bitmap *objects;
+};
+
 struct bitmap_writer {
 	struct ewah_bitmap *commits;
 	struct ewah_bitmap *trees;
@@ -38,15 +56,52 @@ struct bitmap_writer {
 	struct progress *progress;
 	int show_progress;
 	unsigned char pack_checksum[GIT_MAX_RAWSZ];
+
+	/*
+	 * When writing a layer of an incremental MIDX chain, the bitmap
+	 * of the layer below, whose "base_nr" objects come first.
+	 */
+	struct bitmap_index *base;
+	uint32_t base_nr;
+
+	/* 1 for EWAH commit bitmaps, 2 for roaring ones */
+	uint16_t version;
+
+	struct pseudo_merge *pseudo_merges;
+	size_t pseudo_merges_nr, pseudo_merges_alloc;
 };
 
-static struct bitmap_writer writer;
+static struct bitmap_writer writer = { .version = 1 };
 
 void bitmap_writer_show_progress(int show)
 {
 	writer.show_progress = show;
 }
 
+void bitmap_writer_set_version(uint16_t version)
+{
+	writer.version = version;
+}
+
+void bitmap_writer_set_base(struct bitmap_index *base, uint32_t base_nr)
+{
+	writer.base = base;
+	writer.base_nr = base_nr;
+}
+
+static struct ewah_bitmap *base_type_bitmap(enum object_type type)
+{
+	struct ewah_bitmap *ewah = ewah_new();
+
+	if (writer.base) {
+		/* xor-ing with an empty bitmap makes a copy */
+		struct ewah_bitmap *empty = ewah_new();
+		ewah_xor(bitmap_for_type(writer.base, type), empty, ewah);
+		ewah_free(empty);
+	}
+	return ewah;
+}
+
 /**
  * Build the initial type index for the packfile or multi-pack-index
  */
@@ -56,10 +111,10 @@ void bitmap_writer_build_type_index(struct packing_data *to_pack,
 {
 	uint32_t i;
 
-	writer.commits = ewah_new();
-	writer.trees = ewah_new();
-	writer.blobs = ewah_new();
-	writer.tags = ewah_new();
+	writer.commits = base_type_bitmap(OBJ_COMMIT);
+	writer.trees = base_type_bitmap(OBJ_TREE);
+	writer.blobs = base_type_bitmap(OBJ_BLOB);
+	writer.tags = base_type_bitmap(OBJ_TAG);
 	ALLOC_ARRAY(to_pack->in_pack_pos, to_pack->nr_objects);
 
 	for (i = 0; i < index_nr; ++i) {
@@ -84,19 +139,19 @@ void bitmap_writer_build_type_index(struct packing_data *to_pack,
 
 		switch (real_type) {
 		case OBJ_COMMIT:
-			ewah_set(writer.commits, i);
+			ewah_set(writer.commits, writer.base_nr + i);
 			break;
 
 		case OBJ_TREE:
-			ewah_set(writer.trees, i);
+			ewah_set(writer.trees, writer.base_nr + i);
 			break;
 
 		case OBJ_BLOB:
-			ewah_set(writer.blobs, i);
+			ewah_set(writer.blobs, writer.base_nr + i);
 			break;
 
 		case OBJ_TAG:
-			ewah_set(writer.tags, i);
+			ewah_set(writer.tags, writer.base_nr + i);
 			break;
 
 		default:
@@ -120,6 +175,7 @@ static inline void push_bitmapped_commit(struct commit *commit)
 
 	writer.selected[writer.selected_nr].commit = commit;
 	writer.selected[writer.selected_nr].bitmap = NULL;
+	writer.selected[writer.selected_nr].roaring = NULL;
 	writer.selected[writer.selected_nr].flags = 0;
 
 	writer.selected_nr++;
@@ -129,6 +185,15 @@ static uint32_t find_object_pos(const struct object_id *oid, int *found)
 {
 	struct object_entry *entry = packlist_find(writer.to_pack, oid);
 
+	if (!entry && writer.base) {
+		int pos = bitmap_object_position(writer.base, oid);
+		if (pos >= 0) {
+			if (found)
+				*found = 1;
+			return pos;
+		}
+	}
+
 	if (!entry) {
 		if (found)
 			*found = 0;
@@ -139,7 +204,45 @@ static uint32_t find_object_pos(const struct object_id *oid, int *found)
 
 	if (found)
 		*found = 1;
-	return oe_in_pack_pos(writer.to_pack, entry);
+	return writer.base_nr + oe_in_pack_pos(writer.to_pack, entry);
+}
+
+static void compute_roaring_xor_offsets(void)
+{
+	static const int MAX_XOR_OFFSET_SEARCH = 10;
+
+	int i, next;
+
+	for (next = 0; next < writer.selected_nr; next++) {
+		struct bitmapped_commit *stored = &writer.selected[next];
+
+		int best_offset = 0;
+		struct roaring_bitmap *best_bitmap = stored->roaring;
+		size_t best_size = roaring_serialized_size(best_bitmap);
+
+		for (i = 1; i <= MAX_XOR_OFFSET_SEARCH && next - i >= 0; ++i) {
+			struct roaring_bitmap *test_xor = roaring_new();
+			size_t test_size;
+
+			roaring_xor(writer.selected[next - i].roaring,
+				    stored->roaring, test_xor);
+			test_size = roaring_serialized_size(test_xor);
+
+			if (test_size < best_size) {
+				if (best_bitmap != stored->roaring)
+					roaring_free(best_bitmap);
+
+				best_bitmap = test_xor;
+				best_size = test_size;
+				best_offset = i;
+			} else {
+				roaring_free(test_xor);
+			}
+		}
+
+		stored->xor_offset = best_offset;
+		stored->roaring_write_as = best_bitmap;
+	}
 }
 
 static void compute_xor_offsets(void)
@@ -389,7 +492,8 @@ static int fill_bitmap_commit(struct bb_commit *ent,
 			      struct prio_queue *queue,
 			      struct prio_queue *tree_queue,
 			      struct bitmap_index *old_bitmap,
-			      const uint32_t *mapping)
+			      const uint32_t *mapping,
+			      kh_oid_map_t *selected)
 {
 	int found;
 	uint32_t pos;
@@ -402,17 +506,40 @@ static int fill_bitmap_commit(struct bb_commit *ent,
 		struct commit_list *p;
 		struct commit *c = prio_queue_get(queue);
 
-		if (old_bitmap && mapping) {
+		if (old_bitmap) {
 			struct ewah_bitmap *old = bitmap_for_commit(old_bitmap, c);
 			/*
 			 * If this commit has an old bitmap, then translate that
 			 * bitmap and add its bits to this one. No need to walk
 			 * parents or the tree for this commit.
+			 *
+			 * The bitmaps of a base layer need no translation,
+			 * since its objects keep their positions.
 			 */
+			if (old && !mapping) {
+				bitmap_or_ewah(ent->bitmap, old);
+				continue;
+			}
 			if (old && !rebuild_bitmap(mapping, old, ent->bitmap))
 				continue;
 		}
 
+		if (selected) {
+			/* the same, with a bitmap we have just built */
+			khiter_t hash_pos = kh_get_oid_map(selected, c->object.oid);
+
+			if (hash_pos < kh_end(selected)) {
+				struct bitmapped_commit *stored =
+					kh_value(selected, hash_pos);
+
+				if (stored->roaring)
+					bitmap_or_roaring(ent->bitmap, stored->roaring);
+				else
+					bitmap_or_ewah(ent->bitmap, stored->bitmap);
+				continue;
+			}
+		}
+
 		/*
 		 * Mark ourselves and queue our tree. The commit
 		 * walk ensures we cover all parents.
@@ -448,7 +575,10 @@ static void store_selected(struct bb_commit *ent, struct commit *commit)
 	khiter_t hash_pos;
 	int hash_ret;
 
-	stored->bitmap = bitmap_to_ewah(ent->bitmap);
+	if (writer.version == 2)
+		stored->roaring = bitmap_to_roaring(ent->bitmap);
+	else
+		stored->bitmap = bitmap_to_ewah(ent->bitmap);
 
 	hash_pos = kh_put_oid_map(writer.bitmaps, commit->object.oid, &hash_ret);
 	if (hash_ret == 0)
@@ -457,6 +587,202 @@ static void store_selected(struct bb_commit *ent, struct commit *commit)
 	kh_value(writer.bitmaps, hash_pos) = stored;
 }
 
+struct pseudo_merge_group {
+	char *pattern;
+	timestamp_t threshold;
+	int max_merges;
+
+	struct commit **commits;
+	size_t commits_nr, commits_alloc;
+	struct oidset seen;
+};
+
+static int pseudo_merge_config(const char *var, const char *value, void *data)
+{
+	struct string_list *groups = data;
+	struct string_list_item *item;
+	struct pseudo_merge_group *group;
+	const char *name, *key;
+	size_t namelen;
+	char *name_buf;
+
+	if (parse_config_key(var, "bitmappseudomerge", &name, &namelen, &key) < 0 ||
+	    !name)
+		return 0;
+
+	name_buf = xmemdupz(name, namelen);
+	item = string_list_insert(groups, name_buf);
+	free(name_buf);
+	if (!item->util) {
+		CALLOC_ARRAY(group, 1);
+		group->threshold = approxidate("1.week.ago");
+		group->max_merges = 64;
+		oidset_init(&group->seen, 0);
+		item->util = group;
+	}
+	group = item->util;
+
+	if (!strcmp(key, "pattern")) {
+		free(group->pattern);
+		return git_config_string((const char **)&group->pattern, var, value);
+	} else if (!strcmp(key, "threshold")) {
+		const char *date;
+		if (git_config_string(&date, var, value))
+			return -1;
+		group->threshold = approxidate(date);
+		free((char *)date);
+	} else if (!strcmp(key, "maxmerges")) {
+		group->max_merges = git_config_int(var, value);
+		if (group->max_merges <= 0)
+			return error(_("%s must be positive"), var);
+	}
+	return 0;
+}
+
+static int in_bitmap_objects(const struct object_id *oid)
+{
+	if (packlist_find(writer.to_pack, oid))
+		return 1;
+	return writer.base && bitmap_object_position(writer.base, oid) >= 0;
+}
+
+static int add_pseudo_merge_tip(const char *refname,
+				const struct object_id *oid,
+				int flags, void *data)
+{
+	struct string_list *groups = data;
+	struct string_list_item *item;
+	struct commit *commit = NULL;
+
+	for_each_string_list_item(item, groups) {
+		struct pseudo_merge_group *group = item->util;
+
+		if (!group->pattern || wildmatch(group->pattern, refname, 0))
+			continue;
+
+		if (!commit) {
+			commit = lookup_commit_reference_gently(writer.to_pack->repo,
+								oid, 1);
+			if (!commit || repo_parse_commit(writer.to_pack->repo, commit) ||
+			    !in_bitmap_objects(&commit->object.oid))
+				return 0;
+		}
+		if (commit->date > group->threshold ||
+		    oidset_insert(&group->seen, &commit->object.oid))
+			continue;
+
+		ALLOC_GROW(group->commits, group->commits_nr + 1,
+			   group->commits_alloc);
+		group->commits[group->commits_nr++] = commit;
+	}
+	return 0;
+}
+
+/* Oldest first, so that new tips go at the end. */
+static int pseudo_merge_tip_cmp(const void *_a, const void *_b)
+{
+	struct commit *a = *(struct commit **)_a;
+	struct commit *b = *(struct commit **)_b;
+
+	if (a->date != b->date)
+		return a->date < b->date ? -1 : 1;
+	return oidcmp(&a->object.oid, &b->object.oid);
+}
+
+/*
+ * Split the tips of each group into at most "maxMerges" pseudo-merges
+ * of tips of about the same age. The pseudo-merges are cut from the
+ * oldest tips on, with a power of two of tips each, so that new tips
+ * only change the youngest pseudo-merge, until their number doubles:
+ * the older ones, whose refs are less likely to move, stay the same
+ * from one repack to the next.
+ */
+static void select_pseudo_merges(void)
+{
+	struct string_list groups = STRING_LIST_INIT_DUP;
+	struct string_list_item *item;
+
+	repo_config(writer.to_pack->repo, pseudo_merge_config, &groups);
+	if (!groups.nr)
+		return;
+
+	for_each_ref(add_pseudo_merge_tip, &groups);
+
+	for_each_string_list_item(item, &groups) {
+		struct pseudo_merge_group *group = item->util;
+		size_t i, per_merge;
+
+		QSORT(group->commits, group->commits_nr, pseudo_merge_tip_cmp);
+		for (per_merge = 1;
+		     per_merge * group->max_merges < group->commits_nr;
+		     per_merge <<= 1)
+			; /* round up to a power of two */
+
+		/* a pseudo-merge of one tip is no better than its bitmap */
+		for (i = 0; per_merge > 1 && i + 1 < group->commits_nr; i += per_merge) {
+			struct pseudo_merge *merge;
+			size_t nr = group->commits_nr - i;
+
+			if (nr > per_merge)
+				nr = per_merge;
+
+			ALLOC_GROW(writer.pseudo_merges, writer.pseudo_merges_nr + 1,
+				   writer.pseudo_merges_alloc);
+			merge = &writer.pseudo_merges[writer.pseudo_merges_nr++];
+			memset(merge, 0, sizeof(*merge));
+			ALLOC_ARRAY(merge->commits, nr);
+			COPY_ARRAY(merge->commits, group->commits + i, nr);
+			merge->commits_nr = merge->commits_alloc = nr;
+		}
+
+		free(group->pattern);
+		free(group->commits);
+		oidset_clear(&group->seen);
+	}
+
+	string_list_clear(&groups, 1);
+}
+
+static int build_pseudo_merges(struct prio_queue *queue,
+			       struct prio_queue *tree_queue,
+			       struct bitmap_index *old_bitmap,
+			       const uint32_t *mapping)
+{
+	size_t i, j;
+
+	select_pseudo_merges();
+
+	for (i = 0; i < writer.pseudo_merges_nr; i++) {
+		struct pseudo_merge *merge = &writer.pseudo_merges[i];
+		struct bitmap *commit_bits = bitmap_new();
+		struct bb_commit ent = { 0 };
+
+		for (j = 0; j < merge->commits_nr; j++) {
+			struct commit *c = merge->commits[j];
+			int found;
+
+			bitmap_set(commit_bits, find_object_pos(&c->object.oid,
+								&found));
+			if (fill_bitmap_commit(&ent, c, queue, tree_queue,
+					       old_bitmap, mapping,
+					       writer.bitmaps) < 0) {
+				bitmap_free(commit_bits);
+				bitmap_free(ent.bitmap);
+				return -1;
+			}
+		}
+
+		merge->commit_bits = bitmap_to_ewah(commit_bits);
+		merge->objects = bitmap_to_ewah(ent.bitmap);
+		bitmap_free(commit_bits);
+		bitmap_free(ent.bitmap);
+	}
+
+	trace2_data_intmax("pack-bitmap-write", the_repository,
+			   "num_pseudo_merges", writer.pseudo_merges_nr);
+	return 0;
+}
+
 int bitmap_writer_build(struct packing_data *to_pack)
 {
 	struct bitmap_builder bb;
@@ -476,11 +802,16 @@ int bitmap_writer_build(struct packing_data *to_pack)
 	trace2_region_enter("pack-bitmap-write", "building_bitmaps_total",
 			    the_repository);
 
-	old_bitmap = prepare_bitmap_git(to_pack->repo);
-	if (old_bitmap)
-		mapping = create_bitmap_mapping(old_bitmap, to_pack);
-	else
+	if (writer.base) {
+		old_bitmap = writer.base;
 		mapping = NULL;
+	} else {
+		old_bitmap = prepare_bitmap_git(to_pack->repo);
+		if (old_bitmap)
+			mapping = create_bitmap_mapping(old_bitmap, to_pack);
+		else
+			mapping = NULL;
+	}
 
 	bitmap_builder_init(&bb, &writer, old_bitmap);
 	for (i = bb.commits_nr; i > 0; i--) {
@@ -490,7 +821,7 @@ int bitmap_writer_build(struct packing_data *to_pack)
 		int reused = 0;
 
 		if (fill_bitmap_commit(ent, commit, &queue, &tree_queue,
-				       old_bitmap, mapping) < 0) {
+				       old_bitmap, mapping, NULL) < 0) {
 			closed = 0;
 			break;
 		}
@@ -518,10 +849,16 @@ int bitmap_writer_build(struct packing_data *to_pack)
 			bitmap_free(ent->bitmap);
 		ent->bitmap = NULL;
 	}
+
+	if (closed && build_pseudo_merges(&queue, &tree_queue,
+					  old_bitmap, mapping) < 0)
+		closed = 0;
+
 	clear_prio_queue(&queue);
 	clear_prio_queue(&tree_queue);
 	bitmap_builder_clear(&bb);
 	free_bitmap_index(old_bitmap);
+	writer.base = NULL;
 	free(mapping);
 
 	trace2_region_leave("pack-bitmap-write", "building_bitmaps_total",
@@ -529,7 +866,9 @@ int bitmap_writer_build(struct packing_data *to_pack)
 
 	stop_progress(&writer.progress);
 
-	if (closed)
+	if (closed && writer.version == 2)
+		compute_roaring_xor_offsets();
+	else if (closed)
 		compute_xor_offsets();
 	return closed ? 0 : -1;
 }
@@ -664,7 +1003,13 @@ static void write_selected_commits_v1(struct hashfile *f,
 		hashwrite_u8(f, stored->xor_offset);
 		hashwrite_u8(f, stored->flags);
 
-		dump_bitmap(f, stored->write_as);
+		if (writer.version == 2) {
+			if (roaring_serialize_to(stored->roaring_write_as,
+						 hashwrite_ewah_helper, f) < 0)
+				die("Failed to write bitmap index");
+		} else {
+			dump_bitmap(f, stored->write_as);
+		}
 	}
 }
 
@@ -741,6 +1086,31 @@ static void write_lookup_table(struct hashfile *f,
 	free(table_inv);
 }
 
+/*
+ * The pseudo-merge extension: for each pseudo-merge, the EWAH bitmap
+ * of its commits and that of the objects they reach; then the offset
+ * of each pair, their number, and the size of the whole extension.
+ */
+static void write_pseudo_merges(struct hashfile *f)
+{
+	off_t start = hashfile_total(f);
+	off_t *offsets;
+	size_t i;
+
+	ALLOC_ARRAY(offsets, writer.pseudo_merges_nr);
+	for (i = 0; i < writer.pseudo_merges_nr; i++) {
+		offsets[i] = hashfile_total(f);
+		dump_bitmap(f, writer.pseudo_merges[i].commit_bits);
+		dump_bitmap(f, writer.pseudo_merges[i].objects);
+	}
+	for (i = 0; i < writer.pseudo_merges_nr; i++)
+		hashwrite_be64(f, (uint64_t)offsets[i]);
+	hashwrite_be32(f, writer.pseudo_merges_nr);
+	hashwrite_be64(f, hashfile_total(f) + sizeof(uint64_t) - start);
+
+	free(offsets);
+}
+
 static void write_hash_cache(struct hashfile *f,
 			     struct pack_idx_entry **index,
 			     uint32_t index_nr)
@@ -763,7 +1133,6 @@ void bitmap_writer_finish(struct pack_idx_entry **index,
 			  const char *filename,
 			  uint16_t options)
 {
-	static uint16_t default_version = 1;
 	static uint16_t flags = BITMAP_OPT_FULL_DAG;
 	struct strbuf tmp_file = STRBUF_INIT;
 	struct hashfile *f;
@@ -775,10 +1144,18 @@ void bitmap_writer_finish(struct pack_idx_entry **index,
 
 	int fd = odb_mkstemp(&tmp_file, "pack/tmp_bitmap_XXXXXX");
 
+	/* Hashes other than the original ones go into their own extension. */
+	if ((options & BITMAP_OPT_HASH_CACHE) &&
+	    writer.to_pack->name_hash_version > 1)
+		options ^= BITMAP_OPT_HASH_CACHE | BITMAP_OPT_HASH_CACHE_V2;
+
+	if (writer.pseudo_merges_nr)
+		options |= BITMAP_OPT_PSEUDO_MERGES;
+
 	f = hashfd(fd, tmp_file.buf);
 
 	memcpy(header.magic, BITMAP_IDX_SIGNATURE, sizeof(BITMAP_IDX_SIGNATURE));
-	header.version = htons(default_version);
+	header.version = htons(writer.version);
 	header.options = htons(flags | options);
 	header.entry_count = htonl(writer.selected_nr);
 	hashcpy(header.checksum, writer.pack_checksum);
@@ -801,11 +1178,17 @@ void bitmap_writer_finish(struct pack_idx_entry **index,
 		if (commit_pos < 0)
 			BUG(_("trying to write commit not in index"));
 
-		commit_positions[i] = commit_pos;
+		commit_positions[i] = writer.base_nr + commit_pos;
 	}
 
 	write_selected_commits_v1(f, commit_positions, offsets);
 
+	if (options & BITMAP_OPT_PSEUDO_MERGES)
+		write_pseudo_merges(f);
+
+	if (options & BITMAP_OPT_HASH_CACHE_V2)
+		write_hash_cache(f, index, index_nr);
+
 	if (options & BITMAP_OPT_LOOKUP_TABLE)
 		write_lookup_table(f, commit_positions, offsets);
 
@@ -24,6 +24,8 @@
 struct stored_bitmap {
 	struct object_id oid;
 	struct ewah_bitmap *root;
+	/* in version 2 files, the bitmap itself is roaring */
+	struct roaring_bitmap *roaring;
 	struct stored_bitmap *xor;
 	int flags;
 };
@@ -47,6 +49,14 @@ struct bitmap_index {
 	struct packed_git *pack;
 	struct multi_pack_index *midx;
 
+	/*
+	 * For a layer of an incremental MIDX chain, the bitmap index of
+	 * the layer below. Bit positions of the objects in the layers
+	 * below come first, and the commit bitmaps of this layer only
+	 * cover its own commits; we fall back to the base for others.
+	 */
+	struct bitmap_index *base;
+
 	/*
 	 * Mark the first `reuse_objects` in the packfile as reused:
 	 * they will be sent as-is without using them for repacking
@@ -80,6 +90,9 @@ struct bitmap_index {
 	/* If not NULL, this is a name-hash cache pointing into map. */
 	uint32_t *hashes;
 
+	/* The pack_name_hash_version() of "hashes" and of ext_index. */
+	int name_hash_version;
+
 	/* The checksum of the packfile or MIDX; points into map. */
 	const unsigned char *checksum;
 
@@ -109,27 +122,74 @@ struct bitmap_index {
 	/* "have" bitmap from the last performed walk */
 	struct bitmap *haves;
 
+	/*
+	 * If not NULL, maps commits that have no bitmap in the index to
+	 * an ewah_bitmap of their reachability, computed by a walk; see
+	 * prepare_bitmap_walk_on().
+	 */
+	kh_oid_map_t *gap_bitmaps;
+
 	/* Version of the bitmap index */
 	unsigned int version;
+
+	/*
+	 * The pseudo-merge extension (within `map`), and the pseudo-merges
+	 * read from it: groups of ref tips that share one bitmap of what
+	 * they reach, and which a walk can use when it starts from all of
+	 * them. Their bitmaps are only read from `offset` when a walk first
+	 * needs them.
+	 */
+	const unsigned char *pseudo_merge_ext;
+	size_t pseudo_merge_ext_size;
+	struct bitmap_pseudo_merge {
+		uint64_t offset;
+		struct bitmap *commits;
+		struct ewah_bitmap *objects;
+	} *pseudo_merges;
+	uint32_t pseudo_merges_nr;
 };
 
-static struct ewah_bitmap *lookup_stored_bitmap(struct stored_bitmap *st)
+static struct stored_bitmap *resolve_stored_bitmap(struct stored_bitmap *st)
 {
-	struct ewah_bitmap *parent;
-	struct ewah_bitmap *composed;
+	struct stored_bitmap *parent;
 
 	if (!st->xor)
-		return st->root;
+		return st;
+
+	parent = resolve_stored_bitmap(st->xor);
+	if (st->roaring) {
+		struct roaring_bitmap *composed = roaring_new();
+		roaring_xor(st->roaring, parent->roaring, composed);
+		roaring_free(st->roaring);
+		st->roaring = composed;
+	} else {
+		struct ewah_bitmap *composed = ewah_pool_new();
+		ewah_xor(st->root, parent->root, composed);
+		ewah_pool_free(st->root);
+		st->root = composed;
+	}
+	st->xor = NULL;
 
-	composed = ewah_pool_new();
-	parent = lookup_stored_bitmap(st->xor);
-	ewah_xor(st->root, parent, composed);
+	return st;
+}
 
-	ewah_pool_free(st->root);
-	st->root = composed;
-	st->xor = NULL;
+static struct ewah_bitmap *lookup_stored_bitmap(struct stored_bitmap *st)
+{
+	st = resolve_stored_bitmap(st);
+	if (!st->root) {
+		struct bitmap *tmp = roaring_to_bitmap(st->roaring);
+		st->root = bitmap_to_ewah(tmp);
+		bitmap_free(tmp);
+	}
+	return st->root;
+}
 
-	return composed;
+static void bitmap_or_stored(struct bitmap *dst, struct stored_bitmap *st)
+{
+	if (st->roaring)
+		bitmap_or_roaring(dst, st->roaring);
+	else
+		bitmap_or_ewah(dst, st->root);
 }
 
 /*
@@ -154,13 +214,52 @@ static struct ewah_bitmap *read_bitmap_1(struct bitmap_index *index)
 	return b;
 }
 
+static struct roaring_bitmap *read_roaring_1(struct bitmap_index *index)
+{
+	struct roaring_bitmap *b = roaring_new();
+
+	ssize_t bitmap_size = roaring_read_mmap(b,
+		index->map + index->map_pos,
+		index->map_size - index->map_pos);
+
+	if (bitmap_size < 0) {
+		error(_("failed to load bitmap index (corrupted?)"));
+		roaring_free(b);
+		return NULL;
+	}
+
+	index->map_pos += bitmap_size;
+	return b;
+}
+
+static uint32_t bitmap_num_objects_in_base(struct bitmap_index *index)
+{
+	if (index->midx)
+		return index->midx->num_objects_in_base;
+	return 0;
+}
+
 static uint32_t bitmap_num_objects(struct bitmap_index *index)
 {
 	if (index->midx)
-		return index->midx->num_objects;
+		return index->midx->num_objects_in_base +
+		       index->midx->num_objects;
 	return index->pack->num_objects;
 }
 
+/*
+ * Return the bitmap index of the layer holding the object at bit
+ * position "*pos", adjusting "*pos" to be relative to that layer.
+ */
+static struct bitmap_index *bitmap_layer_for_pos(struct bitmap_index *index,
+						 uint32_t *pos)
+{
+	while (index->base && *pos < bitmap_num_objects_in_base(index))
+		index = index->base;
+	*pos -= bitmap_num_objects_in_base(index);
+	return index;
+}
+
 static int load_bitmap_header(struct bitmap_index *index)
 {
 	struct bitmap_disk_header *header = (void *)index->map;
@@ -173,13 +272,16 @@ static int load_bitmap_header(struct bitmap_index *index)
 		return error(_("corrupted bitmap index file (wrong header)"));
 
 	index->version = ntohs(header->version);
-	if (index->version != 1)
+	if (index->version != 1 && index->version != 2)
 		return error(_("unsupported version '%d' for bitmap index file"), index->version);
 
 	/* Parse known bitmap format options */
 	{
 		uint32_t flags = ntohs(header->options);
-		size_t cache_size = st_mult(bitmap_num_objects(index), sizeof(uint32_t));
+		/* the name-hash cache only covers this layer's objects */
+		size_t cache_size = st_mult(bitmap_num_objects(index) -
+					    bitmap_num_objects_in_base(index),
+					    sizeof(uint32_t));
 		unsigned char *index_end = index->map + index->map_size - the_hash_algo->rawsz;
 
 		if ((flags & BITMAP_OPT_FULL_DAG) == 0)
@@ -202,6 +304,34 @@ static int load_bitmap_header(struct bitmap_index *index)
 				index->table_lookup = (void *)(index_end - table_size);
 			index_end -= table_size;
 		}
+
+		/*
+		 * This comes before the other extensions, so that readers
+		 * that don't know about it still find them at the end.
+		 */
+		index->name_hash_version = 1;
+		if (flags & BITMAP_OPT_HASH_CACHE_V2) {
+			if (cache_size > index_end - index->map - header_size)
+				return error(_("corrupted bitmap index file (too short to fit hash cache)"));
+			index->hashes = (void *)(index_end - cache_size);
+			index->name_hash_version = 2;
+			index_end -= cache_size;
+		}
+
+		/* And this comes before all of them. */
+		if (flags & BITMAP_OPT_PSEUDO_MERGES) {
+			uint64_t ext_size;
+
+			if (index_end - index->map - header_size < 12)
+				return error(_("corrupted bitmap index file (too short to fit pseudo-merges)"));
+			ext_size = get_be64(index_end - 8);
+			if (ext_size < 12 ||
+			    ext_size > index_end - index->map - header_size)
+				return error(_("corrupted bitmap index file (too short to fit pseudo-merges)"));
+			index->pseudo_merge_ext = index_end - ext_size;
+			index->pseudo_merge_ext_size = ext_size;
+			index_end -= ext_size;
+		}
 	}
 
 	index->entry_count = ntohl(header->entry_count);
@@ -212,6 +342,7 @@ static int load_bitmap_header(struct bitmap_index *index)
 
 static struct stored_bitmap *store_bitmap(struct bitmap_index *index,
 					  struct ewah_bitmap *root,
+					  struct roaring_bitmap *roaring,
 					  const struct object_id *oid,
 					  struct stored_bitmap *xor_with,
 					  int flags)
@@ -222,6 +353,7 @@ static struct stored_bitmap *store_bitmap(struct bitmap_index *index,
 
 	stored = xmalloc(sizeof(struct stored_bitmap));
 	stored->root = root;
+	stored->roaring = roaring;
 	stored->xor = xor_with;
 	stored->flags = flags;
 	oidcpy(&stored->oid, oid);
@@ -242,6 +374,29 @@ static struct stored_bitmap *store_bitmap(struct bitmap_index *index,
 	return stored;
 }
 
+/*
+ * Read the bitmap of a commit, in the format given by the version of
+ * the index, and store it in "index".
+ */
+static int read_commit_bitmap(struct bitmap_index *index,
+			      const struct object_id *oid,
+			      struct stored_bitmap *xor_with, int flags,
+			      struct stored_bitmap **out)
+{
+	struct ewah_bitmap *root = NULL;
+	struct roaring_bitmap *roaring = NULL;
+
+	if (index->version == 2)
+		roaring = read_roaring_1(index);
+	else
+		root = read_bitmap_1(index);
+	if (!root && !roaring)
+		return -1;
+
+	*out = store_bitmap(index, root, roaring, oid, xor_with, flags);
+	return 0;
+}
+
 static inline uint32_t read_be32(const unsigned char *buffer, size_t *pos)
 {
 	uint32_t result = get_be32(buffer + *pos);
@@ -272,7 +427,6 @@ static int load_bitmap_entries_v1(struct bitmap_index *index)
 
 	for (i = 0; i < index->entry_count; ++i) {
 		int xor_offset, flags;
-		struct ewah_bitmap *bitmap = NULL;
 		struct stored_bitmap *xor_bitmap = NULL;
 		uint32_t commit_idx_pos;
 		struct object_id oid;
@@ -284,14 +438,12 @@ static int load_bitmap_entries_v1(struct bitmap_index *index)
 		xor_offset = read_u8(index->map, &index->map_pos);
 		flags = read_u8(index->map, &index->map_pos);
 
-		if (nth_bitmap_object_oid(index, &oid, commit_idx_pos) < 0)
+		if (commit_idx_pos < bitmap_num_objects_in_base(index) ||
+		    nth_bitmap_object_oid(index, &oid, commit_idx_pos -
+					  bitmap_num_objects_in_base(index)) < 0)
 			return error(_("corrupt ewah bitmap: commit index %u out of range"),
 				     (unsigned)commit_idx_pos);
 
-		bitmap = read_bitmap_1(index);
-		if (!bitmap)
-			return -1;
-
 		if (xor_offset > MAX_XOR_OFFSET || xor_offset > i)
 			return error(_("corrupted bitmap pack index"));
 
@@ -302,8 +454,9 @@ static int load_bitmap_entries_v1(struct bitmap_index *index)
 				return error(_("invalid XOR offset in bitmap pack index"));
 		}
 
-		recent_bitmaps[i % MAX_XOR_OFFSET] = store_bitmap(
-			index, bitmap, &oid, xor_bitmap, flags);
+		if (read_commit_bitmap(index, &oid, xor_bitmap, flags,
+				       &recent_bitmaps[i % MAX_XOR_OFFSET]) < 0)
+			return -1;
 	}
 
 	return 0;
@@ -313,6 +466,11 @@ char *midx_bitmap_filename(struct multi_pack_index *midx)
 {
 	struct strbuf buf = STRBUF_INIT;
 
+	if (midx->incremental) {
+		get_split_midx_filename_ext(&buf, midx->object_dir,
+					    get_midx_checksum(midx), "bitmap");
+		return strbuf_detach(&buf, NULL);
+	}
 	get_midx_filename(&buf, midx->object_dir);
 	strbuf_addf(&buf, "-%s.bitmap", hash_to_hex(get_midx_checksum(midx)));
 
@@ -394,6 +552,14 @@ static int open_midx_bitmap_1(struct bitmap_index *bitmap_git,
 		goto cleanup;
 	}
 
+	if (midx->base_midx) {
+		bitmap_git->base = prepare_midx_bitmap_git(midx->base_midx);
+		if (!bitmap_git->base) {
+			warning(_("multi-pack bitmap is missing the bitmap of its base layer"));
+			goto cleanup;
+		}
+	}
+
 	return 0;
 
 cleanup:
@@ -484,6 +650,71 @@ static int load_reverse_index(struct bitmap_index *bitmap_git)
 	return load_pack_revindex(bitmap_git->pack);
 }
 
+static int load_pseudo_merges(struct bitmap_index *bitmap_git)
+{
+	const unsigned char *ext = bitmap_git->pseudo_merge_ext;
+	size_t ext_size = bitmap_git->pseudo_merge_ext_size;
+	uint32_t i, nr;
+
+	if (!ext)
+		return 0;
+
+	nr = get_be32(ext + ext_size - 12);
+	if (nr > (ext_size - 12) / 8)
+		return error(_("corrupted bitmap index file (too short to fit pseudo-merges)"));
+
+	CALLOC_ARRAY(bitmap_git->pseudo_merges, nr);
+	bitmap_git->pseudo_merges_nr = nr;
+	for (i = 0; i < nr; i++) {
+		uint64_t offset = get_be64(ext + ext_size - 12 - 8 * (nr - i));
+
+		if (offset < ext - bitmap_git->map ||
+		    offset >= ext - bitmap_git->map + ext_size)
+			return error(_("corrupted bitmap index file (bad pseudo-merge offset)"));
+		bitmap_git->pseudo_merges[i].offset = offset;
+	}
+
+	return 0;
+}
+
+/*
+ * Read the bitmaps of "merge", one of the pseudo-merges of "bitmap_git",
+ * unless that has been done already.
+ */
+static int load_pseudo_merge(struct bitmap_index *bitmap_git,
+			     struct bitmap_pseudo_merge *merge)
+{
+	size_t saved_pos = bitmap_git->map_pos;
+	struct ewah_bitmap *commits, *objects = NULL;
+	int ret = -1;
+
+	if (merge->commits)
+		return 0;
+
+	bitmap_git->map_pos = merge->offset;
+	if ((commits = read_bitmap_1(bitmap_git)) &&
+	    (objects = read_bitmap_1(bitmap_git))) {
+		merge->commits = ewah_to_bitmap(commits);
+		merge->objects = objects;
+		ret = 0;
+	}
+	ewah_free(commits);
+	bitmap_git->map_pos = saved_pos;
+	return ret;
+}
+
+static void free_pseudo_merges(struct bitmap_index *bitmap_git)
+{
+	uint32_t i;
+
+	for (i = 0; i < bitmap_git->pseudo_merges_nr; i++) {
+		bitmap_free(bitmap_git->pseudo_merges[i].commits);
+		ewah_free(bitmap_git->pseudo_merges[i].objects);
+	}
+	FREE_AND_NULL(bitmap_git->pseudo_merges);
+	bitmap_git->pseudo_merges_nr = 0;
+}
+
 static int load_bitmap(struct bitmap_index *bitmap_git)
 {
 	assert(bitmap_git->map);
@@ -500,12 +731,16 @@ static int load_bitmap(struct bitmap_index *bitmap_git)
 		!(bitmap_git->tags = read_bitmap_1(bitmap_git)))
 		goto failed;
 
+	if (load_pseudo_merges(bitmap_git) < 0)
+		goto failed;
+
 	if (!bitmap_git->table_lookup && load_bitmap_entries_v1(bitmap_git) < 0)
 		goto failed;
 
 	return 0;
 
 failed:
+	free_pseudo_merges(bitmap_git);
 	munmap(bitmap_git->map, bitmap_git->map_size);
 	bitmap_git->map = NULL;
 	bitmap_git->map_size = 0;
@@ -544,8 +779,12 @@ static int open_midx_bitmap(struct repository *r,
 	assert(!bitmap_git->map);
 
 	for (midx = get_multi_pack_index(r); midx; midx = midx->next) {
-		if (!open_midx_bitmap_1(bitmap_git, midx))
+		if (!open_midx_bitmap_1(bitmap_git, midx)) {
 			ret = 0;
+			/* the bitmaps of the layers below come with it */
+			while (midx->base_midx)
+				midx = midx->base_midx;
+		}
 	}
 	return ret;
 }
@@ -661,9 +900,11 @@ static uint32_t bitmap_bsearch_pos(struct bitmap_index *bitmap_git,
 {
 	int found;
 
-	if (bitmap_is_midx(bitmap_git))
+	if (bitmap_is_midx(bitmap_git)) {
 		found = bsearch_midx(oid, bitmap_git->midx, result);
-	else
+		if (found)
+			*result += bitmap_num_objects_in_base(bitmap_git);
+	} else
 		found = bsearch_pack(oid, bitmap_git->pack, result);
 
 	return found;
@@ -696,8 +937,7 @@ static struct stored_bitmap *lazy_bitmap_for_commit(struct bitmap_index *bitmap_
 	int flags;
 	struct bitmap_lookup_table_triplet triplet;
 	struct object_id *oid = &commit->object.oid;
-	struct ewah_bitmap *bitmap;
-	struct stored_bitmap *xor_bitmap = NULL;
+	struct stored_bitmap *xor_bitmap = NULL, *stored;
 	const int bitmap_header_size = 6;
 	static struct bitmap_lookup_table_xor_item *xor_items = NULL;
 	static size_t xor_items_nr = 0, xor_items_alloc = 0;
@@ -733,7 +973,10 @@ static struct stored_bitmap *lazy_bitmap_for_commit(struct bitmap_index *bitmap_
 		xor_item = &xor_items[xor_items_nr];
 		xor_item->offset = triplet.offset;
 
-		if (nth_bitmap_object_oid(bitmap_git, &xor_item->oid, triplet.commit_pos) < 0) {
+		if (triplet.commit_pos < bitmap_num_objects_in_base(bitmap_git) ||
+		    nth_bitmap_object_oid(bitmap_git, &xor_item->oid,
+					  triplet.commit_pos -
+					  bitmap_num_objects_in_base(bitmap_git)) < 0) {
 			error(_("corrupt bitmap lookup table: commit index %u out of range"),
 				triplet.commit_pos);
 			goto corrupt;
@@ -766,12 +1009,9 @@ static struct stored_bitmap *lazy_bitmap_for_commit(struct bitmap_index *bitmap_
 
 		bitmap_git->map_pos += sizeof(uint32_t) + sizeof(uint8_t);
 		xor_flags = read_u8(bitmap_git->map, &bitmap_git->map_pos);
-		bitmap = read_bitmap_1(bitmap_git);
-
-		if (!bitmap)
+		if (read_commit_bitmap(bitmap_git, &xor_item->oid, xor_bitmap,
+				       xor_flags, &xor_bitmap) < 0)
 			goto corrupt;
-
-		xor_bitmap = store_bitmap(bitmap_git, bitmap, &xor_item->oid, xor_bitmap, xor_flags);
 		xor_items_nr--;
 	}
 
@@ -807,12 +1047,10 @@ static struct stored_bitmap *lazy_bitmap_for_commit(struct bitmap_index *bitmap_
 	 */
 	bitmap_git->map_pos += sizeof(uint32_t) + sizeof(uint8_t);
 	flags = read_u8(bitmap_git->map, &bitmap_git->map_pos);
-	bitmap = read_bitmap_1(bitmap_git);
-
-	if (!bitmap)
+	if (read_commit_bitmap(bitmap_git, oid, xor_bitmap, flags, &stored) < 0)
 		goto corrupt;
 
-	return store_bitmap(bitmap_git, bitmap, oid, xor_bitmap, flags);
+	return stored;
 
 corrupt:
 	free(xor_items);
@@ -820,24 +1058,31 @@ static struct stored_bitmap *lazy_bitmap_for_commit(struct bitmap_index *bitmap_
 	return NULL;
 }
 
-struct ewah_bitmap *bitmap_for_commit(struct bitmap_index *bitmap_git,
-				      struct commit *commit)
+static struct stored_bitmap *stored_bitmap_for_commit(struct bitmap_index *bitmap_git,
+						      struct commit *commit)
 {
 	khiter_t hash_pos = kh_get_oid_map(bitmap_git->bitmaps,
 					   commit->object.oid);
 	if (hash_pos >= kh_end(bitmap_git->bitmaps)) {
 		struct stored_bitmap *bitmap = NULL;
-		if (!bitmap_git->table_lookup)
-			return NULL;
-
-		/* this is a fairly hot codepath - no trace2_region please */
-		/* NEEDSWORK: cache misses aren't recorded */
-		bitmap = lazy_bitmap_for_commit(bitmap_git, commit);
-		if (!bitmap)
-			return NULL;
-		return lookup_stored_bitmap(bitmap);
+		if (bitmap_git->table_lookup)
+			/* this is a fairly hot codepath - no trace2_region please */
+			/* NEEDSWORK: cache misses aren't recorded */
+			bitmap = lazy_bitmap_for_commit(bitmap_git, commit);
+		if (bitmap)
+			return resolve_stored_bitmap(bitmap);
+		if (bitmap_git->base)
+			return stored_bitmap_for_commit(bitmap_git->base, commit);
+		return NULL;
 	}
-	return lookup_stored_bitmap(kh_value(bitmap_git->bitmaps, hash_pos));
+	return resolve_stored_bitmap(kh_value(bitmap_git->bitmaps, hash_pos));
+}
+
+struct ewah_bitmap *bitmap_for_commit(struct bitmap_index *bitmap_git,
+				      struct commit *commit)
+{
+	struct stored_bitmap *stored = stored_bitmap_for_commit(bitmap_git, commit);
+	return stored ? lookup_stored_bitmap(stored) : NULL;
 }
 
 static inline int bitmap_position_extended(struct bitmap_index *bitmap_git,
@@ -871,12 +1116,16 @@ static int bitmap_position_midx(struct bitmap_index *bitmap_git,
 				const struct object_id *oid)
 {
 	uint32_t want, got;
-	if (!bsearch_midx(oid, bitmap_git->midx, &want))
-		return -1;
+
+	while (!bsearch_midx(oid, bitmap_git->midx, &want)) {
+		bitmap_git = bitmap_git->base;
+		if (!bitmap_git)
+			return -1;
+	}
 
 	if (midx_to_pack_pos(bitmap_git->midx, want, &got) < 0)
 		return -1;
-	return got;
+	return got + bitmap_num_objects_in_base(bitmap_git);
 }
 
 static int bitmap_position(struct bitmap_index *bitmap_git,
@@ -909,7 +1158,8 @@ static int ext_index_add_object(struct bitmap_index *bitmap_git,
 
 		bitmap_pos = eindex->count;
 		eindex->objects[eindex->count] = object;
-		eindex->hashes[eindex->count] = pack_name_hash(name);
+		eindex->hashes[eindex->count] =
+			pack_name_hash_version(name, bitmap_git->name_hash_version);
 		kh_value(eindex->positions, hash_pos) = bitmap_pos;
 		eindex->count++;
 	} else {
@@ -942,12 +1192,26 @@ static void show_commit(struct commit *commit, void *data)
 {
 }
 
+static struct ewah_bitmap *gap_bitmap_for_commit(struct bitmap_index *bitmap_git,
+						 struct commit *commit)
+{
+	khiter_t pos;
+
+	if (!bitmap_git->gap_bitmaps)
+		return NULL;
+	pos = kh_get_oid_map(bitmap_git->gap_bitmaps, commit->object.oid);
+	if (pos >= kh_end(bitmap_git->gap_bitmaps))
+		return NULL;
+	return kh_value(bitmap_git->gap_bitmaps, pos);
+}
+
 static int add_to_include_set(struct bitmap_index *bitmap_git,
 			      struct include_data *data,
 			      struct commit *commit,
 			      int bitmap_pos)
 {
-	struct ewah_bitmap *partial;
+	struct stored_bitmap *partial;
+	struct ewah_bitmap *gap;
 
 	if (data->seen && bitmap_get(data->seen, bitmap_pos))
 		return 0;
@@ -955,9 +1219,15 @@ static int add_to_include_set(struct bitmap_index *bitmap_git,
 	if (bitmap_get(data->base, bitmap_pos))
 		return 0;
 
-	partial = bitmap_for_commit(bitmap_git, commit);
+	partial = stored_bitmap_for_commit(bitmap_git, commit);
 	if (partial) {
-		bitmap_or_ewah(data->base, partial);
+		bitmap_or_stored(data->base, partial);
+		return 0;
+	}
+
+	gap = gap_bitmap_for_commit(bitmap_git, commit);
+	if (gap) {
+		bitmap_or_ewah(data->base, gap);
 		return 0;
 	}
 
@@ -1010,19 +1280,153 @@ static int add_commit_to_bitmap(struct bitmap_index *bitmap_git,
 				struct bitmap **base,
 				struct commit *commit)
 {
-	struct ewah_bitmap *or_with = bitmap_for_commit(bitmap_git, commit);
+	struct stored_bitmap *or_with = stored_bitmap_for_commit(bitmap_git, commit);
+	struct ewah_bitmap *gap = NULL;
 
-	if (!or_with)
+	if (!or_with && !(gap = gap_bitmap_for_commit(bitmap_git, commit)))
 		return 0;
 
 	if (!*base)
-		*base = ewah_to_bitmap(or_with);
+		*base = bitmap_word_alloc(0);
+	if (or_with)
+		bitmap_or_stored(*base, or_with);
 	else
-		bitmap_or_ewah(*base, or_with);
+		bitmap_or_ewah(*base, gap);
 
 	return 1;
 }
 
+/*
+ * Start the result of a walk from "roots" with the pseudo-merges whose
+ * commits are all among the roots, or reachable from the pseudo-merges
+ * used so far. Returns NULL if there is none.
+ */
+static struct bitmap *apply_pseudo_merges(struct bitmap_index *bitmap_git,
+					  struct object_list *roots)
+{
+	struct bitmap_pseudo_merge **merges = NULL;
+	size_t merges_nr = 0, merges_alloc = 0, i;
+	struct bitmap *roots_bitmap, *base = NULL;
+	struct bitmap_index *layer;
+	size_t applied_nr = 0;
+	int progress;
+
+	for (layer = bitmap_git; layer; layer = layer->base) {
+		for (i = 0; i < layer->pseudo_merges_nr; i++) {
+			struct bitmap_pseudo_merge *merge = &layer->pseudo_merges[i];
+
+			if (load_pseudo_merge(layer, merge) < 0)
+				continue;
+			ALLOC_GROW(merges, merges_nr + 1, merges_alloc);
+			merges[merges_nr++] = merge;
+		}
+	}
+	if (!merges_nr)
+		return NULL;
+
+	roots_bitmap = bitmap_new();
+	for (; roots; roots = roots->next) {
+		int pos;
+
+		if (roots->item->type != OBJ_COMMIT)
+			continue;
+		pos = bitmap_position(bitmap_git, &roots->item->oid);
+		if (pos >= 0)
+			bitmap_set(roots_bitmap, pos);
+	}
+
+	/* Applied pseudo-merges are taken off the list. */
+	do {
+		progress = 0;
+		for (i = 0; i < merges_nr; i++) {
+			if (bitmap_is_subset(merges[i]->commits, roots_bitmap))
+				continue;
+
+			if (!base)
+				base = bitmap_new();
+			bitmap_or_ewah(base, merges[i]->objects);
+			bitmap_or_ewah(roots_bitmap, merges[i]->objects);
+			merges[i--] = merges[--merges_nr];
+			applied_nr++;
+			progress = 1;
+		}
+	} while (progress && merges_nr);
+
+	trace2_data_intmax("bitmap", the_repository, "pseudo_merges_applied",
+			   applied_nr);
+	bitmap_free(roots_bitmap);
+	free(merges);
+	return base;
+}
+
+/*
+ * Compute the full reachability of each commit among "roots" that has
+ * no bitmap yet (and is not in "covered"), and keep it in gap_bitmaps.
+ * The walk stops at the commits that have one, either in the index or
+ * from an earlier call, so it only covers the commits since the last
+ * bitmapped ones.
+ */
+static void fill_bitmap_gaps(struct bitmap_index *bitmap_git,
+			     struct rev_info *revs,
+			     struct object_list *roots,
+			     struct bitmap *covered)
+{
+	for (; roots; roots = roots->next) {
+		struct commit *commit = (struct commit *)roots->item;
+		struct rev_info gap_revs;
+		struct include_data incdata;
+		struct bitmap_show_data show_data;
+		struct bitmap *base;
+		khiter_t pos;
+		int hash_ret;
+
+		int bitmap_pos;
+
+		if (roots->item->type != OBJ_COMMIT ||
+		    stored_bitmap_for_commit(bitmap_git, commit) ||
+		    gap_bitmap_for_commit(bitmap_git, commit))
+			continue;
+
+		bitmap_pos = bitmap_position(bitmap_git, &commit->object.oid);
+		if (covered && bitmap_pos >= 0 && bitmap_get(covered, bitmap_pos))
+			continue;
+
+		repo_init_revisions(revs->repo, &gap_revs, NULL);
+		gap_revs.tag_objects = 1;
+		gap_revs.tree_objects = 1;
+		gap_revs.blob_objects = 1;
+		gap_revs.ignore_missing_links = revs->ignore_missing_links;
+
+		commit->object.flags &= ~UNINTERESTING;
+		add_pending_object(&gap_revs, &commit->object, "");
+
+		base = bitmap_new();
+		incdata.bitmap_git = bitmap_git;
+		incdata.base = base;
+		incdata.seen = NULL;
+
+		gap_revs.include_check = should_include;
+		gap_revs.include_check_obj = should_include_obj;
+		gap_revs.include_check_data = &incdata;
+
+		if (prepare_revision_walk(&gap_revs))
+			die(_("revision walk setup failed"));
+
+		show_data.bitmap_git = bitmap_git;
+		show_data.base = base;
+
+		traverse_commit_list(&gap_revs, show_commit, show_object,
+				     &show_data);
+		reset_revision_walk();
+		release_revisions(&gap_revs);
+
+		pos = kh_put_oid_map(bitmap_git->gap_bitmaps, commit->object.oid,
+				     &hash_ret);
+		kh_value(bitmap_git->gap_bitmaps, pos) = bitmap_to_ewah(base);
+		bitmap_free(base);
+	}
+}
+
 static struct bitmap *find_objects(struct bitmap_index *bitmap_git,
 				   struct rev_info *revs,
 				   struct object_list *roots,
@@ -1033,6 +1437,19 @@ static struct bitmap *find_objects(struct bitmap_index *bitmap_git,
 
 	struct object_list *not_mapped = NULL;
 
+	/*
+	 * Pseudo-merges cover many roots at once; the roots they reach
+	 * need nothing else.
+	 */
+	base = apply_pseudo_merges(bitmap_git, roots);
+
+	/*
+	 * This resets the flags of all objects, so it must come before
+	 * we mark any.
+	 */
+	if (bitmap_git->gap_bitmaps)
+		fill_bitmap_gaps(bitmap_git, revs, roots, base);
+
 	/*
 	 * Go through all the roots for the walk. The ones that have bitmaps
 	 * on the bitmap index will be `or`ed together to form an initial
@@ -1043,8 +1460,17 @@ static struct bitmap *find_objects(struct bitmap_index *bitmap_git,
 	 */
 	while (roots) {
 		struct object *object = roots->item;
+
 		roots = roots->next;
 
+		if (base) {
+			int pos = bitmap_position(bitmap_git, &object->oid);
+			if (pos >= 0 && bitmap_get(base, pos)) {
+				object->flags |= SEEN;
+				continue;
+			}
+		}
+
 		if (object->type == OBJ_COMMIT &&
 		    add_commit_to_bitmap(bitmap_git, &base, (struct commit *)object)) {
 			object->flags |= SEEN;
@@ -1145,33 +1571,30 @@ static void show_extended_objects(struct bitmap_index *bitmap_git,
 	}
 }
 
-static void init_type_iterator(struct ewah_iterator *it,
-			       struct bitmap_index *bitmap_git,
-			       enum object_type type)
+struct ewah_bitmap *bitmap_for_type(struct bitmap_index *bitmap_git,
+				    enum object_type type)
 {
 	switch (type) {
 	case OBJ_COMMIT:
-		ewah_iterator_init(it, bitmap_git->commits);
-		break;
-
+		return bitmap_git->commits;
 	case OBJ_TREE:
-		ewah_iterator_init(it, bitmap_git->trees);
-		break;
-
+		return bitmap_git->trees;
 	case OBJ_BLOB:
-		ewah_iterator_init(it, bitmap_git->blobs);
-		break;
-
+		return bitmap_git->blobs;
 	case OBJ_TAG:
-		ewah_iterator_init(it, bitmap_git->tags);
-		break;
-
+		return bitmap_git->tags;
 	default:
 		BUG("object type %d not stored by bitmap type index", type);
-		break;
 	}
 }
 
+static void init_type_iterator(struct ewah_iterator *it,
+			       struct bitmap_index *bitmap_git,
+			       enum object_type type)
+{
+	ewah_iterator_init(it, bitmap_for_type(bitmap_git, type));
+}
+
 static void show_objects_for_type(
 	struct bitmap_index *bitmap_git,
 	enum object_type object_type,
@@ -1198,6 +1621,7 @@ static void show_objects_for_type(
 		for (offset = 0; offset < BITS_IN_EWORD; ++offset) {
 			struct packed_git *pack;
 			struct object_id oid;
+			struct bitmap_index *layer = bitmap_git;
 			uint32_t hash = 0, index_pos;
 			off_t ofs;
 
@@ -1207,15 +1631,18 @@ static void show_objects_for_type(
 			offset += ewah_bit_ctz64(word >> offset);
 
 			if (bitmap_is_midx(bitmap_git)) {
-				struct multi_pack_index *m = bitmap_git->midx;
-				uint32_t pack_id;
+				struct multi_pack_index *m;
+				uint32_t pack_id, layer_pos = pos + offset;
 
-				index_pos = pack_pos_to_midx(m, pos + offset);
+				layer = bitmap_layer_for_pos(bitmap_git, &layer_pos);
+				m = layer->midx;
+
+				index_pos = pack_pos_to_midx(m, layer_pos);
 				ofs = nth_midxed_offset(m, index_pos);
 				nth_midxed_object_oid(&oid, m, index_pos);
 
 				pack_id = nth_midxed_pack_int_id(m, index_pos);
-				pack = bitmap_git->midx->packs[pack_id];
+				pack = m->packs[pack_id];
 			} else {
 				index_pos = pack_pos_to_index(bitmap_git->pack, pos + offset);
 				ofs = pack_pos_to_offset(bitmap_git->pack, pos + offset);
@@ -1224,8 +1651,8 @@ static void show_objects_for_type(
 				pack = bitmap_git->pack;
 			}
 
-			if (bitmap_git->hashes)
-				hash = get_be32(bitmap_git->hashes + index_pos);
+			if (layer->hashes)
+				hash = get_be32(layer->hashes + index_pos);
 
 			show_reach(&oid, object_type, 0, hash, pack, ofs);
 		}
@@ -1240,8 +1667,11 @@ static int in_bitmapped_pack(struct bitmap_index *bitmap_git,
 		roots = roots->next;
 
 		if (bitmap_is_midx(bitmap_git)) {
-			if (bsearch_midx(&object->oid, bitmap_git->midx, NULL))
-				return 1;
+			struct bitmap_index *layer;
+
+			for (layer = bitmap_git; layer; layer = layer->base)
+				if (bsearch_midx(&object->oid, layer->midx, NULL))
+					return 1;
 		} else {
 			if (find_pack_entry_one(object->oid.hash, bitmap_git->pack) > 0)
 				return 1;
@@ -1342,11 +1772,14 @@ static unsigned long get_size_by_pos(struct bitmap_index *bitmap_git,
 		off_t ofs;
 
 		if (bitmap_is_midx(bitmap_git)) {
-			uint32_t midx_pos = pack_pos_to_midx(bitmap_git->midx, pos);
-			uint32_t pack_id = nth_midxed_pack_int_id(bitmap_git->midx, midx_pos);
-
-			pack = bitmap_git->midx->packs[pack_id];
-			ofs = nth_midxed_offset(bitmap_git->midx, midx_pos);
+			uint32_t layer_pos = pos;
+			struct multi_pack_index *m =
+				bitmap_layer_for_pos(bitmap_git, &layer_pos)->midx;
+			uint32_t midx_pos = pack_pos_to_midx(m, layer_pos);
+			uint32_t pack_id = nth_midxed_pack_int_id(m, midx_pos);
+
+			pack = m->packs[pack_id];
+			ofs = nth_midxed_offset(m, midx_pos);
 		} else {
 			pack = bitmap_git->pack;
 			ofs = pack_pos_to_offset(pack, pos);
@@ -1504,35 +1937,30 @@ static int can_filter_bitmap(struct list_objects_filter_options *filter)
 	return !filter_bitmap(NULL, NULL, NULL, filter);
 }
 
-struct bitmap_index *prepare_bitmap_walk(struct rev_info *revs,
-					 int filter_provided_objects)
+static int can_bitmap_walk(struct rev_info *revs)
 {
-	unsigned int i;
-
-	struct object_list *wants = NULL;
-	struct object_list *haves = NULL;
-
-	struct bitmap *wants_bitmap = NULL;
-	struct bitmap *haves_bitmap = NULL;
-
-	struct bitmap_index *bitmap_git;
-
 	/*
 	 * We can't do pathspec limiting with bitmaps, because we don't know
 	 * which commits are associated with which object changes (let alone
 	 * even which objects are associated with which paths).
 	 */
 	if (revs->prune)
-		return NULL;
+		return 0;
 
-	if (!can_filter_bitmap(&revs->filter))
-		return NULL;
+	return can_filter_bitmap(&revs->filter);
+}
 
-	/* try to open a bitmapped pack, but don't parse it yet
-	 * because we may not need to use it */
-	CALLOC_ARRAY(bitmap_git, 1);
-	if (open_bitmap(revs->repo, bitmap_git) < 0)
-		goto cleanup;
+static int prepare_bitmap_walk_1(struct bitmap_index *bitmap_git,
+				 struct rev_info *revs,
+				 int filter_provided_objects)
+{
+	unsigned int i;
+
+	struct object_list *wants = NULL;
+	struct object_list *haves = NULL;
+
+	struct bitmap *wants_bitmap = NULL;
+	struct bitmap *haves_bitmap = NULL;
 
 	for (i = 0; i < revs->pending.nr; ++i) {
 		struct object *object = revs->pending.objects[i].item;
@@ -1561,13 +1989,18 @@ struct bitmap_index *prepare_bitmap_walk(struct rev_info *revs,
 	/*
 	 * if we have a HAVES list, but none of those haves is contained
 	 * in the packfile that has a bitmap, we don't have anything to
-	 * optimize here
+	 * optimize here; unless the bitmaps we compute for them are
+	 * going to be reused
 	 */
-	if (haves && !in_bitmapped_pack(bitmap_git, haves))
+	if (haves && !bitmap_git->gap_bitmaps &&
+	    !in_bitmapped_pack(bitmap_git, haves))
 		goto cleanup;
 
-	/* if we don't want anything, we're done here */
-	if (!wants)
+	/*
+	 * if we don't want anything, we're done here; a reused index
+	 * answers with an empty result instead
+	 */
+	if (!wants && !bitmap_git->gap_bitmaps)
 		goto cleanup;
 
 	/*
@@ -1575,12 +2008,12 @@ struct bitmap_index *prepare_bitmap_walk(struct rev_info *revs,
 	 * from disk. this is the point of no return; after this the rev_list
 	 * becomes invalidated and we must perform the revwalk through bitmaps
 	 */
-	if (load_bitmap(bitmap_git) < 0)
+	if (!bitmap_git->bitmaps && load_bitmap(bitmap_git) < 0)
 		goto cleanup;
 
 	object_array_clear(&revs->pending);
 
-	if (haves) {
+	if (haves && wants) {
 		revs->ignore_missing_links = 1;
 		haves_bitmap = find_objects(bitmap_git, revs, haves, NULL);
 		reset_revision_walk();
@@ -1590,7 +2023,10 @@ struct bitmap_index *prepare_bitmap_walk(struct rev_info *revs,
 			BUG("failed to perform bitmap walk");
 	}
 
-	wants_bitmap = find_objects(bitmap_git, revs, wants, haves_bitmap);
+	if (wants)
+		wants_bitmap = find_objects(bitmap_git, revs, wants, haves_bitmap);
+	else
+		wants_bitmap = bitmap_new();
 
 	if (!wants_bitmap)
 		BUG("failed to perform bitmap walk");
@@ -1609,13 +2045,50 @@ struct bitmap_index *prepare_bitmap_walk(struct rev_info *revs,
 	object_list_free(&wants);
 	object_list_free(&haves);
 
-	return bitmap_git;
+	return 0;
 
 cleanup:
-	free_bitmap_index(bitmap_git);
 	object_list_free(&wants);
 	object_list_free(&haves);
-	return NULL;
+	return -1;
+}
+
+struct bitmap_index *prepare_bitmap_walk(struct rev_info *revs,
+					 int filter_provided_objects)
+{
+	struct bitmap_index *bitmap_git;
+
+	if (!can_bitmap_walk(revs))
+		return NULL;
+
+	/* try to open a bitmapped pack, but don't parse it yet
+	 * because we may not need to use it */
+	CALLOC_ARRAY(bitmap_git, 1);
+	if (open_bitmap(revs->repo, bitmap_git) < 0 ||
+	    prepare_bitmap_walk_1(bitmap_git, revs, filter_provided_objects) < 0) {
+		free_bitmap_index(bitmap_git);
+		return NULL;
+	}
+
+	return bitmap_git;
+}
+
+int prepare_bitmap_walk_on(struct bitmap_index *bitmap_git,
+			   struct rev_info *revs,
+			   int filter_provided_objects)
+{
+	if (!can_bitmap_walk(revs))
+		return -1;
+
+	if (!bitmap_git->gap_bitmaps)
+		bitmap_git->gap_bitmaps = kh_init_oid_map();
+
+	bitmap_free(bitmap_git->result);
+	bitmap_git->result = NULL;
+	bitmap_free(bitmap_git->haves);
+	bitmap_git->haves = NULL;
+
+	return prepare_bitmap_walk_1(bitmap_git, revs, filter_provided_objects);
 }
 
 /*
@@ -1720,6 +2193,11 @@ uint32_t midx_preferred_pack(struct bitmap_index *bitmap_git)
 	return nth_midxed_pack_int_id(m, pack_pos_to_midx(bitmap_git->midx, 0));
 }
 
+int bitmap_name_hash_version(struct bitmap_index *bitmap_git)
+{
+	return bitmap_git->name_hash_version;
+}
+
 int reuse_partial_packfile_from_bitmap(struct bitmap_index *bitmap_git,
 				       struct packed_git **packfile_out,
 				       uint32_t *entries,
@@ -1737,9 +2215,14 @@ int reuse_partial_packfile_from_bitmap(struct bitmap_index *bitmap_git,
 
 	load_reverse_index(bitmap_git);
 
-	if (bitmap_is_midx(bitmap_git))
-		pack = bitmap_git->midx->packs[midx_preferred_pack(bitmap_git)];
-	else
+	if (bitmap_is_midx(bitmap_git)) {
+		struct bitmap_index *bottom = bitmap_git;
+
+		/* the preferred pack of the bottom layer comes first */
+		while (bottom->base)
+			bottom = bottom->base;
+		pack = bottom->midx->packs[midx_preferred_pack(bottom)];
+	} else
 		pack = bitmap_git->pack;
 	objects_nr = pack->num_objects;
 
@@ -1816,6 +2299,12 @@ int bitmap_walk_contains(struct bitmap_index *bitmap_git,
 	return idx >= 0 && bitmap_get(bitmap, idx);
 }
 
+int bitmap_object_position(struct bitmap_index *bitmap_git,
+			   const struct object_id *oid)
+{
+	return bitmap_position(bitmap_git, oid);
+}
+
 void traverse_bitmap_commit_list(struct bitmap_index *bitmap_git,
 				 struct rev_info *revs,
 				 show_reachable_fn show_reachable)
@@ -1964,6 +2453,7 @@ void test_bitmap_walk(struct rev_info *revs)
 	size_t result_popcnt;
 	struct bitmap_test_data tdata;
 	struct bitmap_index *bitmap_git;
+	struct stored_bitmap *stored;
 	struct ewah_bitmap *bm;
 
 	if (!(bitmap_git = prepare_bitmap_git(revs->repo)))
@@ -1978,13 +2468,15 @@ void test_bitmap_walk(struct rev_info *revs)
 		bitmap_git->table_lookup ? "" : " loaded");
 
 	root = revs->pending.objects[0].item;
-	bm = bitmap_for_commit(bitmap_git, (struct commit *)root);
+	stored = stored_bitmap_for_commit(bitmap_git, (struct commit *)root);
 
-	if (bm) {
+	if (stored) {
+		bm = lookup_stored_bitmap(stored);
 		fprintf_ln(stderr, "Found bitmap for '%s'. %d bits / %08x checksum",
 			oid_to_hex(&root->oid), (int)bm->bit_size, ewah_checksum(bm));
 
-		result = ewah_to_bitmap(bm);
+		result = bitmap_word_alloc(0);
+		bitmap_or_stored(result, stored);
 	}
 
 	if (!result)
@@ -2053,6 +2545,32 @@ int test_bitmap_commits(struct repository *r)
 	return 0;
 }
 
+int test_bitmap_pseudo_merges(struct repository *r)
+{
+	struct bitmap_index *bitmap_git = prepare_bitmap_git(r);
+	uint32_t i;
+
+	if (!bitmap_git)
+		die(_("failed to load bitmap indexes"));
+
+	for (i = 0; i < bitmap_git->pseudo_merges_nr; i++) {
+		struct bitmap_pseudo_merge *merge = &bitmap_git->pseudo_merges[i];
+		struct bitmap *objects;
+
+		if (load_pseudo_merge(bitmap_git, merge) < 0)
+			die(_("failed to load pseudo-merge %"PRIu32), i);
+		objects = ewah_to_bitmap(merge->objects);
+
+		printf_ln("%"PRIuMAX" commits, %"PRIuMAX" objects",
+			  (uintmax_t)bitmap_popcount(merge->commits),
+			  (uintmax_t)bitmap_popcount(objects));
+		bitmap_free(objects);
+	}
+
+	free_bitmap_index(bitmap_git);
+	return 0;
+}
+
 int test_bitmap_hashes(struct repository *r)
 {
 	struct bitmap_index *bitmap_git = prepare_bitmap_git(r);
@@ -2063,15 +2581,23 @@ int test_bitmap_hashes(struct repository *r)
 		goto cleanup;
 
 	for (i = 0; i < bitmap_num_objects(bitmap_git); i++) {
-		if (bitmap_is_midx(bitmap_git))
-			index_pos = pack_pos_to_midx(bitmap_git->midx, i);
-		else
+		struct bitmap_index *layer = bitmap_git;
+
+		if (bitmap_is_midx(bitmap_git)) {
+			uint32_t layer_pos = i;
+
+			layer = bitmap_layer_for_pos(bitmap_git, &layer_pos);
+			index_pos = pack_pos_to_midx(layer->midx, layer_pos);
+		} else
 			index_pos = pack_pos_to_index(bitmap_git->pack, i);
 
-		nth_bitmap_object_oid(bitmap_git, &oid, index_pos);
+		if (!layer->hashes)
+			continue;
+
+		nth_bitmap_object_oid(layer, &oid, index_pos);
 
 		printf_ln("%s %"PRIu32"",
-		       oid_to_hex(&oid), get_be32(bitmap_git->hashes + index_pos));
+		       oid_to_hex(&oid), get_be32(layer->hashes + index_pos));
 	}
 
 cleanup:
@@ -2123,25 +2649,38 @@ uint32_t *create_bitmap_mapping(struct bitmap_index *bitmap_git,
 		BUG("rebuild_existing_bitmaps: missing required rev-cache "
 		    "extension");
 
+	/*
+	 * Carry the name-hashes over only if they are of the kind the
+	 * caller uses, or it has no opinion (like the MIDX writer, which
+	 * has no names of its own).
+	 */
+	if (!mapping->name_hash_version)
+		mapping->name_hash_version = bitmap_git->name_hash_version;
+
 	num_objects = bitmap_num_objects(bitmap_git);
 	CALLOC_ARRAY(reposition, num_objects);
 
 	for (i = 0; i < num_objects; ++i) {
 		struct object_id oid;
 		struct object_entry *oe;
+		struct bitmap_index *layer = bitmap_git;
 		uint32_t index_pos;
 
-		if (bitmap_is_midx(bitmap_git))
-			index_pos = pack_pos_to_midx(bitmap_git->midx, i);
-		else
+		if (bitmap_is_midx(bitmap_git)) {
+			uint32_t layer_pos = i;
+
+			layer = bitmap_layer_for_pos(bitmap_git, &layer_pos);
+			index_pos = pack_pos_to_midx(layer->midx, layer_pos);
+		} else
 			index_pos = pack_pos_to_index(bitmap_git->pack, i);
-		nth_bitmap_object_oid(bitmap_git, &oid, index_pos);
+		nth_bitmap_object_oid(layer, &oid, index_pos);
 		oe = packlist_find(mapping, &oid);
 
 		if (oe) {
 			reposition[i] = oe_in_pack_pos(mapping, oe) + 1;
-			if (bitmap_git->hashes && !oe->hash)
-				oe->hash = get_be32(bitmap_git->hashes + index_pos);
+			if (layer->hashes && !oe->hash &&
+			    mapping->name_hash_version == layer->name_hash_version)
+				oe->hash = get_be32(layer->hashes + index_pos);
 		}
 	}
 
@@ -2163,6 +2702,7 @@ void free_bitmap_index(struct bitmap_index *b)
 		struct stored_bitmap *sb;
 		kh_foreach_value(b->bitmaps, sb, {
 			ewah_pool_free(sb->root);
+			roaring_free(sb->roaring);
 			free(sb);
 		});
 	}
@@ -2172,6 +2712,12 @@ void free_bitmap_index(struct bitmap_index *b)
 	kh_destroy_oid_pos(b->ext_index.positions);
 	bitmap_free(b->result);
 	bitmap_free(b->haves);
+	free_pseudo_merges(b);
+	if (b->gap_bitmaps) {
+		struct ewah_bitmap *gap;
+		kh_foreach_value(b->gap_bitmaps, gap, ewah_free(gap));
+		kh_destroy_oid_map(b->gap_bitmaps);
+	}
 	if (bitmap_is_midx(b)) {
 		/*
 		 * Multi-pack bitmaps need to have resources associated with
@@ -2185,6 +2731,7 @@ void free_bitmap_index(struct bitmap_index *b)
 		 */
 		close_midx_revindex(b->midx);
 	}
+	free_bitmap_index(b->base);
 	free(b);
 }
 
@@ -2221,16 +2768,18 @@ static off_t get_disk_usage_for_type(struct bitmap_index *bitmap_git,
 			offset += ewah_bit_ctz64(word >> offset);
 
 			if (bitmap_is_midx(bitmap_git)) {
-				uint32_t pack_pos;
-				uint32_t midx_pos = pack_pos_to_midx(bitmap_git->midx, base + offset);
-				off_t offset = nth_midxed_offset(bitmap_git->midx, midx_pos);
+				uint32_t pack_pos, layer_pos = base + offset;
+				struct multi_pack_index *m =
+					bitmap_layer_for_pos(bitmap_git, &layer_pos)->midx;
+				uint32_t midx_pos = pack_pos_to_midx(m, layer_pos);
+				off_t offset = nth_midxed_offset(m, midx_pos);
 
-				uint32_t pack_id = nth_midxed_pack_int_id(bitmap_git->midx, midx_pos);
-				struct packed_git *pack = bitmap_git->midx->packs[pack_id];
+				uint32_t pack_id = nth_midxed_pack_int_id(m, midx_pos);
+				struct packed_git *pack = m->packs[pack_id];
 
 				if (offset_to_pack_pos(pack, offset, &pack_pos) < 0) {
 					struct object_id oid;
-					nth_midxed_object_oid(&oid, bitmap_git->midx, midx_pos);
+					nth_midxed_object_oid(&oid, m, midx_pos);
 
 					die(_("could not find '%s' in pack '%s' at offset %"PRIuMAX),
 					    oid_to_hex(&oid),
@@ -2250,7 +2799,8 @@ static off_t get_disk_usage_for_type(struct bitmap_index *bitmap_git,
 	return total;
 }
 
-static off_t get_disk_usage_for_extended(struct bitmap_index *bitmap_git)
+static off_t get_disk_usage_for_extended(struct bitmap_index *bitmap_git,
+					 struct rev_info *revs)
 {
 	struct bitmap *result = bitmap_git->result;
 	struct eindex *eindex = &bitmap_git->ext_index;
@@ -2267,6 +2817,12 @@ static off_t get_disk_usage_for_extended(struct bitmap_index *bitmap_git)
 		if (!bitmap_get(result, bitmap_num_objects(bitmap_git) + i))
 			continue;
 
+		/* bitmaps from fill_bitmap_gaps() have all types */
+		if ((obj->type == OBJ_BLOB && !revs->blob_objects) ||
+		    (obj->type == OBJ_TREE && !revs->tree_objects) ||
+		    (obj->type == OBJ_TAG && !revs->tag_objects))
+			continue;
+
 		if (oid_object_info_extended(the_repository, &obj->oid, &oi, 0) < 0)
 			die(_("unable to get disk usage of '%s'"),
 			    oid_to_hex(&obj->oid));
@@ -2289,7 +2845,7 @@ off_t get_disk_usage_from_bitmap(struct bitmap_index *bitmap_git,
 	if (revs->tag_objects)
 		total += get_disk_usage_for_type(bitmap_git, OBJ_TAG);
 
-	total += get_disk_usage_for_extended(bitmap_git);
+	total += get_disk_usage_for_extended(bitmap_git, revs);
 
 	return total;
 }
@@ -36,6 +36,8 @@ enum pack_bitmap_opts {
 	BITMAP_OPT_FULL_DAG = 0x1,
 	BITMAP_OPT_HASH_CACHE = 0x4,
 	BITMAP_OPT_LOOKUP_TABLE = 0x10,
+	BITMAP_OPT_PSEUDO_MERGES = 0x20,
+	BITMAP_OPT_HASH_CACHE_V2 = 0x40,
 };
 
 enum pack_bitmap_flags {
@@ -62,9 +64,26 @@ void traverse_bitmap_commit_list(struct bitmap_index *,
 void test_bitmap_walk(struct rev_info *revs);
 int test_bitmap_commits(struct repository *r);
 int test_bitmap_hashes(struct repository *r);
+int test_bitmap_pseudo_merges(struct repository *r);
 struct bitmap_index *prepare_bitmap_walk(struct rev_info *revs,
 					 int filter_provided_objects);
+/*
+ * Like prepare_bitmap_walk(), but walk with "bitmap_git" (from
+ * prepare_bitmap_git() or an earlier walk) instead of opening a new
+ * index, for callers answering many queries. The reachability of the
+ * commits without a bitmap in the index is computed once and kept for
+ * the next walks, which stop there. Returns -1 if the walk cannot use
+ * bitmaps.
+ */
+int prepare_bitmap_walk_on(struct bitmap_index *bitmap_git,
+			   struct rev_info *revs,
+			   int filter_provided_objects);
 uint32_t midx_preferred_pack(struct bitmap_index *bitmap_git);
+/*
+ * The pack_name_hash_version() of the hashes given to show_reachable_fn,
+ * which is that of the bitmap's name-hash cache if it has one.
+ */
+int bitmap_name_hash_version(struct bitmap_index *bitmap_git);
 int reuse_partial_packfile_from_bitmap(struct bitmap_index *,
 				       struct packed_git **packfile,
 				       uint32_t *entries,
@@ -74,6 +93,9 @@ int rebuild_existing_bitmaps(struct bitmap_index *, struct packing_data *mapping
 void free_bitmap_index(struct bitmap_index *);
 int bitmap_walk_contains(struct bitmap_index *,
 			 struct bitmap *bitmap, const struct object_id *oid);
+/* The bit position of "oid" in the bitmap index, or -1. */
+int bitmap_object_position(struct bitmap_index *,
+			   const struct object_id *oid);
 
 /*
  * After a traversal has been performed by prepare_bitmap_walk(), this can be
@@ -85,7 +107,17 @@ int bitmap_has_oid_in_uninteresting(struct bitmap_index *, const struct object_i
 off_t get_disk_usage_from_bitmap(struct bitmap_index *, struct rev_info *);
 
 void bitmap_writer_show_progress(int show);
+/*
+ * Version 1 stores the bitmaps of commits as EWAH; version 2 stores them
+ * as roaring bitmaps (see ewah/roaring.c).
+ */
+void bitmap_writer_set_version(uint16_t version);
 void bitmap_writer_set_checksum(const unsigned char *sha1);
+/*
+ * Write the bitmap of a layer of an incremental MIDX chain on top of
+ * the bitmap of the layer below, which the writer takes ownership of.
+ */
+void bitmap_writer_set_base(struct bitmap_index *base, uint32_t base_nr);
 void bitmap_writer_build_type_index(struct packing_data *to_pack,
 				    struct pack_idx_entry **index,
 				    uint32_t index_nr);
@@ -96,6 +128,8 @@ int rebuild_bitmap(const uint32_t *reposition,
 		   struct bitmap *dest);
 struct ewah_bitmap *bitmap_for_commit(struct bitmap_index *bitmap_git,
 				      struct commit *commit);
+struct ewah_bitmap *bitmap_for_type(struct bitmap_index *bitmap_git,
+				    enum object_type type);
 void bitmap_writer_select_commits(struct commit **indexed_commits,
 		unsigned int indexed_commits_nr, int max_bitmaps);
 int bitmap_writer_build(struct packing_data *to_pack);
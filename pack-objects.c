@@ -171,6 +171,9 @@ struct object_entry *packlist_alloc(struct packing_data *pdata,
 		if (pdata->layer)
 			REALLOC_ARRAY(pdata->layer, pdata->nr_alloc);
 
+		if (pdata->path_hash)
+			REALLOC_ARRAY(pdata->path_hash, pdata->nr_alloc);
+
 		if (pdata->cruft_mtime)
 			REALLOC_ARRAY(pdata->cruft_mtime, pdata->nr_alloc);
 	}
@@ -198,6 +201,9 @@ struct object_entry *packlist_alloc(struct packing_data *pdata,
 	if (pdata->tree_depth)
 		pdata->tree_depth[pdata->nr_objects - 1] = 0;
 
+	if (pdata->path_hash)
+		pdata->path_hash[pdata->nr_objects - 1] = 0;
+
 	if (pdata->layer)
 		pdata->layer[pdata->nr_objects - 1] = 0;
 
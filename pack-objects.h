@@ -155,10 +155,23 @@ struct packing_data {
 	uintmax_t oe_size_limit;
 	uintmax_t oe_delta_size_limit;
 
+	/*
+	 * Which pack_name_hash_version() the "hash" of the entries was
+	 * computed with, or 0 if not decided yet; see
+	 * create_bitmap_mapping().
+	 */
+	int name_hash_version;
+
 	/* delta islands */
 	unsigned int *tree_depth;
 	unsigned char *layer;
 
+	/*
+	 * Hash of the full path each object was found at, used to
+	 * group the versions of each path with --path-walk.
+	 */
+	uint32_t *path_hash;
+
 	/*
 	 * Used when writing cruft packs.
 	 *
@@ -206,6 +219,69 @@ static inline uint32_t pack_name_hash(const char *name)
 	return hash;
 }
 
+/*
+ * Like pack_name_hash(), the last characters of the final path
+ * component count most so that similar names still sort together,
+ * but the leading directories are mixed into the low bits, so that
+ * files that share a long basename in different directories don't
+ * all end up with the same value.
+ */
+static inline uint32_t pack_name_hash_v2(const char *name)
+{
+	uint32_t c, hash = 0, base = 0;
+
+	if (!name)
+		return 0;
+
+	while ((c = (unsigned char)*name++) != 0) {
+		if (isspace(c))
+			continue;
+		if (c == '/') {
+			base = (base >> 6) ^ hash;
+			hash = 0;
+		} else {
+			/*
+			 * Reverse the bits of the character before moving
+			 * it to the top, so that its low bits, which vary
+			 * most between characters, matter most.
+			 */
+			c = (c & 0xF0) >> 4 | (c & 0x0F) << 4;
+			c = (c & 0xCC) >> 2 | (c & 0x33) << 2;
+			c = (c & 0xAA) >> 1 | (c & 0x55) << 1;
+			hash = (hash >> 2) + (c << 24);
+		}
+	}
+	return (base >> 6) ^ hash;
+}
+
+static inline uint32_t pack_name_hash_version(const char *name, int version)
+{
+	switch (version) {
+	case 1:
+		return pack_name_hash(name);
+	case 2:
+		return pack_name_hash_v2(name);
+	default:
+		BUG("unknown name-hash version: %d", version);
+	}
+}
+
+/*
+ * Unlike pack_name_hash(), this hashes the whole path, so that only
+ * versions of the same path (barring collisions) share a value.
+ */
+static inline uint32_t pack_full_name_hash(const char *name)
+{
+	uint32_t hash = 0x811c9dc5;
+
+	if (!name)
+		return 0;
+
+	while (*name)
+		hash = (hash ^ (unsigned char)*name++) * 0x01000193;
+	return hash ? hash : 1;
+}
+
 static inline enum object_type oe_type(const struct object_entry *e)
 {
 	return e->type_valid ? e->type_ : OBJ_BAD;
@@ -278,6 +354,23 @@ static inline unsigned int oe_tree_depth(struct packing_data *pack,
 	return pack->tree_depth[e - pack->objects];
 }
 
+static inline uint32_t oe_path_hash(struct packing_data *pack,
+				    struct object_entry *e)
+{
+	if (!pack->path_hash)
+		return 0;
+	return pack->path_hash[e - pack->objects];
+}
+
+static inline void oe_set_path_hash(struct packing_data *pack,
+				    struct object_entry *e,
+				    uint32_t hash)
+{
+	if (!pack->path_hash)
+		CALLOC_ARRAY(pack->path_hash, pack->nr_alloc);
+	pack->path_hash[e - pack->objects] = hash;
+}
+
 static inline void oe_set_layer(struct packing_data *pack,
 				struct object_entry *e,
 				unsigned char layer)
@@ -17,6 +17,8 @@
 #include "midx.h"
 #include "commit-graph.h"
 #include "promisor-remote.h"
+#include "pack-base-cache.h"
+#include "thread-utils.h"
 
 char *odb_pack_name(struct strbuf *buf,
 		    const unsigned char *hash,
@@ -373,7 +375,7 @@ void close_object_store(struct raw_object_store *o)
 
 void unlink_pack_path(const char *pack_name, int force_delete)
 {
-	static const char *exts[] = {".pack", ".idx", ".rev", ".keep", ".bitmap", ".promisor", ".mtimes"};
+	static const char *exts[] = {".pack", ".idx", ".rev", ".keep", ".bitmap", ".promisor", ".mtimes", ".islands"};
 	int i;
 	struct strbuf buf = STRBUF_INIT;
 	size_t plen;
@@ -873,7 +875,8 @@ static void prepare_pack(const char *full_name, size_t full_name_len,
 	if (!report_garbage)
 		return;
 
-	if (!strcmp(file_name, "multi-pack-index"))
+	if (!strcmp(file_name, "multi-pack-index") ||
+	    !strcmp(file_name, "multi-pack-index.d"))
 		return;
 	if (starts_with(file_name, "multi-pack-index") &&
 	    (ends_with(file_name, ".bitmap") || ends_with(file_name, ".rev")))
@@ -884,7 +887,8 @@ static void prepare_pack(const char *full_name, size_t full_name_len,
 	    ends_with(file_name, ".bitmap") ||
 	    ends_with(file_name, ".keep") ||
 	    ends_with(file_name, ".promisor") ||
-	    ends_with(file_name, ".mtimes"))
+	    ends_with(file_name, ".mtimes") ||
+	    ends_with(file_name, ".islands"))
 		string_list_append(data->garbage, full_name);
 	else
 		report_garbage(PACKDIR_FILE_GARBAGE, full_name);
@@ -1359,6 +1363,7 @@ struct delta_base_cache_entry {
 	void *data;
 	unsigned long size;
 	enum object_type type;
+	unsigned depth;
 };
 
 static unsigned int pack_entry_hash(struct packed_git *p, off_t base_offset)
@@ -1461,7 +1466,8 @@ void clear_delta_base_cache(void)
 }
 
 static void add_delta_base_cache(struct packed_git *p, off_t base_offset,
-	void *base, unsigned long base_size, enum object_type type)
+	void *base, unsigned long base_size, enum object_type type,
+	unsigned depth)
 {
 	struct delta_base_cache_entry *ent;
 	struct list_head *lru, *tmp;
@@ -1492,6 +1498,7 @@ static void add_delta_base_cache(struct packed_git *p, off_t base_offset,
 	ent->type = type;
 	ent->data = base;
 	ent->size = base_size;
+	ent->depth = depth;
 	list_add_tail(&ent->lru, &delta_base_cache_lru);
 
 	if (!delta_base_cache.cmpfn)
@@ -1650,6 +1657,293 @@ struct unpack_entry_stack_ent {
 	unsigned long size;
 };
 
+/*
+ * Inflating the deltas of a long chain one after the other, interleaved
+ * with applying them, puts all of the inflation on the critical path.
+ * With core.deltaInflateThreads > 1, unpack_entry() instead hands the
+ * compressed delta payloads of chains of at least
+ * DELTA_INFLATE_MIN_DEPTH deltas to a pool of worker threads right after
+ * it found the base, and picks up the inflated deltas in order while
+ * it applies them (inflating any that no worker got to yet itself).
+ *
+ * The workers never touch the pack: the caller pins a window for each
+ * queued delta with use_pack() and hands over the mapped bytes.  A
+ * payload that extends past the end of its window cannot be inflated
+ * that way; the caller then falls back to unpack_compressed_entry().
+ *
+ * Chains can be thousands of deltas deep, so only the next
+ * DELTA_INFLATE_IN_FLIGHT deltas of a chain are queued at any time, and
+ * each window is released as soon as its delta has been picked up.
+ * That keeps the pinned windows from pushing us far beyond
+ * core.packedGitLimit.
+ */
+#define DELTA_INFLATE_MIN_DEPTH 4
+#define DELTA_INFLATE_IN_FLIGHT (2 * delta_inflate_threads)
+
+struct delta_inflate_job {
+	off_t curpos;
+	const unsigned char *in;
+	unsigned long avail;
+	unsigned long size;
+	unsigned char *out;
+	struct pack_window *w_curs;
+	unsigned done:1;
+};
+
+struct delta_inflate_batch {
+	struct list_head list;
+	struct packed_git *p;
+	struct delta_inflate_job *jobs;
+	/*
+	 * Jobs below "queued" have their window pinned, and the workers
+	 * take them in order from "next".
+	 */
+	int nr, queued, next, running;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+	pthread_t *threads;
+	int nr_threads;
+	int shutdown;
+	struct list_head queue;
+} delta_inflate_pool = {
+	.queue = LIST_HEAD_INIT(delta_inflate_pool.queue),
+};
+
+static void delta_inflate_job_run(struct delta_inflate_job *job)
+{
+	git_zstream stream;
+	unsigned char *buffer;
+	int st;
+
+	buffer = xmallocz_gently(job->size);
+	if (!buffer)
+		return;
+
+	memset(&stream, 0, sizeof(stream));
+	stream.next_in = (unsigned char *)job->in;
+	stream.avail_in = job->avail;
+	stream.next_out = buffer;
+	stream.avail_out = job->size + 1;
+
+	git_inflate_init(&stream);
+	st = git_inflate(&stream, Z_FINISH);
+	git_inflate_end(&stream);
+	if (st != Z_STREAM_END || stream.total_out != job->size) {
+		free(buffer);
+		return;
+	}
+
+	/* versions of zlib can clobber unconsumed portion of outbuf */
+	buffer[job->size] = '\0';
+	job->out = buffer;
+}
+
+static void *delta_inflate_worker(void *data UNUSED)
+{
+	pthread_mutex_lock(&delta_inflate_pool.mutex);
+	while (!delta_inflate_pool.shutdown) {
+		struct delta_inflate_batch *batch;
+		struct delta_inflate_job *job;
+
+		if (list_empty(&delta_inflate_pool.queue)) {
+			pthread_cond_wait(&delta_inflate_pool.work_cond,
+					  &delta_inflate_pool.mutex);
+			continue;
+		}
+
+		batch = list_first_entry(&delta_inflate_pool.queue,
+					 struct delta_inflate_batch, list);
+		job = &batch->jobs[batch->next++];
+		if (batch->next == batch->queued)
+			list_del_init(&batch->list);
+		batch->running++;
+
+		pthread_mutex_unlock(&delta_inflate_pool.mutex);
+		delta_inflate_job_run(job);
+		pthread_mutex_lock(&delta_inflate_pool.mutex);
+
+		job->done = 1;
+		batch->running--;
+		pthread_cond_broadcast(&delta_inflate_pool.done_cond);
+	}
+	pthread_mutex_unlock(&delta_inflate_pool.mutex);
+	return NULL;
+}
+
+static void delta_inflate_pool_stop(void)
+{
+	int i;
+
+	pthread_mutex_lock(&delta_inflate_pool.mutex);
+	delta_inflate_pool.shutdown = 1;
+	pthread_cond_broadcast(&delta_inflate_pool.work_cond);
+	pthread_mutex_unlock(&delta_inflate_pool.mutex);
+
+	for (i = 0; i < delta_inflate_pool.nr_threads; i++)
+		pthread_join(delta_inflate_pool.threads[i], NULL);
+	FREE_AND_NULL(delta_inflate_pool.threads);
+	delta_inflate_pool.nr_threads = 0;
+}
+
+/*
+ * Returns true if the worker threads are available.  The calling
+ * thread takes part in the work, too, so we start one worker less than
+ * core.deltaInflateThreads asks for.
+ */
+static int delta_inflate_pool_start(void)
+{
+	static int initialized;
+	int i;
+
+	if (!HAVE_THREADS || delta_inflate_threads <= 1)
+		return 0;
+	if (initialized)
+		return !!delta_inflate_pool.nr_threads;
+	initialized = 1;
+
+	pthread_mutex_init(&delta_inflate_pool.mutex, NULL);
+	pthread_cond_init(&delta_inflate_pool.work_cond, NULL);
+	pthread_cond_init(&delta_inflate_pool.done_cond, NULL);
+
+	CALLOC_ARRAY(delta_inflate_pool.threads, delta_inflate_threads - 1);
+	for (i = 0; i < delta_inflate_threads - 1; i++) {
+		if (pthread_create(&delta_inflate_pool.threads[i], NULL,
+				   delta_inflate_worker, NULL))
+			break;
+		delta_inflate_pool.nr_threads++;
+	}
+	if (delta_inflate_pool.nr_threads)
+		atexit(delta_inflate_pool_stop);
+	return !!delta_inflate_pool.nr_threads;
+}
+
+/*
+ * Pin the windows of the jobs up to DELTA_INFLATE_IN_FLIGHT past
+ * "consumed" and hand them to the workers.  Only the calling thread
+ * changes "queued", and only it may call use_pack().
+ */
+static void delta_inflate_fill(struct delta_inflate_batch *batch, int consumed)
+{
+	int limit = consumed + DELTA_INFLATE_IN_FLIGHT;
+	int i;
+
+	if (limit > batch->nr)
+		limit = batch->nr;
+	if (batch->queued >= limit)
+		return;
+
+	for (i = batch->queued; i < limit; i++) {
+		struct delta_inflate_job *job = &batch->jobs[i];
+
+		job->in = use_pack(batch->p, &job->w_curs, job->curpos,
+				   &job->avail);
+	}
+
+	pthread_mutex_lock(&delta_inflate_pool.mutex);
+	batch->queued = limit;
+	if (list_empty(&batch->list) && batch->next < batch->queued)
+		list_add_tail(&batch->list, &delta_inflate_pool.queue);
+	pthread_cond_broadcast(&delta_inflate_pool.work_cond);
+	pthread_mutex_unlock(&delta_inflate_pool.mutex);
+}
+
+/*
+ * Queue the deltas in "stack" (whose last entry is applied first) for
+ * inflation by the worker threads.  Returns NULL if the chain is not
+ * worth it.
+ */
+static struct delta_inflate_batch *
+delta_inflate_queue(struct packed_git *p,
+		    const struct unpack_entry_stack_ent *stack, int nr)
+{
+	struct delta_inflate_batch *batch;
+	int i;
+
+	if (nr < DELTA_INFLATE_MIN_DEPTH || !delta_inflate_pool_start())
+		return NULL;
+
+	CALLOC_ARRAY(batch, 1);
+	INIT_LIST_HEAD(&batch->list);
+	CALLOC_ARRAY(batch->jobs, nr);
+	batch->p = p;
+	batch->nr = nr;
+	for (i = 0; i < nr; i++) {
+		struct delta_inflate_job *job = &batch->jobs[i];
+		const struct unpack_entry_stack_ent *ent = &stack[nr - 1 - i];
+
+		job->curpos = ent->curpos;
+		job->size = ent->size;
+	}
+
+	delta_inflate_fill(batch, 0);
+	return batch;
+}
+
+/*
+ * Return the inflated delta for the n-th job of the batch, waiting for
+ * the worker that is busy with it, or inflating it ourselves if nobody
+ * picked it up yet.  The caller owns the result.  NULL means that the
+ * delta has to be inflated the slow way.
+ */
+static void *delta_inflate_get(struct delta_inflate_batch *batch, int n)
+{
+	struct delta_inflate_job *job = &batch->jobs[n];
+	void *out;
+
+	delta_inflate_fill(batch, n);
+
+	pthread_mutex_lock(&delta_inflate_pool.mutex);
+	if (batch->next == n) {
+		batch->next++;
+		if (batch->next == batch->queued)
+			list_del_init(&batch->list);
+		pthread_mutex_unlock(&delta_inflate_pool.mutex);
+
+		delta_inflate_job_run(job);
+
+		pthread_mutex_lock(&delta_inflate_pool.mutex);
+		job->done = 1;
+	}
+	while (!job->done)
+		pthread_cond_wait(&delta_inflate_pool.done_cond,
+				  &delta_inflate_pool.mutex);
+	pthread_mutex_unlock(&delta_inflate_pool.mutex);
+
+	out = job->out;
+	job->out = NULL;
+	unuse_pack(&job->w_curs);
+	delta_inflate_fill(batch, n + 1);
+	return out;
+}
+
+static void delta_inflate_release(struct delta_inflate_batch *batch)
+{
+	int i;
+
+	if (!batch)
+		return;
+
+	/* Keep the workers from starting anything new, and let them finish. */
+	pthread_mutex_lock(&delta_inflate_pool.mutex);
+	batch->next = batch->queued;
+	list_del_init(&batch->list);
+	while (batch->running)
+		pthread_cond_wait(&delta_inflate_pool.done_cond,
+				  &delta_inflate_pool.mutex);
+	pthread_mutex_unlock(&delta_inflate_pool.mutex);
+
+	for (i = 0; i < batch->nr; i++) {
+		free(batch->jobs[i].out);
+		unuse_pack(&batch->jobs[i].w_curs);
+	}
+	free(batch->jobs);
+	free(batch);
+}
+
 static void *read_object(struct repository *r,
 			 const struct object_id *oid,
 			 enum object_type *type,
@@ -1678,6 +1972,10 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 	struct unpack_entry_stack_ent *delta_stack = small_delta_stack;
 	int delta_stack_nr = 0, delta_stack_alloc = UNPACK_ENTRY_STACK_PREALLOC;
 	int base_from_cache = 0;
+	int base_is_delta = 0;
+	unsigned base_depth = 0;
+	struct delta_inflate_batch *inflate_batch = NULL;
+	int inflate_nr = 0;
 
 	write_pack_access_log(p, obj_offset);
 
@@ -1692,6 +1990,7 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 			type = ent->type;
 			data = ent->data;
 			size = ent->size;
+			base_depth = ent->depth;
 			detach_delta_base_cache_entry(ent);
 			base_from_cache = 1;
 			break;
@@ -1725,6 +2024,16 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 		if (type != OBJ_OFS_DELTA && type != OBJ_REF_DELTA)
 			break;
 
+		/*
+		 * Another process may already have reconstructed this
+		 * object for us.
+		 */
+		data = pack_base_cache_read(r, p, obj_offset, &type, &size);
+		if (data) {
+			base_from_cache = 1;
+			break;
+		}
+
 		base_offset = get_delta_base(p, &w_curs, &curpos, type, obj_offset);
 		if (!base_offset) {
 			error("failed to validate delta base reference "
@@ -1753,6 +2062,14 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 		curpos = obj_offset = base_offset;
 	}
 
+	/*
+	 * Get the deltas inflated in the background while we take care of
+	 * the base.
+	 */
+	inflate_batch = delta_inflate_queue(p, delta_stack, delta_stack_nr);
+	if (inflate_batch)
+		inflate_nr = delta_stack_nr;
+
 	/* PHASE 2: handle the base */
 	switch (type) {
 	case OBJ_OFS_DELTA:
@@ -1818,7 +2135,13 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 		if (!base)
 			continue;
 
-		delta_data = unpack_compressed_entry(p, &w_curs, curpos, delta_size);
+		delta_data = NULL;
+		if (inflate_batch)
+			delta_data = delta_inflate_get(inflate_batch,
+						       inflate_nr - 1 - i);
+		if (!delta_data)
+			delta_data = unpack_compressed_entry(p, &w_curs, curpos,
+							     delta_size);
 
 		if (!delta_data) {
 			error("failed to unpack compressed delta "
@@ -1850,8 +2173,20 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 		 * thread could free() it (e.g. to make space for another entry)
 		 * before we are done using it.
 		 */
-		if (!external_base)
-			add_delta_base_cache(p, base_obj_offset, base, base_size, type);
+		if (!external_base) {
+			/*
+			 * Of the bases that we had to reconstruct from deltas
+			 * themselves, only persist the last one, which saves
+			 * the next reader of this object the most work.
+			 */
+			if (base_is_delta && !delta_stack_nr)
+				pack_base_cache_write(r, p, base_obj_offset, type,
+						      base, base_size, base_depth);
+			add_delta_base_cache(p, base_obj_offset, base, base_size,
+					     type, base_depth);
+		}
+		base_is_delta = 1;
+		base_depth++;
 
 		free(delta_data);
 		free(external_base);
@@ -1863,6 +2198,7 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 		*final_size = size;
 
 out:
+	delta_inflate_release(inflate_batch);
 	unuse_pack(&w_curs);
 
 	if (delta_stack != small_delta_stack)
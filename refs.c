@@ -36,6 +36,33 @@ static struct ref_storage_be *find_ref_storage_backend(const char *name)
 	return NULL;
 }
 
+/*
+ * Names of the ref storage formats, indexed by enum ref_storage_format.
+ * Each name must match the name of the backend implementing it.
+ */
+static const char *ref_storage_format_names[] = {
+	[REF_STORAGE_FORMAT_FILES] = "files",
+	[REF_STORAGE_FORMAT_REFTABLE] = "reftable",
+};
+
+enum ref_storage_format ref_storage_format_by_name(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(ref_storage_format_names); i++)
+		if (ref_storage_format_names[i] &&
+		    !strcmp(ref_storage_format_names[i], name))
+			return i;
+	return REF_STORAGE_FORMAT_UNKNOWN;
+}
+
+const char *ref_storage_format_to_name(unsigned int ref_storage_format)
+{
+	if (ref_storage_format >= ARRAY_SIZE(ref_storage_format_names))
+		return NULL;
+	return ref_storage_format_names[ref_storage_format];
+}
+
 /*
  * How to handle various characters in refnames:
  * 0: An acceptable character for refs
@@ -1990,10 +2017,14 @@ static struct ref_store *ref_store_init(struct repository *repo,
 					const char *gitdir,
 					unsigned int flags)
 {
-	const char *be_name = "files";
-	struct ref_storage_be *be = find_ref_storage_backend(be_name);
+	const char *be_name = ref_storage_format_to_name(repo->ref_storage_format);
+	struct ref_storage_be *be;
 	struct ref_store *refs;
 
+	if (!be_name)
+		BUG("reference storage format %u is unknown",
+		    repo->ref_storage_format);
+	be = find_ref_storage_backend(be_name);
 	if (!be)
 		BUG("reference backend %s is unknown", be_name);
 
@@ -12,6 +12,24 @@ struct string_list;
 struct string_list_item;
 struct worktree;
 
+/*
+ * The on-disk formats in which references can be stored. The value
+ * is recorded in the repository's "extensions.refStorage" setting.
+ */
+enum ref_storage_format {
+	REF_STORAGE_FORMAT_UNKNOWN,
+	REF_STORAGE_FORMAT_FILES,
+	REF_STORAGE_FORMAT_REFTABLE,
+};
+
+/*
+ * Translate between the names of ref storage formats (e.g. "files",
+ * "reftable") and their enum values. Unknown names yield
+ * REF_STORAGE_FORMAT_UNKNOWN; unknown values yield NULL.
+ */
+enum ref_storage_format ref_storage_format_by_name(const char *name);
+const char *ref_storage_format_to_name(unsigned int ref_storage_format);
+
 /*
  * Resolve a reference, recursively following symbolic refererences.
  *
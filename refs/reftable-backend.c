@@ -0,0 +1,2284 @@
+#include "../cache.h"
+#include "../config.h"
+#include "../dir.h"
+#include "../refs.h"
+#include "refs-internal.h"
+#include "../iterator.h"
+#include "../object.h"
+#include "../chdir-notify.h"
+#include "../strmap.h"
+#include "../reftable/reftable-error.h"
+#include "../reftable/reftable-iterator.h"
+#include "../reftable/reftable-merged.h"
+#include "../reftable/reftable-record.h"
+#include "../reftable/reftable-stack.h"
+
+/*
+ * The reftable backend stores references in a stack of reftables as
+ * described in Documentation/technical/reftable.txt. The stack of the
+ * main working tree lives in "$GIT_COMMON_DIR/reftable" and holds all
+ * shared references as well as the per-worktree references of the
+ * main working tree. Each linked worktree has its own stack in
+ * "$GIT_DIR/reftable" holding only its per-worktree references.
+ */
+
+/*
+ * Used as a flag in ref_update::flags when the ref_update was via an
+ * update to HEAD. Its numerical value must not conflict with the
+ * flags defined in "refs-internal.h" and "refs.h".
+ */
+#define REF_UPDATE_VIA_HEAD (1 << 8)
+
+struct reftable_backend {
+	struct reftable_stack *stack;
+	/* Absolute path of the directory holding the stack. */
+	char *path;
+};
+
+struct reftable_ref_store {
+	struct ref_store base;
+	unsigned int store_flags;
+
+	char *gitcommondir;
+
+	/*
+	 * The main backend refers to the common dir and thus contains
+	 * common refs as well as the per-worktree refs of the main
+	 * working tree.
+	 */
+	struct reftable_backend main_backend;
+
+	/*
+	 * The worktree backend refers to the gitdir in case the refdb
+	 * is opened via a linked worktree. It contains the per-worktree
+	 * refs of that worktree. NULL otherwise.
+	 */
+	struct reftable_backend *worktree_backend;
+
+	/*
+	 * Backends of other worktrees by worktree name, populated lazily
+	 * when resolving "worktrees/<name>/<ref>" names.
+	 */
+	struct strmap worktree_backends;
+
+	struct reftable_write_options write_options;
+	int auto_compact;
+
+	/*
+	 * Number of ref and reflog iterators that are currently alive.
+	 * While there are any, we must neither reload nor compact the
+	 * stacks, as that may close tables the iterators are reading.
+	 */
+	int live_iterators;
+};
+
+static struct reftable_ref_store *reftable_be_downcast(struct ref_store *ref_store,
+						       unsigned int required_flags,
+						       const char *caller)
+{
+	struct reftable_ref_store *refs;
+
+	if (ref_store->be != &refs_be_reftable)
+		BUG("ref_store is type \"%s\" not \"reftable\" in %s",
+		    ref_store->be->name, caller);
+
+	refs = (struct reftable_ref_store *)ref_store;
+
+	if ((refs->store_flags & required_flags) != required_flags)
+		BUG("operation %s requires abilities 0x%x, but only have 0x%x",
+		    caller, required_flags, refs->store_flags);
+
+	return refs;
+}
+
+static void backend_init(struct reftable_backend *be, const char *path,
+			 struct reftable_write_options opts)
+{
+	struct strbuf sb = STRBUF_INIT;
+	int ret;
+
+	strbuf_add_absolute_path(&sb, path);
+	be->path = strbuf_detach(&sb, NULL);
+
+	ret = reftable_new_stack(&be->stack, be->path, opts);
+	if (ret)
+		die(_("unable to open reftable stack '%s': %s"),
+		    be->path, reftable_error_str(ret));
+}
+
+static void backend_reinit(struct reftable_backend *be,
+			   struct reftable_write_options opts)
+{
+	char *path = be->path;
+
+	reftable_stack_destroy(be->stack);
+	backend_init(be, path, opts);
+	free(path);
+}
+
+static int backend_reload(struct reftable_ref_store *refs,
+			  struct reftable_backend *be)
+{
+	if (refs->live_iterators)
+		return 0;
+	return reftable_stack_reload(be->stack);
+}
+
+/*
+ * Return the backend that stores `refname`, and set `*rewritten_ref`
+ * to the name under which the reference is stored in it, which
+ * differs for "main-worktree/" and "worktrees/<name>/" references.
+ */
+static struct reftable_backend *backend_for(struct reftable_ref_store *refs,
+					    const char *refname,
+					    const char **rewritten_ref)
+{
+	struct strbuf wt_dir = STRBUF_INIT;
+	const char *wtname, *bare_refname;
+	struct reftable_backend *be;
+	int wtname_len;
+
+	switch (parse_worktree_ref(refname, &wtname, &wtname_len,
+				   &bare_refname)) {
+	case REF_WORKTREE_OTHER:
+		if (!*bare_refname)
+			break;
+
+		strbuf_addf(&wt_dir, "%s/worktrees/%.*s/reftable",
+			    refs->gitcommondir, wtname_len, wtname);
+		be = strmap_get(&refs->worktree_backends, wt_dir.buf);
+		if (!be && refs->worktree_backend) {
+			struct strbuf abs = STRBUF_INIT;
+
+			strbuf_add_absolute_path(&abs, wt_dir.buf);
+			if (!fspathcmp(abs.buf, refs->worktree_backend->path))
+				be = refs->worktree_backend;
+			strbuf_release(&abs);
+		}
+		if (!be) {
+			CALLOC_ARRAY(be, 1);
+			backend_init(be, wt_dir.buf, refs->write_options);
+			strmap_put(&refs->worktree_backends, wt_dir.buf, be);
+		}
+		strbuf_release(&wt_dir);
+
+		*rewritten_ref = bare_refname;
+		return be;
+	case REF_WORKTREE_CURRENT:
+		*rewritten_ref = bare_refname;
+		return refs->worktree_backend ?
+			refs->worktree_backend : &refs->main_backend;
+	case REF_WORKTREE_MAIN:
+	case REF_WORKTREE_SHARED:
+		*rewritten_ref = bare_refname;
+		return &refs->main_backend;
+	}
+
+	*rewritten_ref = refname;
+	return &refs->main_backend;
+}
+
+/*
+ * Like backend_for(), but also reload the stack so that reads see the
+ * current state of the on-disk tables.
+ */
+static int backend_for_reading(struct reftable_backend **out,
+			       struct reftable_ref_store *refs,
+			       const char *refname,
+			       const char **rewritten_ref)
+{
+	*out = backend_for(refs, refname, rewritten_ref);
+	return backend_reload(refs, *out);
+}
+
+/*
+ * Stacks of worktrees are created lazily, so the directory may not
+ * exist yet when writing the first table into it.
+ */
+static int backend_prepare_write(struct reftable_backend *be)
+{
+	if (!mkdir(be->path, 0777))
+		return adjust_shared_perm(be->path);
+	if (errno == EEXIST)
+		return 0;
+	return error_errno(_("unable to create directory '%s'"), be->path);
+}
+
+static int reftable_be_config(const char *var, const char *value, void *cb)
+{
+	struct reftable_ref_store *refs = cb;
+
+	if (!strcmp(var, "reftable.blocksize")) {
+		unsigned long block_size = git_config_ulong(var, value);
+		if (block_size > 16777215)
+			die(_("reftable block size cannot exceed 16MB"));
+		refs->write_options.block_size = block_size;
+	} else if (!strcmp(var, "reftable.restartinterval")) {
+		unsigned long restart_interval = git_config_ulong(var, value);
+		if (restart_interval > UINT16_MAX)
+			die(_("reftable restart interval cannot exceed %u"),
+			    (unsigned)UINT16_MAX);
+		refs->write_options.restart_interval = restart_interval;
+	} else if (!strcmp(var, "reftable.indexobjects")) {
+		refs->write_options.skip_index_objects =
+			!git_config_bool(var, value);
+	} else if (!strcmp(var, "reftable.autocompaction")) {
+		refs->auto_compact = git_config_bool(var, value);
+	}
+
+	return 0;
+}
+
+static struct ref_store *reftable_be_init(struct repository *repo,
+					  const char *gitdir,
+					  unsigned int store_flags)
+{
+	struct reftable_ref_store *refs = xcalloc(1, sizeof(*refs));
+	struct strbuf path = STRBUF_INIT;
+	int is_worktree;
+	mode_t mask;
+
+	mask = umask(0);
+	umask(mask);
+
+	base_ref_store_init(&refs->base, repo, gitdir, &refs_be_reftable);
+	strmap_init(&refs->worktree_backends);
+	refs->store_flags = store_flags;
+	refs->auto_compact = 1;
+
+	refs->write_options.hash_id = repo->hash_algo->format_id;
+	refs->write_options.default_permissions =
+		calc_shared_perm(0666 & ~mask);
+	/*
+	 * Name conflicts are checked via refs_verify_refname_available()
+	 * before writing, which also knows about the references that are
+	 * part of the same transaction.
+	 */
+	refs->write_options.skip_name_check = 1;
+
+	repo_config(repo, reftable_be_config, refs);
+
+	is_worktree = get_common_dir_noenv(&path, gitdir);
+	refs->gitcommondir = strbuf_detach(&path, NULL);
+
+	strbuf_addf(&path, "%s/reftable", refs->gitcommondir);
+	backend_init(&refs->main_backend, path.buf, refs->write_options);
+
+	if (is_worktree) {
+		strbuf_reset(&path);
+		strbuf_addf(&path, "%s/reftable", gitdir);
+		CALLOC_ARRAY(refs->worktree_backend, 1);
+		backend_init(refs->worktree_backend, path.buf,
+			     refs->write_options);
+	}
+
+	chdir_notify_reparent("reftables-backend $GIT_DIR", &refs->base.gitdir);
+	chdir_notify_reparent("reftables-backend $GIT_COMMONDIR",
+			      &refs->gitcommondir);
+
+	strbuf_release(&path);
+	return &refs->base;
+}
+
+static void maybe_auto_compact(struct reftable_ref_store *refs,
+			       struct reftable_backend *be)
+{
+	/*
+	 * Compaction is an optimization only; failing to compact, e.g.
+	 * because a concurrent writer holds the lock, is not an error.
+	 */
+	if (refs->auto_compact && !refs->live_iterators)
+		reftable_stack_auto_compact(be->stack);
+}
+
+static int reftable_be_init_db(struct ref_store *ref_store,
+			       struct strbuf *err UNUSED)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_WRITE, "init_db");
+	struct strbuf sb = STRBUF_INIT;
+
+	/*
+	 * The ref store may have been opened before the object format of
+	 * a new repository was known, as it is the case for clones. The
+	 * stacks are still empty at this point, so we can simply reopen
+	 * them with the final hash.
+	 */
+	if (refs->write_options.hash_id != refs->base.repo->hash_algo->format_id) {
+		refs->write_options.hash_id = refs->base.repo->hash_algo->format_id;
+		backend_reinit(&refs->main_backend, refs->write_options);
+		if (refs->worktree_backend)
+			backend_reinit(refs->worktree_backend,
+				       refs->write_options);
+	}
+
+	safe_create_dir(refs->main_backend.path, 1);
+
+	/*
+	 * The "HEAD" file and the "refs/" directory need to exist so
+	 * that the directory is recognized as a repository at all. To
+	 * keep older versions of Git that do not understand the
+	 * "refstorage" extension from misinterpreting the repository,
+	 * "refs/heads" is created as a regular file.
+	 */
+	strbuf_addf(&sb, "%s/HEAD", refs->base.gitdir);
+	if (!file_exists(sb.buf))
+		write_file(sb.buf, "ref: refs/heads/.invalid");
+	adjust_shared_perm(sb.buf);
+
+	strbuf_reset(&sb);
+	strbuf_addf(&sb, "%s/refs", refs->gitcommondir);
+	safe_create_dir(sb.buf, 1);
+
+	strbuf_addstr(&sb, "/heads");
+	if (!file_exists(sb.buf))
+		write_file(sb.buf, "this repository uses the reftable format");
+	adjust_shared_perm(sb.buf);
+
+	strbuf_release(&sb);
+	return 0;
+}
+
+/*
+ * Read a single reference from `stack` without reloading it. Returns
+ * 0 if the reference was found, 1 if it does not exist and a negative
+ * reftable error code otherwise.
+ */
+static int read_ref_without_reload(struct reftable_stack *stack,
+				   const char *refname,
+				   struct object_id *oid,
+				   struct strbuf *referent,
+				   unsigned int *type)
+{
+	struct reftable_ref_record ref = { 0 };
+	int ret;
+
+	ret = reftable_stack_read_ref(stack, refname, &ref);
+	if (ret)
+		goto done;
+
+	if (ref.value_type == REFTABLE_REF_SYMREF) {
+		strbuf_reset(referent);
+		strbuf_addstr(referent, ref.value.symref);
+		*type |= REF_ISSYMREF;
+	} else if (reftable_ref_record_val1(&ref)) {
+		oidread(oid, reftable_ref_record_val1(&ref));
+	} else {
+		/* Deletions are suppressed when reading from the stack. */
+		BUG("unhandled reference value type %d", ref.value_type);
+	}
+
+done:
+	reftable_ref_record_release(&ref);
+	return ret;
+}
+
+static int reftable_be_read_raw_ref(struct ref_store *ref_store,
+				    const char *refname,
+				    struct object_id *oid,
+				    struct strbuf *referent,
+				    unsigned int *type,
+				    int *failure_errno)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_READ, "read_raw_ref");
+	struct reftable_backend *be;
+	int ret;
+
+	ret = backend_for_reading(&be, refs, refname, &refname);
+	if (!ret)
+		ret = read_ref_without_reload(be->stack, refname, oid,
+					      referent, type);
+	if (ret < 0) {
+		*failure_errno = EIO;
+		return -1;
+	}
+	if (ret > 0) {
+		*failure_errno = ENOENT;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int reftable_be_read_symbolic_ref(struct ref_store *ref_store,
+					 const char *refname,
+					 struct strbuf *referent)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_READ, "read_symbolic_ref");
+	struct reftable_ref_record ref = { 0 };
+	struct reftable_backend *be;
+	int ret;
+
+	ret = backend_for_reading(&be, refs, refname, &refname);
+	if (ret)
+		return -1;
+
+	ret = reftable_stack_read_ref(be->stack, refname, &ref);
+	if (!ret && ref.value_type == REFTABLE_REF_SYMREF)
+		strbuf_addstr(referent, ref.value.symref);
+	else
+		ret = -1;
+
+	reftable_ref_record_release(&ref);
+	return ret;
+}
+
+struct reftable_ref_iterator {
+	struct ref_iterator base;
+	struct reftable_ref_store *refs;
+	struct reftable_iterator iter;
+	struct reftable_ref_record ref;
+	struct object_id oid;
+
+	char *prefix;
+	unsigned int flags;
+	int err;
+};
+
+static int reftable_ref_iterator_advance(struct ref_iterator *ref_iterator)
+{
+	struct reftable_ref_iterator *iter =
+		(struct reftable_ref_iterator *)ref_iterator;
+	struct reftable_ref_store *refs = iter->refs;
+
+	while (!iter->err) {
+		int flags = 0;
+
+		iter->err = reftable_iterator_next_ref(&iter->iter, &iter->ref);
+		if (iter->err)
+			break;
+
+		/*
+		 * Like the files backend, only yield references that live
+		 * in "refs/". Pseudorefs like "HEAD" sort before it.
+		 */
+		if (!starts_with(iter->ref.refname, "refs/"))
+			continue;
+
+		if (!starts_with(iter->ref.refname, iter->prefix)) {
+			iter->err = 1;
+			break;
+		}
+
+		if (iter->flags & DO_FOR_EACH_PER_WORKTREE_ONLY &&
+		    parse_worktree_ref(iter->ref.refname, NULL, NULL, NULL) !=
+			    REF_WORKTREE_CURRENT)
+			continue;
+
+		switch (iter->ref.value_type) {
+		case REFTABLE_REF_VAL1:
+			oidread(&iter->oid, iter->ref.value.val1);
+			break;
+		case REFTABLE_REF_VAL2:
+			oidread(&iter->oid, iter->ref.value.val2.value);
+			break;
+		case REFTABLE_REF_SYMREF:
+			if (!refs_resolve_ref_unsafe(&refs->base, iter->ref.refname,
+						     RESOLVE_REF_READING,
+						     &iter->oid, &flags))
+				oidclr(&iter->oid);
+			flags |= REF_ISSYMREF;
+			break;
+		default:
+			BUG("unhandled reference value type %d",
+			    iter->ref.value_type);
+		}
+
+		if (is_null_oid(&iter->oid))
+			flags |= REF_ISBROKEN;
+
+		if (check_refname_format(iter->ref.refname,
+					 REFNAME_ALLOW_ONELEVEL)) {
+			oidclr(&iter->oid);
+			flags |= REF_BAD_NAME | REF_ISBROKEN;
+		}
+
+		if (iter->flags & DO_FOR_EACH_OMIT_DANGLING_SYMREFS &&
+		    flags & REF_ISSYMREF &&
+		    flags & REF_ISBROKEN)
+			continue;
+
+		if (!(iter->flags & DO_FOR_EACH_INCLUDE_BROKEN) &&
+		    !ref_resolves_to_object(iter->ref.refname, refs->base.repo,
+					    &iter->oid, flags))
+			continue;
+
+		iter->base.refname = iter->ref.refname;
+		iter->base.oid = &iter->oid;
+		iter->base.flags = flags;
+		return ITER_OK;
+	}
+
+	if (iter->err > 0) {
+		if (ref_iterator_abort(ref_iterator) != ITER_DONE)
+			return ITER_ERROR;
+		return ITER_DONE;
+	}
+
+	ref_iterator_abort(ref_iterator);
+	return ITER_ERROR;
+}
+
+static int reftable_ref_iterator_peel(struct ref_iterator *ref_iterator,
+				      struct object_id *peeled)
+{
+	struct reftable_ref_iterator *iter =
+		(struct reftable_ref_iterator *)ref_iterator;
+
+	if (iter->ref.value_type == REFTABLE_REF_VAL2) {
+		oidread(peeled, iter->ref.value.val2.target_value);
+		return 0;
+	}
+
+	return peel_object(&iter->oid, peeled) ? -1 : 0;
+}
+
+static int reftable_ref_iterator_abort(struct ref_iterator *ref_iterator)
+{
+	struct reftable_ref_iterator *iter =
+		(struct reftable_ref_iterator *)ref_iterator;
+
+	reftable_ref_record_release(&iter->ref);
+	reftable_iterator_destroy(&iter->iter);
+	iter->refs->live_iterators--;
+	free(iter->prefix);
+	base_ref_iterator_free(ref_iterator);
+	return ITER_DONE;
+}
+
+static struct ref_iterator_vtable reftable_ref_iterator_vtable = {
+	.advance = reftable_ref_iterator_advance,
+	.peel = reftable_ref_iterator_peel,
+	.abort = reftable_ref_iterator_abort
+};
+
+static struct ref_iterator *ref_iterator_for_stack(struct reftable_ref_store *refs,
+						   struct reftable_backend *be,
+						   const char *prefix,
+						   unsigned int flags)
+{
+	struct reftable_merged_table *merged;
+	struct reftable_ref_iterator *iter;
+
+	CALLOC_ARRAY(iter, 1);
+	base_ref_iterator_init(&iter->base, &reftable_ref_iterator_vtable, 1);
+	iter->refs = refs;
+	iter->prefix = xstrdup(prefix);
+	iter->flags = flags;
+
+	iter->err = backend_reload(refs, be);
+	if (!iter->err) {
+		merged = reftable_stack_merged_table(be->stack);
+		iter->err = reftable_merged_table_seek_ref(merged, &iter->iter,
+							   prefix);
+	}
+
+	refs->live_iterators++;
+	return &iter->base;
+}
+
+/*
+ * Merge the references of a linked worktree with the common ones.
+ * Per-worktree references stored in the main stack belong to the main
+ * working tree and are thus skipped.
+ */
+static enum iterator_selection iterator_select(struct ref_iterator *iter_worktree,
+					       struct ref_iterator *iter_common,
+					       void *cb_data UNUSED)
+{
+	if (iter_common) {
+		if (iter_worktree) {
+			int cmp = strcmp(iter_worktree->refname,
+					 iter_common->refname);
+			if (cmp < 0)
+				return ITER_SELECT_0;
+			if (!cmp)
+				return ITER_SELECT_0_SKIP_1;
+		}
+
+		if (parse_worktree_ref(iter_common->refname, NULL, NULL,
+				       NULL) == REF_WORKTREE_SHARED)
+			return ITER_SELECT_1;
+		return ITER_SKIP_1;
+	}
+
+	return iter_worktree ? ITER_SELECT_0 : ITER_SELECT_DONE;
+}
+
+static struct ref_iterator *reftable_be_iterator_begin(struct ref_store *ref_store,
+						       const char *prefix,
+						       unsigned int flags)
+{
+	struct ref_iterator *main_iter, *worktree_iter;
+	struct reftable_ref_store *refs;
+	unsigned int required_flags = REF_STORE_READ;
+
+	if (!(flags & DO_FOR_EACH_INCLUDE_BROKEN))
+		required_flags |= REF_STORE_ODB;
+	refs = reftable_be_downcast(ref_store, required_flags,
+				    "ref_iterator_begin");
+
+	if (!prefix)
+		prefix = "";
+
+	main_iter = ref_iterator_for_stack(refs, &refs->main_backend,
+					   prefix, flags);
+	if (!refs->worktree_backend)
+		return main_iter;
+
+	worktree_iter = ref_iterator_for_stack(refs, refs->worktree_backend,
+					       prefix, flags);
+	return merge_ref_iterator_begin(1, worktree_iter, main_iter,
+					iterator_select, NULL);
+}
+
+struct reftable_reflog_iterator {
+	struct ref_iterator base;
+	struct reftable_ref_store *refs;
+	struct reftable_iterator iter;
+	struct reftable_log_record log;
+	struct object_id oid;
+	char *last_name;
+	int err;
+};
+
+static int reftable_reflog_iterator_advance(struct ref_iterator *ref_iterator)
+{
+	struct reftable_reflog_iterator *iter =
+		(struct reftable_reflog_iterator *)ref_iterator;
+
+	while (!iter->err) {
+		int flags = 0;
+
+		iter->err = reftable_iterator_next_log(&iter->iter, &iter->log);
+		if (iter->err)
+			break;
+
+		/*
+		 * Log records are sorted by refname and then by their
+		 * update index. We only want to yield each reflog once.
+		 */
+		if (iter->last_name && !strcmp(iter->log.refname, iter->last_name))
+			continue;
+
+		free(iter->last_name);
+		iter->last_name = xstrdup(iter->log.refname);
+
+		if (!refs_resolve_ref_unsafe(&iter->refs->base, iter->log.refname,
+					     0, &iter->oid, &flags))
+			continue;
+
+		iter->base.refname = iter->log.refname;
+		iter->base.oid = &iter->oid;
+		iter->base.flags = flags;
+		return ITER_OK;
+	}
+
+	if (iter->err > 0) {
+		if (ref_iterator_abort(ref_iterator) != ITER_DONE)
+			return ITER_ERROR;
+		return ITER_DONE;
+	}
+
+	ref_iterator_abort(ref_iterator);
+	return ITER_ERROR;
+}
+
+static int reftable_reflog_iterator_peel(struct ref_iterator *ref_iterator UNUSED,
+					 struct object_id *peeled UNUSED)
+{
+	BUG("reftable reflog iterator cannot be peeled");
+	return -1;
+}
+
+static int reftable_reflog_iterator_abort(struct ref_iterator *ref_iterator)
+{
+	struct reftable_reflog_iterator *iter =
+		(struct reftable_reflog_iterator *)ref_iterator;
+
+	reftable_log_record_release(&iter->log);
+	reftable_iterator_destroy(&iter->iter);
+	iter->refs->live_iterators--;
+	free(iter->last_name);
+	base_ref_iterator_free(ref_iterator);
+	return ITER_DONE;
+}
+
+static struct ref_iterator_vtable reftable_reflog_iterator_vtable = {
+	.advance = reftable_reflog_iterator_advance,
+	.peel = reftable_reflog_iterator_peel,
+	.abort = reftable_reflog_iterator_abort
+};
+
+static struct ref_iterator *reflog_iterator_for_stack(struct reftable_ref_store *refs,
+						      struct reftable_backend *be)
+{
+	struct reftable_merged_table *merged;
+	struct reftable_reflog_iterator *iter;
+
+	CALLOC_ARRAY(iter, 1);
+	base_ref_iterator_init(&iter->base, &reftable_reflog_iterator_vtable, 1);
+	iter->refs = refs;
+
+	iter->err = backend_reload(refs, be);
+	if (!iter->err) {
+		merged = reftable_stack_merged_table(be->stack);
+		iter->err = reftable_merged_table_seek_log(merged, &iter->iter, "");
+	}
+
+	refs->live_iterators++;
+	return &iter->base;
+}
+
+static struct ref_iterator *reftable_be_reflog_iterator_begin(struct ref_store *ref_store)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_READ, "reflog_iterator_begin");
+	struct ref_iterator *main_iter, *worktree_iter;
+
+	main_iter = reflog_iterator_for_stack(refs, &refs->main_backend);
+	if (!refs->worktree_backend)
+		return main_iter;
+
+	worktree_iter = reflog_iterator_for_stack(refs, refs->worktree_backend);
+	return merge_ref_iterator_begin(1, worktree_iter, main_iter,
+					iterator_select, NULL);
+}
+
+/*
+ * Reflog entries whose old and new object IDs are both null only mark
+ * the reflog as existing; see reftable_be_create_reflog(). They are
+ * never shown to callers.
+ */
+static int is_reflog_existence_marker(const struct reftable_log_record *log)
+{
+	return !hashcmp(log->value.update.old_hash, null_oid()->hash) &&
+	       !hashcmp(log->value.update.new_hash, null_oid()->hash);
+}
+
+static int yield_log_record(struct reftable_log_record *log,
+			    each_reflog_ent_fn fn,
+			    void *cb_data)
+{
+	struct object_id old_oid, new_oid;
+	struct strbuf committer = STRBUF_INIT;
+	int ret;
+
+	if (is_reflog_existence_marker(log))
+		return 0;
+
+	oidread(&old_oid, log->value.update.old_hash);
+	oidread(&new_oid, log->value.update.new_hash);
+	strbuf_addf(&committer, "%s <%s>", log->value.update.name,
+		    log->value.update.email);
+
+	ret = fn(&old_oid, &new_oid, committer.buf, log->value.update.time,
+		 log->value.update.tz_offset,
+		 log->value.update.message ? log->value.update.message : "",
+		 cb_data);
+
+	strbuf_release(&committer);
+	return ret;
+}
+
+/*
+ * Read all log records of `refname` from `stack`, newest first.
+ * Returns 0 on success and a negative reftable error code otherwise.
+ */
+static int read_log_records(struct reftable_stack *stack,
+			    const char *refname,
+			    struct reftable_log_record **logs,
+			    size_t *logs_nr)
+{
+	struct reftable_merged_table *merged = reftable_stack_merged_table(stack);
+	struct reftable_iterator it = { 0 };
+	size_t logs_alloc = 0;
+	int ret;
+
+	*logs = NULL;
+	*logs_nr = 0;
+
+	ret = reftable_merged_table_seek_log(merged, &it, refname);
+	while (!ret) {
+		struct reftable_log_record log = { 0 };
+
+		ret = reftable_iterator_next_log(&it, &log);
+		if (ret || strcmp(log.refname, refname)) {
+			reftable_log_record_release(&log);
+			break;
+		}
+
+		ALLOC_GROW(*logs, *logs_nr + 1, logs_alloc);
+		(*logs)[(*logs_nr)++] = log;
+	}
+
+	reftable_iterator_destroy(&it);
+	return ret < 0 ? ret : 0;
+}
+
+static void free_log_records(struct reftable_log_record *logs, size_t nr)
+{
+	size_t i;
+
+	for (i = 0; i < nr; i++)
+		reftable_log_record_release(&logs[i]);
+	free(logs);
+}
+
+static int reftable_be_for_each_reflog_ent_reverse(struct ref_store *ref_store,
+						   const char *refname,
+						   each_reflog_ent_fn fn,
+						   void *cb_data)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_READ, "for_each_reflog_ent_reverse");
+	struct reftable_merged_table *merged;
+	struct reftable_log_record log = { 0 };
+	struct reftable_iterator it = { 0 };
+	struct reftable_backend *be;
+	int ret;
+
+	ret = backend_for_reading(&be, refs, refname, &refname);
+	if (ret < 0)
+		return ret;
+
+	merged = reftable_stack_merged_table(be->stack);
+	ret = reftable_merged_table_seek_log(merged, &it, refname);
+	while (!ret) {
+		ret = reftable_iterator_next_log(&it, &log);
+		if (ret < 0)
+			break;
+		if (ret > 0 || strcmp(log.refname, refname)) {
+			ret = 0;
+			break;
+		}
+
+		ret = yield_log_record(&log, fn, cb_data);
+	}
+
+	reftable_log_record_release(&log);
+	reftable_iterator_destroy(&it);
+	return ret;
+}
+
+static int reftable_be_for_each_reflog_ent(struct ref_store *ref_store,
+					   const char *refname,
+					   each_reflog_ent_fn fn,
+					   void *cb_data)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_READ, "for_each_reflog_ent");
+	struct reftable_log_record *logs;
+	struct reftable_backend *be;
+	size_t logs_nr, i;
+	int ret;
+
+	ret = backend_for_reading(&be, refs, refname, &refname);
+	if (ret < 0)
+		return ret;
+
+	/*
+	 * Log records are stored newest first, so we have to read all of
+	 * them before we can yield them in chronological order.
+	 */
+	ret = read_log_records(be->stack, refname, &logs, &logs_nr);
+	for (i = logs_nr; !ret && i; i--)
+		ret = yield_log_record(&logs[i - 1], fn, cb_data);
+
+	free_log_records(logs, logs_nr);
+	return ret;
+}
+
+static int stack_has_reflog(struct reftable_stack *stack, const char *refname)
+{
+	struct reftable_log_record log = { 0 };
+	int ret;
+
+	ret = reftable_stack_read_log(stack, refname, &log);
+	reftable_log_record_release(&log);
+	return !ret;
+}
+
+static int reftable_be_reflog_exists(struct ref_store *ref_store,
+				     const char *refname)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_READ, "reflog_exists");
+	struct reftable_backend *be;
+
+	if (backend_for_reading(&be, refs, refname, &refname) < 0)
+		return 0;
+
+	return stack_has_reflog(be->stack, refname);
+}
+
+
+/*
+ * The records making up a single new table. All records own their
+ * memory and are released via table_records_release().
+ */
+struct table_records {
+	uint64_t update_index;
+	struct reftable_ref_record *refs;
+	size_t refs_nr, refs_alloc;
+	struct reftable_log_record *logs;
+	size_t logs_nr, logs_alloc;
+};
+
+static void table_records_release(struct table_records *records)
+{
+	size_t i;
+
+	for (i = 0; i < records->refs_nr; i++)
+		reftable_ref_record_release(&records->refs[i]);
+	for (i = 0; i < records->logs_nr; i++)
+		reftable_log_record_release(&records->logs[i]);
+	FREE_AND_NULL(records->refs);
+	FREE_AND_NULL(records->logs);
+	records->refs_nr = records->refs_alloc = 0;
+	records->logs_nr = records->logs_alloc = 0;
+}
+
+/*
+ * Append a ref record for `refname` at the update index of the table.
+ * The record is a deletion until its value is set.
+ */
+static struct reftable_ref_record *add_ref_record(struct table_records *records,
+						  const char *refname)
+{
+	struct reftable_ref_record *ref;
+
+	ALLOC_GROW(records->refs, records->refs_nr + 1, records->refs_alloc);
+	ref = &records->refs[records->refs_nr++];
+	memset(ref, 0, sizeof(*ref));
+	ref->refname = xstrdup(refname);
+	ref->update_index = records->update_index;
+	ref->value_type = REFTABLE_REF_DELETION;
+	return ref;
+}
+
+static void set_ref_record_oid(struct reftable_ref_record *ref,
+			       const struct object_id *oid)
+{
+	struct object_id peeled;
+
+	if (peel_object(oid, &peeled) == PEEL_PEELED) {
+		ref->value_type = REFTABLE_REF_VAL2;
+		ref->value.val2.value = xmemdupz(oid->hash, the_hash_algo->rawsz);
+		ref->value.val2.target_value =
+			xmemdupz(peeled.hash, the_hash_algo->rawsz);
+	} else {
+		ref->value_type = REFTABLE_REF_VAL1;
+		ref->value.val1 = xmemdupz(oid->hash, the_hash_algo->rawsz);
+	}
+}
+
+/*
+ * Append a log record for `refname`. Like ref records, log records
+ * start out as deletions.
+ */
+static struct reftable_log_record *add_log_record(struct table_records *records,
+						  const char *refname,
+						  uint64_t update_index)
+{
+	struct reftable_log_record *log;
+
+	ALLOC_GROW(records->logs, records->logs_nr + 1, records->logs_alloc);
+	log = &records->logs[records->logs_nr++];
+	memset(log, 0, sizeof(*log));
+	log->refname = xstrdup(refname);
+	log->update_index = update_index;
+	log->value_type = REFTABLE_LOG_DELETION;
+	return log;
+}
+
+/* Turn `log` into an update by the current committer. */
+static void set_log_record_update(struct reftable_log_record *log,
+				  const struct object_id *old_oid,
+				  const struct object_id *new_oid,
+				  const char *msg)
+{
+	const char *info = git_committer_info(0);
+	struct ident_split split = { 0 };
+
+	if (split_ident_line(&split, info, strlen(info)))
+		BUG("failed splitting committer info");
+
+	log->value_type = REFTABLE_LOG_UPDATE;
+	log->value.update.name =
+		xmemdupz(split.name_begin, split.name_end - split.name_begin);
+	log->value.update.email =
+		xmemdupz(split.mail_begin, split.mail_end - split.mail_begin);
+	log->value.update.time = parse_timestamp(split.date_begin, NULL, 10);
+	log->value.update.tz_offset = strtol(split.tz_begin, NULL, 10);
+	log->value.update.old_hash = xmemdupz(old_oid->hash, the_hash_algo->rawsz);
+	log->value.update.new_hash = xmemdupz(new_oid->hash, the_hash_algo->rawsz);
+	log->value.update.message = xstrdup(msg ? msg : "");
+}
+
+/* Turn `dst` into a copy of the update recorded in `src`. */
+static void copy_log_record_update(struct reftable_log_record *dst,
+				   const struct reftable_log_record *src)
+{
+	dst->value_type = REFTABLE_LOG_UPDATE;
+	dst->value.update.name = xstrdup(src->value.update.name);
+	dst->value.update.email = xstrdup(src->value.update.email);
+	dst->value.update.time = src->value.update.time;
+	dst->value.update.tz_offset = src->value.update.tz_offset;
+	dst->value.update.old_hash =
+		xmemdupz(src->value.update.old_hash, the_hash_algo->rawsz);
+	dst->value.update.new_hash =
+		xmemdupz(src->value.update.new_hash, the_hash_algo->rawsz);
+	dst->value.update.message = xstrdup(src->value.update.message ?
+					    src->value.update.message : "");
+}
+
+/*
+ * Append deletions for all existing log records of `refname` except
+ * for those at the update indices listed in `keep`, which is sorted
+ * in descending order just like the log records.
+ */
+static int add_reflog_tombstones(struct table_records *records,
+				 struct reftable_stack *stack,
+				 const char *refname,
+				 const struct reftable_log_record *keep,
+				 size_t keep_nr)
+{
+	struct reftable_log_record *logs;
+	size_t logs_nr, i, j = 0;
+	int ret;
+
+	ret = read_log_records(stack, refname, &logs, &logs_nr);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < logs_nr; i++) {
+		while (j < keep_nr && keep[j].update_index > logs[i].update_index)
+			j++;
+		if (j < keep_nr && keep[j].update_index == logs[i].update_index)
+			continue;
+		add_log_record(records, refname, logs[i].update_index);
+	}
+
+	free_log_records(logs, logs_nr);
+	return 0;
+}
+
+static int should_autocreate_log(const char *refname)
+{
+	if (log_all_ref_updates == LOG_REFS_UNSET)
+		log_all_ref_updates = is_bare_repository() ? LOG_REFS_NONE : LOG_REFS_NORMAL;
+
+	return should_autocreate_reflog(refname);
+}
+
+/*
+ * Whether an update of `refname`, which is stored as `stored_refname`
+ * in `stack`, should be logged. This is the case when the reflog
+ * already exists or would be created by the files backend.
+ */
+static int should_write_log(struct reftable_stack *stack,
+			    const char *refname,
+			    const char *stored_refname,
+			    unsigned int flags)
+{
+	return (flags & REF_FORCE_CREATE_REFLOG) ||
+		should_autocreate_log(refname) ||
+		stack_has_reflog(stack, stored_refname);
+}
+
+static int write_records_table(struct reftable_writer *writer, void *cb_data)
+{
+	struct table_records *records = cb_data;
+	int ret;
+
+	reftable_writer_set_limits(writer, records->update_index,
+				   records->update_index);
+
+	ret = reftable_writer_add_refs(writer, records->refs, records->refs_nr);
+	if (!ret)
+		ret = reftable_writer_add_logs(writer, records->logs,
+					       records->logs_nr);
+	return ret;
+}
+
+static void transaction_error(struct strbuf *err, int ret)
+{
+	if (ret == REFTABLE_LOCK_ERROR)
+		strbuf_addstr(err, _("the reference database is locked or "
+				     "was modified concurrently"));
+	else
+		strbuf_addf(err, _("reftable: transaction failure: %s"),
+			    reftable_error_str(ret));
+}
+
+/*
+ * Lock the stack of `be` for adding a new table. This fails with
+ * REFTABLE_LOCK_ERROR if the stack was modified since it was last
+ * reloaded, so callers can safely compute the contents of the new
+ * table from what they have read before.
+ */
+static int backend_lock(struct reftable_backend *be,
+			struct reftable_addition **add,
+			struct strbuf *err)
+{
+	int ret;
+
+	if (backend_prepare_write(be)) {
+		strbuf_addf(err, _("unable to create directory '%s'"), be->path);
+		return -1;
+	}
+
+	ret = reftable_stack_new_addition(add, be->stack);
+	if (ret > 0)
+		ret = REFTABLE_LOCK_ERROR;
+	if (ret) {
+		transaction_error(err, ret);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int backend_add_records(struct reftable_ref_store *refs,
+			       struct reftable_backend *be,
+			       struct table_records *records,
+			       struct strbuf *err)
+{
+	struct reftable_addition *add = NULL;
+	int ret;
+
+	if (backend_lock(be, &add, err))
+		return -1;
+
+	ret = reftable_addition_add(add, write_records_table, records);
+	if (!ret)
+		ret = reftable_addition_commit(add);
+	reftable_addition_destroy(add);
+
+	if (ret) {
+		transaction_error(err, ret);
+		return -1;
+	}
+
+	maybe_auto_compact(refs, be);
+	return 0;
+}
+
+struct reftable_transaction_update {
+	struct ref_update *update;
+	struct object_id current_oid;
+	int is_symref;
+};
+
+/* The updates of a transaction that go into the same stack. */
+struct write_transaction_table_arg {
+	struct reftable_backend *be;
+	struct reftable_addition *addition;
+	struct reftable_transaction_update **updates;
+	size_t updates_nr, updates_alloc;
+};
+
+struct reftable_transaction_data {
+	struct write_transaction_table_arg *args;
+	size_t args_nr, args_alloc;
+	int skip_logs;
+};
+
+static void free_transaction_data(struct reftable_transaction_data *tx_data)
+{
+	size_t i, j;
+
+	if (!tx_data)
+		return;
+
+	for (i = 0; i < tx_data->args_nr; i++) {
+		struct write_transaction_table_arg *arg = &tx_data->args[i];
+
+		reftable_addition_destroy(arg->addition);
+		for (j = 0; j < arg->updates_nr; j++)
+			free(arg->updates[j]);
+		free(arg->updates);
+	}
+	free(tx_data->args);
+	free(tx_data);
+}
+
+/*
+ * Look up the stack that `update` needs to be written to and lock it
+ * unless the transaction already holds its lock. Locking happens
+ * before any of its references are read so that the values we verify
+ * are guaranteed to be the ones we are replacing.
+ */
+static int transaction_lock_stack(struct reftable_ref_store *refs,
+				  struct reftable_transaction_data *tx_data,
+				  const char *refname,
+				  struct write_transaction_table_arg **out,
+				  const char **rewritten_ref,
+				  struct strbuf *err)
+{
+	struct reftable_backend *be = backend_for(refs, refname, rewritten_ref);
+	struct write_transaction_table_arg *arg;
+	struct strbuf reason = STRBUF_INIT;
+	size_t i;
+
+	for (i = 0; i < tx_data->args_nr; i++) {
+		if (tx_data->args[i].be == be) {
+			*out = &tx_data->args[i];
+			return 0;
+		}
+	}
+
+	if (backend_reload(refs, be) < 0) {
+		strbuf_addf(err, _("unable to reload reftable stack '%s'"),
+			    be->path);
+		return -1;
+	}
+
+	ALLOC_GROW(tx_data->args, tx_data->args_nr + 1, tx_data->args_alloc);
+	arg = &tx_data->args[tx_data->args_nr];
+	memset(arg, 0, sizeof(*arg));
+	arg->be = be;
+
+	if (backend_lock(be, &arg->addition, &reason)) {
+		strbuf_addf(err, "cannot lock ref '%s': %s", refname, reason.buf);
+		strbuf_release(&reason);
+		return -1;
+	}
+
+	tx_data->args_nr++;
+	*out = arg;
+	return 0;
+}
+
+static const char *original_update_refname(struct ref_update *update)
+{
+	while (update->parent_update)
+		update = update->parent_update;
+
+	return update->refname;
+}
+
+/*
+ * If update is a direct update of head_ref (the reference pointed to
+ * by HEAD), then add an extra REF_LOG_ONLY update for HEAD.
+ */
+static int split_head_update(struct ref_update *update,
+			     struct ref_transaction *transaction,
+			     const char *head_ref,
+			     struct string_list *affected_refnames,
+			     struct strbuf *err)
+{
+	struct string_list_item *item;
+	struct ref_update *new_update;
+
+	if ((update->flags & REF_LOG_ONLY) ||
+	    (update->flags & REF_UPDATE_VIA_HEAD))
+		return 0;
+
+	if (strcmp(update->refname, head_ref))
+		return 0;
+
+	if (string_list_has_string(affected_refnames, "HEAD")) {
+		strbuf_addf(err,
+			    "multiple updates for 'HEAD' (including one "
+			    "via its referent '%s') are not allowed",
+			    update->refname);
+		return TRANSACTION_NAME_CONFLICT;
+	}
+
+	new_update = ref_transaction_add_update(
+			transaction, "HEAD",
+			update->flags | REF_LOG_ONLY | REF_NO_DEREF,
+			&update->new_oid, &update->old_oid,
+			update->msg);
+
+	item = string_list_insert(affected_refnames, new_update->refname);
+	item->util = new_update;
+
+	return 0;
+}
+
+/*
+ * update is for a symref that points at referent and doesn't have
+ * REF_NO_DEREF set. Split it into two updates: the symref becomes
+ * log-only and the update is forwarded to the referent.
+ */
+static int split_symref_update(struct ref_update *update,
+			       const char *referent,
+			       struct ref_transaction *transaction,
+			       struct string_list *affected_refnames,
+			       struct strbuf *err)
+{
+	struct string_list_item *item;
+	struct ref_update *new_update;
+	unsigned int new_flags;
+
+	if (string_list_has_string(affected_refnames, referent)) {
+		strbuf_addf(err,
+			    "multiple updates for '%s' (including one "
+			    "via symref '%s') are not allowed",
+			    referent, update->refname);
+		return TRANSACTION_NAME_CONFLICT;
+	}
+
+	new_flags = update->flags;
+	if (!strcmp(update->refname, "HEAD"))
+		new_flags |= REF_UPDATE_VIA_HEAD;
+
+	new_update = ref_transaction_add_update(
+			transaction, referent, new_flags,
+			&update->new_oid, &update->old_oid,
+			update->msg);
+
+	new_update->parent_update = update;
+
+	update->flags |= REF_LOG_ONLY | REF_NO_DEREF;
+	update->flags &= ~REF_HAVE_OLD;
+
+	item = string_list_insert(affected_refnames, new_update->refname);
+	if (item->util)
+		BUG("%s unexpectedly found in affected_refnames",
+		    new_update->refname);
+	item->util = new_update;
+
+	return 0;
+}
+
+static int check_old_oid(struct ref_update *update, struct object_id *oid,
+			 struct strbuf *err)
+{
+	if (!(update->flags & REF_HAVE_OLD) ||
+		   oideq(oid, &update->old_oid))
+		return 0;
+
+	if (is_null_oid(&update->old_oid))
+		strbuf_addf(err, "cannot lock ref '%s': "
+			    "reference already exists",
+			    original_update_refname(update));
+	else if (is_null_oid(oid))
+		strbuf_addf(err, "cannot lock ref '%s': "
+			    "reference is missing but expected %s",
+			    original_update_refname(update),
+			    oid_to_hex(&update->old_oid));
+	else
+		strbuf_addf(err, "cannot lock ref '%s': "
+			    "is at %s but expected %s",
+			    original_update_refname(update),
+			    oid_to_hex(oid),
+			    oid_to_hex(&update->old_oid));
+
+	return -1;
+}
+
+static int verify_new_object(struct reftable_ref_store *refs,
+			     struct ref_update *update,
+			     struct strbuf *err)
+{
+	struct object *o = parse_object(refs->base.repo, &update->new_oid);
+
+	if (!o) {
+		strbuf_addf(err, "cannot update ref '%s': "
+			    "trying to write ref '%s' with nonexistent object %s",
+			    update->refname, update->refname,
+			    oid_to_hex(&update->new_oid));
+		return -1;
+	}
+
+	if (o->type != OBJ_COMMIT && is_branch(update->refname)) {
+		strbuf_addf(err, "cannot update ref '%s': "
+			    "trying to write non-commit object %s to branch '%s'",
+			    update->refname, oid_to_hex(&update->new_oid),
+			    update->refname);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int prepare_transaction_update(struct reftable_ref_store *refs,
+				      struct reftable_transaction_data *tx_data,
+				      struct ref_transaction *transaction,
+				      struct ref_update *update,
+				      const char *head_ref,
+				      struct string_list *affected_refnames,
+				      struct strbuf *err)
+{
+	struct write_transaction_table_arg *arg;
+	struct reftable_transaction_update *tx_update;
+	struct strbuf referent = STRBUF_INIT;
+	struct object_id current_oid = { 0 };
+	const char *rewritten_ref;
+	unsigned int type = 0;
+	int ret;
+
+	if (head_ref) {
+		ret = split_head_update(update, transaction, head_ref,
+					affected_refnames, err);
+		if (ret)
+			goto done;
+	}
+
+	ret = transaction_lock_stack(refs, tx_data, update->refname, &arg,
+				     &rewritten_ref, err);
+	if (ret)
+		goto done;
+
+	ret = read_ref_without_reload(arg->be->stack, rewritten_ref,
+				      &current_oid, &referent, &type);
+	if (ret < 0) {
+		strbuf_addf(err, "cannot lock ref '%s': error reading reference",
+			    original_update_refname(update));
+		goto done;
+	}
+
+	if (ret > 0) {
+		/* The reference does not exist yet. */
+		if ((update->flags & REF_HAVE_OLD) &&
+		    !is_null_oid(&update->old_oid)) {
+			strbuf_addf(err, "cannot lock ref '%s': "
+				    "unable to resolve reference '%s'",
+				    original_update_refname(update),
+				    update->refname);
+			ret = -1;
+			goto done;
+		}
+
+		if ((update->flags & REF_HAVE_NEW) &&
+		    !is_null_oid(&update->new_oid) &&
+		    !(update->flags & REF_LOG_ONLY)) {
+			struct strbuf reason = STRBUF_INIT;
+
+			if (refs_verify_refname_available(&refs->base,
+							  update->refname,
+							  affected_refnames,
+							  NULL, &reason)) {
+				strbuf_addf(err, "cannot lock ref '%s': %s",
+					    original_update_refname(update),
+					    reason.buf);
+				strbuf_release(&reason);
+				ret = TRANSACTION_NAME_CONFLICT;
+				goto done;
+			}
+		}
+
+		ret = 0;
+	}
+
+	if (type & REF_ISSYMREF) {
+		if (update->flags & REF_NO_DEREF) {
+			/*
+			 * We won't be reading the referent as part of
+			 * the transaction, so we have to read it here
+			 * to record and possibly check old_oid:
+			 */
+			if (!refs_resolve_ref_unsafe(&refs->base, referent.buf, 0,
+						     &current_oid, NULL)) {
+				if (update->flags & REF_HAVE_OLD) {
+					strbuf_addf(err, "cannot lock ref '%s': "
+						    "error reading reference",
+						    original_update_refname(update));
+					ret = -1;
+					goto done;
+				}
+				oidclr(&current_oid);
+			} else if (check_old_oid(update, &current_oid, err)) {
+				ret = -1;
+				goto done;
+			}
+		} else {
+			ret = split_symref_update(update, referent.buf,
+						  transaction,
+						  affected_refnames, err);
+			if (ret)
+				goto done;
+		}
+	} else {
+		struct ref_update *parent_update;
+
+		if (check_old_oid(update, &current_oid, err)) {
+			ret = -1;
+			goto done;
+		}
+
+		/*
+		 * If this update is happening indirectly because of a
+		 * symref update, record the old OID in the parent
+		 * update so that its reflog entry is correct.
+		 */
+		for (parent_update = update->parent_update;
+		     parent_update;
+		     parent_update = parent_update->parent_update) {
+			struct reftable_transaction_update *parent =
+				parent_update->backend_data;
+			oidcpy(&parent->current_oid, &current_oid);
+		}
+	}
+
+	if ((update->flags & REF_HAVE_NEW) &&
+	    !is_null_oid(&update->new_oid) &&
+	    !(update->flags & REF_LOG_ONLY) &&
+	    !(update->flags & REF_SKIP_OID_VERIFICATION) &&
+	    ((type & REF_ISSYMREF) || !oideq(&current_oid, &update->new_oid))) {
+		ret = verify_new_object(refs, update, err);
+		if (ret)
+			goto done;
+	}
+
+	CALLOC_ARRAY(tx_update, 1);
+	tx_update->update = update;
+	tx_update->is_symref = !!(type & REF_ISSYMREF);
+	oidcpy(&tx_update->current_oid, &current_oid);
+	update->backend_data = tx_update;
+
+	ALLOC_GROW(arg->updates, arg->updates_nr + 1, arg->updates_alloc);
+	arg->updates[arg->updates_nr++] = tx_update;
+
+done:
+	strbuf_release(&referent);
+	return ret;
+}
+
+static int reftable_be_transaction_prepare(struct ref_store *ref_store,
+					   struct ref_transaction *transaction,
+					   struct strbuf *err)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_WRITE, "ref_transaction_prepare");
+	struct string_list affected_refnames = STRING_LIST_INIT_NODUP;
+	struct reftable_transaction_data *tx_data;
+	char *head_ref = NULL;
+	int head_type;
+	size_t i;
+	int ret = 0;
+
+	CALLOC_ARRAY(tx_data, 1);
+	transaction->backend_data = tx_data;
+
+	/*
+	 * Fail if a refname appears more than once in the transaction.
+	 * Updates added by split_symref_update() and split_head_update()
+	 * are checked when they are added.
+	 */
+	for (i = 0; i < transaction->nr; i++)
+		string_list_append(&affected_refnames,
+				   transaction->updates[i]->refname)->util =
+			transaction->updates[i];
+	string_list_sort(&affected_refnames);
+	if (ref_update_reject_duplicates(&affected_refnames, err)) {
+		ret = TRANSACTION_GENERIC_ERROR;
+		goto done;
+	}
+
+	/*
+	 * Like the files backend, also update the reflog of HEAD when
+	 * the reference it points to is updated directly.
+	 */
+	head_ref = refs_resolve_refdup(ref_store, "HEAD",
+				       RESOLVE_REF_NO_RECURSE,
+				       NULL, &head_type);
+	if (head_ref && !(head_type & REF_ISSYMREF))
+		FREE_AND_NULL(head_ref);
+
+	/* Note that this loop may append more updates to the transaction. */
+	for (i = 0; i < transaction->nr; i++) {
+		ret = prepare_transaction_update(refs, tx_data, transaction,
+						 transaction->updates[i],
+						 head_ref, &affected_refnames,
+						 err);
+		if (ret)
+			goto done;
+	}
+
+done:
+	free(head_ref);
+	string_list_clear(&affected_refnames, 0);
+
+	if (ret) {
+		free_transaction_data(tx_data);
+		transaction->backend_data = NULL;
+		transaction->state = REF_TRANSACTION_CLOSED;
+		if (!err->len)
+			strbuf_addstr(err, _("reftable: transaction prepare failure"));
+		return ret < 0 ? TRANSACTION_GENERIC_ERROR : ret;
+	}
+
+	transaction->state = REF_TRANSACTION_PREPARED;
+	return 0;
+}
+
+static int reftable_be_transaction_abort(struct ref_store *ref_store UNUSED,
+					 struct ref_transaction *transaction,
+					 struct strbuf *err UNUSED)
+{
+	free_transaction_data(transaction->backend_data);
+	transaction->backend_data = NULL;
+	transaction->state = REF_TRANSACTION_CLOSED;
+	return 0;
+}
+
+/* Convert the prepared updates that go into one stack into records. */
+static int collect_transaction_records(struct reftable_ref_store *refs,
+				       struct write_transaction_table_arg *arg,
+				       int skip_logs,
+				       struct table_records *records)
+{
+	struct reftable_stack *stack = arg->be->stack;
+	size_t i;
+	int ret;
+
+	records->update_index = reftable_stack_next_update_index(stack);
+
+	for (i = 0; i < arg->updates_nr; i++) {
+		struct reftable_transaction_update *tx_update = arg->updates[i];
+		struct ref_update *u = tx_update->update;
+		struct reftable_log_record *log;
+		struct reftable_ref_record *ref;
+		const char *rewritten_ref;
+		int write_log;
+
+		if (!(u->flags & REF_HAVE_NEW))
+			continue;
+
+		backend_for(refs, u->refname, &rewritten_ref);
+		write_log = !skip_logs &&
+			should_write_log(stack, u->refname, rewritten_ref,
+					 u->flags);
+
+		if (u->flags & REF_LOG_ONLY) {
+			if (!write_log)
+				continue;
+		} else if (is_null_oid(&u->new_oid)) {
+			/* Deleting a reference also deletes its reflog. */
+			add_ref_record(records, rewritten_ref);
+			ret = add_reflog_tombstones(records, stack,
+						    rewritten_ref, NULL, 0);
+			if (ret < 0)
+				return ret;
+			continue;
+		} else if (!tx_update->is_symref &&
+			   oideq(&tx_update->current_oid, &u->new_oid)) {
+			/* The reference already has the desired value. */
+			continue;
+		} else {
+			ref = add_ref_record(records, rewritten_ref);
+			set_ref_record_oid(ref, &u->new_oid);
+			if (!write_log)
+				continue;
+		}
+
+		log = add_log_record(records, rewritten_ref,
+				     records->update_index);
+		set_log_record_update(log, &tx_update->current_oid,
+				      &u->new_oid, u->msg);
+	}
+
+	return 0;
+}
+
+static int reftable_be_transaction_finish(struct ref_store *ref_store,
+					  struct ref_transaction *transaction,
+					  struct strbuf *err)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_WRITE, "ref_transaction_finish");
+	struct reftable_transaction_data *tx_data = transaction->backend_data;
+	size_t i;
+	int ret = 0;
+
+	if (!tx_data)
+		goto done;
+
+	/*
+	 * Write the new tables of all stacks first and only then commit
+	 * them, so that a failure to write any of the tables leaves all
+	 * stacks untouched.
+	 */
+	for (i = 0; !ret && i < tx_data->args_nr; i++) {
+		struct write_transaction_table_arg *arg = &tx_data->args[i];
+		struct table_records records = { 0 };
+
+		ret = collect_transaction_records(refs, arg, tx_data->skip_logs,
+						  &records);
+		if (!ret)
+			ret = reftable_addition_add(arg->addition,
+						    write_records_table,
+						    &records);
+		table_records_release(&records);
+	}
+
+	for (i = 0; !ret && i < tx_data->args_nr; i++)
+		ret = reftable_addition_commit(tx_data->args[i].addition);
+
+	if (ret) {
+		transaction_error(err, ret);
+		ret = TRANSACTION_GENERIC_ERROR;
+	}
+
+	for (i = 0; !ret && i < tx_data->args_nr; i++)
+		maybe_auto_compact(refs, tx_data->args[i].be);
+
+done:
+	free_transaction_data(tx_data);
+	transaction->backend_data = NULL;
+	transaction->state = REF_TRANSACTION_CLOSED;
+	return ret;
+}
+
+static int reftable_be_initial_transaction_commit(struct ref_store *ref_store,
+						  struct ref_transaction *transaction,
+						  struct strbuf *err)
+{
+	size_t i;
+	int ret;
+
+	/*
+	 * Like the files backend, the initial transaction neither
+	 * verifies that the objects exist nor writes any reflogs.
+	 */
+	for (i = 0; i < transaction->nr; i++)
+		transaction->updates[i]->flags |= REF_SKIP_OID_VERIFICATION;
+
+	ret = reftable_be_transaction_prepare(ref_store, transaction, err);
+	if (ret)
+		return ret;
+
+	((struct reftable_transaction_data *)transaction->backend_data)->skip_logs = 1;
+	return reftable_be_transaction_finish(ref_store, transaction, err);
+}
+
+static int reftable_be_pack_refs(struct ref_store *ref_store,
+				 unsigned int flags UNUSED)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_WRITE | REF_STORE_ODB,
+				     "pack_refs");
+	struct reftable_backend *backends[2];
+	size_t i, nr = 0;
+	int ret = 0;
+
+	backends[nr++] = &refs->main_backend;
+	if (refs->worktree_backend)
+		backends[nr++] = refs->worktree_backend;
+
+	for (i = 0; i < nr; i++) {
+		struct reftable_backend *be = backends[i];
+		int err;
+
+		if (!is_directory(be->path))
+			continue;
+
+		err = backend_reload(refs, be);
+		if (!err)
+			err = reftable_stack_compact_all(be->stack, NULL);
+		if (!err)
+			err = reftable_stack_clean(be->stack);
+		if (err)
+			ret = error(_("unable to compact stack '%s': %s"),
+				    be->path, reftable_error_str(err));
+	}
+
+	return ret;
+}
+
+static int reftable_be_create_symref(struct ref_store *ref_store,
+				     const char *refname,
+				     const char *target,
+				     const char *logmsg)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_WRITE, "create_symref");
+	struct table_records records = { 0 };
+	struct object_id old_oid, new_oid;
+	struct reftable_ref_record *ref;
+	struct reftable_backend *be;
+	struct strbuf referent = STRBUF_INIT;
+	struct strbuf err = STRBUF_INIT;
+	const char *rewritten_ref;
+	unsigned int type = 0;
+	int ret;
+
+	ret = backend_for_reading(&be, refs, refname, &rewritten_ref);
+	if (!ret)
+		ret = read_ref_without_reload(be->stack, rewritten_ref, &old_oid,
+					      &referent, &type);
+	if (ret < 0) {
+		ret = error(_("unable to read reference '%s'"), refname);
+		goto done;
+	}
+
+	if (ret > 0 &&
+	    refs_verify_refname_available(&refs->base, refname,
+					  NULL, NULL, &err)) {
+		ret = error("%s", err.buf);
+		goto done;
+	}
+	ret = 0;
+
+	if (!refs_resolve_ref_unsafe(&refs->base, refname, RESOLVE_REF_READING,
+				     &old_oid, NULL))
+		oidclr(&old_oid);
+
+	records.update_index = reftable_stack_next_update_index(be->stack);
+	ref = add_ref_record(&records, rewritten_ref);
+	ref->value_type = REFTABLE_REF_SYMREF;
+	ref->value.symref = xstrdup(target);
+
+	if (logmsg &&
+	    refs_resolve_ref_unsafe(&refs->base, target, RESOLVE_REF_READING,
+				    &new_oid, NULL) &&
+	    should_write_log(be->stack, refname, rewritten_ref, 0)) {
+		struct reftable_log_record *log =
+			add_log_record(&records, rewritten_ref,
+				       records.update_index);
+		set_log_record_update(log, &old_oid, &new_oid, logmsg);
+	}
+
+	if (backend_add_records(refs, be, &records, &err))
+		ret = error("%s", err.buf);
+
+done:
+	table_records_release(&records);
+	strbuf_release(&referent);
+	strbuf_release(&err);
+	return ret;
+}
+
+static int reftable_be_delete_refs(struct ref_store *ref_store,
+				   const char *msg,
+				   struct string_list *refnames,
+				   unsigned int flags)
+{
+	struct strbuf err = STRBUF_INIT;
+	struct ref_transaction *transaction;
+	struct string_list_item *item;
+	int ret;
+
+	reftable_be_downcast(ref_store, REF_STORE_WRITE, "delete_refs");
+
+	if (!refnames->nr)
+		return 0;
+
+	/*
+	 * Since we don't check the references' old_oids, the
+	 * individual updates can't fail, so we can pack all of the
+	 * updates into a single transaction.
+	 */
+	transaction = ref_store_transaction_begin(ref_store, &err);
+	if (!transaction)
+		return -1;
+
+	for_each_string_list_item(item, refnames) {
+		if (ref_transaction_delete(transaction, item->string, NULL,
+					   flags, msg, &err)) {
+			warning(_("could not delete reference %s: %s"),
+				item->string, err.buf);
+			strbuf_reset(&err);
+		}
+	}
+
+	ret = ref_transaction_commit(transaction, &err);
+
+	if (ret) {
+		if (refnames->nr == 1)
+			error(_("could not delete reference %s: %s"),
+			      refnames->items[0].string, err.buf);
+		else
+			error(_("could not delete references: %s"), err.buf);
+	}
+
+	ref_transaction_free(transaction);
+	strbuf_release(&err);
+	return ret;
+}
+
+static int reftable_be_copy_or_rename_ref(struct ref_store *ref_store,
+					  const char *oldrefname,
+					  const char *newrefname,
+					  const char *logmsg,
+					  int copy)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_WRITE, "rename_ref");
+	const char *old_rewritten, *new_rewritten;
+	struct reftable_log_record *logs = NULL;
+	struct table_records records = { 0 };
+	struct string_list skip = STRING_LIST_INIT_NODUP;
+	struct reftable_backend *be;
+	struct reftable_ref_record *ref;
+	struct strbuf err = STRBUF_INIT;
+	struct object_id orig_oid;
+	size_t logs_nr = 0, i;
+	int flag = 0, ret = 0;
+
+	if (!refs_resolve_ref_unsafe(&refs->base, oldrefname,
+				     RESOLVE_REF_READING | RESOLVE_REF_NO_RECURSE,
+				     &orig_oid, &flag)) {
+		ret = error("refname %s not found", oldrefname);
+		goto done;
+	}
+
+	if (flag & REF_ISSYMREF) {
+		if (copy)
+			ret = error("refname %s is a symbolic ref, copying it is not supported",
+				    oldrefname);
+		else
+			ret = error("refname %s is a symbolic ref, renaming it is not supported",
+				    oldrefname);
+		goto done;
+	}
+
+	/* When copying, the old reference stays and may still conflict. */
+	if (!copy)
+		string_list_insert(&skip, oldrefname);
+	if (refs_verify_refname_available(&refs->base, newrefname,
+					  NULL, &skip, &err)) {
+		ret = error("%s", err.buf);
+		goto done;
+	}
+
+	be = backend_for(refs, oldrefname, &old_rewritten);
+	if (be != backend_for(refs, newrefname, &new_rewritten)) {
+		strbuf_addstr(&err, _("cannot move references between "
+				      "reference stores"));
+		goto failure;
+	}
+
+	if (backend_reload(refs, be) < 0) {
+		strbuf_addf(&err, _("unable to reload reftable stack '%s'"),
+			    be->path);
+		goto failure;
+	}
+
+	ret = read_log_records(be->stack, old_rewritten, &logs, &logs_nr);
+	if (ret < 0) {
+		strbuf_addstr(&err, reftable_error_str(ret));
+		goto failure;
+	}
+
+	records.update_index = reftable_stack_next_update_index(be->stack);
+
+	ref = add_ref_record(&records, new_rewritten);
+	set_ref_record_oid(ref, &orig_oid);
+
+	/*
+	 * The reflog of the new reference is replaced with the one of
+	 * the old reference, which moves along unless we copy. There is
+	 * nothing to move when renaming a reference onto itself.
+	 */
+	if (strcmp(old_rewritten, new_rewritten)) {
+		if (!copy)
+			add_ref_record(&records, old_rewritten);
+
+		for (i = 0; i < logs_nr; i++) {
+			struct reftable_log_record *log =
+				add_log_record(&records, new_rewritten,
+					       logs[i].update_index);
+			copy_log_record_update(log, &logs[i]);
+			if (!copy)
+				add_log_record(&records, old_rewritten,
+					       logs[i].update_index);
+		}
+
+		ret = add_reflog_tombstones(&records, be->stack, new_rewritten,
+					    logs, logs_nr);
+		if (ret < 0) {
+			strbuf_addstr(&err, reftable_error_str(ret));
+			goto failure;
+		}
+	}
+
+	/*
+	 * Like the files backend, which deletes the old reference via a
+	 * transaction, record the deletion in the reflog of HEAD when it
+	 * points to the renamed reference.
+	 */
+	if (!copy) {
+		const char *head_rewritten;
+		const char *head_ref;
+		int head_flag;
+
+		head_ref = refs_resolve_ref_unsafe(&refs->base, "HEAD",
+						   RESOLVE_REF_NO_RECURSE,
+						   NULL, &head_flag);
+		if (head_ref && (head_flag & REF_ISSYMREF) &&
+		    !strcmp(head_ref, oldrefname) &&
+		    backend_for(refs, "HEAD", &head_rewritten) == be &&
+		    should_write_log(be->stack, "HEAD", head_rewritten, 0)) {
+			struct reftable_log_record *log =
+				add_log_record(&records, head_rewritten,
+					       records.update_index);
+			set_log_record_update(log, &orig_oid, null_oid(), logmsg);
+		}
+	}
+
+	if (logs_nr || should_write_log(be->stack, newrefname,
+					new_rewritten, 0)) {
+		struct reftable_log_record *log =
+			add_log_record(&records, new_rewritten,
+				       records.update_index);
+		set_log_record_update(log, &orig_oid, &orig_oid, logmsg);
+	}
+
+	if (!backend_add_records(refs, be, &records, &err)) {
+		ret = 0;
+		goto done;
+	}
+
+failure:
+	if (copy)
+		ret = error("unable to copy '%s' to '%s': %s",
+			    oldrefname, newrefname, err.buf);
+	else
+		ret = error("unable to rename '%s' to '%s': %s",
+			    oldrefname, newrefname, err.buf);
+
+done:
+	free_log_records(logs, logs_nr);
+	table_records_release(&records);
+	string_list_clear(&skip, 0);
+	strbuf_release(&err);
+	return ret;
+}
+
+static int reftable_be_rename_ref(struct ref_store *ref_store,
+				  const char *oldrefname,
+				  const char *newrefname,
+				  const char *logmsg)
+{
+	return reftable_be_copy_or_rename_ref(ref_store, oldrefname,
+					      newrefname, logmsg, 0);
+}
+
+static int reftable_be_copy_ref(struct ref_store *ref_store,
+				const char *oldrefname,
+				const char *newrefname,
+				const char *logmsg)
+{
+	return reftable_be_copy_or_rename_ref(ref_store, oldrefname,
+					      newrefname, logmsg, 1);
+}
+
+static void add_reflog_existence_marker(struct table_records *records,
+					const char *refname)
+{
+	struct reftable_log_record *log =
+		add_log_record(records, refname, records->update_index);
+
+	set_log_record_update(log, null_oid(), null_oid(), NULL);
+}
+
+static int reftable_be_create_reflog(struct ref_store *ref_store,
+				     const char *refname,
+				     struct strbuf *err)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_WRITE, "create_reflog");
+	struct table_records records = { 0 };
+	struct reftable_backend *be;
+	int ret;
+
+	ret = backend_for_reading(&be, refs, refname, &refname);
+	if (ret < 0) {
+		strbuf_addf(err, _("unable to reload reftable stack '%s'"),
+			    be->path);
+		return -1;
+	}
+
+	if (stack_has_reflog(be->stack, refname))
+		return 0;
+
+	/*
+	 * A reflog only exists as long as it has entries, so we write
+	 * an entry that only marks its existence.
+	 */
+	records.update_index = reftable_stack_next_update_index(be->stack);
+	add_reflog_existence_marker(&records, refname);
+
+	ret = backend_add_records(refs, be, &records, err);
+	table_records_release(&records);
+	return ret;
+}
+
+static int reftable_be_delete_reflog(struct ref_store *ref_store,
+				     const char *refname)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_WRITE, "delete_reflog");
+	struct table_records records = { 0 };
+	struct strbuf err = STRBUF_INIT;
+	struct reftable_backend *be;
+	int ret;
+
+	ret = backend_for_reading(&be, refs, refname, &refname);
+	if (!ret) {
+		records.update_index = reftable_stack_next_update_index(be->stack);
+		ret = add_reflog_tombstones(&records, be->stack, refname,
+					    NULL, 0);
+	}
+	if (ret < 0) {
+		ret = error(_("unable to delete reflog '%s': %s"), refname,
+			    reftable_error_str(ret));
+		goto done;
+	}
+
+	if (backend_add_records(refs, be, &records, &err))
+		ret = error("%s", err.buf);
+
+done:
+	table_records_release(&records);
+	strbuf_release(&err);
+	return ret;
+}
+
+static int reftable_be_reflog_expire(struct ref_store *ref_store,
+				     const char *refname,
+				     unsigned int flags,
+				     reflog_expiry_prepare_fn prepare_fn,
+				     reflog_expiry_should_prune_fn should_prune_fn,
+				     reflog_expiry_cleanup_fn cleanup_fn,
+				     void *policy_cb_data)
+{
+	struct reftable_ref_store *refs =
+		reftable_be_downcast(ref_store, REF_STORE_WRITE, "reflog_expire");
+	struct reftable_log_record *logs = NULL;
+	struct table_records records = { 0 };
+	struct strbuf committer = STRBUF_INIT;
+	struct strbuf err = STRBUF_INIT;
+	struct object_id oid, last_kept_oid = { 0 };
+	const char *rewritten_ref;
+	struct reftable_backend *be;
+	size_t logs_nr = 0, i;
+	int kept = 0, ret;
+
+	ret = backend_for_reading(&be, refs, refname, &rewritten_ref);
+	if (!ret)
+		ret = read_log_records(be->stack, rewritten_ref,
+				       &logs, &logs_nr);
+	if (ret < 0) {
+		ret = error(_("unable to read reflog '%s': %s"), refname,
+			    reftable_error_str(ret));
+		goto done;
+	}
+
+	if (!logs_nr)
+		goto done;
+
+	if (!refs_resolve_ref_unsafe(&refs->base, refname, 0, &oid, NULL))
+		oidclr(&oid);
+
+	records.update_index = reftable_stack_next_update_index(be->stack);
+
+	prepare_fn(refname, &oid, policy_cb_data);
+
+	/* Log records are ordered newest first, but we expire oldest first. */
+	for (i = logs_nr; i; i--) {
+		struct reftable_log_record *log = &logs[i - 1];
+		struct object_id old_oid, new_oid;
+
+		if (is_reflog_existence_marker(log)) {
+			kept = 1;
+			continue;
+		}
+
+		oidread(&old_oid, log->value.update.old_hash);
+		oidread(&new_oid, log->value.update.new_hash);
+		if (flags & EXPIRE_REFLOGS_REWRITE)
+			oidcpy(&old_oid, &last_kept_oid);
+
+		strbuf_reset(&committer);
+		strbuf_addf(&committer, "%s <%s>", log->value.update.name,
+			    log->value.update.email);
+
+		if (should_prune_fn(&old_oid, &new_oid, committer.buf,
+				    log->value.update.time,
+				    log->value.update.tz_offset,
+				    log->value.update.message ?
+				    log->value.update.message : "",
+				    policy_cb_data)) {
+			add_log_record(&records, rewritten_ref,
+				       log->update_index);
+			continue;
+		}
+
+		if (hashcmp(old_oid.hash, log->value.update.old_hash)) {
+			struct reftable_log_record *rewritten =
+				add_log_record(&records, rewritten_ref,
+					       log->update_index);
+			copy_log_record_update(rewritten, log);
+			memcpy(rewritten->value.update.old_hash, old_oid.hash,
+			       the_hash_algo->rawsz);
+		}
+
+		oidcpy(&last_kept_oid, &new_oid);
+		kept = 1;
+	}
+
+	cleanup_fn(policy_cb_data);
+
+	if (flags & EXPIRE_REFLOGS_DRY_RUN)
+		goto done;
+
+	/* Expiring all entries must not delete the reflog itself. */
+	if (!kept)
+		add_reflog_existence_marker(&records, rewritten_ref);
+
+	/*
+	 * It doesn't make sense to adjust a reference pointed to by a
+	 * symbolic ref based on expiring entries in the symbolic
+	 * reference's reflog. Nor can we update a reference if there
+	 * are no remaining reflog entries.
+	 */
+	if ((flags & EXPIRE_REFLOGS_UPDATE_REF) &&
+	    !is_null_oid(&last_kept_oid)) {
+		int type;
+
+		if (refs_resolve_ref_unsafe(&refs->base, refname,
+					    RESOLVE_REF_NO_RECURSE,
+					    NULL, &type) &&
+		    !(type & REF_ISSYMREF))
+			set_ref_record_oid(add_ref_record(&records, rewritten_ref),
+					   &last_kept_oid);
+	}
+
+	if (backend_add_records(refs, be, &records, &err))
+		ret = error("%s", err.buf);
+
+done:
+	free_log_records(logs, logs_nr);
+	table_records_release(&records);
+	strbuf_release(&committer);
+	strbuf_release(&err);
+	return ret;
+}
+
+struct ref_storage_be refs_be_reftable = {
+	.next = NULL,
+	.name = "reftable",
+	.init = reftable_be_init,
+	.init_db = reftable_be_init_db,
+	.transaction_prepare = reftable_be_transaction_prepare,
+	.transaction_finish = reftable_be_transaction_finish,
+	.transaction_abort = reftable_be_transaction_abort,
+	.initial_transaction_commit = reftable_be_initial_transaction_commit,
+
+	.pack_refs = reftable_be_pack_refs,
+	.create_symref = reftable_be_create_symref,
+	.delete_refs = reftable_be_delete_refs,
+	.rename_ref = reftable_be_rename_ref,
+	.copy_ref = reftable_be_copy_ref,
+
+	.iterator_begin = reftable_be_iterator_begin,
+	.read_raw_ref = reftable_be_read_raw_ref,
+	.read_symbolic_ref = reftable_be_read_symbolic_ref,
+
+	.reflog_iterator_begin = reftable_be_reflog_iterator_begin,
+	.for_each_reflog_ent = reftable_be_for_each_reflog_ent,
+	.for_each_reflog_ent_reverse = reftable_be_for_each_reflog_ent_reverse,
+	.reflog_exists = reftable_be_reflog_exists,
+	.create_reflog = reftable_be_create_reflog,
+	.delete_reflog = reftable_be_delete_reflog,
+	.reflog_expire = reftable_be_reflog_expire,
+};
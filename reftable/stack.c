@@ -476,6 +476,8 @@ static int reftable_stack_init_addition(struct reftable_addition *add,
 		} else {
 			err = REFTABLE_IO_ERROR;
 		}
+		/* The lock is not ours, so we must not remove it. */
+		strbuf_release(&add->lock_file_name);
 		goto done;
 	}
 	if (st->config.default_permissions) {
@@ -53,6 +53,9 @@ void prepare_repo_settings(struct repository *r)
 	repo_cfg_bool(r, "core.commitgraph", &r->settings.core_commit_graph, 1);
 	repo_cfg_int(r, "commitgraph.generationversion", &r->settings.commit_graph_generation_version, 2);
 	repo_cfg_bool(r, "commitgraph.readchangedpaths", &r->settings.commit_graph_read_changed_paths, 1);
+	repo_cfg_bool(r, "commitgraph.readreachabilityindex", &r->settings.commit_graph_read_reachability_index, 1);
+	repo_cfg_bool(r, "commitgraph.readfirstparentskips", &r->settings.commit_graph_read_first_parent_skips, 1);
+	repo_cfg_bool(r, "commitgraph.readidents", &r->settings.commit_graph_read_idents, 1);
 	repo_cfg_bool(r, "gc.writecommitgraph", &r->settings.gc_write_commit_graph, 1);
 	repo_cfg_bool(r, "fetch.writecommitgraph", &r->settings.fetch_write_commit_graph, 0);
 
@@ -60,6 +63,7 @@ void prepare_repo_settings(struct repository *r)
 	repo_cfg_bool(r, "pack.usesparse", &r->settings.pack_use_sparse, 1);
 	repo_cfg_bool(r, "core.multipackindex", &r->settings.core_multi_pack_index, 1);
 	repo_cfg_bool(r, "index.sparse", &r->settings.sparse_index, 0);
+	repo_cfg_bool(r, "core.persistentdeltabasecache", &r->settings.pack_base_cache, 0);
 
 	/*
 	 * The GIT_TEST_MULTI_PACK_INDEX variable is special in that
@@ -77,6 +81,12 @@ void prepare_repo_settings(struct repository *r)
 	if (!repo_config_get_int(r, "index.version", &value))
 		r->settings.index_version = value;
 
+	if (repo_config_get_ulong(r, "core.persistentdeltabasecachelimit",
+				  &r->settings.pack_base_cache_limit))
+		r->settings.pack_base_cache_limit = 1024 * 1024 * 1024;
+	if (!r->settings.pack_base_cache_limit)
+		r->settings.pack_base_cache = 0;
+
 	if (!repo_config_get_string_tmp(r, "core.untrackedcache", &strval)) {
 		int v = git_parse_maybe_bool(strval);
 
@@ -33,6 +33,9 @@ struct repo_settings {
 	int core_commit_graph;
 	int commit_graph_generation_version;
 	int commit_graph_read_changed_paths;
+	int commit_graph_read_reachability_index;
+	int commit_graph_read_first_parent_skips;
+	int commit_graph_read_idents;
 	int gc_write_commit_graph;
 	int fetch_write_commit_graph;
 	int command_requires_full_index;
@@ -47,6 +50,9 @@ struct repo_settings {
 	enum fetch_negotiation_setting fetch_negotiation_algorithm;
 
 	int core_multi_pack_index;
+
+	int pack_base_cache;
+	unsigned long pack_base_cache_limit;
 };
 
 struct repo_path_cache {
@@ -151,6 +157,12 @@ struct repository {
 	/* Repository's current hash algorithm, as serialized on disk. */
 	const struct git_hash_algo *hash_algo;
 
+	/*
+	 * Repository's reference storage format, as serialized on disk;
+	 * one of the REF_STORAGE_FORMAT_* values from "refs.h".
+	 */
+	unsigned int ref_storage_format;
+
 	/* A unique-id for tracing purposes. */
 	int trace2_repo_id;
 
@@ -186,6 +198,8 @@ void repo_set_gitdir(struct repository *repo, const char *root,
 		     const struct set_gitdir_args *extra_args);
 void repo_set_worktree(struct repository *repo, const char *path);
 void repo_set_hash_algo(struct repository *repo, int algo);
+void repo_set_ref_storage_format(struct repository *repo,
+				 unsigned int ref_storage_format);
 void initialize_the_repository(void);
 RESULT_MUST_BE_USED
 int repo_init(struct repository *r, const char *gitdir, const char *worktree);
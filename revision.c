@@ -30,6 +30,7 @@
 #include "prio-queue.h"
 #include "hashmap.h"
 #include "utf8.h"
+#include "strmap.h"
 #include "bloom.h"
 #include "json-writer.h"
 #include "list-objects-filter-options.h"
@@ -648,25 +649,52 @@ static void trace2_bloom_filter_statistics_atexit(void)
 
 static int forbid_bloom_filters(struct pathspec *spec)
 {
-	if (spec->has_wildcard)
-		return 1;
-	if (spec->nr > 1)
-		return 1;
-	if (spec->magic & ~PATHSPEC_LITERAL)
-		return 1;
-	if (spec->nr && (spec->items[0].magic & ~PATHSPEC_LITERAL))
+	/* The filters hash the paths as they are in the tree. */
+	if (spec->magic & PATHSPEC_ICASE)
 		return 1;
 
 	return 0;
 }
 
+/*
+ * The keys for the part of a pathspec item that every path it matches
+ * starts with: the whole path if it is literal, or the leading
+ * directories before its first wildcard. NULL if there is no such part.
+ */
+static struct bloom_keyvec *bloom_keyvec_for_item(struct pathspec_item *pi,
+						  const struct bloom_filter_settings *settings)
+{
+	size_t len = pi->nowildcard_len;
+
+	if (len < pi->len)
+		while (len && pi->match[len - 1] != '/')
+			len--;
+	while (len && pi->match[len - 1] == '/')
+		len--;
+	if (!len)
+		return NULL;
+
+	/*
+	 * At this point, the path is normalized to use Unix-style path
+	 * separators. This is required due to how the changed-path Bloom
+	 * filters store the paths.
+	 */
+	return bloom_keyvec_new(pi->match, len, settings);
+}
+
+static void release_bloom_keyvecs(struct rev_info *revs)
+{
+	int i;
+
+	for (i = 0; i < revs->bloom_keyvecs_nr; i++)
+		bloom_keyvec_free(revs->bloom_keyvecs[i]);
+	FREE_AND_NULL(revs->bloom_keyvecs);
+	revs->bloom_keyvecs_nr = 0;
+}
+
 static void prepare_to_use_bloom_filter(struct rev_info *revs)
 {
-	struct pathspec_item *pi;
-	char *path_alloc = NULL;
-	const char *path, *p;
-	size_t len;
-	int path_component_nr = 1;
+	int i;
 
 	if (!revs->commits)
 		return;
@@ -683,63 +711,45 @@ static void prepare_to_use_bloom_filter(struct rev_info *revs)
 	if (!revs->pruning.pathspec.nr)
 		return;
 
-	pi = &revs->pruning.pathspec.items[0];
+	/*
+	 * A commit may differ in the pathspec if it may differ in any of
+	 * its items, so each of them needs keys. Excluded items only take
+	 * paths away, and can be ignored.
+	 */
+	release_bloom_keyvecs(revs);
+	CALLOC_ARRAY(revs->bloom_keyvecs, revs->pruning.pathspec.nr);
+	for (i = 0; i < revs->pruning.pathspec.nr; i++) {
+		struct pathspec_item *pi = &revs->pruning.pathspec.items[i];
+		struct bloom_keyvec *vec;
 
-	/* remove single trailing slash from path, if needed */
-	if (pi->len > 0 && pi->match[pi->len - 1] == '/') {
-		path_alloc = xmemdupz(pi->match, pi->len - 1);
-		path = path_alloc;
-	} else
-		path = pi->match;
+		if (pi->magic & PATHSPEC_EXCLUDE)
+			continue;
+		vec = bloom_keyvec_for_item(pi, revs->bloom_filter_settings);
+		if (!vec) {
+			release_bloom_keyvecs(revs);
+			break;
+		}
+		revs->bloom_keyvecs[revs->bloom_keyvecs_nr++] = vec;
+	}
 
-	len = strlen(path);
-	if (!len) {
+	if (!revs->bloom_keyvecs_nr) {
+		release_bloom_keyvecs(revs);
 		revs->bloom_filter_settings = NULL;
-		free(path_alloc);
 		return;
 	}
 
-	p = path;
-	while (*p) {
-		/*
-		 * At this point, the path is normalized to use Unix-style
-		 * path separators. This is required due to how the
-		 * changed-path Bloom filters store the paths.
-		 */
-		if (*p == '/')
-			path_component_nr++;
-		p++;
-	}
-
-	revs->bloom_keys_nr = path_component_nr;
-	ALLOC_ARRAY(revs->bloom_keys, revs->bloom_keys_nr);
-
-	fill_bloom_key(path, len, &revs->bloom_keys[0],
-		       revs->bloom_filter_settings);
-	path_component_nr = 1;
-
-	p = path + len - 1;
-	while (p > path) {
-		if (*p == '/')
-			fill_bloom_key(path, p - path,
-				       &revs->bloom_keys[path_component_nr++],
-				       revs->bloom_filter_settings);
-		p--;
-	}
-
 	if (trace2_is_enabled() && !bloom_filter_atexit_registered) {
 		atexit(trace2_bloom_filter_statistics_atexit);
 		bloom_filter_atexit_registered = 1;
 	}
-
-	free(path_alloc);
 }
 
 static int check_maybe_different_in_bloom_filter(struct rev_info *revs,
-						 struct commit *commit)
+						 struct commit *commit,
+						 int nth_parent)
 {
-	struct bloom_filter *filter;
-	int result = 1, j;
+	struct bloom_filter *filter, parent_filter;
+	int result = 0, j;
 
 	if (!revs->repo->objects->commit_graph)
 		return -1;
@@ -747,18 +757,25 @@ static int check_maybe_different_in_bloom_filter(struct rev_info *revs,
 	if (commit_graph_generation(commit) == GENERATION_NUMBER_INFINITY)
 		return -1;
 
-	filter = get_bloom_filter(revs->repo, commit);
+	if (nth_parent) {
+		/* Only graphs written with --merge-changed-paths have these. */
+		if (!get_parent_bloom_filter(revs->repo, commit, nth_parent,
+					     &parent_filter))
+			return -1;
+		filter = &parent_filter;
+	} else {
+		filter = get_bloom_filter(revs->repo, commit);
 
-	if (!filter) {
-		count_bloom_filter_not_present++;
-		return -1;
+		if (!filter) {
+			count_bloom_filter_not_present++;
+			return -1;
+		}
 	}
 
-	for (j = 0; result && j < revs->bloom_keys_nr; j++) {
-		result = bloom_filter_contains(filter,
-					       &revs->bloom_keys[j],
-					       revs->bloom_filter_settings);
-	}
+	for (j = 0; !result && j < revs->bloom_keyvecs_nr; j++)
+		result = bloom_filter_contains_vec(filter,
+						   revs->bloom_keyvecs[j],
+						   revs->bloom_filter_settings);
 
 	if (result)
 		count_bloom_filter_maybe++;
@@ -773,7 +790,7 @@ static int rev_compare_tree(struct rev_info *revs,
 {
 	struct tree *t1 = get_commit_tree(parent);
 	struct tree *t2 = get_commit_tree(commit);
-	int bloom_ret = 1;
+	int bloom_ret = -1;
 
 	if (!t1)
 		return REV_TREE_NEW;
@@ -798,8 +815,9 @@ static int rev_compare_tree(struct rev_info *revs,
 			return REV_TREE_SAME;
 	}
 
-	if (revs->bloom_keys_nr && !nth_parent) {
-		bloom_ret = check_maybe_different_in_bloom_filter(revs, commit);
+	if (revs->bloom_keyvecs_nr) {
+		bloom_ret = check_maybe_different_in_bloom_filter(revs, commit,
+								  nth_parent);
 
 		if (bloom_ret == 0)
 			return REV_TREE_SAME;
@@ -809,9 +827,8 @@ static int rev_compare_tree(struct rev_info *revs,
 	revs->pruning.flags.has_changes = 0;
 	diff_tree_oid(&t1->object.oid, &t2->object.oid, "", &revs->pruning);
 
-	if (!nth_parent)
-		if (bloom_ret == 1 && tree_difference == REV_TREE_SAME)
-			count_bloom_filter_false_positive++;
+	if (bloom_ret == 1 && tree_difference == REV_TREE_SAME)
+		count_bloom_filter_false_positive++;
 
 	return tree_difference;
 }
@@ -1086,6 +1103,21 @@ static void try_to_simplify_commit(struct rev_info *revs, struct commit *commit)
 		commit->object.flags |= TREESAME;
 }
 
+/*
+ * With "--first-parent --before=<date>", the first parents that are
+ * too new are not shown and lead to nothing but their own first
+ * parents, so we can jump over them with the first-parent skips of
+ * the commit-graph, as long as nothing else wants to see them.
+ */
+static int can_skip_first_parents(struct rev_info *revs, struct commit *p)
+{
+	return revs->first_parent_only && revs->min_age != -1 &&
+	       p->date > revs->min_age && !(p->object.flags & SEEN) &&
+	       !revs->limited && !revs->prune && !revs->reflog_info &&
+	       !revs->rewrite_parents && !revs->graph && !revs->boundary &&
+	       !revs->line_level_traverse && !revs->include_check;
+}
+
 static int process_parents(struct rev_info *revs, struct commit *commit,
 			   struct commit_list **list, struct prio_queue *queue)
 {
@@ -1160,6 +1192,18 @@ static int process_parents(struct rev_info *revs, struct commit *commit,
 			}
 			return -1;
 		}
+		if (list && can_skip_first_parents(revs, p)) {
+			struct commit *old;
+
+			if (!commit_graph_first_parent_until(revs->repo, p,
+							     revs->min_age, &old)) {
+				if (!old)
+					break;
+				if (repo_parse_commit_gently(revs->repo, old, gently) < 0)
+					return -1;
+				p = old;
+			}
+		}
 		if (revs->sources) {
 			char **slot = revision_sources_at(revs->sources, p);
 
@@ -3020,6 +3064,11 @@ void release_revisions(struct rev_info *revs)
 	date_mode_release(&revs->date_mode);
 	release_revisions_mailmap(revs->mailmap);
 	free_grep_patterns(&revs->grep_filter);
+	release_bloom_keyvecs(revs);
+	if (revs->graph_ident_matches) {
+		strintmap_clear(revs->graph_ident_matches);
+		FREE_AND_NULL(revs->graph_ident_matches);
+	}
 	/* TODO (need to handle "no_free"): diff_free(&revs->diffopt) */
 	diff_free(&revs->pruning);
 	reflog_walk_info_release(revs->reflog_info);
@@ -3812,6 +3861,54 @@ int rewrite_parents(struct rev_info *revs, struct commit *commit,
 	return 0;
 }
 
+/*
+ * With nothing but --author and --committer patterns, match them
+ * against the idents the commit-graph has for the commit instead of
+ * reading it, remembering the answer for each pair of idents. Returns
+ * -1 if we cannot.
+ */
+static int commit_match_graph_idents(struct commit *commit,
+				     struct rev_info *opt)
+{
+	const char *author, *committer;
+	size_t author_len, committer_len;
+	struct strbuf key = STRBUF_INIT;
+	int ret;
+
+	if (opt->grep_filter.pattern_list ||
+	    opt->grep_filter.use_reflog_filter || opt->show_notes ||
+	    !is_encoding_utf8(get_log_output_encoding()) ||
+	    commit_graph_idents(opt->repo, commit, &author, &author_len,
+				&committer, &committer_len))
+		return -1;
+
+	/* The date is stripped before matching, so any will do. */
+	strbuf_addf(&key, "author %.*s 0 +0000\ncommitter %.*s 0 +0000\n\n",
+		    (int)author_len, author, (int)committer_len, committer);
+
+	if (!opt->graph_ident_matches) {
+		CALLOC_ARRAY(opt->graph_ident_matches, 1);
+		strintmap_init(opt->graph_ident_matches, -1);
+	}
+	ret = strintmap_get(opt->graph_ident_matches, key.buf);
+	if (ret < 0) {
+		struct strbuf buf = STRBUF_INIT;
+
+		strbuf_addbuf(&buf, &key);
+		if (opt->mailmap) {
+			const char *commit_headers[] = { "author ", "committer ", NULL };
+
+			apply_mailmap_to_header(&buf, commit_headers, opt->mailmap);
+		}
+		ret = grep_buffer(&opt->grep_filter, buf.buf, buf.len);
+		strintmap_set(opt->graph_ident_matches, key.buf, ret);
+		strbuf_release(&buf);
+	}
+
+	strbuf_release(&key);
+	return ret;
+}
+
 static int commit_match(struct commit *commit, struct rev_info *opt)
 {
 	int retval;
@@ -3822,6 +3919,10 @@ static int commit_match(struct commit *commit, struct rev_info *opt)
 	if (!opt->grep_filter.pattern_list && !opt->grep_filter.header_list)
 		return 1;
 
+	retval = commit_match_graph_idents(commit, opt);
+	if (retval >= 0)
+		return retval;
+
 	/* Prepend "fake" headers as needed */
 	if (opt->grep_filter.use_reflog_filter) {
 		strbuf_addstr(&buf, "reflog ");
@@ -59,8 +59,9 @@ struct repository;
 struct rev_info;
 struct string_list;
 struct saved_parents;
-struct bloom_key;
+struct bloom_keyvec;
 struct bloom_filter_settings;
+struct strintmap;
 define_shared_commit_slab(revision_sources, char *);
 
 struct rev_cmdline_info {
@@ -264,6 +265,8 @@ struct rev_info {
 
 	/* Filter by commit log message */
 	struct grep_opt	grep_filter;
+	/* Which pairs of idents from the commit-graph match grep_filter */
+	struct strintmap *graph_ident_matches;
 
 	/* Display history graph */
 	struct git_graph *graph;
@@ -323,9 +326,9 @@ struct rev_info {
 	struct topo_walk_info *topo_walk_info;
 
 	/* Commit graph bloom filter fields */
-	/* The bloom filter key(s) for the pathspec */
-	struct bloom_key *bloom_keys;
-	int bloom_keys_nr;
+	/* The bloom filter keys for each item of the pathspec */
+	struct bloom_keyvec **bloom_keyvecs;
+	int bloom_keyvecs_nr;
 
 	/*
 	 * The bloom filter settings used to generate the key.
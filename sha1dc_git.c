@@ -1,4 +1,7 @@
 #include "cache.h"
+#include "compat/hw-sha.h"
+#include "block-sha1/sha1.h"
+#include "sha1dc_simd.h"
 
 #ifdef DC_SHA1_EXTERNAL
 /*
@@ -22,12 +25,119 @@ void git_SHA1DCFinal(unsigned char hash[20], SHA1_CTX *ctx)
 	    hash_to_hex_algop(hash, &hash_algos[GIT_HASH_SHA1]));
 }
 
+#ifdef SHA1DC_SIMD
+static int sha1dc_always_supported(void)
+{
+	return 1;
+}
+
+#ifdef HAVE_X86_SHA_NI
+static int sha1dc_sha_ni_supported(void)
+{
+	return x86_have_sha_ni();
+}
+#endif
+
+#ifdef HAVE_ARM_SHA
+static int sha1dc_armv8_supported(void)
+{
+	return arm_have_sha1();
+}
+#endif
+
+/*
+ * The backends name the block function used for the blocks that
+ * cannot be part of a collision attack; "sha1dc" hashes everything the
+ * way sha1dc does on its own.
+ */
+const struct git_hash_backend git_SHA1DC_backends[] = {
+#ifdef HAVE_X86_SHA_NI
+	{ "sha-ni", sha1dc_sha_ni_supported, blk_SHA1_blocks_sha_ni },
+#endif
+#ifdef HAVE_ARM_SHA
+	{ "armv8", sha1dc_armv8_supported, blk_SHA1_blocks_armv8 },
+#endif
+	{ "portable", sha1dc_always_supported, blk_SHA1_blocks_portable },
+	{ "sha1dc", sha1dc_always_supported, NULL },
+	{ NULL }
+};
+
+static git_hash_blocks_fn sha1dc_blocks;
+
+void git_SHA1DCUseBackend(const struct git_hash_backend *backend)
+{
+	sha1dc_blocks = backend->blocks;
+}
+
+/*
+ * Feed "nr" whole blocks to an empty buffer in "ctx". Only the blocks
+ * that meet the unavoidable bit conditions of some disturbance vector
+ * need the full collision check of SHA1DCUpdate(); the others (the
+ * vast majority) are only hashed, which sha1dc_blocks does faster.
+ */
+static void sha1dc_update_blocks(SHA1_CTX *ctx, const unsigned char *data,
+				 size_t nr)
+{
+	uint32_t dvmask[SHA1DC_SIMD_LANES];
+
+	while (nr) {
+		size_t n = nr < SHA1DC_SIMD_LANES ? nr : SHA1DC_SIMD_LANES;
+		size_t i = 0;
+
+		sha1dc_ubc_check_blocks(data, n, dvmask);
+		while (i < n) {
+			size_t run = 0;
+
+			while (i + run < n && !dvmask[i + run])
+				run++;
+			if (run) {
+				sha1dc_blocks(ctx->ihv, data + 64 * i, run);
+				ctx->total += 64 * run;
+				i += run;
+			} else {
+				SHA1DCUpdate(ctx, (const char *)data + 64 * i, 64);
+				i++;
+			}
+		}
+		data += 64 * n;
+		nr -= n;
+	}
+}
+#endif
+
 /*
  * Same as SHA1DCUpdate, but adjust types to match git's usual interface.
  */
 void git_SHA1DCUpdate(SHA1_CTX *ctx, const void *vdata, unsigned long len)
 {
 	const char *data = vdata;
+
+#ifdef SHA1DC_SIMD
+	/*
+	 * Without the unavoidable bit conditions, sha1dc checks every
+	 * disturbance vector for every block; leave that to it.
+	 */
+	if (sha1dc_blocks && ctx->detect_coll && ctx->ubc_check) {
+		size_t left = ctx->total & 63;
+
+		if (left) {
+			size_t fill = 64 - left;
+
+			if (len < fill)
+				fill = len;
+			SHA1DCUpdate(ctx, data, fill);
+			data += fill;
+			len -= fill;
+		}
+		if (len >= 64) {
+			sha1dc_update_blocks(ctx, (const unsigned char *)data,
+					     len / 64);
+			data += len & ~63UL;
+			len &= 63;
+		}
+	}
+#endif
+
 	/* We expect an unsigned long, but sha1dc only takes an int */
 	while (len > INT_MAX) {
 		SHA1DCUpdate(ctx, data, INT_MAX);
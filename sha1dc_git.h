@@ -17,6 +17,20 @@ void git_SHA1DCInit(SHA1_CTX *);
 void git_SHA1DCFinal(unsigned char [20], SHA1_CTX *);
 void git_SHA1DCUpdate(SHA1_CTX *ctx, const void *data, unsigned long len);
 
+#if defined(__GNUC__) && !defined(DC_SHA1_EXTERNAL)
+/*
+ * Check blocks for collision attacks several at a time, and hash the
+ * ones that pass with the faster block functions of block-sha1/; see
+ * sha1dc_simd.c.
+ */
+#define SHA1DC_SIMD
+extern const struct git_hash_backend git_SHA1DC_backends[];
+void git_SHA1DCUseBackend(const struct git_hash_backend *backend);
+
+#define platform_SHA1_backends git_SHA1DC_backends
+#define platform_SHA1_use_backend git_SHA1DCUseBackend
+#endif
+
 #define platform_SHA_CTX SHA1_CTX
 #define platform_SHA1_Init git_SHA1DCInit
 #define platform_SHA1_Update git_SHA1DCUpdate
@@ -0,0 +1,274 @@
+/*
+ * Check the unavoidable bit conditions of sha1dc for several blocks at
+ * once, using the vector extension of GCC and clang.
+ *
+ * The conditions are a mechanical translation of ubc_check() in
+ * sha1dc/ubc_check.c (Copyright 2017 Marc Stevens, Dan Shumow;
+ * distributed under the MIT license, see sha1dc/LICENSE.txt), which is
+ * itself generated from the list of disturbance vectors:
+ *
+ *  - "if (mask & ...)" guards that only skip work are dropped, as the
+ *    lanes cannot branch independently;
+ *
+ *  - a condition "if (!(x) || !(!(y))) mask &= ~DV_bit;" becomes
+ *    "mask &= ~(DV_bit & (UBC_ZERO(x) | UBC_NONZERO(y)));".
+ *
+ * Keep them in sync when updating sha1dc.
+ */
+#include "cache.h"
+#include "compat/hw-sha.h"
+#include "sha1dc_git.h"
+#include "sha1dc_simd.h"
+
+#ifdef SHA1DC_SIMD
+
+typedef uint32_t sha1dc_vec __attribute__((vector_size(4 * SHA1DC_SIMD_LANES)));
+
+/* Comparisons give -1 (all bits set) for true, and 0 for false. */
+#define UBC_ZERO(x) ((sha1dc_vec)((x) == 0))
+#define UBC_NONZERO(x) ((sha1dc_vec)((x) != 0))
+
+#define DV_I_43_0_bit (1u << 0)
+#define DV_I_44_0_bit (1u << 1)
+#define DV_I_45_0_bit (1u << 2)
+#define DV_I_46_0_bit (1u << 3)
+#define DV_I_46_2_bit (1u << 4)
+#define DV_I_47_0_bit (1u << 5)
+#define DV_I_47_2_bit (1u << 6)
+#define DV_I_48_0_bit (1u << 7)
+#define DV_I_48_2_bit (1u << 8)
+#define DV_I_49_0_bit (1u << 9)
+#define DV_I_49_2_bit (1u << 10)
+#define DV_I_50_0_bit (1u << 11)
+#define DV_I_50_2_bit (1u << 12)
+#define DV_I_51_0_bit (1u << 13)
+#define DV_I_51_2_bit (1u << 14)
+#define DV_I_52_0_bit (1u << 15)
+#define DV_II_45_0_bit (1u << 16)
+#define DV_II_46_0_bit (1u << 17)
+#define DV_II_46_2_bit (1u << 18)
+#define DV_II_47_0_bit (1u << 19)
+#define DV_II_48_0_bit (1u << 20)
+#define DV_II_49_0_bit (1u << 21)
+#define DV_II_49_2_bit (1u << 22)
+#define DV_II_50_0_bit (1u << 23)
+#define DV_II_50_2_bit (1u << 24)
+#define DV_II_51_0_bit (1u << 25)
+#define DV_II_51_2_bit (1u << 26)
+#define DV_II_52_0_bit (1u << 27)
+#define DV_II_53_0_bit (1u << 28)
+#define DV_II_54_0_bit (1u << 29)
+#define DV_II_55_0_bit (1u << 30)
+#define DV_II_56_0_bit (1u << 31)
+
+/* The conditions only look at the first 65 words of the message. */
+#define UBC_WORDS 65
+
+static inline __attribute__((always_inline))
+void ubc_check_lanes(const unsigned char *data, size_t nr, uint32_t *dvmask)
+{
+	sha1dc_vec W[UBC_WORDS], mask, x;
+	size_t i, t;
+
+	memset(W, 0, 16 * sizeof(*W));
+	for (i = 0; i < nr; i++)
+		for (t = 0; t < 16; t++)
+			W[t][i] = get_be32(data + 64 * i + 4 * t);
+	for (t = 16; t < UBC_WORDS; t++) {
+		x = W[t - 3] ^ W[t - 8] ^ W[t - 14] ^ W[t - 16];
+		W[t] = (x << 1) | (x >> 31);
+	}
+
+	mask = ~(sha1dc_vec){ 0 };
+	mask &= (((((W[44]^W[45])>>29)&1)-1) | ~(DV_I_48_0_bit|DV_I_51_0_bit|DV_I_52_0_bit|DV_II_45_0_bit|DV_II_46_0_bit|DV_II_50_0_bit|DV_II_51_0_bit));
+	mask &= (((((W[49]^W[50])>>29)&1)-1) | ~(DV_I_46_0_bit|DV_II_45_0_bit|DV_II_50_0_bit|DV_II_51_0_bit|DV_II_55_0_bit|DV_II_56_0_bit));
+	mask &= (((((W[48]^W[49])>>29)&1)-1) | ~(DV_I_45_0_bit|DV_I_52_0_bit|DV_II_49_0_bit|DV_II_50_0_bit|DV_II_54_0_bit|DV_II_55_0_bit));
+	mask &= ((((W[47]^(W[50]>>25))&(1<<4))-(1<<4)) | ~(DV_I_47_0_bit|DV_I_49_0_bit|DV_I_51_0_bit|DV_II_45_0_bit|DV_II_51_0_bit|DV_II_56_0_bit));
+	mask &= (((((W[47]^W[48])>>29)&1)-1) | ~(DV_I_44_0_bit|DV_I_51_0_bit|DV_II_48_0_bit|DV_II_49_0_bit|DV_II_53_0_bit|DV_II_54_0_bit));
+	mask &= (((((W[46]>>4)^(W[49]>>29))&1)-1) | ~(DV_I_46_0_bit|DV_I_48_0_bit|DV_I_50_0_bit|DV_I_52_0_bit|DV_II_50_0_bit|DV_II_55_0_bit));
+	mask &= (((((W[46]^W[47])>>29)&1)-1) | ~(DV_I_43_0_bit|DV_I_50_0_bit|DV_II_47_0_bit|DV_II_48_0_bit|DV_II_52_0_bit|DV_II_53_0_bit));
+	mask &= (((((W[45]>>4)^(W[48]>>29))&1)-1) | ~(DV_I_45_0_bit|DV_I_47_0_bit|DV_I_49_0_bit|DV_I_51_0_bit|DV_II_49_0_bit|DV_II_54_0_bit));
+	mask &= (((((W[45]^W[46])>>29)&1)-1) | ~(DV_I_49_0_bit|DV_I_52_0_bit|DV_II_46_0_bit|DV_II_47_0_bit|DV_II_51_0_bit|DV_II_52_0_bit));
+	mask &= (((((W[44]>>4)^(W[47]>>29))&1)-1) | ~(DV_I_44_0_bit|DV_I_46_0_bit|DV_I_48_0_bit|DV_I_50_0_bit|DV_II_48_0_bit|DV_II_53_0_bit));
+	mask &= (((((W[43]>>4)^(W[46]>>29))&1)-1) | ~(DV_I_43_0_bit|DV_I_45_0_bit|DV_I_47_0_bit|DV_I_49_0_bit|DV_II_47_0_bit|DV_II_52_0_bit));
+	mask &= (((((W[43]^W[44])>>29)&1)-1) | ~(DV_I_47_0_bit|DV_I_50_0_bit|DV_I_51_0_bit|DV_II_45_0_bit|DV_II_49_0_bit|DV_II_50_0_bit));
+	mask &= (((((W[42]>>4)^(W[45]>>29))&1)-1) | ~(DV_I_44_0_bit|DV_I_46_0_bit|DV_I_48_0_bit|DV_I_52_0_bit|DV_II_46_0_bit|DV_II_51_0_bit));
+	mask &= (((((W[41]>>4)^(W[44]>>29))&1)-1) | ~(DV_I_43_0_bit|DV_I_45_0_bit|DV_I_47_0_bit|DV_I_51_0_bit|DV_II_45_0_bit|DV_II_50_0_bit));
+	mask &= (((((W[40]^W[41])>>29)&1)-1) | ~(DV_I_44_0_bit|DV_I_47_0_bit|DV_I_48_0_bit|DV_II_46_0_bit|DV_II_47_0_bit|DV_II_56_0_bit));
+	mask &= (((((W[54]^W[55])>>29)&1)-1) | ~(DV_I_51_0_bit|DV_II_47_0_bit|DV_II_50_0_bit|DV_II_55_0_bit|DV_II_56_0_bit));
+	mask &= (((((W[53]^W[54])>>29)&1)-1) | ~(DV_I_50_0_bit|DV_II_46_0_bit|DV_II_49_0_bit|DV_II_54_0_bit|DV_II_55_0_bit));
+	mask &= (((((W[52]^W[53])>>29)&1)-1) | ~(DV_I_49_0_bit|DV_II_45_0_bit|DV_II_48_0_bit|DV_II_53_0_bit|DV_II_54_0_bit));
+	mask &= ((((W[50]^(W[53]>>25))&(1<<4))-(1<<4)) | ~(DV_I_50_0_bit|DV_I_52_0_bit|DV_II_46_0_bit|DV_II_48_0_bit|DV_II_54_0_bit));
+	mask &= (((((W[50]^W[51])>>29)&1)-1) | ~(DV_I_47_0_bit|DV_II_46_0_bit|DV_II_51_0_bit|DV_II_52_0_bit|DV_II_56_0_bit));
+	mask &= ((((W[49]^(W[52]>>25))&(1<<4))-(1<<4)) | ~(DV_I_49_0_bit|DV_I_51_0_bit|DV_II_45_0_bit|DV_II_47_0_bit|DV_II_53_0_bit));
+	mask &= ((((W[48]^(W[51]>>25))&(1<<4))-(1<<4)) | ~(DV_I_48_0_bit|DV_I_50_0_bit|DV_I_52_0_bit|DV_II_46_0_bit|DV_II_52_0_bit));
+	mask &= (((((W[42]^W[43])>>29)&1)-1) | ~(DV_I_46_0_bit|DV_I_49_0_bit|DV_I_50_0_bit|DV_II_48_0_bit|DV_II_49_0_bit));
+	mask &= (((((W[41]^W[42])>>29)&1)-1) | ~(DV_I_45_0_bit|DV_I_48_0_bit|DV_I_49_0_bit|DV_II_47_0_bit|DV_II_48_0_bit));
+	mask &= (((((W[40]>>4)^(W[43]>>29))&1)-1) | ~(DV_I_44_0_bit|DV_I_46_0_bit|DV_I_50_0_bit|DV_II_49_0_bit|DV_II_56_0_bit));
+	mask &= (((((W[39]>>4)^(W[42]>>29))&1)-1) | ~(DV_I_43_0_bit|DV_I_45_0_bit|DV_I_49_0_bit|DV_II_48_0_bit|DV_II_55_0_bit));
+	mask &= (((((W[38]>>4)^(W[41]>>29))&1)-1) | ~(DV_I_44_0_bit|DV_I_48_0_bit|DV_II_47_0_bit|DV_II_54_0_bit|DV_II_56_0_bit));
+	mask &= (((((W[37]>>4)^(W[40]>>29))&1)-1) | ~(DV_I_43_0_bit|DV_I_47_0_bit|DV_II_46_0_bit|DV_II_53_0_bit|DV_II_55_0_bit));
+	mask &= (((((W[55]^W[56])>>29)&1)-1) | ~(DV_I_52_0_bit|DV_II_48_0_bit|DV_II_51_0_bit|DV_II_56_0_bit));
+	mask &= ((((W[52]^(W[55]>>25))&(1<<4))-(1<<4)) | ~(DV_I_52_0_bit|DV_II_48_0_bit|DV_II_50_0_bit|DV_II_56_0_bit));
+	mask &= ((((W[51]^(W[54]>>25))&(1<<4))-(1<<4)) | ~(DV_I_51_0_bit|DV_II_47_0_bit|DV_II_49_0_bit|DV_II_55_0_bit));
+	mask &= (((((W[51]^W[52])>>29)&1)-1) | ~(DV_I_48_0_bit|DV_II_47_0_bit|DV_II_52_0_bit|DV_II_53_0_bit));
+	mask &= (((((W[36]>>4)^(W[40]>>29))&1)-1) | ~(DV_I_46_0_bit|DV_I_49_0_bit|DV_II_45_0_bit|DV_II_48_0_bit));
+	mask &= ((0-(((W[53]^W[56])>>29)&1)) | ~(DV_I_52_0_bit|DV_II_48_0_bit|DV_II_49_0_bit));
+	mask &= ((0-(((W[51]^W[54])>>29)&1)) | ~(DV_I_50_0_bit|DV_II_46_0_bit|DV_II_47_0_bit));
+	mask &= ((0-(((W[50]^W[52])>>29)&1)) | ~(DV_I_49_0_bit|DV_I_51_0_bit|DV_II_45_0_bit));
+	mask &= ((0-(((W[49]^W[51])>>29)&1)) | ~(DV_I_48_0_bit|DV_I_50_0_bit|DV_I_52_0_bit));
+	mask &= ((0-(((W[48]^W[50])>>29)&1)) | ~(DV_I_47_0_bit|DV_I_49_0_bit|DV_I_51_0_bit));
+	mask &= ((0-(((W[47]^W[49])>>29)&1)) | ~(DV_I_46_0_bit|DV_I_48_0_bit|DV_I_50_0_bit));
+	mask &= ((0-(((W[46]^W[48])>>29)&1)) | ~(DV_I_45_0_bit|DV_I_47_0_bit|DV_I_49_0_bit));
+	mask &= ((((W[45]^W[47])&(1<<6))-(1<<6)) | ~(DV_I_47_2_bit|DV_I_49_2_bit|DV_I_51_2_bit));
+	mask &= ((0-(((W[45]^W[47])>>29)&1)) | ~(DV_I_44_0_bit|DV_I_46_0_bit|DV_I_48_0_bit));
+	mask &= (((((W[44]^W[46])>>6)&1)-1) | ~(DV_I_46_2_bit|DV_I_48_2_bit|DV_I_50_2_bit));
+	mask &= ((0-(((W[44]^W[46])>>29)&1)) | ~(DV_I_43_0_bit|DV_I_45_0_bit|DV_I_47_0_bit));
+	mask &= ((0-((W[41]^(W[42]>>5))&(1<<1))) | ~(DV_I_48_2_bit|DV_II_46_2_bit|DV_II_51_2_bit));
+	mask &= ((0-((W[40]^(W[41]>>5))&(1<<1))) | ~(DV_I_47_2_bit|DV_I_51_2_bit|DV_II_50_2_bit));
+	mask &= ((0-(((W[40]^W[42])>>4)&1)) | ~(DV_I_44_0_bit|DV_I_46_0_bit|DV_II_56_0_bit));
+	mask &= ((0-((W[39]^(W[40]>>5))&(1<<1))) | ~(DV_I_46_2_bit|DV_I_50_2_bit|DV_II_49_2_bit));
+	mask &= ((0-(((W[39]^W[41])>>4)&1)) | ~(DV_I_43_0_bit|DV_I_45_0_bit|DV_II_55_0_bit));
+	mask &= ((0-(((W[38]^W[40])>>4)&1)) | ~(DV_I_44_0_bit|DV_II_54_0_bit|DV_II_56_0_bit));
+	mask &= ((0-(((W[37]^W[39])>>4)&1)) | ~(DV_I_43_0_bit|DV_II_53_0_bit|DV_II_55_0_bit));
+	mask &= ((0-((W[36]^(W[37]>>5))&(1<<1))) | ~(DV_I_47_2_bit|DV_I_50_2_bit|DV_II_46_2_bit));
+	mask &= (((((W[35]>>4)^(W[39]>>29))&1)-1) | ~(DV_I_45_0_bit|DV_I_48_0_bit|DV_II_47_0_bit));
+	mask &= ((0-((W[63]^(W[64]>>5))&(1<<0))) | ~(DV_I_48_0_bit|DV_II_48_0_bit));
+	mask &= ((0-((W[63]^(W[64]>>5))&(1<<1))) | ~(DV_I_45_0_bit|DV_II_45_0_bit));
+	mask &= ((0-((W[62]^(W[63]>>5))&(1<<0))) | ~(DV_I_47_0_bit|DV_II_47_0_bit));
+	mask &= ((0-((W[61]^(W[62]>>5))&(1<<0))) | ~(DV_I_46_0_bit|DV_II_46_0_bit));
+	mask &= ((0-((W[61]^(W[62]>>5))&(1<<2))) | ~(DV_I_46_2_bit|DV_II_46_2_bit));
+	mask &= ((0-((W[60]^(W[61]>>5))&(1<<0))) | ~(DV_I_45_0_bit|DV_II_45_0_bit));
+	mask &= (((((W[58]^W[59])>>29)&1)-1) | ~(DV_II_51_0_bit|DV_II_54_0_bit));
+	mask &= (((((W[57]^W[58])>>29)&1)-1) | ~(DV_II_50_0_bit|DV_II_53_0_bit));
+	mask &= ((((W[56]^(W[59]>>25))&(1<<4))-(1<<4)) | ~(DV_II_52_0_bit|DV_II_54_0_bit));
+	mask &= ((0-(((W[56]^W[59])>>29)&1)) | ~(DV_II_51_0_bit|DV_II_52_0_bit));
+	mask &= (((((W[56]^W[57])>>29)&1)-1) | ~(DV_II_49_0_bit|DV_II_52_0_bit));
+	mask &= ((((W[55]^(W[58]>>25))&(1<<4))-(1<<4)) | ~(DV_II_51_0_bit|DV_II_53_0_bit));
+	mask &= ((((W[54]^(W[57]>>25))&(1<<4))-(1<<4)) | ~(DV_II_50_0_bit|DV_II_52_0_bit));
+	mask &= ((((W[53]^(W[56]>>25))&(1<<4))-(1<<4)) | ~(DV_II_49_0_bit|DV_II_51_0_bit));
+	mask &= ((((W[51]^(W[50]>>5))&(1<<1))-(1<<1)) | ~(DV_I_50_2_bit|DV_II_46_2_bit));
+	mask &= ((((W[48]^W[50])&(1<<6))-(1<<6)) | ~(DV_I_50_2_bit|DV_II_46_2_bit));
+	mask &= ((0-(((W[48]^W[55])>>29)&1)) | ~(DV_I_51_0_bit|DV_I_52_0_bit));
+	mask &= ((((W[47]^W[49])&(1<<6))-(1<<6)) | ~(DV_I_49_2_bit|DV_I_51_2_bit));
+	mask &= ((((W[48]^(W[47]>>5))&(1<<1))-(1<<1)) | ~(DV_I_47_2_bit|DV_II_51_2_bit));
+	mask &= ((((W[46]^W[48])&(1<<6))-(1<<6)) | ~(DV_I_48_2_bit|DV_I_50_2_bit));
+	mask &= ((((W[47]^(W[46]>>5))&(1<<1))-(1<<1)) | ~(DV_I_46_2_bit|DV_II_50_2_bit));
+	mask &= ((0-((W[44]^(W[45]>>5))&(1<<1))) | ~(DV_I_51_2_bit|DV_II_49_2_bit));
+	mask &= ((((W[43]^W[45])&(1<<6))-(1<<6)) | ~(DV_I_47_2_bit|DV_I_49_2_bit));
+	mask &= (((((W[42]^W[44])>>6)&1)-1) | ~(DV_I_46_2_bit|DV_I_48_2_bit));
+	mask &= ((((W[43]^(W[42]>>5))&(1<<1))-(1<<1)) | ~(DV_II_46_2_bit|DV_II_51_2_bit));
+	mask &= ((((W[42]^(W[41]>>5))&(1<<1))-(1<<1)) | ~(DV_I_51_2_bit|DV_II_50_2_bit));
+	mask &= ((((W[41]^(W[40]>>5))&(1<<1))-(1<<1)) | ~(DV_I_50_2_bit|DV_II_49_2_bit));
+	mask &= ((((W[39]^(W[43]>>25))&(1<<4))-(1<<4)) | ~(DV_I_52_0_bit|DV_II_51_0_bit));
+	mask &= ((((W[38]^(W[42]>>25))&(1<<4))-(1<<4)) | ~(DV_I_51_0_bit|DV_II_50_0_bit));
+	mask &= ((0-((W[37]^(W[38]>>5))&(1<<1))) | ~(DV_I_48_2_bit|DV_I_51_2_bit));
+	mask &= ((((W[37]^(W[41]>>25))&(1<<4))-(1<<4)) | ~(DV_I_50_0_bit|DV_II_49_0_bit));
+	mask &= ((0-((W[36]^W[38])&(1<<4))) | ~(DV_II_52_0_bit|DV_II_54_0_bit));
+	mask &= ((0-((W[35]^(W[36]>>5))&(1<<1))) | ~(DV_I_46_2_bit|DV_I_49_2_bit));
+	mask &= ((((W[35]^(W[39]>>25))&(1<<3))-(1<<3)) | ~(DV_I_51_0_bit|DV_II_47_0_bit));
+	mask &= ~(DV_I_43_0_bit & (UBC_ZERO((W[61]^(W[62]>>5)) & (1<<1))
+			| UBC_NONZERO((W[59]^(W[63]>>25)) & (1<<5))
+			| UBC_ZERO((W[58]^(W[63]>>30)) & (1<<0))));
+	mask &= ~(DV_I_44_0_bit & (UBC_ZERO((W[62]^(W[63]>>5)) & (1<<1))
+			| UBC_NONZERO((W[60]^(W[64]>>25)) & (1<<5))
+			| UBC_ZERO((W[59]^(W[64]>>30)) & (1<<0))));
+	mask &= ((~((W[40]^W[42])>>2)) | ~DV_I_46_2_bit);
+	mask &= ~(DV_I_47_2_bit & (UBC_ZERO((W[62]^(W[63]>>5)) & (1<<2))
+			| UBC_NONZERO((W[41]^W[43]) & (1<<6))));
+	mask &= ~(DV_I_48_2_bit & (UBC_ZERO((W[63]^(W[64]>>5)) & (1<<2))
+			| UBC_NONZERO((W[48]^(W[49]<<5)) & (1<<6))));
+	mask &= ~(DV_I_49_2_bit & (UBC_NONZERO((W[49]^(W[50]<<5)) & (1<<6))
+			| UBC_ZERO((W[42]^W[50]) & (1<<1))
+			| UBC_NONZERO((W[39]^(W[40]<<5)) & (1<<6))
+			| UBC_ZERO((W[38]^W[40]) & (1<<1))));
+	mask &= ((((W[36]^W[37])<<7)) | ~DV_I_50_0_bit);
+	mask &= ((((W[43]^W[51])<<11)) | ~DV_I_50_2_bit);
+	mask &= ((((W[37]^W[38])<<9)) | ~DV_I_51_0_bit);
+	mask &= ~(DV_I_51_2_bit & (UBC_NONZERO((W[51]^(W[52]<<5)) & (1<<6))
+			| UBC_NONZERO((W[49]^W[51]) & (1<<6))
+			| UBC_NONZERO((W[37]^(W[37]>>5)) & (1<<1))
+			| UBC_NONZERO((W[35]^(W[39]>>25)) & (1<<5))));
+	mask &= ((((W[38]^W[39])<<11)) | ~DV_I_52_0_bit);
+	mask &= ((((W[47]^W[51])<<17)) | ~DV_II_46_2_bit);
+	mask &= ~(DV_II_48_0_bit & (UBC_NONZERO((W[36]^(W[40]>>25)) & (1<<3))
+			| UBC_ZERO((W[35]^(W[40]<<2)) & (1<<30))));
+	mask &= ~(DV_II_49_0_bit & (UBC_NONZERO((W[37]^(W[41]>>25)) & (1<<3))
+			| UBC_ZERO((W[36]^(W[41]<<2)) & (1<<30))));
+	mask &= ~(DV_II_49_2_bit & (UBC_NONZERO((W[53]^(W[54]<<5)) & (1<<6))
+			| UBC_NONZERO((W[51]^W[53]) & (1<<6))
+			| UBC_ZERO((W[50]^W[54]) & (1<<1))
+			| UBC_NONZERO((W[45]^(W[46]<<5)) & (1<<6))
+			| UBC_NONZERO((W[37]^(W[41]>>25)) & (1<<5))
+			| UBC_ZERO((W[36]^(W[41]>>30)) & (1<<0))));
+	mask &= ~(DV_II_50_0_bit & (UBC_ZERO((W[55]^W[58]) & (1<<29))
+			| UBC_NONZERO((W[38]^(W[42]>>25)) & (1<<3))
+			| UBC_ZERO((W[37]^(W[42]<<2)) & (1<<30))));
+	mask &= ~(DV_II_50_2_bit & (UBC_NONZERO((W[54]^(W[55]<<5)) & (1<<6))
+			| UBC_NONZERO((W[52]^W[54]) & (1<<6))
+			| UBC_ZERO((W[51]^W[55]) & (1<<1))
+			| UBC_ZERO((W[45]^W[47]) & (1<<1))
+			| UBC_NONZERO((W[38]^(W[42]>>25)) & (1<<5))
+			| UBC_ZERO((W[37]^(W[42]>>30)) & (1<<0))));
+	mask &= ~(DV_II_51_0_bit & (UBC_NONZERO((W[39]^(W[43]>>25)) & (1<<3))
+			| UBC_ZERO((W[38]^(W[43]<<2)) & (1<<30))));
+	mask &= ~(DV_II_51_2_bit & (UBC_NONZERO((W[55]^(W[56]<<5)) & (1<<6))
+			| UBC_NONZERO((W[53]^W[55]) & (1<<6))
+			| UBC_ZERO((W[52]^W[56]) & (1<<1))
+			| UBC_ZERO((W[46]^W[48]) & (1<<1))
+			| UBC_NONZERO((W[39]^(W[43]>>25)) & (1<<5))
+			| UBC_ZERO((W[38]^(W[43]>>30)) & (1<<0))));
+	mask &= ~(DV_II_52_0_bit & (UBC_NONZERO((W[59]^W[60]) & (1<<29))
+			| UBC_NONZERO((W[40]^(W[44]>>25)) & (1<<3))
+			| UBC_NONZERO((W[40]^(W[44]>>25)) & (1<<4))
+			| UBC_ZERO((W[39]^(W[44]<<2)) & (1<<30))));
+	mask &= ~(DV_II_53_0_bit & (UBC_ZERO((W[58]^W[61]) & (1<<29))
+			| UBC_NONZERO((W[57]^(W[61]>>25)) & (1<<4))
+			| UBC_NONZERO((W[41]^(W[45]>>25)) & (1<<3))
+			| UBC_NONZERO((W[41]^(W[45]>>25)) & (1<<4))));
+	mask &= ~(DV_II_54_0_bit & (UBC_NONZERO((W[58]^(W[62]>>25)) & (1<<4))
+			| UBC_NONZERO((W[42]^(W[46]>>25)) & (1<<3))
+			| UBC_NONZERO((W[42]^(W[46]>>25)) & (1<<4))));
+	mask &= ~(DV_II_55_0_bit & (UBC_NONZERO((W[59]^(W[63]>>25)) & (1<<4))
+			| UBC_NONZERO((W[57]^(W[59]>>25)) & (1<<4))
+			| UBC_NONZERO((W[43]^(W[47]>>25)) & (1<<3))
+			| UBC_NONZERO((W[43]^(W[47]>>25)) & (1<<4))));
+	mask &= ~(DV_II_56_0_bit & (UBC_NONZERO((W[60]^(W[64]>>25)) & (1<<4))
+			| UBC_NONZERO((W[44]^(W[48]>>25)) & (1<<3))
+			| UBC_NONZERO((W[44]^(W[48]>>25)) & (1<<4))));
+
+	for (i = 0; i < nr; i++)
+		dvmask[i] = mask[i];
+}
+
+static void ubc_check_generic(const unsigned char *data, size_t nr,
+			      uint32_t *dvmask)
+{
+	ubc_check_lanes(data, nr, dvmask);
+}
+
+#ifdef HAVE_X86_SHA_NI
+X86_AVX2_TARGET
+static void ubc_check_avx2(const unsigned char *data, size_t nr,
+			   uint32_t *dvmask)
+{
+	ubc_check_lanes(data, nr, dvmask);
+}
+#endif
+
+void sha1dc_ubc_check_blocks(const unsigned char *data, size_t nr,
+			     uint32_t *dvmask)
+{
+	static void (*fn)(const unsigned char *, size_t, uint32_t *);
+
+	if (!fn) {
+		fn = ubc_check_generic;
+#ifdef HAVE_X86_SHA_NI
+		if (x86_have_avx2())
+			fn = ubc_check_avx2;
+#endif
+	}
+	fn(data, nr, dvmask);
+}
+
+#endif /* SHA1DC_SIMD */
@@ -0,0 +1,20 @@
+#ifndef SHA1DC_SIMD_H
+#define SHA1DC_SIMD_H
+
+/*
+ * The number of blocks whose unavoidable bit conditions are checked at
+ * once, one block per lane of a vector register.
+ */
+#define SHA1DC_SIMD_LANES 8
+
+/*
+ * Do what sha1dc's ubc_check() does, for "nr" (at most
+ * SHA1DC_SIMD_LANES) consecutive 64-byte blocks at "data" at once:
+ * dvmask[i] has a bit set for each disturbance vector whose conditions
+ * block "i" meets, and is 0 if the block cannot be part of a known
+ * collision attack.
+ */
+void sha1dc_ubc_check_blocks(const unsigned char *data, size_t nr,
+			     uint32_t *dvmask);
+
+#endif
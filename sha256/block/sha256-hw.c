@@ -0,0 +1,168 @@
+/*
+ * SHA-256 block functions using the SHA instructions of x86 and ARMv8
+ * CPUs. Which one (if any) gets used is decided at runtime, see
+ * blk_SHA256_backends.
+ */
+#include "git-compat-util.h"
+#include "hash.h"
+#include "compat/hw-sha.h"
+#include "./sha256.h"
+
+#if defined(HAVE_X86_SHA_NI) || defined(HAVE_ARM_SHA)
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+#endif
+
+#ifdef HAVE_X86_SHA_NI
+/*
+ * Rounds 4*i to 4*i+3. w[] holds the message schedule for the current
+ * and the next three groups of rounds; as we go, each entry is
+ * replaced with the schedule for four groups later.
+ */
+#define SHA_NI_ROUNDS(i) do { \
+	msg = _mm_add_epi32(w[(i) & 3], \
+			    _mm_loadu_si128((const __m128i *)&sha256_k[4 * (i)])); \
+	cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg); \
+	if ((i) >= 3 && (i) <= 14) { \
+		tmp = _mm_alignr_epi8(w[(i) & 3], w[((i) + 3) & 3], 4); \
+		w[((i) + 1) & 3] = _mm_add_epi32(w[((i) + 1) & 3], tmp); \
+		w[((i) + 1) & 3] = _mm_sha256msg2_epu32(w[((i) + 1) & 3], \
+							w[(i) & 3]); \
+	} \
+	msg = _mm_shuffle_epi32(msg, 0x0e); \
+	abef = _mm_sha256rnds2_epu32(abef, cdgh, msg); \
+	if ((i) >= 1 && (i) <= 12) \
+		w[((i) + 3) & 3] = _mm_sha256msg1_epu32(w[((i) + 3) & 3], \
+							w[(i) & 3]); \
+} while (0)
+
+X86_SHA_NI_TARGET
+void blk_SHA256_blocks_sha_ni(uint32_t *state, const unsigned char *data,
+			      size_t nr)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					     0x0405060700010203ULL);
+	__m128i abef, cdgh, abef_save, cdgh_save, msg, tmp, w[4];
+	int i;
+
+	/* The instructions want the state as ABEF and CDGH. */
+	tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+	cdgh = _mm_loadu_si128((const __m128i *)&state[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xb1);
+	cdgh = _mm_shuffle_epi32(cdgh, 0x1b);
+	abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+	for (; nr; nr--, data += 64) {
+		abef_save = abef;
+		cdgh_save = cdgh;
+
+		for (i = 0; i < 4; i++)
+			w[i] = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)(data + 16 * i)),
+				bswap);
+
+		SHA_NI_ROUNDS(0);
+		SHA_NI_ROUNDS(1);
+		SHA_NI_ROUNDS(2);
+		SHA_NI_ROUNDS(3);
+		SHA_NI_ROUNDS(4);
+		SHA_NI_ROUNDS(5);
+		SHA_NI_ROUNDS(6);
+		SHA_NI_ROUNDS(7);
+		SHA_NI_ROUNDS(8);
+		SHA_NI_ROUNDS(9);
+		SHA_NI_ROUNDS(10);
+		SHA_NI_ROUNDS(11);
+		SHA_NI_ROUNDS(12);
+		SHA_NI_ROUNDS(13);
+		SHA_NI_ROUNDS(14);
+		SHA_NI_ROUNDS(15);
+
+		abef = _mm_add_epi32(abef, abef_save);
+		cdgh = _mm_add_epi32(cdgh, cdgh_save);
+	}
+
+	tmp = _mm_shuffle_epi32(abef, 0x1b);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+	abef = _mm_blend_epi16(tmp, cdgh, 0xf0);
+	cdgh = _mm_alignr_epi8(cdgh, tmp, 8);
+	_mm_storeu_si128((__m128i *)&state[0], abef);
+	_mm_storeu_si128((__m128i *)&state[4], cdgh);
+}
+#endif
+
+#ifdef HAVE_ARM_SHA
+/*
+ * Rounds 4*i to 4*i+3, replacing w[i & 3] with the message schedule
+ * for four groups of rounds later.
+ */
+#define ARMV8_ROUNDS(i) do { \
+	wk = vaddq_u32(w[(i) & 3], vld1q_u32(&sha256_k[4 * (i)])); \
+	tmp = abcd; \
+	abcd = vsha256hq_u32(abcd, efgh, wk); \
+	efgh = vsha256h2q_u32(efgh, tmp, wk); \
+	if ((i) < 12) \
+		w[(i) & 3] = vsha256su1q_u32( \
+			vsha256su0q_u32(w[(i) & 3], w[((i) + 1) & 3]), \
+			w[((i) + 2) & 3], w[((i) + 3) & 3]); \
+} while (0)
+
+ARM_SHA_TARGET
+void blk_SHA256_blocks_armv8(uint32_t *state, const unsigned char *data,
+			     size_t nr)
+{
+	uint32x4_t abcd, efgh, abcd_save, efgh_save, wk, tmp, w[4];
+	int i;
+
+	abcd = vld1q_u32(&state[0]);
+	efgh = vld1q_u32(&state[4]);
+
+	for (; nr; nr--, data += 64) {
+		abcd_save = abcd;
+		efgh_save = efgh;
+
+		for (i = 0; i < 4; i++)
+			w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+
+		ARMV8_ROUNDS(0);
+		ARMV8_ROUNDS(1);
+		ARMV8_ROUNDS(2);
+		ARMV8_ROUNDS(3);
+		ARMV8_ROUNDS(4);
+		ARMV8_ROUNDS(5);
+		ARMV8_ROUNDS(6);
+		ARMV8_ROUNDS(7);
+		ARMV8_ROUNDS(8);
+		ARMV8_ROUNDS(9);
+		ARMV8_ROUNDS(10);
+		ARMV8_ROUNDS(11);
+		ARMV8_ROUNDS(12);
+		ARMV8_ROUNDS(13);
+		ARMV8_ROUNDS(14);
+		ARMV8_ROUNDS(15);
+
+		abcd = vaddq_u32(abcd, abcd_save);
+		efgh = vaddq_u32(efgh, efgh_save);
+	}
+
+	vst1q_u32(&state[0], abcd);
+	vst1q_u32(&state[4], efgh);
+}
+#endif
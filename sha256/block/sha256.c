@@ -1,4 +1,6 @@
 #include "git-compat-util.h"
+#include "hash.h"
+#include "compat/hw-sha.h"
 #include "./sha256.h"
 
 #undef RND
@@ -55,7 +57,7 @@ static inline uint32_t gamma1(uint32_t x)
 	return ror(x, 17) ^ ror(x, 19) ^ (x >> 10);
 }
 
-static void blk_SHA256_Transform(blk_SHA256_CTX *ctx, const unsigned char *buf)
+static void blk_SHA256_Transform(uint32_t *state, const unsigned char *buf)
 {
 
 	uint32_t S[8], W[64], t0, t1;
@@ -63,7 +65,7 @@ static void blk_SHA256_Transform(blk_SHA256_CTX *ctx, const unsigned char *buf)
 
 	/* copy state into S */
 	for (i = 0; i < 8; i++)
-		S[i] = ctx->state[i];
+		S[i] = state[i];
 
 	/* copy the state into 512-bits into W[0..15] */
 	for (i = 0; i < 16; i++, buf += sizeof(uint32_t))
@@ -145,7 +147,51 @@ static void blk_SHA256_Transform(blk_SHA256_CTX *ctx, const unsigned char *buf)
 	RND(S[1],S[2],S[3],S[4],S[5],S[6],S[7],S[0],63,0xc67178f2);
 
 	for (i = 0; i < 8; i++)
-		ctx->state[i] += S[i];
+		state[i] += S[i];
+}
+
+static void blk_SHA256_blocks_portable(uint32_t *state,
+				       const unsigned char *data, size_t nr)
+{
+	for (; nr; nr--, data += BLKSIZE)
+		blk_SHA256_Transform(state, data);
+}
+
+static int blk_SHA256_portable_supported(void)
+{
+	return 1;
+}
+
+#ifdef HAVE_X86_SHA_NI
+static int blk_SHA256_sha_ni_supported(void)
+{
+	return x86_have_sha_ni();
+}
+#endif
+
+#ifdef HAVE_ARM_SHA
+static int blk_SHA256_armv8_supported(void)
+{
+	return arm_have_sha2();
+}
+#endif
+
+const struct git_hash_backend blk_SHA256_backends[] = {
+#ifdef HAVE_X86_SHA_NI
+	{ "sha-ni", blk_SHA256_sha_ni_supported, blk_SHA256_blocks_sha_ni },
+#endif
+#ifdef HAVE_ARM_SHA
+	{ "armv8", blk_SHA256_armv8_supported, blk_SHA256_blocks_armv8 },
+#endif
+	{ "portable", blk_SHA256_portable_supported, blk_SHA256_blocks_portable },
+	{ NULL }
+};
+
+static git_hash_blocks_fn blk_SHA256_blocks = blk_SHA256_blocks_portable;
+
+void blk_SHA256_use_backend(const struct git_hash_backend *backend)
+{
+	blk_SHA256_blocks = backend->blocks;
 }
 
 void blk_SHA256_Update(blk_SHA256_CTX *ctx, const void *data, size_t len)
@@ -165,12 +211,14 @@ void blk_SHA256_Update(blk_SHA256_CTX *ctx, const void *data, size_t len)
 		data = ((const char *)data + left);
 		if (len_buf)
 			return;
-		blk_SHA256_Transform(ctx, ctx->buf);
+		blk_SHA256_blocks(ctx->state, ctx->buf, 1);
 	}
-	while (len >= 64) {
-		blk_SHA256_Transform(ctx, data);
-		data = ((const char *)data + 64);
-		len -= 64;
+	if (len >= 64) {
+		size_t nr = len / 64;
+
+		blk_SHA256_blocks(ctx->state, data, nr);
+		data = ((const char *)data + nr * 64);
+		len -= nr * 64;
 	}
 	if (len)
 		memcpy(ctx->buf, data, len);
@@ -16,9 +16,19 @@ void blk_SHA256_Init(blk_SHA256_CTX *ctx);
 void blk_SHA256_Update(blk_SHA256_CTX *ctx, const void *data, size_t len);
 void blk_SHA256_Final(unsigned char *digest, blk_SHA256_CTX *ctx);
 
+extern const struct git_hash_backend blk_SHA256_backends[];
+void blk_SHA256_use_backend(const struct git_hash_backend *backend);
+
+void blk_SHA256_blocks_sha_ni(uint32_t *state, const unsigned char *data,
+			      size_t nr);
+void blk_SHA256_blocks_armv8(uint32_t *state, const unsigned char *data,
+			     size_t nr);
+
 #define platform_SHA256_CTX blk_SHA256_CTX
 #define platform_SHA256_Init blk_SHA256_Init
 #define platform_SHA256_Update blk_SHA256_Update
 #define platform_SHA256_Final blk_SHA256_Final
+#define platform_SHA256_backends blk_SHA256_backends
+#define platform_SHA256_use_backend blk_SHA256_use_backend
 
 #endif
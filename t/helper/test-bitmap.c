@@ -1,6 +1,10 @@
 #include "test-tool.h"
 #include "cache.h"
 #include "pack-bitmap.h"
+#include "ewah/ewok.h"
+
+#define NUM_SECONDS 3
+#define SPEED_WORDS 16384
 
 static int bitmap_list_commits(void)
 {
@@ -12,8 +16,138 @@ static int bitmap_dump_hashes(void)
 	return test_bitmap_hashes(the_repository);
 }
 
+static int bitmap_dump_pseudo_merges(void)
+{
+	return test_bitmap_pseudo_merges(the_repository);
+}
+
+static int bitmap_name_hash_version_cmd(void)
+{
+	struct bitmap_index *bitmap_git = prepare_bitmap_git(the_repository);
+
+	if (!bitmap_git)
+		return 1;
+	printf("%d\n", bitmap_name_hash_version(bitmap_git));
+	free_bitmap_index(bitmap_git);
+	return 0;
+}
+
+static void fill_words(struct bitmap *b, uint64_t seed)
+{
+	size_t i;
+
+	/* Dense, random-looking words, with a few empty stretches. */
+	for (i = 0; i < b->word_alloc; i++) {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		b->words[i] = (i & 1023) < 64 ? 0 : seed ^ (seed >> 29);
+	}
+}
+
+static void bitmap_op_speed(const char *op, struct bitmap *dst,
+			    struct bitmap *src, struct ewah_bitmap *ewah)
+{
+	clock_t initial, start, end;
+	unsigned long j;
+	double mb;
+
+	/* Use this as an offset to make overflow less likely. */
+	initial = clock();
+	start = end = clock() - initial;
+	for (j = 0; ((end - start) / CLOCKS_PER_SEC) < NUM_SECONDS; j++) {
+		if (!strcmp(op, "or"))
+			bitmap_or(dst, src);
+		else if (!strcmp(op, "and-not"))
+			bitmap_and_not(dst, src);
+		else if (!strcmp(op, "or-ewah"))
+			bitmap_or_ewah(dst, ewah);
+		else
+			bitmap_popcount(src);
+
+		/*
+		 * Only check elapsed time every 128 iterations to avoid
+		 * dominating the runtime with system calls.
+		 */
+		if (!(j & 127))
+			end = clock() - initial;
+	}
+	mb = (double)j * SPEED_WORDS * sizeof(eword_t) / (1024 * 1024);
+	printf("%s: %lu iters; %0.2f MiB/s\n", op, j,
+	       mb / (((double)end - start) / CLOCKS_PER_SEC));
+}
+
+static void bitmap_speed(const struct ewah_backend *b)
+{
+	const char *ops[] = { "or", "and-not", "or-ewah", "popcount" };
+	struct bitmap *dst = bitmap_word_alloc(SPEED_WORDS);
+	struct bitmap *src = bitmap_word_alloc(SPEED_WORDS);
+	struct ewah_bitmap *ewah;
+	int i;
+
+	fill_words(dst, 1);
+	fill_words(src, 2);
+	dst->word_alloc = src->word_alloc = SPEED_WORDS;
+	ewah = bitmap_to_ewah(src);
+
+	ewah_use_backend(b);
+	printf("backend: %s (%d words)\n", b->name, SPEED_WORDS);
+	for (i = 0; i < ARRAY_SIZE(ops); i++)
+		bitmap_op_speed(ops[i], dst, src, ewah);
+
+	ewah_free(ewah);
+	bitmap_free(dst);
+	bitmap_free(src);
+}
+
+static int bitmap_speed_cmd(int argc, const char **argv)
+{
+	const struct ewah_backend *b;
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		for (b = ewah_backends; b->name; b++)
+			if (!strcmp(argv[i], b->name))
+				break;
+		if (!b->name)
+			die("unknown bitmap backend '%s'", argv[i]);
+	}
+
+	/* Benchmark the given backends, or all supported ones. */
+	for (b = ewah_backends; b->name; b++) {
+		if (argc) {
+			for (i = 0; i < argc; i++)
+				if (!strcmp(argv[i], b->name))
+					break;
+			if (i == argc)
+				continue;
+		}
+		if (!b->supported()) {
+			if (argc)
+				die("bitmap backend '%s' is not supported", b->name);
+			continue;
+		}
+		bitmap_speed(b);
+	}
+	return 0;
+}
+
+static int bitmap_backends_cmd(void)
+{
+	const struct ewah_backend *b;
+
+	for (b = ewah_backends; b->name; b++)
+		if (b->supported())
+			puts(b->name);
+	return 0;
+}
+
 int cmd__bitmap(int argc, const char **argv)
 {
+	/* These do not need a repository. */
+	if (argc >= 2 && !strcmp(argv[1], "speed"))
+		return bitmap_speed_cmd(argc - 2, argv + 2);
+	if (argc == 2 && !strcmp(argv[1], "backends"))
+		return bitmap_backends_cmd();
+
 	setup_git_directory();
 
 	if (argc != 2)
@@ -23,10 +157,18 @@ int cmd__bitmap(int argc, const char **argv)
 		return bitmap_list_commits();
 	if (!strcmp(argv[1], "dump-hashes"))
 		return bitmap_dump_hashes();
+	if (!strcmp(argv[1], "name-hash-version"))
+		return bitmap_name_hash_version_cmd();
+	if (!strcmp(argv[1], "dump-pseudo-merges"))
+		return bitmap_dump_pseudo_merges();
 
 usage:
 	usage("\ttest-tool bitmap list-commits\n"
-	      "\ttest-tool bitmap dump-hashes");
+	      "\ttest-tool bitmap dump-hashes\n"
+	      "\ttest-tool bitmap name-hash-version\n"
+	      "\ttest-tool bitmap dump-pseudo-merges\n"
+	      "\ttest-tool bitmap backends\n"
+	      "\ttest-tool bitmap speed [<backend>...]");
 
 	return -1;
 }
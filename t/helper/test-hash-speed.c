@@ -10,7 +10,7 @@ static inline void compute_hash(const struct git_hash_algo *algo, git_hash_ctx *
 	algo->final_fn(final, ctx);
 }
 
-int cmd__hash_speed(int ac, const char **av)
+static void hash_speed(const struct git_hash_algo *algo, const char *backend)
 {
 	git_hash_ctx ctx;
 	unsigned char hash[GIT_MAX_RAWSZ];
@@ -18,23 +18,14 @@ int cmd__hash_speed(int ac, const char **av)
 	unsigned bufsizes[] = { 64, 256, 1024, 8192, 16384 };
 	int i;
 	void *p;
-	const struct git_hash_algo *algo = NULL;
-
-	if (ac == 2) {
-		for (i = 1; i < GIT_HASH_NALGOS; i++) {
-			if (!strcmp(av[1], hash_algos[i].name)) {
-				algo = &hash_algos[i];
-				break;
-			}
-		}
-	}
-	if (!algo)
-		die("usage: test-tool hash-speed algo_name");
 
 	/* Use this as an offset to make overflow less likely. */
 	initial = clock();
 
-	printf("algo: %s\n", algo->name);
+	if (backend)
+		printf("algo: %s (%s)\n", algo->name, backend);
+	else
+		printf("algo: %s\n", algo->name);
 
 	for (i = 0; i < ARRAY_SIZE(bufsizes); i++) {
 		unsigned long j, kb;
@@ -56,6 +47,76 @@ int cmd__hash_speed(int ac, const char **av)
 		printf("size %u: %lu iters; %lu KiB; %0.2f KiB/s\n", bufsizes[i], j, kb, kb_per_sec);
 		free(p);
 	}
+}
+
+static const char *usage_str =
+	"test-tool hash-speed [--backends] <algo_name> [<backend>...]";
+
+int cmd__hash_speed(int ac, const char **av)
+{
+	const struct git_hash_algo *algo = NULL;
+	const struct git_hash_backend *b;
+	int list_backends = 0;
+	int i;
+
+	if (ac > 1 && !strcmp(av[1], "--backends")) {
+		list_backends = 1;
+		ac--;
+		av++;
+	}
+	if (ac >= 2) {
+		for (i = 1; i < GIT_HASH_NALGOS; i++) {
+			if (!strcmp(av[1], hash_algos[i].name)) {
+				algo = &hash_algos[i];
+				break;
+			}
+		}
+	}
+	if (!algo)
+		usage(usage_str);
+	ac -= 2;
+	av += 2;
+
+	/* List the backends that can be used on this machine. */
+	if (list_backends) {
+		for (b = algo->backends; b && b->name; b++)
+			if (b->supported())
+				puts(b->name);
+		return 0;
+	}
+
+	if (!algo->backends) {
+		if (ac)
+			die("%s has no backends to choose from", algo->name);
+		hash_speed(algo, NULL);
+		return 0;
+	}
+
+	for (i = 0; i < ac; i++) {
+		for (b = algo->backends; b->name; b++)
+			if (!strcmp(av[i], b->name))
+				break;
+		if (!b->name)
+			die("unknown backend '%s' for %s", av[i], algo->name);
+	}
+
+	/* Benchmark the given backends, or all supported ones. */
+	for (b = algo->backends; b->name; b++) {
+		if (ac) {
+			for (i = 0; i < ac; i++)
+				if (!strcmp(av[i], b->name))
+					break;
+			if (i == ac)
+				continue;
+		}
+		if (!b->supported()) {
+			if (ac)
+				die("backend '%s' is not supported", b->name);
+			continue;
+		}
+		hash_algo_use_backend(algo, b);
+		hash_speed(algo, b->name);
+	}
 
 	return 0;
 }
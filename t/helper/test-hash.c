@@ -9,6 +9,7 @@ int cmd_hash_impl(int ac, const char **av, int algo)
 	int binary = 0;
 	char *buffer;
 	const struct git_hash_algo *algop = &hash_algos[algo];
+	const char *backend = getenv("GIT_TEST_HASH_BACKEND");
 
 	if (ac == 2) {
 		if (!strcmp(av[1], "-b"))
@@ -27,6 +28,19 @@ int cmd_hash_impl(int ac, const char **av, int algo)
 			die("OOPS");
 	}
 
+	if (backend) {
+		const struct git_hash_backend *b;
+
+		for (b = algop->backends; b && b->name; b++)
+			if (!strcmp(b->name, backend))
+				break;
+		if (!b || !b->name)
+			die("unknown backend '%s' for %s", backend, algop->name);
+		if (!b->supported())
+			die("backend '%s' is not supported", backend);
+		hash_algo_use_backend(algop, b);
+	}
+
 	algop->init_fn(&ctx);
 
 	while (1) {
@@ -0,0 +1,22 @@
+/*
+ * test-name-hash.c: Read a list of paths over stdin and report on their
+ * name-hash as computed by each version of the name-hash function.
+ */
+#include "test-tool.h"
+#include "git-compat-util.h"
+#include "pack-objects.h"
+#include "strbuf.h"
+
+int cmd__name_hash(int argc, const char **argv)
+{
+	struct strbuf line = STRBUF_INIT;
+
+	while (!strbuf_getline(&line, stdin)) {
+		printf("%10"PRIu32" ", pack_name_hash(line.buf));
+		printf("%10"PRIu32" ", pack_name_hash_v2(line.buf));
+		printf("%s\n", line.buf);
+	}
+
+	strbuf_release(&line);
+	return 0;
+}
@@ -141,6 +141,29 @@ int cmd__reach(int ac, const char **av)
 			filter.with_commit_tag_algo = 0;
 
 		printf("%s(_,A,X,_):%d\n", av[1], commit_contains(&filter, A, X, &cache));
+	} else if (!strcmp(av[1], "contains_many")) {
+		/*
+		 * Like "git branch --contains" (or, with --tag, "git tag
+		 * --contains") with the Y commits as the branches: a lot
+		 * of queries against the same X, which makes for a
+		 * benchmark of the reachability queries.
+		 */
+		struct ref_filter filter;
+		struct contains_cache cache;
+		struct commit_list *list = NULL;
+		int i;
+
+		init_contains_cache(&cache);
+		filter.with_commit_tag_algo = ac > 2 && !strcmp(av[2], "--tag");
+
+		for (i = 0; i < Y_nr; i++)
+			if (commit_contains(&filter, Y_array[i], X, &cache))
+				commit_list_insert(Y_array[i], &list);
+
+		printf("%s(_,Y,X,_):\n", av[1]);
+		print_sorted_commit_ids(list);
+		free_commit_list(list);
+		clear_contains_cache(&cache);
 	} else if (!strcmp(av[1], "get_reachable_subset")) {
 		const int reachable_flag = 1;
 		int i, count = 0;
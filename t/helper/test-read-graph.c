@@ -44,6 +44,20 @@ int cmd__read_graph(int argc, const char **argv)
 		printf(" bloom_indexes");
 	if (graph->chunk_bloom_data)
 		printf(" bloom_data");
+	if (graph->chunk_merge_bloom_indexes)
+		printf(" merge_bloom_indexes");
+	if (graph->chunk_merge_bloom_data)
+		printf(" merge_bloom_data");
+	if (graph->chunk_reachability_index)
+		printf(" reachability_index");
+	if (graph->chunk_first_parent_skips)
+		printf(" first_parent_skips");
+	if (graph->chunk_idents)
+		printf(" idents");
+	if (graph->chunk_ident_index)
+		printf(" ident_index");
+	if (graph->chunk_ident_data)
+		printf(" ident_data");
 	printf("\n");
 
 	printf("options:");
@@ -45,4 +45,17 @@ test_perf 'rev-list --objects $commit --not --all' '
 	git rev-list --objects $commit --not --all >/dev/null
 '
 
+test_expect_success 'write commit-graph with changed-path Bloom filters' '
+	git commit-graph write --reachable --changed-paths &&
+	git ls-tree -d --name-only HEAD | head -n 1 >dir
+'
+
+test_perf 'rev-list -- <dir>/<wildcard> (Bloom filters)' '
+	git rev-list HEAD -- "$(cat dir)/*.c" >/dev/null
+'
+
+test_perf 'rev-list -- <multiple paths> (Bloom filters)' '
+	git rev-list HEAD -- dummy "$(cat dir)" >/dev/null
+'
+
 test_done
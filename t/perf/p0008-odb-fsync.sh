@@ -57,6 +57,15 @@ test_perf_fsync_cfgs "add $total_files files" \
 	"setup_repo" \
 	"add -- files"
 
+for threads in 1 4 0
+do
+	test_perf "add $total_files files (fsyncMethod=batch, bulkCheckinThreads=$threads)" \
+		--setup "setup_repo" \
+		"GIT_TEST_FSYNC=1 git -c core.fsync=loose-object \
+			-c core.fsyncMethod=batch -c core.bulkCheckinThreads=$threads \
+			add -- files"
+done
+
 test_perf_fsync_cfgs "stash $total_files files" \
 	"setup_repo" \
 	"stash push -u -- files"
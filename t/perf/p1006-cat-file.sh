@@ -9,4 +9,43 @@ test_perf 'cat-file --batch-check' '
 	git cat-file --batch-all-objects --batch-check
 '
 
+test_expect_success 'setup list of blobs' '
+	git cat-file --batch-all-objects --unordered \
+		--batch-check="%(objecttype) %(objectname)" >objects &&
+	sed -n "s/^blob //p" objects >blobs
+'
+
+for threads in 1 4 8
+do
+	test_perf "cat-file --batch on many blobs (--threads=$threads)" "
+		git cat-file --batch --buffer --threads=$threads \
+			<blobs >/dev/null
+	"
+done
+
+test_expect_success 'setup repository with long delta chains' '
+	git init chains &&
+	(
+		cd chains &&
+		test_seq 100000 >file &&
+		for i in $(test_seq 200)
+		do
+			sed -e "s/^$((i * 400))\$/changed $i/" file >file.new &&
+			mv file.new file &&
+			git add file &&
+			git commit -q -m "commit $i" || return 1
+		done &&
+		git repack -adf --depth=50 --window=250
+	)
+'
+
+for threads in 1 4
+do
+	test_perf "cat-file --batch on long chains (deltaInflateThreads=$threads)" "
+		git -C chains -c core.deltaBaseCacheLimit=0 \
+			-c core.deltaInflateThreads=$threads \
+			cat-file --batch-all-objects --batch >/dev/null
+	"
+done
+
 test_done
@@ -47,4 +47,23 @@ test_perf 'index-pack default number of threads' \
 	GIT_DIR=repo.git git index-pack --stdin < $PACK
 '
 
+# Without deltas, all the work happens in the first pass, which reads
+# the pack serially but hashes the objects in threads.
+test_expect_success 'repack without deltas' '
+	git repack -adf --window=0 &&
+	PACK=$(ls .git/objects/pack/*.pack | head -n1) &&
+	test -f "$PACK" &&
+	export PACK
+'
+
+test_perf 'index-pack without deltas, 0 threads' \
+	--setup 'rm -rf repo.git && git init --bare repo.git' '
+	GIT_DIR=repo.git git index-pack --threads=1 --stdin <$PACK
+'
+
+test_perf 'index-pack without deltas, default number of threads' \
+	--setup 'rm -rf repo.git && git init --bare repo.git' '
+	GIT_DIR=repo.git git index-pack --stdin <$PACK
+'
+
 test_done
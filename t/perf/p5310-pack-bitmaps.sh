@@ -27,14 +27,22 @@ test_lookup_pack_bitmap () {
 		git tag --message="tag pointing to HEAD" perf-tag HEAD
 	'
 
-	test_perf "enable lookup table: $1" '
-		git config pack.writeBitmapLookupTable '"$1"'
+	test_perf "enable lookup table: $1, bitmap version: $2" '
+		git config pack.writeBitmapLookupTable '"$1"' &&
+		git config pack.bitmapVersion '"$2"'
 	'
 
 	test_pack_bitmap
+
+	test_size "bitmap size (lookup table: $1, bitmap version: $2)" '
+		git repack -adb &&
+		test_file_size $(ls .git/objects/pack/pack-*.bitmap)
+	'
 }
 
-test_lookup_pack_bitmap false
-test_lookup_pack_bitmap true
+test_lookup_pack_bitmap false 1
+test_lookup_pack_bitmap true 1
+test_lookup_pack_bitmap false 2
+test_lookup_pack_bitmap true 2
 
 test_done
@@ -0,0 +1,33 @@
+#!/bin/sh
+
+test_description='performance tests of pack-objects --path-walk'
+. ./perf-lib.sh
+
+test_perf_default_repo
+
+test_expect_success 'setup rev-list input' '
+	git rev-parse --all >revs
+'
+
+for opt in "" "--path-walk"
+do
+	test_perf "pack-objects --all $opt" "
+		git pack-objects --stdout --revs --no-reuse-delta \
+			--delta-base-offset $opt <revs >tmp.pack
+	"
+
+	test_size "size with $opt" '
+		wc -c <tmp.pack
+	'
+
+	test_perf "repack -adf $opt" "
+		git repack -adf $opt
+	"
+
+	test_size "repacked size with $opt" '
+		gitdir=$(git rev-parse --git-dir) &&
+		cat "$gitdir"/objects/pack/pack-*.pack | wc -c
+	'
+done
+
+test_done
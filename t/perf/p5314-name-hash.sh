@@ -0,0 +1,34 @@
+#!/bin/sh
+
+test_description='performance tests of the name-hash versions of pack-objects'
+. ./perf-lib.sh
+
+test_perf_default_repo
+
+for version in 1 2
+do
+	test_perf "repack -adf with name-hash version $version" "
+		git repack -adf --name-hash-version=$version
+	"
+
+	test_size "repack size with name-hash version $version" '
+		gitdir=$(git rev-parse --git-dir) &&
+		cat "$gitdir"/objects/pack/pack-*.pack | wc -c
+	'
+
+	test_expect_success "write bitmaps with name-hash version $version" "
+		git repack -adb --name-hash-version=$version
+	"
+
+	test_perf "pack-objects from bitmaps (version $version cache)" '
+		git rev-parse --all >revs &&
+		git -c pack.allowPackReuse=false pack-objects --stdout --revs \
+			--use-bitmap-index --no-reuse-delta <revs >tmp.pack
+	'
+
+	test_size "pack size from bitmaps (version $version cache)" '
+		wc -c <tmp.pack
+	'
+done
+
+test_done
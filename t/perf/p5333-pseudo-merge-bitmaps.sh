@@ -0,0 +1,45 @@
+#!/bin/sh
+
+test_description='Tests the performance of pseudo-merge bitmaps'
+. ./perf-lib.sh
+
+test_perf_large_repo
+
+# Give many commits a ref of their own, like the pull requests of a
+# fork network, so that most refs point to commits without a bitmap.
+test_expect_success 'create many refs' '
+	git rev-list --first-parent HEAD |
+	awk "NR % 10 == 1 { print \"create refs/perf/pull/\" NR \"/head \" \$1 }" |
+	head -n 5000 >in &&
+	git update-ref --stdin <in
+'
+
+test_expect_success 'repack without pseudo-merges' '
+	git repack -adb
+'
+
+test_perf 'count all objects (without pseudo-merges)' '
+	git rev-list --use-bitmap-index --count --objects --all
+'
+
+test_perf 'pack all objects (without pseudo-merges)' '
+	git pack-objects --stdout --revs --all --use-bitmap-index \
+		--delta-base-offset </dev/null >/dev/null
+'
+
+test_expect_success 'repack with pseudo-merges' '
+	git config bitmapPseudoMerge.all.pattern "refs/perf/pull/*" &&
+	git config bitmapPseudoMerge.all.threshold now &&
+	git repack -adb
+'
+
+test_perf 'count all objects (with pseudo-merges)' '
+	git rev-list --use-bitmap-index --count --objects --all
+'
+
+test_perf 'pack all objects (with pseudo-merges)' '
+	git pack-objects --stdout --revs --all --use-bitmap-index \
+		--delta-base-offset </dev/null >/dev/null
+'
+
+test_done
@@ -0,0 +1,53 @@
+#!/bin/sh
+
+test_description='Tests the performance of the commit-graph reachability index'
+. ./perf-lib.sh
+
+test_perf_large_repo
+
+# Give many commits along the history a ref of their own, and ask which
+# of them contain an old and a recent commit, once walking and once
+# with the reachability index.
+test_expect_success 'setup' '
+	git rev-list --first-parent HEAD >commits &&
+	awk "NR % 50 == 1 { print \"create refs/perf/branch/\" NR \" \" \$1 }" \
+		<commits >in &&
+	git update-ref --stdin <in &&
+	sed -n "\$p" commits >old &&
+	printf "X:%s\n" $(cat old) $(sed -n 100p commits) >input &&
+	git for-each-ref --format="Y:%(objectname)" refs/perf/branch >>input
+'
+
+test_expect_success 'write commit-graph without reachability index' '
+	git commit-graph write --reachable --no-reachability-index
+'
+
+test_perf 'test-tool reach contains_many (walk)' '
+	test-tool reach contains_many <input >/dev/null
+'
+
+test_perf 'test-tool reach contains_many --tag (walk)' '
+	test-tool reach contains_many --tag <input >/dev/null
+'
+
+test_perf 'for-each-ref --contains (walk)' '
+	git for-each-ref --contains $(cat old) refs/perf/branch >/dev/null
+'
+
+test_expect_success 'write commit-graph with reachability index' '
+	git commit-graph write --reachable --reachability-index
+'
+
+test_perf 'test-tool reach contains_many (index)' '
+	test-tool reach contains_many <input >/dev/null
+'
+
+test_perf 'test-tool reach contains_many --tag (index)' '
+	test-tool reach contains_many --tag <input >/dev/null
+'
+
+test_perf 'for-each-ref --contains (index)' '
+	git for-each-ref --contains $(cat old) refs/perf/branch >/dev/null
+'
+
+test_done
@@ -0,0 +1,48 @@
+#!/bin/sh
+
+test_description='Tests the performance of the commit-graph first-parent skips'
+. ./perf-lib.sh
+
+test_perf_large_repo
+
+test_expect_success 'setup' '
+	git rev-list --first-parent HEAD >commits &&
+	old=$(sed -n "\$p" commits) &&
+	mid=$(sed -n "$(($(wc -l <commits) / 2))p" commits) &&
+	echo $old >old &&
+	git log -1 --format=%ct $mid >date
+'
+
+test_expect_success 'write commit-graph without first-parent skips' '
+	git commit-graph write --reachable --no-first-parent-skips
+'
+
+test_perf 'rev-list --first-parent --count (walk)' '
+	git rev-list --first-parent --count HEAD >/dev/null
+'
+
+test_perf 'log --first-parent -1 --before (walk)' '
+	git log --first-parent -1 --before=$(cat date) HEAD >/dev/null
+'
+
+test_perf 'merge-base with the first commit (walk)' '
+	git merge-base HEAD $(cat old) >/dev/null
+'
+
+test_expect_success 'write commit-graph with first-parent skips' '
+	git commit-graph write --reachable --first-parent-skips
+'
+
+test_perf 'rev-list --first-parent --count (skips)' '
+	git rev-list --first-parent --count HEAD >/dev/null
+'
+
+test_perf 'log --first-parent -1 --before (skips)' '
+	git log --first-parent -1 --before=$(cat date) HEAD >/dev/null
+'
+
+test_perf 'merge-base with the first commit (skips)' '
+	git merge-base HEAD $(cat old) >/dev/null
+'
+
+test_done
@@ -0,0 +1,36 @@
+#!/bin/sh
+
+test_description='Tests the performance of the commit-graph idents'
+. ./perf-lib.sh
+
+test_perf_large_repo
+
+test_expect_success 'setup' '
+	git log -1 --format="%ae" HEAD >author
+'
+
+test_expect_success 'write commit-graph without idents' '
+	git commit-graph write --reachable --no-idents
+'
+
+test_perf 'log --author (commits)' '
+	git log --format=%H --author="$(cat author)" HEAD >/dev/null
+'
+
+test_perf 'log --author-date-order (commits)' '
+	git log --format=%H --author-date-order HEAD >/dev/null
+'
+
+test_expect_success 'write commit-graph with idents' '
+	git commit-graph write --reachable --idents
+'
+
+test_perf 'log --author (idents)' '
+	git log --format=%H --author="$(cat author)" HEAD >/dev/null
+'
+
+test_perf 'log --author-date-order (idents)' '
+	git log --format=%H --author-date-order HEAD >/dev/null
+'
+
+test_done
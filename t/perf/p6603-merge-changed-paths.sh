@@ -0,0 +1,40 @@
+#!/bin/sh
+
+test_description='Tests the performance of Bloom filters against all merge parents'
+. ./perf-lib.sh
+
+test_perf_large_repo
+
+# Pick a file that was last changed on a side branch, so that looking
+# for its history has to check merges against their second parents.
+test_expect_success 'setup' '
+	git rev-list --merges -1 HEAD >merge &&
+	git diff --name-only "$(cat merge)^1" "$(cat merge)" | head -n 1 >path &&
+	test -s path
+'
+
+test_expect_success 'write commit-graph without merge filters' '
+	git commit-graph write --reachable --changed-paths --no-merge-changed-paths
+'
+
+test_perf 'log --full-history -- <path> (first parent)' '
+	git log --format=%H --full-history -- "$(cat path)" >/dev/null
+'
+
+test_perf 'blame <path> (first parent)' '
+	git blame HEAD -- "$(cat path)" >/dev/null
+'
+
+test_expect_success 'write commit-graph with merge filters' '
+	git commit-graph write --reachable --changed-paths --merge-changed-paths
+'
+
+test_perf 'log --full-history -- <path> (all parents)' '
+	git log --format=%H --full-history -- "$(cat path)" >/dev/null
+'
+
+test_perf 'blame <path> (all parents)' '
+	git blame HEAD -- "$(cat path)" >/dev/null
+'
+
+test_done
@@ -51,6 +51,19 @@ then
 	(cd ../repos; ./many-files.sh -d $PARAM_D -w $PARAM_W -f $PARAM_F)
 fi
 
+# On Linux the daemon needs one inotify watch per directory in the
+# worktree.  Do not report bogus numbers if we cannot get them all.
+#
+if test -r /proc/sys/fs/inotify/max_user_watches
+then
+	nr_dirs=$(git -C $REPO ls-tree -r -d --name-only $BALLAST_BR | wc -l)
+	if test $nr_dirs -ge $(cat /proc/sys/fs/inotify/max_user_watches)
+	then
+		skip_all="fs.inotify.max_user_watches is too low for $nr_dirs directories"
+		test_done
+	fi
+fi
+
 
 enable_uc () {
 	git -C $REPO config core.untrackedcache true
@@ -214,6 +227,15 @@ do_matrix () {
 	fi
 }
 
+# Time how long it takes the daemon to start watching the worktree
+# (and to be ready to answer queries).  On Linux this includes the
+# recursive scan that registers an inotify watch for every directory.
+#
+test_perf "fsmonitor--daemon start/stop" "
+	git -C $REPO fsmonitor--daemon start &&
+	git -C $REPO fsmonitor--daemon stop
+"
+
 # Begin testing each case in the matrix that we care about.
 #
 uc_values="false"
@@ -18,4 +18,14 @@ test_expect_success 'test-sha1 detects shattered pdf' '
 	grep 38762cf7f55934b34d179ae6a4c80cadccbb7f0a err
 '
 
+test_expect_success 'all sha1 backends detect shattered pdf' '
+	test-tool hash-speed --backends sha1 >backends &&
+	for backend in $(cat backends)
+	do
+		test_must_fail env GIT_TEST_HASH_BACKEND=$backend \
+			test-tool sha1 <"$TEST_DATA/shattered-1.pdf" 2>err &&
+		grep 38762cf7f55934b34d179ae6a4c80cadccbb7f0a err || return 1
+	done
+'
+
 test_done
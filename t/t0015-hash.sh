@@ -53,4 +53,26 @@ test_expect_success 'test basic SHA-256 hash values' '
 	grep 6ef19b41225c5369f1c104d45d8d85efa9b057b53b14b4b9b939dd74decc5321 actual
 '
 
+test_expect_success 'all hash backends compute the same values' '
+	perl -e "print map { chr(\$_ % 251) } 1..100000" >data &&
+	for algo in sha1 sha256
+	do
+		test-tool hash-speed --backends $algo >backends &&
+		for len in 0 1 55 56 63 64 65 127 128 129 1000 100000
+		do
+			test_copy_bytes $len <data >in-$len &&
+			test-tool $algo <in-$len || return 1
+		done >expect &&
+		for backend in $(cat backends)
+		do
+			for len in 0 1 55 56 63 64 65 127 128 129 1000 100000
+			do
+				GIT_TEST_HASH_BACKEND=$backend \
+					test-tool $algo <in-$len || return 1
+			done >actual &&
+			test_cmp expect actual || return 1
+		done || return 1
+	done
+'
+
 test_done
@@ -0,0 +1,310 @@
+#!/bin/sh
+
+test_description='reftable reference backend basics'
+GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME=main
+export GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME
+
+GIT_TEST_DEFAULT_REF_FORMAT=reftable
+export GIT_TEST_DEFAULT_REF_FORMAT
+
+. ./test-lib.sh
+
+INVALID_OID=$(test_oid 001)
+
+test_expect_success 'init: creates basic reftable structures' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_path_is_dir repo/.git/reftable &&
+	test_path_is_file repo/.git/reftable/tables.list &&
+	echo reftable >expect &&
+	git -C repo config extensions.refstorage >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'init: keeps HEAD and refs/ for older Git versions' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_path_is_dir repo/.git/refs &&
+	test_path_is_file repo/.git/refs/heads &&
+	echo "ref: refs/heads/.invalid" >expect &&
+	test_cmp expect repo/.git/HEAD &&
+	echo refs/heads/main >expect &&
+	git -C repo symbolic-ref HEAD >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'init: rejects unknown ref format' '
+	test_must_fail git init --ref-format=garbage repo 2>err &&
+	test_i18ngrep "unknown ref storage format" err
+'
+
+test_expect_success 'init: --ref-format overrides GIT_DEFAULT_REF_FORMAT' '
+	test_when_finished "rm -rf repo" &&
+	GIT_DEFAULT_REF_FORMAT=reftable git init --ref-format=files repo &&
+	test_path_is_missing repo/.git/reftable &&
+	test_path_is_dir repo/.git/refs/heads &&
+	test_must_fail git -C repo config extensions.refstorage
+'
+
+test_expect_success 'init: reinit does not change the format' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	test_must_fail git init --ref-format=files repo &&
+	git init repo &&
+	git -C repo rev-parse --verify A
+'
+
+test_expect_success 'update-ref: basic writes and reads' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	test_commit -C repo B &&
+	A=$(git -C repo rev-parse A) &&
+	B=$(git -C repo rev-parse B) &&
+	git -C repo update-ref refs/heads/topic $A &&
+	echo $A >expect &&
+	git -C repo rev-parse refs/heads/topic >actual &&
+	test_cmp expect actual &&
+	git -C repo update-ref refs/heads/topic $B $A &&
+	echo $B >expect &&
+	git -C repo rev-parse refs/heads/topic >actual &&
+	test_cmp expect actual &&
+	test_must_fail git -C repo update-ref refs/heads/topic $A $A 2>err &&
+	test_i18ngrep "is at $B but expected $A" err &&
+	git -C repo update-ref -d refs/heads/topic $B &&
+	test_must_fail git -C repo rev-parse --verify refs/heads/topic
+'
+
+test_expect_success 'update-ref: refuses nonexistent objects' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	test_must_fail git -C repo update-ref refs/heads/broken $INVALID_OID 2>err &&
+	test_i18ngrep "nonexistent object" err
+'
+
+test_expect_success 'update-ref: refuses D/F conflicts' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	git -C repo update-ref refs/heads/dir A &&
+	test_must_fail git -C repo update-ref refs/heads/dir/file A 2>err &&
+	test_i18ngrep "${SQ}refs/heads/dir${SQ} exists" err &&
+	test_must_fail git -C repo update-ref refs/heads/main/file A &&
+	git -C repo update-ref refs/heads/other/file A &&
+	test_must_fail git -C repo update-ref refs/heads/other A
+'
+
+test_expect_success 'update-ref: transactions are atomic' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	test_commit -C repo B &&
+	cat >stdin <<-EOF &&
+	create refs/heads/new $(git -C repo rev-parse A)
+	update refs/heads/main $(git -C repo rev-parse A) $(git -C repo rev-parse A)
+	EOF
+	test_must_fail git -C repo update-ref --stdin <stdin &&
+	test_must_fail git -C repo rev-parse --verify refs/heads/new &&
+	git -C repo rev-parse B >expect &&
+	git -C repo rev-parse main >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'update-ref: fails when the stack is locked' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	>repo/.git/reftable/tables.list.lock &&
+	test_must_fail git -C repo update-ref refs/heads/new A 2>err &&
+	test_i18ngrep "cannot lock ref ${SQ}refs/heads/new${SQ}" err &&
+	test_path_is_file repo/.git/reftable/tables.list.lock &&
+	rm repo/.git/reftable/tables.list.lock &&
+	git -C repo update-ref refs/heads/new A
+'
+
+test_expect_success 'symbolic-ref: basic writes and reads' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	git -C repo symbolic-ref refs/heads/sym refs/heads/main &&
+	echo refs/heads/main >expect &&
+	git -C repo symbolic-ref refs/heads/sym >actual &&
+	test_cmp expect actual &&
+	git -C repo rev-parse main >expect &&
+	git -C repo rev-parse sym >actual &&
+	test_cmp expect actual &&
+	git -C repo update-ref --no-deref -d refs/heads/sym &&
+	test_must_fail git -C repo symbolic-ref refs/heads/sym &&
+	git -C repo rev-parse --verify main
+'
+
+test_expect_success 'reflog: records updates of branch and HEAD' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	test_commit -C repo B &&
+	cat >expect <<-EOF &&
+	$(git -C repo rev-parse B) commit: B
+	$(git -C repo rev-parse A) commit (initial): A
+	EOF
+	git -C repo log -g --format="%H %gs" main >actual &&
+	test_cmp expect actual &&
+	git -C repo log -g --format="%H %gs" HEAD >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'reflog: deleting a ref deletes its reflog' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	git -C repo branch topic &&
+	git -C repo reflog exists refs/heads/topic &&
+	git -C repo branch -D topic &&
+	test_must_fail git -C repo reflog exists refs/heads/topic &&
+	git -C repo branch topic &&
+	git -C repo log -g --format=%gs topic >actual &&
+	test_line_count = 1 actual
+'
+
+test_expect_success 'reflog: expiring all entries keeps the reflog' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	test_commit -C repo B &&
+	git -C repo reflog expire --expire=all refs/heads/main &&
+	git -C repo reflog exists refs/heads/main &&
+	git -C repo reflog show refs/heads/main >actual &&
+	test_must_be_empty actual &&
+	test_commit -C repo C &&
+	git -C repo log -g --format=%gs main >actual &&
+	echo "commit: C" >expect &&
+	test_cmp expect actual
+'
+
+test_expect_success 'reflog: bare repositories only log on request' '
+	test_when_finished "rm -rf repo" &&
+	git init --bare repo &&
+	tree=$(git -C repo mktree </dev/null) &&
+	commit=$(git -C repo commit-tree -m A $tree) &&
+	git -C repo update-ref refs/heads/main $commit &&
+	test_must_fail git -C repo reflog exists refs/heads/main &&
+	git -C repo update-ref --create-reflog refs/heads/topic $commit &&
+	git -C repo reflog exists refs/heads/topic
+'
+
+test_expect_success 'branch: rename moves the reflog' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	git -C repo branch topic &&
+	git -C repo branch -m topic renamed &&
+	test_must_fail git -C repo rev-parse --verify topic &&
+	test_must_fail git -C repo reflog exists refs/heads/topic &&
+	cat >expect <<-EOF &&
+	Branch: renamed refs/heads/topic to refs/heads/renamed
+	branch: Created from main
+	EOF
+	git -C repo log -g --format=%gs renamed >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'branch: copy keeps the original reflog' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	git -C repo branch topic &&
+	git -C repo branch -c topic copied &&
+	git -C repo log -g --format=%gs topic >expect &&
+	git -C repo log -g --format=%gs copied >actual &&
+	test_line_count = 1 expect &&
+	test_line_count = 2 actual
+'
+
+test_expect_success 'pack-refs: compacts tables' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	git -C repo config reftable.autoCompaction false &&
+	test_commit -C repo A &&
+	for i in 1 2 3 4 5
+	do
+		git -C repo branch branch-$i || return 1
+	done &&
+	test_line_count -gt 5 repo/.git/reftable/tables.list &&
+	git -C repo pack-refs &&
+	test_line_count = 1 repo/.git/reftable/tables.list &&
+	git -C repo for-each-ref --format="%(refname)" refs/heads/ >actual &&
+	test_line_count = 6 actual
+'
+
+test_expect_success 'auto-compaction keeps the number of tables small' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_commit -C repo A &&
+	for i in $(test_seq 20)
+	do
+		git -C repo branch branch-$i || return 1
+	done &&
+	test_line_count -lt 10 repo/.git/reftable/tables.list
+'
+
+test_expect_success 'worktree: per-worktree refs are separate' '
+	test_when_finished "rm -rf repo wt" &&
+	git init repo &&
+	test_commit -C repo A &&
+	test_commit -C repo B &&
+	git -C repo worktree add ../wt &&
+	git -C wt update-ref refs/bisect/good A &&
+	git -C repo update-ref refs/bisect/good B &&
+	git -C repo rev-parse B >expect &&
+	git -C repo rev-parse refs/bisect/good >actual &&
+	test_cmp expect actual &&
+	git -C repo rev-parse A >expect &&
+	git -C wt rev-parse refs/bisect/good >actual &&
+	test_cmp expect actual &&
+	git -C repo rev-parse worktrees/wt/refs/bisect/good >actual &&
+	test_cmp expect actual &&
+	test_path_is_dir repo/.git/worktrees/wt/reftable &&
+	echo refs/heads/wt >expect &&
+	git -C wt symbolic-ref HEAD >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'worktree: shared refs are visible everywhere' '
+	test_when_finished "rm -rf repo wt" &&
+	git init repo &&
+	test_commit -C repo A &&
+	git -C repo worktree add ../wt &&
+	git -C wt branch from-worktree &&
+	git -C repo rev-parse --verify from-worktree &&
+	git -C repo for-each-ref --format="%(refname)" >actual &&
+	grep refs/heads/from-worktree actual
+'
+
+test_expect_success 'clone: --ref-format selects the format' '
+	test_when_finished "rm -rf source clone" &&
+	git init --ref-format=files source &&
+	test_commit -C source A &&
+	git clone --ref-format=reftable source clone &&
+	test_path_is_dir clone/.git/reftable &&
+	echo reftable >expect &&
+	git -C clone config extensions.refstorage >actual &&
+	test_cmp expect actual &&
+	git -C source rev-parse A >expect &&
+	git -C clone rev-parse origin/main >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'clone: uses the object format of the remote' '
+	test_when_finished "rm -rf source clone" &&
+	git init --object-format=sha256 source &&
+	test_commit -C source A &&
+	GIT_DEFAULT_HASH=sha1 git clone source clone &&
+	git -C clone fsck &&
+	git -C source rev-parse A >expect &&
+	git -C clone rev-parse main >actual &&
+	test_cmp expect actual
+'
+
+test_done
@@ -1135,4 +1135,77 @@ test_expect_success 'batch-command flush without --buffer' '
 	grep "^fatal:.*flush is only for --buffer mode.*" err
 '
 
+test_expect_success 'setup objects for --threads' '
+	git init threads &&
+	(
+		cd threads &&
+		for i in $(test_seq 50)
+		do
+			echo "content $i" >file-$i &&
+			git add file-$i &&
+			test_tick &&
+			git commit -q -m "commit $i" || return 1
+		done &&
+		test-tool genrandom big 100000 >big &&
+		git add big &&
+		git commit -q -m big &&
+		git repack -ad &&
+		echo loose >loose &&
+		git add loose &&
+		git commit -q -m loose &&
+		git rev-list --objects --all >list &&
+		{
+			cut -d" " -f1 list &&
+			echo HEAD:big &&
+			echo HEAD:does-not-exist &&
+			echo $ZERO_OID &&
+			echo 0000
+		} >input
+	)
+'
+
+for opts in --batch --batch-check "--batch=%(objectname) %(rest)"
+do
+	test_expect_success "--threads matches single-threaded output ($opts)" '
+		git -C threads cat-file "$opts" <threads/input >expect &&
+		git -C threads cat-file "$opts" --threads=4 \
+			<threads/input >actual &&
+		test_cmp expect actual &&
+		git -C threads -c core.bigFileThreshold=1k \
+			cat-file "$opts" --threads=4 --buffer \
+			<threads/input >actual &&
+		test_cmp expect actual
+	'
+done
+
+test_expect_success '--threads with --batch-all-objects' '
+	git -C threads cat-file --batch --batch-all-objects >expect &&
+	git -C threads cat-file --batch --batch-all-objects \
+		--threads=4 >actual &&
+	test_cmp expect actual &&
+	git -C threads cat-file --batch --batch-all-objects --unordered \
+		>expect &&
+	git -C threads cat-file --batch --batch-all-objects --unordered \
+		--threads=0 >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success '--threads with --batch-command' '
+	awk "{ print (NR % 3 == 1 ? \"info \" : \"contents \") \$0 }
+	     NR % 10 == 0 { print \"flush\" }" threads/input >cmd &&
+	git -C threads cat-file --batch-command --buffer <cmd >expect &&
+	git -C threads cat-file --batch-command --buffer --threads=4 \
+		<cmd >actual &&
+	test_cmp expect actual &&
+	grep -v flush cmd >cmd.noflush &&
+	git -C threads cat-file --batch-command --threads=4 \
+		<cmd.noflush >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success '--threads requires a batch mode' '
+	test_must_fail git cat-file --threads=2 -p HEAD 2>err &&
+	grep "requires a batch mode" err
+'
+
 test_done
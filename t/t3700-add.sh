@@ -62,6 +62,132 @@ test_expect_success 'git update-index: core.fsyncmethod=batch' "
 	test_cmp added_files2_oids added_files2_actual
 "
 
+THREADS_CONFIGURATION='-c core.bulkCheckinThreads=4'
+
+test_expect_success 'git add: core.bulkCheckinThreads' "
+	test_create_unique_files 4 8 files_base_dir3 &&
+	cp files_base_dir3/dir1/file1.txt files_base_dir3/dir1/duplicate.txt &&
+	git $THREADS_CONFIGURATION add -- ./files_base_dir3/ &&
+	git ls-files --stage files_base_dir3/ |
+	test_parse_ls_files_stage_oids >added_files3_oids &&
+	test_line_count = 33 added_files3_oids &&
+	git cat-file --batch-check='%(objectname)' <added_files3_oids >added_files3_actual &&
+	test_cmp added_files3_oids added_files3_actual &&
+	git fsck --no-dangling
+"
+
+test_expect_success 'git update-index: core.bulkCheckinThreads with batch fsync' "
+	test_create_unique_files 4 8 files_base_dir4 &&
+	find files_base_dir4 ! -type d -print |
+	GIT_TEST_FSYNC=1 xargs git $THREADS_CONFIGURATION $BATCH_CONFIGURATION \
+		update-index --add -- &&
+	git ls-files --stage files_base_dir4 |
+	test_parse_ls_files_stage_oids >added_files4_oids &&
+	test_line_count = 32 added_files4_oids &&
+	git cat-file --batch-check='%(objectname)' <added_files4_oids >added_files4_actual &&
+	test_cmp added_files4_oids added_files4_actual &&
+	test_path_is_missing .git/objects/tmp_objdir-bulk-fsync-* &&
+	git fsck --no-dangling
+"
+
+test_expect_success 'git commit -a: core.bulkCheckinThreads' "
+	test_create_unique_files 2 4 files_base_dir5 &&
+	git add files_base_dir5 &&
+	git commit -q -m base &&
+	for f in files_base_dir5/*/*
+	do
+		echo changed >>\$f || return 1
+	done &&
+	git $THREADS_CONFIGURATION commit -q -a -m changed &&
+	git diff --exit-code HEAD &&
+	git fsck --no-dangling
+"
+
+test_expect_success 'git add: core.bulkCheckinPack' '
+	test_when_finished "rm -rf bulk-pack" &&
+	git init bulk-pack &&
+	(
+		cd bulk-pack &&
+		test_create_unique_files 4 8 files &&
+		cp files/dir1/file1.txt files/dir1/duplicate.txt &&
+		ln -s files/dir1/file1.txt link &&
+		git -c core.bulkCheckinPack=true add files link &&
+		git ls-files --stage |
+		test_parse_ls_files_stage_oids >oids &&
+		test_line_count = 34 oids &&
+
+		ls .git/objects/pack/pack-*.pack >packs &&
+		test_line_count = 1 packs &&
+		git show-index <$(ls .git/objects/pack/pack-*.idx) >index &&
+		test_line_count = 33 index &&
+		find .git/objects -type f \
+			-path ".git/objects/[0-9a-f][0-9a-f]/*" >loose &&
+		test_must_be_empty loose &&
+
+		git cat-file --batch-check="%(objectname)" <oids >actual &&
+		test_cmp oids actual &&
+		git fsck --no-dangling
+	)
+'
+
+test_expect_success 'git commit -a: core.bulkCheckinPack' '
+	test_when_finished "rm -rf bulk-pack" &&
+	git init bulk-pack &&
+	(
+		cd bulk-pack &&
+		test_create_unique_files 2 4 files &&
+		git add files &&
+		git commit -q -m base &&
+		for f in files/*/*
+		do
+			echo changed >>$f || return 1
+		done &&
+		GIT_TEST_FSYNC=1 git -c core.bulkCheckinPack=true \
+			$BATCH_CONFIGURATION commit -q -a -m changed &&
+		git diff --exit-code HEAD &&
+		git ls-tree -r HEAD files >tree &&
+		for oid in $(awk "{print \$3}" tree)
+		do
+			test_path_is_missing .git/objects/$(test_oid_to_path $oid) ||
+			return 1
+		done &&
+		git fsck --no-dangling
+	)
+'
+
+test_expect_success 'core.bulkCheckinPack: read back objects before the pack is done' '
+	test_when_finished "rm -rf bulk-pack bulk-src" &&
+	git init bulk-src &&
+	(
+		cd bulk-src &&
+		test_seq 1000 >file &&
+		git add file &&
+		git commit -q -m base &&
+		for i in 1 2 3 4
+		do
+			echo $i >>file &&
+			git commit -q -a -m $i || return 1
+		done &&
+		git pack-objects --revs --stdout --no-reuse-delta \
+			--depth=1 <<-\EOF >../deltas.pack
+		HEAD
+		EOF
+	) &&
+	git init bulk-pack &&
+	(
+		cd bulk-pack &&
+		# Resolving the deltas reads their bases, which are in the
+		# pack that is still being written.
+		git -c core.bulkCheckinPack=true unpack-objects <../deltas.pack &&
+		ls .git/objects/pack/pack-*.pack >packs &&
+		test_line_count = 1 packs &&
+		git -C ../bulk-src rev-list --objects HEAD | cut -d" " -f1 >expect &&
+		git cat-file --batch-check="%(objectname)" <expect >actual &&
+		test_cmp expect actual &&
+		git fsck --no-dangling
+	)
+'
+
 test_expect_success \
 	'git add: Test that executable bit is not used if core.filemode=0' \
 	'git config core.filemode 0 &&
@@ -121,8 +121,9 @@ test_expect_success 'git log with --walk-reflogs does not use Bloom filters' '
 	test_bloom_filters_not_used "--walk-reflogs -- A"
 '
 
-test_expect_success 'git log -- multiple path specs does not use Bloom filters' '
-	test_bloom_filters_not_used "-- file4 A/file1"
+test_expect_success 'git log -- multiple path specs uses Bloom filters' '
+	test_bloom_filters_used "-- file4 A/file1" &&
+	test_bloom_filters_used "-- A/B/C file_to_be_deleted"
 '
 
 test_expect_success 'git log -- "." pathspec at root does not use Bloom filters' '
@@ -134,9 +135,31 @@ test_expect_success 'git log with wildcard that resolves to a single path uses B
 	test_bloom_filters_used "-- *renamed"
 '
 
-test_expect_success 'git log with wildcard that resolves to a multiple paths does not uses Bloom filters' '
-	test_bloom_filters_not_used "-- *" &&
-	test_bloom_filters_not_used "-- file*"
+test_expect_success 'git log with wildcard that resolves to a multiple paths uses Bloom filters' '
+	test_bloom_filters_used "-- *" &&
+	test_bloom_filters_used "-- file*"
+'
+
+test_expect_success 'git log with wildcards after a directory uses Bloom filters' '
+	test_bloom_filters_used "-- :(glob)A/B/*" &&
+	test_bloom_filters_used "-- :(glob)A/**/file3" &&
+	test_bloom_filters_used "-- :(glob)A/B/fi?e2" &&
+	test_bloom_filters_used "-- :(glob)A/*/C :(glob)A/fi?e1"
+'
+
+test_expect_success 'git log with excluded path specs uses Bloom filters' '
+	test_bloom_filters_used "-- A :(exclude)A/B" &&
+	test_bloom_filters_used "-- A/B :!A/B/C/file3"
+'
+
+test_expect_success 'git log with a wildcard in the first directory does not use Bloom filters' '
+	test_bloom_filters_not_used "-- :(glob)*/file1" &&
+	test_bloom_filters_not_used "-- A/file1 :(glob)fi*" &&
+	test_bloom_filters_not_used "-- :!A/file1"
+'
+
+test_expect_success 'git log with case-insensitive path specs does not use Bloom filters' '
+	test_bloom_filters_not_used "-- :(icase)a/file1"
 '
 
 test_expect_success 'setup - add commit-graph to the chain without Bloom filters' '
@@ -404,4 +427,94 @@ test_expect_success 'Bloom generation backfills empty commits' '
 	)
 '
 
+test_expect_success 'setup - merges with changed-path Bloom filters against all parents' '
+	git init merges &&
+	(
+		cd merges &&
+		mkdir topic trunk octo &&
+		test_commit base &&
+		git checkout -b side &&
+		test_commit side-1 topic/file1 &&
+		test_commit side-2 topic/file2 &&
+		git checkout main &&
+		test_commit main-1 trunk/file &&
+		test_merge m1 side &&
+		git checkout side &&
+		test_commit side-3 topic/file1 &&
+		git checkout main &&
+		test_commit main-2 trunk/file &&
+		test_merge m2 side &&
+		git checkout -b b1 &&
+		test_commit o1 octo/file1 &&
+		git checkout -b b2 main &&
+		mkdir octo &&
+		test_commit o2 octo/file2 &&
+		git checkout main &&
+		test_commit main-3 trunk/file &&
+		test_merge oct b1 b2 &&
+
+		rm -f trace.event &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git commit-graph write --reachable --changed-paths \
+				--merge-changed-paths &&
+		grep "\"key\":\"merge-filter-computed\",\"value\":\"4\"" trace.event &&
+		test-tool read-graph >graph &&
+		grep "merge_bloom_indexes merge_bloom_data" graph
+	)
+'
+
+bloom_definitely_not () {
+	sed -n "s/.*\"definitely_not\":\([0-9]*\).*/\1/p" "$1"
+}
+
+test_expect_success 'git log --full-history uses Bloom filters against all parents' '
+	(
+		cd merges &&
+		for args in "--full-history -- topic/file1" \
+			    "--full-history -- trunk" \
+			    "--full-history -- octo/file2" \
+			    "--full-history --simplify-merges -- topic" \
+			    "--sparse -- octo" \
+			    "-- topic/file2"
+		do
+			git -c core.commitGraph=false log --format=%s $args >expect &&
+			rm -f trace.perf &&
+			GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+				git log --format=%s $args >actual &&
+			test_cmp expect actual || return 1
+		done &&
+
+		# The merges are no longer diffed against their other parents.
+		git commit-graph write --reachable --no-merge-changed-paths &&
+		rm -f trace.perf &&
+		GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+			git log --full-history -- topic/file2 >expect &&
+		without=$(bloom_definitely_not trace.perf) &&
+		git commit-graph write --reachable --merge-changed-paths &&
+		rm -f trace.perf &&
+		GIT_TRACE2_PERF="$(pwd)/trace.perf" \
+			git log --full-history -- topic/file2 >actual &&
+		test_cmp expect actual &&
+		test $(bloom_definitely_not trace.perf) -gt $without
+	)
+'
+
+test_expect_success 'Bloom filters against all parents are kept until asked to drop them' '
+	(
+		cd merges &&
+		test_commit after trunk/file &&
+		rm -f trace.event &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git commit-graph write --reachable &&
+		grep "\"key\":\"merge-filter-computed\",\"value\":\"0\"" trace.event &&
+		test-tool read-graph >graph &&
+		grep "merge_bloom_indexes merge_bloom_data" graph &&
+
+		git commit-graph write --reachable --no-merge-changed-paths &&
+		test-tool read-graph >graph &&
+		grep bloom_data graph &&
+		! grep merge_bloom graph
+	)
+'
+
 test_done
@@ -218,6 +218,21 @@ test_expect_success 'compare delta flavors' '
 	'\'' test-2-$packname_2.pack test-3-$packname_3.pack
 '
 
+test_expect_success 'deflating in threads writes the same pack' '
+	packname_t1=$(git pack-objects --window=0 --threads=1 test-t1 <obj-list) &&
+	packname_t4=$(git pack-objects --window=0 --threads=4 test-t4 <obj-list) &&
+	cmp test-t1-$packname_t1.pack test-t4-$packname_t4.pack
+'
+
+test_expect_success 'deflate deltas in threads' '
+	packname_t5=$(git -c pack.deltaCacheSize=1 pack-objects --threads=4 \
+		--delta-base-offset test-t5 <obj-list) &&
+	git pack-objects --threads=4 --stdout <obj-list >test-t6.pack &&
+	git index-pack test-t6.pack &&
+	check_unpack test-t5-$packname_t5 obj-list &&
+	check_unpack test-t6 obj-list
+'
+
 check_use_objects () {
 	test_when_finished "rm -rf git2" &&
 	git init --bare git2 &&
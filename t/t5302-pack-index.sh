@@ -66,6 +66,16 @@ test_expect_success 'index-pack results should match pack-objects ones' '
 	cmp "test-2-${pack2}.idx" "2.idx"
 '
 
+test_expect_success 'index-pack with threads hashing the first pass' '
+	GIT_FORCE_THREADS=1 git index-pack --threads=1 --index-version=2 \
+		-o threads-1.idx "test-1-${pack1}.pack" &&
+	cmp "test-2-${pack2}.idx" threads-1.idx &&
+	GIT_FORCE_THREADS=1 git -c core.deltaBaseCacheLimit=1 index-pack \
+		--threads=4 --strict --index-version=2 \
+		-o threads-4.idx "test-1-${pack1}.pack" &&
+	cmp "test-2-${pack2}.idx" threads-4.idx
+'
+
 test_expect_success 'index-pack --verify on index version 1' '
 	git index-pack --verify "test-1-${pack1}.pack"
 '
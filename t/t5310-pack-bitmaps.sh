@@ -28,17 +28,21 @@ has_any () {
 
 test_bitmap_cases () {
 	writeLookupTable=false
+	bitmapVersion=1
+	bitmapFormat=ewah
 	for i in "$@"
 	do
 		case "$i" in
 		"pack.writeBitmapLookupTable") writeLookupTable=true;;
+		"pack.bitmapVersion=2") bitmapVersion=2 bitmapFormat=roaring;;
 		esac
 	done
 
 	test_expect_success 'setup test repository' '
 		rm -fr * .git &&
 		git init &&
-		git config pack.writeBitmapLookupTable '"$writeLookupTable"'
+		git config pack.writeBitmapLookupTable '"$writeLookupTable"' &&
+		git config pack.bitmapVersion '"$bitmapVersion"'
 	'
 	setup_bitmap_history
 
@@ -267,7 +271,7 @@ test_bitmap_cases () {
 		mv -f $bitmap.tmp $bitmap &&
 		git rev-list --use-bitmap-index --count --all >actual 2>stderr &&
 		test_cmp expect actual &&
-		test_i18ngrep corrupt.ewah.bitmap stderr
+		test_i18ngrep corrupt.'"$bitmapFormat"'.bitmap stderr
 	'
 
 	test_expect_success 'truncated bitmap fails gracefully (cache)' '
@@ -371,6 +375,7 @@ test_bitmap_cases () {
 		(
 			cd repo &&
 			git config pack.writeBitmapLookupTable '"$writeLookupTable"' &&
+			git config pack.bitmapVersion '"$bitmapVersion"' &&
 
 			# create enough commits that not all are receive bitmap
 			# coverage even if they are all at the tip of some reference.
@@ -411,6 +416,7 @@ test_bitmap_cases () {
 		(
 			cd repo &&
 			git config pack.writeBitmapLookupTable '"$writeLookupTable"' &&
+			git config pack.bitmapVersion '"$bitmapVersion"' &&
 
 			test_commit base &&
 
@@ -468,4 +474,103 @@ test_expect_success 'truncated bitmap fails gracefully (lookup table)' '
 	test_i18ngrep corrupted.bitmap.index stderr
 '
 
+test_bitmap_cases "pack.bitmapVersion=2"
+
+test_bitmap_cases "pack.writeBitmapLookupTable" "pack.bitmapVersion=2"
+
+test_expect_success 'pack.bitmapVersion=2 writes roaring bitmaps' '
+	test_config pack.bitmapVersion 2 &&
+	git repack -adb &&
+	git rev-list --test-bitmap HEAD 2>err &&
+	grep "Bitmap v2 test" err &&
+
+	test_config pack.bitmapVersion 3 &&
+	test_must_fail git repack -adb 2>err &&
+	test_i18ngrep "bad pack.bitmapVersion=3" err
+'
+
+# expect_name_hashes <version>: compare the bitmap name-hash cache to
+# the hashes of the paths "rev-list --objects" gives for each object.
+expect_name_hashes () {
+	git rev-list --objects --all >objects &&
+	cut -d" " -f1 objects >oids &&
+	sed -e "s/^[0-9a-f]* *//" objects |
+	test-tool name-hash >name-hashes &&
+	awk "{ print \$$1 }" name-hashes >hashes &&
+	paste -d" " oids hashes | sort >expect &&
+	test-tool bitmap dump-hashes | sort >actual &&
+	comm -23 expect actual >missing &&
+	test_must_be_empty missing
+}
+
+test_expect_success 'pack.nameHashVersion selects the bitmap name-hash cache' '
+	git repack -adb &&
+	expect_name_hashes 1 &&
+
+	echo 1 >expect &&
+	test-tool bitmap name-hash-version >actual &&
+	test_cmp expect actual &&
+
+	git -c pack.nameHashVersion=2 repack -adb &&
+	expect_name_hashes 2 &&
+	echo 2 >expect &&
+	test-tool bitmap name-hash-version >actual &&
+	test_cmp expect actual &&
+
+	git rev-list --count --all >expect &&
+	git rev-list --use-bitmap-index --count --all >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'version 2 name-hash cache with a lookup table' '
+	test_config pack.nameHashVersion 2 &&
+	test_config pack.writeBitmapLookupTable true &&
+	git repack -adb &&
+	expect_name_hashes 2 &&
+
+	git rev-list --count --all >expect &&
+	git rev-list --use-bitmap-index --count --all >actual &&
+	test_cmp expect actual &&
+
+	git rev-parse --all >revs &&
+	git pack-objects --stdout --revs --no-use-bitmap-index <revs >walk.pack &&
+	git pack-objects --stdout --revs --use-bitmap-index <revs >bitmap.pack &&
+	git index-pack -o walk.idx walk.pack &&
+	git index-pack -o bitmap.idx bitmap.pack &&
+	list_packed_objects walk.idx | sort >expect &&
+	list_packed_objects bitmap.idx | sort >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'invalid --name-hash-version' '
+	test_must_fail git pack-objects --stdout --name-hash-version=3 \
+		</dev/null 2>err &&
+	test_i18ngrep "invalid --name-hash-version option: 3" err
+'
+
+test_expect_success 'bitmap backends agree' '
+	git repack -adb &&
+	git rev-list --objects --all >expect.raw &&
+	cut -d" " -f1 <expect.raw | sort >expect &&
+	git rev-list --use-bitmap-index --count HEAD~10..HEAD >expect.count &&
+	test-tool bitmap backends >backends &&
+	grep portable backends &&
+	for backend in $(cat backends)
+	do
+		GIT_TEST_EWAH_BACKEND=$backend \
+			git rev-list --use-bitmap-index --objects --all >actual.raw &&
+		cut -d" " -f1 <actual.raw | sort >actual &&
+		test_cmp expect actual &&
+		GIT_TEST_EWAH_BACKEND=$backend \
+			git rev-list --use-bitmap-index --count HEAD~10..HEAD >actual &&
+		test_cmp expect.count actual || return 1
+	done
+'
+
+test_expect_success 'unknown bitmap backend' '
+	test_must_fail env GIT_TEST_EWAH_BACKEND=nope \
+		git rev-list --use-bitmap-index --count HEAD 2>err &&
+	grep "unknown bitmap backend .nope." err
+'
+
 test_done
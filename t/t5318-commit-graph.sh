@@ -839,4 +839,201 @@ test_expect_success 'overflow during generation version upgrade' '
 	)
 '
 
+test_expect_success 'reachability index is kept until asked to drop it' '
+	git init reachability-index &&
+	(
+		cd reachability-index &&
+		test_commit base &&
+		git checkout -b side &&
+		test_commit side &&
+		git checkout - &&
+		test_commit main &&
+		test_merge merge side &&
+
+		git commit-graph write --reachable --reachability-index &&
+		graph_read_expect 4 "generation_data reachability_index" &&
+		git commit-graph verify &&
+
+		test_commit next &&
+		git commit-graph write --reachable &&
+		graph_read_expect 5 "generation_data reachability_index" &&
+
+		git commit-graph write --reachable --no-reachability-index &&
+		graph_read_expect 5 generation_data
+	)
+'
+
+test_expect_success 'verify notices a broken reachability index' '
+	(
+		cd reachability-index &&
+		git commit-graph write --reachable --reachability-index &&
+		graph=.git/objects/info/commit-graph &&
+		test_when_finished "rm -f $graph" &&
+		chmod u+w $graph &&
+		offset=$(perl -0777 -ne "/RIDX(.{8})/s and print unpack(\"N\", substr(\$1, 4))" $graph) &&
+		test-tool genzeros 60 |
+			dd of=$graph bs=1 seek=$offset conv=notrunc &&
+		test_must_fail git commit-graph verify 2>err &&
+		grep "reachability index for commit" err
+	)
+'
+
+test_expect_success 'first-parent skips are kept until asked to drop them' '
+	git init first-parent-skips &&
+	(
+		cd first-parent-skips &&
+		test_commit base &&
+		git checkout -b side &&
+		test_commit side &&
+		git checkout - &&
+		test_commit main &&
+		test_merge merge side &&
+
+		git commit-graph write --reachable --first-parent-skips &&
+		graph_read_expect 4 "generation_data first_parent_skips" &&
+		git commit-graph verify &&
+
+		test_commit next &&
+		git commit-graph write --reachable &&
+		graph_read_expect 5 "generation_data first_parent_skips" &&
+
+		git commit-graph write --reachable --no-first-parent-skips &&
+		graph_read_expect 5 generation_data
+	)
+'
+
+test_expect_success 'first-parent skips give the same answers as walking' '
+	git init first-parent-history &&
+	(
+		cd first-parent-history &&
+		# The commit-graph chain below must not start from a graph
+		# written by every commit.
+		GIT_TEST_COMMIT_GRAPH=0 &&
+		for i in $(test_seq 1 40)
+		do
+			test_commit --date "@$((1112912000 + $i * 60)) +0000" \
+				c$i || return 1
+		done &&
+		git checkout -b side c10 &&
+		test_commit side &&
+		git checkout - &&
+		test_merge merge side &&
+		git commit-graph write --reachable --split=no-merge \
+			--first-parent-skips &&
+		test_commit after &&
+		git commit-graph write --reachable --split=no-merge &&
+		test_line_count = 2 .git/objects/info/commit-graphs/commit-graph-chain &&
+		git commit-graph verify &&
+
+		git repack -ad &&
+		test_commit loose &&
+		for args in "HEAD" "HEAD side c20" "--skip=3 -n 10 HEAD side" \
+			"--disk-usage HEAD" "--unpacked HEAD^" \
+			"--since-as-filter=@1112913000 HEAD" "HEAD -- c5.t"
+		do
+			git rev-list --first-parent --count $args >expect &&
+			git -c commitGraph.readFirstParentSkips=false \
+				rev-list --first-parent --count $args >actual &&
+			test_cmp expect actual || return 1
+		done &&
+		for date in 1112912000 1112913200 1112914000 1112915000
+		do
+			git -c commitGraph.readFirstParentSkips=false log \
+				--first-parent --format=%H --before=@$date HEAD side >expect &&
+			git log --first-parent --format=%H --before=@$date \
+				HEAD side >actual &&
+			test_cmp expect actual || return 1
+		done &&
+		git rev-parse c7 >expect &&
+		git merge-base HEAD c7 >actual &&
+		test_cmp expect actual &&
+		git merge-base c7 HEAD >actual &&
+		test_cmp expect actual
+	)
+'
+
+test_expect_success 'verify notices broken first-parent skips' '
+	(
+		cd first-parent-skips &&
+		git commit-graph write --reachable --first-parent-skips &&
+		graph=.git/objects/info/commit-graph &&
+		test_when_finished "rm -f $graph" &&
+		chmod u+w $graph &&
+		offset=$(perl -0777 -ne "/FPSK(.{8})/s and print unpack(\"N\", substr(\$1, 4))" $graph) &&
+		test-tool genzeros 80 |
+			dd of=$graph bs=1 seek=$offset conv=notrunc &&
+		test_must_fail git commit-graph verify 2>err &&
+		grep "first-parent skip for commit" err
+	)
+'
+
+test_expect_success 'idents are kept until asked to drop them' '
+	(
+		cd first-parent-skips &&
+		git commit-graph write --reachable --no-first-parent-skips \
+			--idents &&
+		graph_read_expect 5 "generation_data idents ident_index ident_data" &&
+		git commit-graph verify &&
+
+		test_commit more &&
+		git commit-graph write --reachable &&
+		graph_read_expect 6 "generation_data idents ident_index ident_data" &&
+
+		git commit-graph write --reachable --no-idents &&
+		graph_read_expect 6 generation_data
+	)
+'
+
+test_expect_success 'idents give the same answers as the commits' '
+	git init idents &&
+	(
+		cd idents &&
+		for i in $(test_seq 1 12)
+		do
+			GIT_AUTHOR_NAME="Author $((i % 3))" &&
+			GIT_AUTHOR_EMAIL="a$((i % 3))@example.com" &&
+			GIT_AUTHOR_DATE="@$((1112912000 - $i * 60)) +0000" &&
+			GIT_COMMITTER_NAME="Committer $((i % 2))" &&
+			export GIT_AUTHOR_NAME GIT_AUTHOR_EMAIL GIT_AUTHOR_DATE \
+				GIT_COMMITTER_NAME &&
+			test_commit c$i || return 1
+		done &&
+		git checkout -b side c4 &&
+		test_commit side &&
+		git -c i18n.commitEncoding=ISO-8859-1 commit --allow-empty \
+			-m latin1 &&
+		git checkout - &&
+		test_merge merge side &&
+		git commit-graph write --reachable --idents &&
+		git commit-graph verify &&
+		echo "New Name <new@example.com> <a1@example.com>" >.mailmap &&
+
+		for args in "--author=Author.1" "--committer=Committer.0" \
+			"--author=a2@ --committer=Committer.1 --all-match" \
+			"--author=Author.0 --invert-grep" \
+			"--use-mailmap --author=New" \
+			"--author-date-order" "--topo-order --author-date-order"
+		do
+			git -c commitGraph.readIdents=false log --format=%H $args \
+				>expect &&
+			git log --format=%H $args >actual &&
+			test_cmp expect actual || return 1
+		done
+	)
+'
+
+test_expect_success 'verify notices broken idents' '
+	(
+		cd idents &&
+		graph=.git/objects/info/commit-graph &&
+		test_when_finished "rm -f $graph" &&
+		chmod u+w $graph &&
+		offset=$(perl -0777 -ne "/IDNT(.{8})/s and print unpack(\"N\", substr(\$1, 4))" $graph) &&
+		test-tool genzeros 16 |
+			dd of=$graph bs=1 seek=$offset conv=notrunc &&
+		test_must_fail git commit-graph verify 2>err &&
+		grep "commit-graph author date for commit" err
+	)
+'
+
 test_done
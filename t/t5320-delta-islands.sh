@@ -142,4 +142,54 @@ test_expect_success 'unmatched island core is not fatal' '
 	git -c "pack.islandcore=one" repack -adfi
 '
 
+test_expect_success 'repack writes island marks' '
+	git config pack.island "refs/heads/(.*)" &&
+	git config pack.writeIslandMarks true &&
+	git repack -adfi &&
+	ls .git/objects/pack/*.islands >islands &&
+	test_line_count = 1 islands &&
+	is_delta_base $one $root &&
+	is_delta_base $two $root
+'
+
+test_expect_success 'island marks of unchanged islands are reused' '
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" git repack -adfi &&
+	grep "\"key\":\"islands/stable\",\"value\":\"3\"" trace &&
+	ls .git/objects/pack/*.islands >islands &&
+	test_line_count = 1 islands &&
+	is_delta_base $one $root &&
+	is_delta_base $two $root
+'
+
+test_expect_success 'island marks of changed islands are recomputed' '
+	commit one shared 12-longer $(git rev-parse two) &&
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" git repack -adfi &&
+	grep "\"key\":\"islands/stable\",\"value\":\"2\"" trace &&
+	! is_delta_base $two $one
+'
+
+test_expect_success 'corrupt island marks are ignored' '
+	test_when_finished "rm -f .git/objects/pack/*.islands" &&
+	islands=$(ls .git/objects/pack/*.islands) &&
+	test_copy_bytes 40 <"$islands" >tmp &&
+	chmod +w $islands &&
+	mv tmp $islands &&
+	git repack -adfi 2>err &&
+	grep "island marks file .* is corrupt" err &&
+	! is_delta_base $two $one
+'
+
+test_expect_success 'no island marks for incomplete packs' '
+	git repack -adfi &&
+	commit three shared 3 root &&
+	git repack -di &&
+	ls .git/objects/pack/*.islands >islands &&
+	test_line_count = 1 islands &&
+	git -c pack.writeIslandMarks=false repack -adfi &&
+	ls .git/objects/pack >files &&
+	! grep "\.islands$" files
+'
+
 test_done
@@ -303,6 +303,38 @@ test_midx_bitmap_cases () {
 		)
 	'
 
+	test_expect_success 'version 2 hash-cache values are propagated as such' '
+		rm -fr repo &&
+		git init repo &&
+		test_when_finished "rm -fr repo" &&
+		(
+			cd repo &&
+			git config pack.writeBitmapLookupTable '"$writeLookupTable"' &&
+			git config pack.nameHashVersion 2 &&
+
+			test_commit base &&
+			test_commit base2 &&
+			git repack -adb &&
+			echo 2 >expect &&
+			test-tool bitmap name-hash-version >actual &&
+			test_cmp expect actual &&
+
+			test-tool bitmap dump-hashes >pack.raw &&
+			sort pack.raw >pack.hashes &&
+
+			test_commit new &&
+			git repack &&
+			git multi-pack-index write --bitmap &&
+
+			test-tool bitmap name-hash-version >actual &&
+			test_cmp expect actual &&
+			test-tool bitmap dump-hashes >midx.raw &&
+			sort midx.raw >midx.hashes &&
+			comm -23 pack.hashes midx.hashes >dropped.hashes &&
+			test_must_be_empty dropped.hashes
+		)
+	'
+
 	test_expect_success 'no .bitmap is written without any objects' '
 		rm -fr repo &&
 		git init repo &&
@@ -366,6 +398,27 @@ test_expect_success 'multi-pack-index write writes lookup table if enabled' '
 	)
 '
 
+test_expect_success 'multi-pack-index write honors pack.bitmapVersion' '
+	rm -fr repo &&
+	git init repo &&
+	test_when_finished "rm -fr repo" &&
+	(
+		cd repo &&
+		test_commit_bulk --message="base %s" 10 &&
+		git repack -d &&
+		test_commit_bulk --start=11 --message="more %s" 10 &&
+		git repack -d &&
+
+		git -c pack.bitmapVersion=2 multi-pack-index write --bitmap &&
+		git rev-list --test-bitmap HEAD 2>err &&
+		grep "Bitmap v2 test" err &&
+
+		git rev-list --count --objects --all >expect &&
+		git rev-list --count --objects --all --use-bitmap-index >actual &&
+		test_cmp expect actual
+	)
+'
+
 test_expect_success 'preferred pack change with existing MIDX bitmap' '
 	git init preferred-pack-with-existing &&
 	(
@@ -0,0 +1,166 @@
+#!/bin/sh
+
+test_description='persistent delta base cache'
+
+. ./test-lib.sh
+
+cache_dir=.git/objects/info/delta-base-cache
+
+count_entries () {
+	find $cache_dir -type f -path "$cache_dir/*/*" >entries &&
+	wc -l <entries
+}
+
+test_expect_success 'setup' '
+	test_seq 1000 >file &&
+	for i in $(test_seq 20)
+	do
+		sed -e "s/^$((i * 10))\$/changed $i/" file >file.new &&
+		mv file.new file &&
+		git add file &&
+		test_tick &&
+		git commit -q -m "commit $i" || return 1
+	done &&
+	git repack -adf --depth=50 --window=50 &&
+	git cat-file --batch-all-objects --batch >expect
+'
+
+test_expect_success 'cache is disabled by default' '
+	git cat-file --batch-all-objects --batch >actual &&
+	test_cmp expect actual &&
+	test_path_is_missing $cache_dir
+'
+
+test_expect_success 'reconstructed bases are persisted' '
+	test_config core.persistentDeltaBaseCache true &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git cat-file --batch-all-objects --batch >actual &&
+	test_cmp expect actual &&
+	test_path_is_dir $cache_dir &&
+	test $(count_entries) -gt 0 &&
+	grep "\"category\":\"pack-base-cache\",\"key\":\"write\"" trace
+'
+
+test_expect_success 'later processes use the cache' '
+	test_config core.persistentDeltaBaseCache true &&
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git cat-file --batch-all-objects --batch >actual &&
+	test_cmp expect actual &&
+	grep "\"category\":\"pack-base-cache\",\"key\":\"hit\"" trace
+'
+
+test_expect_success 'corrupt entries are detected and dropped' '
+	test_config core.persistentDeltaBaseCache true &&
+	for f in $(find $cache_dir -type f -path "$cache_dir/*/*")
+	do
+		chmod +w $f &&
+		printf "corrupt" | dd of=$f bs=1 seek=16 conv=notrunc 2>/dev/null ||
+		return 1
+	done &&
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git cat-file --batch-all-objects --batch >actual &&
+	test_cmp expect actual &&
+	grep "\"category\":\"pack-base-cache\",\"key\":\"corrupt\"" trace
+'
+
+test_expect_success 'reading objects does not sweep the cache' '
+	test_config core.persistentDeltaBaseCache true &&
+	old=$(ls $cache_dir | grep -v -e "^tmp_" -e "^size") &&
+	test -n "$old" &&
+	echo $old >old-pack &&
+	git repack -adf --depth=3 &&
+	test_path_is_missing .git/objects/pack/pack-$old.pack &&
+	git cat-file --batch-all-objects --batch >actual &&
+	test_cmp expect actual &&
+	test_path_is_dir $cache_dir/$old
+'
+
+test_expect_success 'gc removes the entries of packs that are gone' '
+	test_config core.persistentDeltaBaseCache true &&
+	old=$(cat old-pack) &&
+	git gc &&
+	test_path_is_missing $cache_dir/$old
+'
+
+test_expect_success 'entries of packs that still exist anywhere are kept' '
+	test_config core.persistentDeltaBaseCache true &&
+	git init --bare alt.git &&
+	git repack -adf --depth=50 --window=50 &&
+	pack=$(ls .git/objects/pack/pack-*.pack) &&
+	alt=$(basename $pack .pack) &&
+	alt=${alt#pack-} &&
+	mv .git/objects/pack/pack-$alt.* alt.git/objects/pack/ &&
+	echo "$(pwd)/alt.git/objects" >.git/objects/info/alternates &&
+	test_when_finished "rm -f .git/objects/info/alternates" &&
+	git cat-file --batch-all-objects --batch >actual &&
+	test_cmp expect actual &&
+	test_path_is_dir $cache_dir/$alt &&
+	mkdir $cache_dir/not-a-pack &&
+	git gc &&
+	test_path_is_dir $cache_dir/$alt &&
+	test_path_is_dir $cache_dir/not-a-pack &&
+	mv alt.git/objects/pack/pack-$alt.* .git/objects/pack/
+'
+
+entries_size () {
+	find $cache_dir -type f -path "$cache_dir/*/*" -exec cat {} + | wc -c
+}
+
+test_expect_success 'shallow bases are not persisted' '
+	test_config core.persistentDeltaBaseCache true &&
+	git repack -adf --depth=3 &&
+	rm -rf $cache_dir &&
+	git cat-file --batch-all-objects --batch >actual &&
+	test_cmp expect actual &&
+	test_path_is_missing $cache_dir
+'
+
+test_expect_success 'writers keep track of the cache size' '
+	test_config core.persistentDeltaBaseCache true &&
+	git repack -adf --depth=50 --window=50 &&
+	rm -rf $cache_dir &&
+	git cat-file --batch-all-objects --batch-check="%(objectname) %(objecttype)" >objects &&
+	sed -n "s/ blob\$//p" objects >blobs &&
+	for blob in $(cat blobs)
+	do
+		git cat-file blob $blob >/dev/null || return 1
+	done &&
+	test $(count_entries) -gt 0 &&
+	test $(cat $cache_dir/size) -eq $(entries_size)
+'
+
+test_expect_success 'writers stop adding to a full cache' '
+	test_config core.persistentDeltaBaseCache true &&
+	test_config core.persistentDeltaBaseCacheLimit 16k &&
+	rm -rf $cache_dir trace &&
+	mkdir -p $cache_dir &&
+	echo 16000 >$cache_dir/size &&
+	for blob in $(cat blobs)
+	do
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git cat-file blob $blob >/dev/null || return 1
+	done &&
+	grep "\"category\":\"pack-base-cache\",\"key\":\"full\"" trace &&
+	test 0 -eq $(count_entries)
+'
+
+test_expect_success 'cache size is limited by maintenance' '
+	test_config core.persistentDeltaBaseCache true &&
+	rm -rf $cache_dir &&
+	for blob in $(cat blobs)
+	do
+		git cat-file blob $blob >/dev/null || return 1
+	done &&
+	test $(entries_size) -gt 2048 &&
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" git \
+		-c core.persistentDeltaBaseCacheLimit=2k \
+		maintenance run --task=incremental-repack &&
+	grep "\"category\":\"pack-base-cache\",\"key\":\"evict\"" trace &&
+	test $(entries_size) -le 2048 &&
+	test $(cat $cache_dir/size) -eq $(entries_size)
+'
+
+test_done
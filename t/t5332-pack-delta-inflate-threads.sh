@@ -0,0 +1,61 @@
+#!/bin/sh
+
+test_description='inflating deltas of long chains in parallel'
+
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	test_seq 1000 >file &&
+	for i in $(test_seq 30)
+	do
+		sed -e "s/^$((i * 10))\$/changed $i/" file >file.new &&
+		mv file.new file &&
+		git add file &&
+		test_tick &&
+		git commit -q -m "commit $i" || return 1
+	done &&
+	git repack -adf --depth=50 --window=50 &&
+	git cat-file --batch-all-objects --batch >expect
+'
+
+for threads in 2 4 0
+do
+	test_expect_success "core.deltaInflateThreads=$threads" '
+		git -c core.deltaInflateThreads=$threads \
+			cat-file --batch-all-objects --batch >actual &&
+		test_cmp expect actual &&
+		git -c core.deltaInflateThreads=$threads fsck
+	'
+done
+
+test_expect_success 'deep chains with small pack windows' '
+	git -c core.deltaInflateThreads=2 \
+		-c core.packedGitWindowSize=4k -c core.packedGitLimit=8k \
+		cat-file --batch-all-objects --batch >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'corrupt deltas are still noticed' '
+	pack=$(ls .git/objects/pack/pack-*.pack) &&
+	git verify-pack -v $pack >objects &&
+	# pick the deepest delta; fields are "oid type size size-in-pack
+	# offset depth base"
+	sort -n -k6 objects | tail -n 1 >deepest &&
+	read oid type size packed ofs depth base <deepest &&
+	test $depth -ge 8 &&
+	chmod +w $pack &&
+	# clobber the zlib checksum at the end of the delta payload
+	printf "\377\377" |
+	dd of=$pack bs=1 seek=$((ofs + packed - 2)) conv=notrunc 2>/dev/null &&
+	test_must_fail git -c core.deltaInflateThreads=4 \
+		cat-file blob $oid >out 2>err &&
+	test_i18ngrep "inflate: data stream error" err
+'
+
+test_expect_success 'negative thread count is rejected' '
+	test_must_fail git -c core.deltaInflateThreads=-1 \
+		cat-file -p HEAD 2>err &&
+	test_i18ngrep "invalid number of threads" err
+'
+
+test_done
@@ -0,0 +1,137 @@
+#!/bin/sh
+
+test_description='pseudo-merge bitmaps'
+
+GIT_TEST_MULTI_PACK_INDEX_WRITE_BITMAP=0
+export GIT_TEST_MULTI_PACK_INDEX_WRITE_BITMAP
+
+. ./test-lib.sh
+
+pseudo_merges_applied () {
+	grep "\"key\":\"pseudo_merges_applied\",\"value\":\"$1\"" "$2"
+}
+
+# Each ref under refs/pull points to its own commit on top of main,
+# so that most of them do not get a bitmap.
+test_expect_success 'setup' '
+	test_commit_bulk --id=main 50 &&
+	for i in $(test_seq 40)
+	do
+		test_tick &&
+		blob=$(echo $i | git hash-object -w --stdin) &&
+		tree=$(printf "100644 blob $blob\tpull-$i\n" | git mktree) &&
+		commit=$(git commit-tree -p HEAD~$((i % 20)) -m "pull $i" $tree) &&
+		echo "create refs/pull/$i/head $commit" || return 1
+	done >in &&
+	git update-ref --stdin <in &&
+
+	git rev-list --objects --all >expect.raw &&
+	cut -d" " -f1 expect.raw | sort >expect
+'
+
+test_expect_success 'no pseudo-merges without configuration' '
+	git repack -adb &&
+	test-tool bitmap dump-pseudo-merges >merges &&
+	test_must_be_empty merges
+'
+
+test_expect_success 'write pseudo-merges' '
+	git config bitmapPseudoMerge.pulls.pattern "refs/pull/*" &&
+	git config bitmapPseudoMerge.pulls.maxMerges 4 &&
+	git repack -adb &&
+	test-tool bitmap dump-pseudo-merges >merges &&
+	cat >expect.merges <<-\EOF &&
+	16
+	16
+	8
+	EOF
+	cut -d" " -f1 merges >actual.merges &&
+	test_cmp expect.merges actual.merges
+'
+
+test_expect_success 'new tips leave the older pseudo-merges alone' '
+	test_when_finished "git update-ref -d refs/pull/new/head &&
+		git repack -adb" &&
+	test_tick &&
+	git commit-tree -p HEAD -m new HEAD^{tree} >new &&
+	git update-ref refs/pull/new/head $(cat new) &&
+	git repack -adb &&
+	test-tool bitmap dump-pseudo-merges >merges.new &&
+	head -n 2 merges >expect.old &&
+	head -n 2 merges.new >actual.old &&
+	test_cmp expect.old actual.old &&
+	sed -n 3p merges.new >actual.young &&
+	grep "^9 commits" actual.young
+'
+
+test_expect_success 'walk from all refs uses pseudo-merges' '
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git rev-list --use-bitmap-index --objects --all >actual.raw &&
+	cut -d" " -f1 actual.raw | sort >actual &&
+	test_cmp expect actual &&
+	pseudo_merges_applied 3 trace
+'
+
+test_expect_success 'walk from some refs does not' '
+	rm -f trace &&
+	git rev-list --objects refs/pull/1/head refs/pull/2/head >expect.some &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git rev-list --use-bitmap-index --objects \
+		refs/pull/1/head refs/pull/2/head >actual.some &&
+	cut -d" " -f1 expect.some | sort >expect.some.sorted &&
+	cut -d" " -f1 actual.some | sort >actual.some.sorted &&
+	test_cmp expect.some.sorted actual.some.sorted &&
+	pseudo_merges_applied 0 trace
+'
+
+test_expect_success 'pseudo-merges on the "have" side' '
+	git rev-list --count --objects --all --not refs/pull/* >expect.count &&
+	git rev-list --use-bitmap-index --count --objects \
+		--all --not --glob=refs/pull/* >actual.count &&
+	test_cmp expect.count actual.count
+'
+
+test_expect_success 'clone with pseudo-merges' '
+	git clone --no-local --mirror . clone.git &&
+	git -C clone.git fsck &&
+	git -C clone.git rev-list --objects --all >clone.raw &&
+	cut -d" " -f1 clone.raw | sort >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'threshold leaves out young tips' '
+	test_config bitmapPseudoMerge.pulls.threshold "2005-04-07 00:00:00 +0000" &&
+	git repack -adb &&
+	test-tool bitmap dump-pseudo-merges >merges &&
+	test_must_be_empty merges
+'
+
+test_expect_success 'pseudo-merges in version 2 and multi-pack bitmaps' '
+	test_config pack.bitmapVersion 2 &&
+	git repack -adb &&
+	test-tool bitmap dump-pseudo-merges >merges &&
+	test_line_count = 3 merges &&
+	git rev-list --use-bitmap-index --objects --all >actual.raw &&
+	cut -d" " -f1 actual.raw | sort >actual &&
+	test_cmp expect actual &&
+
+	git repack -ad &&
+	git multi-pack-index write --bitmap &&
+	test-tool bitmap dump-pseudo-merges >merges &&
+	test_line_count = 3 merges &&
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git rev-list --use-bitmap-index --objects --all >actual.raw &&
+	cut -d" " -f1 actual.raw | sort >actual &&
+	test_cmp expect actual &&
+	pseudo_merges_applied 3 trace
+'
+
+test_expect_success 'bad maxMerges' '
+	test_config bitmapPseudoMerge.pulls.maxMerges 0 &&
+	test_must_fail git repack -adb 2>err &&
+	grep "bitmappseudomerge.pulls.maxmerges must be positive" err
+'
+
+test_done
@@ -0,0 +1,197 @@
+#!/bin/sh
+
+test_description='incremental multi-pack-index chains'
+. ./test-lib.sh
+
+GIT_TEST_MULTI_PACK_INDEX=0
+GIT_TEST_MULTI_PACK_INDEX_WRITE_BITMAP=0
+sane_unset GIT_TEST_MIDX_WRITE_REV
+sane_unset GIT_TEST_MIDX_READ_RIDX
+
+objdir=.git/objects
+packdir=$objdir/pack
+midxdir=$packdir/multi-pack-index.d
+midx_chain=$midxdir/multi-pack-index-chain
+
+# Commit a few files in a new pack, named after the prefix "$1".
+add_layer () {
+	test_commit_bulk --start=1 --message="$1 %s" --filename="$1.%s.t" 3 &&
+	git repack -d
+}
+
+test_expect_success 'setup' '
+	git config core.multiPackIndex true &&
+	add_layer base &&
+	git multi-pack-index write --bitmap &&
+	test_path_is_file $packdir/multi-pack-index
+'
+
+test_expect_success 'write a first incremental layer' '
+	add_layer one &&
+	git multi-pack-index write --incremental &&
+	test_path_is_missing $packdir/multi-pack-index &&
+	test_path_is_file $midx_chain &&
+	test_line_count = 1 $midx_chain &&
+	layer=$(cat $midx_chain) &&
+	test_path_is_file $midxdir/multi-pack-index-$layer.midx &&
+	git multi-pack-index verify
+'
+
+test_expect_success 'write more incremental layers' '
+	add_layer two &&
+	git multi-pack-index write --incremental &&
+	test_line_count = 2 $midx_chain &&
+	add_layer three &&
+	git multi-pack-index write --incremental &&
+	test_line_count = 3 $midx_chain &&
+	git multi-pack-index verify &&
+	git count-objects -v >out &&
+	grep "^garbage: 0" out
+'
+
+test_expect_success 'layers are read in order' '
+	git rev-list --objects --all >expect.raw &&
+	sort expect.raw >expect &&
+	GIT_TEST_MULTI_PACK_INDEX=0 git -c core.multiPackIndex=false \
+		rev-list --objects --all >actual.raw &&
+	sort actual.raw >actual &&
+	test_cmp expect actual &&
+	git cat-file --batch-all-objects --batch-check="%(objectname)" >all &&
+	test_line_count = $(git count-objects -v | sed -n "s/in-pack: //p") all
+'
+
+test_expect_success 'incremental write without new packs is a noop' '
+	cp $midx_chain chain.before &&
+	git multi-pack-index write --incremental &&
+	test_cmp chain.before $midx_chain
+'
+
+test_expect_success 'incremental layers with bitmaps' '
+	git multi-pack-index write --bitmap &&
+	test_path_is_missing $midxdir &&
+	for i in four five six
+	do
+		add_layer $i &&
+		git multi-pack-index write --incremental --bitmap || return 1
+	done &&
+	test_line_count = 3 $midx_chain &&
+	for layer in $(cat $midx_chain)
+	do
+		test_path_is_file $midxdir/multi-pack-index-$layer.bitmap ||
+		return 1
+	done &&
+	git rev-list --test-bitmap HEAD &&
+	git rev-list --test-bitmap HEAD~4 &&
+
+	git rev-list --count --objects --all >expect &&
+	git rev-list --count --objects --all --use-bitmap-index >actual &&
+	test_cmp expect actual &&
+
+	git rev-list --count --objects HEAD~4..HEAD >expect &&
+	git rev-list --count --objects HEAD~4..HEAD --use-bitmap-index >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'incremental layers with roaring bitmaps' '
+	test_config pack.bitmapVersion 2 &&
+	add_layer roaring &&
+	git multi-pack-index write --incremental --bitmap &&
+	test_line_count = 4 $midx_chain &&
+	git rev-list --test-bitmap HEAD 2>err &&
+	grep "Bitmap v2 test" err &&
+	git rev-list --test-bitmap HEAD~4 &&
+
+	git rev-list --count --objects --all >expect &&
+	git rev-list --count --objects --all --use-bitmap-index >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'no layer is added for packs of indexed objects only' '
+	cp $midx_chain chain.before &&
+	git rev-parse HEAD HEAD^{tree} | git pack-objects $packdir/pack &&
+	git multi-pack-index write --incremental --bitmap &&
+	test_cmp chain.before $midx_chain &&
+
+	add_layer after-indexed &&
+	git multi-pack-index write --incremental --bitmap &&
+	test_line_count = 5 $midx_chain &&
+	layer=$(tail -n 1 $midx_chain) &&
+	test_path_is_file $midxdir/multi-pack-index-$layer.bitmap &&
+	git rev-list --test-bitmap HEAD
+'
+
+test_expect_success 'incremental bitmap requires a bitmap in the base' '
+	test_when_finished "git multi-pack-index write --bitmap" &&
+	add_layer seven &&
+	git multi-pack-index write --incremental &&
+	add_layer seven-more &&
+	cp $midx_chain chain.before &&
+	test_must_fail git multi-pack-index write --incremental --bitmap 2>err &&
+	test_i18ngrep "cannot write an incremental bitmap without one for its base" err &&
+	test_cmp chain.before $midx_chain &&
+	ls $midxdir/*.midx >layers &&
+	test_line_count = $(wc -l <$midx_chain) layers
+'
+
+test_expect_success 'non-incremental write removes the chain' '
+	add_layer eight &&
+	git multi-pack-index write --incremental &&
+	test_path_is_file $midx_chain &&
+	git multi-pack-index write &&
+	test_path_is_file $packdir/multi-pack-index &&
+	test_path_is_missing $midxdir
+'
+
+test_expect_success 'expire and repack are not supported on a chain' '
+	add_layer nine &&
+	git multi-pack-index write --incremental &&
+	test_must_fail git multi-pack-index expire &&
+	test_must_fail git multi-pack-index repack
+'
+
+test_expect_success '--incremental with --stdin-packs rewrites layers of missing packs' '
+	git multi-pack-index write --bitmap &&
+	for i in ten eleven twelve
+	do
+		ls $packdir/pack-*.idx >before &&
+		add_layer $i &&
+		ls $packdir/pack-*.idx >after &&
+		comm -13 before after >pack-$i &&
+		git multi-pack-index write --incremental --bitmap || return 1
+	done &&
+	test_line_count = 3 $midx_chain &&
+	bottom=$(head -n 1 $midx_chain) &&
+
+	# Roll up the packs of the two top layers into a new pack.
+	for idx in $(cat pack-eleven pack-twelve)
+	do
+		git show-index <$idx || return 1
+	done | cut -d" " -f2 >objs &&
+	new=$(git pack-objects $packdir/pack <objs) &&
+	ls $packdir/pack-*.idx | grep -v -f pack-eleven -f pack-twelve |
+		xargs -n 1 basename >include &&
+	git multi-pack-index write --incremental --bitmap --stdin-packs <include &&
+
+	test_line_count = 2 $midx_chain &&
+	test "$(head -n 1 $midx_chain)" = "$bottom" &&
+	ls $midxdir/*.midx >layers &&
+	test_line_count = 2 layers &&
+	ls $midxdir/*.bitmap >bitmaps &&
+	test_line_count = 2 bitmaps &&
+	git multi-pack-index verify &&
+	git rev-list --test-bitmap HEAD &&
+
+	test-tool read-midx $objdir >midx &&
+	grep "^pack-$new.idx" midx &&
+	! grep -f pack-eleven midx
+'
+
+test_expect_success 'corrupt chain is detected' '
+	test_when_finished "git multi-pack-index write" &&
+	test_oid deadbeef >>$midx_chain &&
+	git rev-list --count --objects --all >actual &&
+	test_must_fail git multi-pack-index verify 2>err &&
+	test_i18ngrep "multi-pack-index chain exists, but failed to parse" err
+'
+
+test_done
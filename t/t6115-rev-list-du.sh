@@ -62,6 +62,74 @@ test_expect_success 'rev-list --disk-usage=human with bitmaps' '
 	grep "$(cat actual_size) bytes" actual
 '
 
+test_expect_success 'rev-list --batch answers each line' '
+	cat >queries <<-\EOF &&
+	HEAD
+	HEAD^..HEAD
+	HEAD@{1} ^HEAD^
+	HEAD@{1}
+	^HEAD
+	HEAD HEAD@{1}
+	--all
+	EOF
+	for opts in --count "--count --objects" --disk-usage "--disk-usage --objects"
+	do
+		while read line
+		do
+			git rev-list $opts $line || return 1
+		done <queries >expect &&
+		git rev-list --use-bitmap-index --batch $opts <queries >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
+test_expect_success 'rev-list --batch usage errors' '
+	test_must_fail git rev-list --batch --count </dev/null 2>err &&
+	test_i18ngrep "requires .--use-bitmap-index." err &&
+	test_must_fail git rev-list --use-bitmap-index --batch </dev/null 2>err &&
+	test_i18ngrep "requires --count or --disk-usage" err
+'
+
+test_expect_success 'rev-list --batch reports bad queries and goes on' '
+	cat >queries <<-\EOF &&
+	HEAD
+	HEAD -- one.t
+	HEAD no-such-ref
+	no-such-ref..HEAD
+	--no-such-option
+	--left-right HEAD...HEAD^
+	HEAD^
+	EOF
+	git rev-list --count HEAD >expect &&
+	cat >>expect <<-EOF &&
+	error: pathspecs are not supported
+	error: bad revision ${SQ}no-such-ref${SQ}
+	error: bad revision ${SQ}no-such-ref..HEAD${SQ}
+	error: unknown argument ${SQ}--no-such-option${SQ}
+	error: cannot use bitmaps for this query
+	EOF
+	git rev-list --count HEAD^ >>expect &&
+	git rev-list --use-bitmap-index --batch --count <queries >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'rev-list --batch with options and --not' '
+	cat >queries <<-\EOF &&
+	HEAD --not HEAD^
+	--branches --not HEAD^
+	HEAD --not --branches
+	EOF
+	for opts in --count "--disk-usage --objects"
+	do
+		git rev-list $opts HEAD --not HEAD^ >expect &&
+		git rev-list $opts --branches --not HEAD^ >>expect &&
+		git rev-list $opts HEAD --not --branches >>expect &&
+		git rev-list --use-bitmap-index --batch $opts \
+			<queries >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
 test_expect_success 'rev-list use --disk-usage unproperly' '
 	test_must_fail git rev-list --objects HEAD --disk-usage=typo 2>err &&
 	cat >expect <<-\EOF &&
@@ -58,11 +58,19 @@ test_expect_success 'setup' '
 	git -c commitGraph.generationVersion=1 commit-graph write --reachable &&
 	mv .git/objects/info/commit-graph commit-graph-no-gdat &&
 	chmod u+w commit-graph-no-gdat &&
+	git commit-graph write --reachable --reachability-index &&
+	mv .git/objects/info/commit-graph commit-graph-reach &&
+	chmod u+w commit-graph-reach &&
+	git show-ref -s commit-5-5 |
+		git commit-graph write --stdin-commits --split --reachability-index &&
+	git commit-graph write --reachable --split=no-merge &&
+	mv .git/objects/info/commit-graphs commit-graphs-reach-split &&
 	git config core.commitGraph true
 '
 
 run_all_modes () {
-	test_when_finished rm -rf .git/objects/info/commit-graph &&
+	test_when_finished rm -rf .git/objects/info/commit-graph \
+		.git/objects/info/commit-graphs &&
 	"$@" <input >actual &&
 	test_cmp expect actual &&
 	cp commit-graph-full .git/objects/info/commit-graph &&
@@ -73,6 +81,13 @@ run_all_modes () {
 	test_cmp expect actual &&
 	cp commit-graph-no-gdat .git/objects/info/commit-graph &&
 	"$@" <input >actual &&
+	test_cmp expect actual &&
+	cp commit-graph-reach .git/objects/info/commit-graph &&
+	"$@" <input >actual &&
+	test_cmp expect actual &&
+	rm .git/objects/info/commit-graph &&
+	cp -R commit-graphs-reach-split .git/objects/info/commit-graphs &&
+	"$@" <input >actual &&
 	test_cmp expect actual
 }
 
@@ -307,6 +322,27 @@ test_expect_success 'commit_contains:miss' '
 	test_all_modes commit_contains --tag
 '
 
+test_expect_success 'contains_many' '
+	X="commit-4-4 commit-7-2" &&
+	printf "X:%s\n" $X >input &&
+	for x in $(test_seq 1 10)
+	do
+		for y in $(test_seq 1 10)
+		do
+			echo "Y:commit-$x-$y" >>input &&
+			if test $x -ge 4 && test $y -ge 4 ||
+			   test $x -ge 7 && test $y -ge 2
+			then
+				git rev-parse commit-$x-$y >>contained
+			fi || return 1
+		done
+	done &&
+	echo "contains_many(_,Y,X,_):" >expect &&
+	sort contained >>expect &&
+	test_all_modes contains_many &&
+	test_all_modes contains_many --tag
+'
+
 test_expect_success 'rev-list: basic topo-order' '
 	git rev-parse \
 		commit-6-6 commit-5-6 commit-4-6 commit-3-6 commit-2-6 commit-1-6 \
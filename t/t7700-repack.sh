@@ -482,4 +482,53 @@ test_expect_success '-n overrides repack.updateServerInfo=true' '
 	test_server_info_missing
 '
 
+test_expect_success 'setup for --path-walk' '
+	git init path-walk &&
+	(
+		cd path-walk &&
+		for i in 1 2 3 4 5 6 7 8
+		do
+			mkdir dir$i &&
+			test-tool genrandom "dir$i" 4096 >dir$i/long-file-name.txt ||
+			return 1
+		done &&
+		git add . &&
+		git commit -m base &&
+		for i in 1 2 3 4 5 6 7 8
+		do
+			echo change >>dir$i/long-file-name.txt || return 1
+		done &&
+		git commit -am change
+	)
+'
+
+blob_deltas () {
+	git verify-pack -v path-walk/.git/objects/pack/pack-*.idx |
+	awk "\$2 == \"blob\" && NF == 7" >blob-deltas &&
+	test_line_count = "$1" blob-deltas
+}
+
+test_expect_success 'repack --path-walk finds deltas between versions of a path' '
+	# The files share the last 16 characters of their path, which is
+	# all the name hash looks at, and the versions of each are more
+	# than a window apart when sorted by size.
+	git -C path-walk repack -adf --window=4 &&
+	blob_deltas 0 &&
+
+	git -C path-walk repack -adf --window=4 --path-walk &&
+	blob_deltas 8 &&
+	git -C path-walk rev-list --objects --all >objects &&
+	while read oid type size size_in_pack offset depth base
+	do
+		path=$(grep "^$oid " objects | cut -d" " -f2) &&
+		grep "^$base $path\$" objects || return 1
+	done <blob-deltas &&
+	git -C path-walk fsck
+'
+
+test_expect_success 'pack.usePathWalk enables --path-walk' '
+	git -C path-walk -c pack.usePathWalk=true repack -adf --window=4 &&
+	blob_deltas 8
+'
+
 test_done
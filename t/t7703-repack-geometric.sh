@@ -277,4 +277,119 @@ test_expect_success '--geometric with pack.packSizeLimit' '
 	)
 '
 
+test_expect_success '--max-bytes and --max-time require --geometric' '
+	test_must_fail git repack -d --max-bytes=1k 2>err &&
+	test_i18ngrep "requires" err &&
+	test_must_fail git repack -d --max-time=10 2>err &&
+	test_i18ngrep "requires" err
+'
+
+test_expect_success '--geometric with --max-bytes defers larger packs' '
+	git init geometric &&
+	test_when_finished "rm -fr geometric" &&
+	(
+		cd geometric &&
+
+		test_commit_bulk --start=1 1 && # 3 objects
+		test_commit_bulk --start=2 1 && # 3 objects
+		test_commit_bulk --start=3 1 && # 3 objects
+		test_commit_bulk --start=4 1 && # 3 objects
+		test_commit_bulk --start=5 8 && # 24 objects
+		find $objdir/pack -name "*.pack" | sort >before &&
+
+		# Enough room for any two of the small packs, but not for
+		# three of them.
+		size=0 &&
+		for p in $(ls -S $objdir/pack/*.pack | sed -n "2,3p")
+		do
+			size=$(($size + $(test_file_size $p))) || return 1
+		done &&
+
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git repack --geometric 2 -d --max-bytes=$size &&
+		grep "\"geometric/rolled_up_packs\",\"value\":\"2\"" trace &&
+		grep "\"geometric/deferred_packs\",\"value\":\"2\"" trace &&
+
+		# The new pack, two deferred small ones, and the large one.
+		find $objdir/pack -name "*.pack" | sort >after &&
+		test_line_count = 4 after &&
+		comm -12 before after >untouched &&
+		test_line_count = 3 untouched &&
+		git fsck &&
+
+		# The next repack picks up where this one stopped.
+		git repack --geometric 2 -d &&
+		find $objdir/pack -name "*.pack" >after &&
+		test_line_count = 2 after
+	)
+'
+
+test_expect_success '--geometric with --max-time rolls up in batches' '
+	git init geometric &&
+	test_when_finished "rm -fr geometric" &&
+	(
+		cd geometric &&
+
+		test_commit_bulk --start=1 1 && # 3 objects
+		test_commit_bulk --start=2 1 && # 3 objects
+		test_commit_bulk --start=3 2 && # 6 objects
+		test_commit_bulk --start=5 4 && # 12 objects
+		test_commit_bulk --start=9 32 && # 96 objects
+		git rev-list --objects --all >expect &&
+
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git repack --geometric 2 -d --max-time=3600 &&
+		grep "\"region_leave\".*\"geometric-rollup\"" trace >batches &&
+		test_line_count -gt 1 batches &&
+		grep "\"geometric/deferred_packs\",\"value\":\"0\"" trace &&
+
+		find $objdir/pack -name "*.pack" >after &&
+		test_line_count = 2 after &&
+		find $objdir/pack -name ".tmp-*" >tmp &&
+		test_must_be_empty tmp &&
+		git rev-list --objects --all >actual &&
+		test_cmp expect actual &&
+		git fsck
+	)
+'
+
+test_expect_success '--geometric --write-midx extends an incremental MIDX chain' '
+	git init geometric &&
+	test_when_finished "rm -fr geometric" &&
+	(
+		cd geometric &&
+		midx_chain=$packdir/multi-pack-index.d/multi-pack-index-chain &&
+
+		test_commit_bulk --start=1 16 && # 48 objects
+		git repack -d &&
+		git multi-pack-index write --incremental --bitmap &&
+		bottom=$(cat $midx_chain) &&
+
+		test_commit_bulk --start=17 1 &&
+		git repack -d &&
+		git multi-pack-index write --incremental --bitmap &&
+		test_commit_bulk --start=18 1 &&
+		git repack -d &&
+		git multi-pack-index write --incremental --bitmap &&
+		test_line_count = 3 $midx_chain &&
+
+		test_commit_bulk --start=19 1 &&
+		git repack --geometric 2 -d --write-midx --write-bitmap-index &&
+
+		# The bottom layer with the large pack stays, the others are
+		# replaced by one with the new pack.
+		test_path_is_missing $midx &&
+		test_line_count = 2 $midx_chain &&
+		test "$(head -n 1 $midx_chain)" = "$bottom" &&
+		find $objdir/pack -name "*.pack" >packs &&
+		test_line_count = 2 packs &&
+		git multi-pack-index verify &&
+		git rev-list --test-bitmap HEAD &&
+
+		git rev-list --count --objects --all >expect &&
+		git rev-list --count --objects --all --use-bitmap-index >actual &&
+		test_cmp expect actual
+	)
+'
+
 test_done